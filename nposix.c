@@ -1,17 +1,37 @@
 /* Copyright (c) Dmitry "Leo" Kuznetsov 2020 see LICENSE for details */
 
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE // mremap()
+#endif
 #include "nposix.h"
 #include <ctype.h>
 #include <inttypes.h>
 #include <math.h>
 #include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <time.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <stdatomic.h>
 #include <sys/mman.h>
+#include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
+#if defined(__linux__) || defined(__APPLE__)
+#include <sys/random.h>
+#endif
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 
 // just in case this code is compiled by C++ (e.g. cl.exe of msvc)
 // to prevent name mangling surround it with begin_c end_c brackets
@@ -118,13 +138,427 @@ static bool str_contains(const char* s1, const char* s2) {
     return strstr(s1, s2) != null;
 }
 
+/* Multi-pattern matcher.
+   Small pattern sets (up to 8) use Teddy-like bucket masks: bit "p" of
+   bucket[k][c] is set when byte "k" of pattern "p" is "c". AND-ing masks
+   of first (up to) 3 bytes at each position rejects almost all positions
+   without looking at patterns at all. Candidates are verified in pattern
+   index order.
+   Larger sets use Aho-Corasick automaton compiled into dense DFA over
+   byte equivalence classes (bytes that do not appear in any pattern all
+   fall into class 0) which keeps transition table small and hot in cache.
+*/
+
+enum { str_matcher_teddy_max = 8, str_matcher_teddy_bytes = 3 };
+
+struct str_matcher_s {
+    int n;
+    int_t max_length;
+    char** pattern;
+    int_t* length;
+    int teddy_bytes; // 0 when Aho-Corasick automaton is used
+    uint8_t bucket[str_matcher_teddy_bytes][256];
+    uint16_t cls[256]; // byte -> equivalence class
+    int classes;
+    int32_t* next;   // [state * classes + cls] -> state
+    int32_t* output; // [state] lowest pattern index ending here or -1
+    int32_t* dict;   // [state] nearest suffix state with output or 0
+};
+
+static void str_matcher_dispose(str_matcher_t* m) {
+    if (m != null) {
+        if (m->pattern != null) {
+            for (int i = 0; i < m->n; i++) { heap.free(m->pattern[i]); }
+        }
+        heap.free(m->pattern);
+        heap.free(m->length);
+        heap.free(m->next);
+        heap.free(m->output);
+        heap.free(m->dict);
+        heap.free(m);
+    }
+}
+
+static bool str_matcher_build_automaton(str_matcher_t* m) {
+    int_t total = 1; // root
+    for (int i = 0; i < m->n; i++) { total += m->length[i]; }
+    m->classes = 1;
+    for (int i = 0; i < m->n; i++) {
+        for (int_t j = 0; j < m->length[i]; j++) {
+            uint8_t c = (uint8_t)m->pattern[i][j];
+            if (m->cls[c] == 0) { m->cls[c] = (uint16_t)m->classes++; }
+        }
+    }
+    const int k = m->classes;
+    m->next = (int32_t*)heap.alloc(total * k * sizeof(int32_t));
+    m->output = (int32_t*)heap.alloc(total * sizeof(int32_t));
+    m->dict = (int32_t*)heap.alloc(total * sizeof(int32_t));
+    int32_t* fail = (int32_t*)heap.alloc(total * sizeof(int32_t));
+    int32_t* queue = (int32_t*)heap.alloc(total * sizeof(int32_t));
+    bool ok = m->next != null && m->output != null && m->dict != null &&
+              fail != null && queue != null;
+    if (ok) {
+        mem.fill(m->next, 0xFF, total * k * sizeof(int32_t)); // -1
+        mem.fill(m->output, 0xFF, total * sizeof(int32_t));
+        int32_t states = 1;
+        for (int i = 0; i < m->n; i++) { // trie
+            int32_t s = 0;
+            for (int_t j = 0; j < m->length[i]; j++) {
+                uint8_t c = (uint8_t)m->pattern[i][j];
+                int32_t* t = &m->next[s * k + m->cls[c]];
+                if (*t < 0) { *t = states++; }
+                s = *t;
+            }
+            if (m->output[s] < 0) { m->output[s] = i; } // duplicates
+        }
+        // breadth first: fail links, dictionary links, DFA transitions
+        int32_t head = 0;
+        int32_t tail = 0;
+        fail[0] = 0;
+        m->dict[0] = 0;
+        for (int c = 0; c < k; c++) {
+            int32_t t = m->next[c];
+            if (t < 0) {
+                m->next[c] = 0;
+            } else {
+                fail[t] = 0;
+                m->dict[t] = 0;
+                queue[tail++] = t;
+            }
+        }
+        while (head < tail) {
+            int32_t s = queue[head++];
+            for (int c = 0; c < k; c++) {
+                int32_t t = m->next[s * k + c];
+                int32_t f = m->next[fail[s] * k + c];
+                if (t < 0) {
+                    m->next[s * k + c] = f;
+                } else {
+                    fail[t] = f;
+                    m->dict[t] = m->output[f] >= 0 ? f : m->dict[f];
+                    queue[tail++] = t;
+                }
+            }
+        }
+    }
+    heap.free(fail);
+    heap.free(queue);
+    return ok;
+}
+
+static str_matcher_t* str_matcher_compile(const char* patterns[], int n) {
+    assertion(n > 0, "n=%d", n);
+    str_matcher_t* m = (str_matcher_t*)heap.allocate(sizeof(str_matcher_t));
+    if (m == null) { return null; }
+    m->n = n;
+    m->pattern = (char**)heap.allocate(n * sizeof(char*));
+    m->length = (int_t*)heap.allocate(n * sizeof(int_t));
+    bool ok = m->pattern != null && m->length != null;
+    int_t min_length = INTPTR_MAX;
+    for (int i = 0; ok && i < n; i++) {
+        m->length[i] = strlen(patterns[i]);
+        assertion(m->length[i] > 0, "patterns[%d] is empty", i);
+        m->pattern[i] = (char*)heap.alloc(m->length[i] + 1);
+        ok = m->pattern[i] != null;
+        if (ok) { mem.copy(m->pattern[i], patterns[i], m->length[i] + 1); }
+        if (m->length[i] > m->max_length) { m->max_length = m->length[i]; }
+        if (m->length[i] < min_length) { min_length = m->length[i]; }
+    }
+    if (ok && n <= str_matcher_teddy_max) {
+        m->teddy_bytes = min_length < str_matcher_teddy_bytes ?
+                         (int)min_length : str_matcher_teddy_bytes;
+        for (int i = 0; i < n; i++) {
+            for (int k = 0; k < m->teddy_bytes; k++) {
+                m->bucket[k][(uint8_t)m->pattern[i][k]] |= (uint8_t)(1U << i);
+            }
+        }
+    } else if (ok) {
+        ok = str_matcher_build_automaton(m);
+    }
+    if (!ok) { str_matcher_dispose(m); m = null; }
+    return m;
+}
+
+static int str_matcher_find_teddy(const str_matcher_t* m,
+        const uint8_t* s, int_t bytes, int_t *at) {
+    const int_t end = bytes - m->teddy_bytes; // inclusive
+    for (int_t i = 0; i <= end; i++) {
+        uint32_t mask = m->bucket[0][s[i]];
+        if (mask != 0 && m->teddy_bytes > 1) { mask &= m->bucket[1][s[i + 1]]; }
+        if (mask != 0 && m->teddy_bytes > 2) { mask &= m->bucket[2][s[i + 2]]; }
+        while (mask != 0) {
+            int p = __builtin_ctz(mask);
+            mask &= mask - 1;
+            if (m->length[p] <= bytes - i &&
+                memcmp(s + i, m->pattern[p], m->length[p]) == 0) {
+                if (at != null) { *at = i; }
+                return p;
+            }
+        }
+    }
+    return -1;
+}
+
+static int str_matcher_find_automaton(const str_matcher_t* m,
+        const uint8_t* s, int_t bytes, int_t *at) {
+    int found = -1;
+    int_t start = 0;
+    int32_t state = 0;
+    for (int_t i = 0; i < bytes; i++) {
+        state = m->next[state * m->classes + m->cls[s[i]]];
+        int32_t t = m->output[state] >= 0 ? state : m->dict[state];
+        while (t != 0) {
+            int p = m->output[t];
+            int_t b = i - m->length[p] + 1;
+            if (found < 0 || b < start || (b == start && p < found)) {
+                found = p;
+                start = b;
+            }
+            t = m->dict[t];
+        }
+        // no match ending further to the right can start before "start":
+        if (found >= 0 && i - start + 1 >= m->max_length) { break; }
+    }
+    if (found >= 0 && at != null) { *at = start; }
+    return found;
+}
+
+static int str_matcher_find(const str_matcher_t* m, const char* s,
+                            int_t bytes, int_t *at) {
+    return m->teddy_bytes > 0 ?
+        str_matcher_find_teddy(m, (const uint8_t*)s, bytes, at) :
+        str_matcher_find_automaton(m, (const uint8_t*)s, bytes, at);
+}
+
+/* Glob is matched by bit-parallel NFA (shift-and). Bit "i" of the state
+   stands for "first i elements of the pattern matched". On each byte
+   non-star elements advance (shift left) when they accept it and star
+   elements keep their bit (self loop). Star also matches empty run so
+   after each step bits of stars propagate to the next element. Because
+   adjacent stars are collapsed on compile single propagation is enough.
+*/
+
+static errno_t str_glob_compile(str_glob_t* g, const char* pattern) {
+    mem.zero(g, sizeof(*g));
+    const uint8_t* p = (const uint8_t*)pattern;
+    int e = 0;
+    while (*p != 0) {
+        if (e >= 63) { return E2BIG; }
+        const uint64_t bit = 1ULL << e;
+        if (*p == '*') {
+            while (*p == '*') { p++; }
+            g->star |= bit;
+        } else if (*p == '?') {
+            for (int c = 0; c < 256; c++) { g->accept[c] |= bit; }
+            p++;
+        } else if (*p == '[') {
+            p++;
+            bool negate = *p == '!' || *p == '^';
+            if (negate) { p++; }
+            bool set[256] = {};
+            bool first = true; // ']' right after '[' or '[!' is literal
+            while (*p != 0 && (*p != ']' || first)) {
+                first = false;
+                if (*p == '\\') { p++; }
+                if (*p == 0) { return EINVAL; }
+                uint8_t from = *p++;
+                uint8_t to = from;
+                if (*p == '-' && p[1] != ']' && p[1] != 0) {
+                    p++;
+                    if (*p == '\\') { p++; }
+                    if (*p == 0) { return EINVAL; }
+                    to = *p++;
+                }
+                for (int c = from; c <= to; c++) { set[c] = true; }
+            }
+            if (*p != ']') { return EINVAL; }
+            p++;
+            for (int c = 0; c < 256; c++) {
+                if (set[c] != negate) { g->accept[c] |= bit; }
+            }
+        } else {
+            if (*p == '\\') { p++; }
+            if (*p == 0) { return EINVAL; }
+            g->accept[*p++] |= bit;
+        }
+        e++;
+    }
+    g->elements = e;
+    return 0;
+}
+
+static bool str_glob_match(const str_glob_t* g, const char* s, int_t bytes) {
+    const uint8_t* b = (const uint8_t*)s;
+    uint64_t state = 1;
+    state |= (state & g->star) << 1;
+    for (int_t i = 0; i < bytes && state != 0; i++) {
+        state = ((state & g->accept[b[i]]) << 1) | (state & g->star);
+        state |= (state & g->star) << 1;
+    }
+    return (state >> g->elements) & 1;
+}
+
+/* Howard Hinnant's constant time civil calendar algorithms
+   http://howardhinnant.github.io/date_algorithms.html
+*/
+
+static int64_t str_days_from_civil(int64_t y, int64_t m, int64_t d) {
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const int64_t yoe = y - era * 400;                           // [0, 399]
+    const int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;  // [0, 146096]
+    return era * 146097 + doe - 719468;
+}
+
+static void str_civil_from_days(int64_t z, int64_t *y, int *m, int *d) {
+    z += 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const int64_t doe = z - era * 146097;
+    const int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const int64_t mp = (5 * doy + 2) / 153;
+    *d = (int)(doy - (153 * mp + 2) / 5 + 1);
+    *m = (int)(mp < 10 ? mp + 3 : mp - 9);
+    *y = yoe + era * 400 + (*m <= 2);
+}
+
+// fixed position digits: any non digit sets bits in *bad
+
+static int str_digits(const char* s, int n, uint32_t *bad) {
+    int v = 0;
+    for (int i = 0; i < n; i++) {
+        uint32_t d = (uint32_t)(uint8_t)s[i] - '0';
+        *bad |= d > 9;
+        v = v * 10 + (int)d;
+    }
+    return v;
+}
+
+static errno_t str_parse_iso8601(const char* s, int_t bytes, int64_t *ns) {
+    // 0123456789012345678
+    // YYYY-MM-DDTHH:MM:SS
+    if (bytes < 20) { return EINVAL; }
+    uint32_t bad = 0;
+    const int year  = str_digits(s +  0, 4, &bad);
+    const int month = str_digits(s +  5, 2, &bad);
+    const int day   = str_digits(s +  8, 2, &bad);
+    const int hour  = str_digits(s + 11, 2, &bad);
+    const int min   = str_digits(s + 14, 2, &bad);
+    const int sec   = str_digits(s + 17, 2, &bad);
+    bad |= (s[4] != '-') | (s[7] != '-') | (s[13] != ':') | (s[16] != ':');
+    bad |= (s[10] != 'T') & (s[10] != 't') & (s[10] != ' ');
+    static const int8_t days_in_month[13] =
+        { 0, 31, 29, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+    const bool leap = (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+    bad |= (month < 1) | (month > 12);
+    if (bad) { return EINVAL; }
+    bad |= (day < 1) | (day > days_in_month[month]) |
+           (month == 2 && day == 29 && !leap);
+    bad |= (hour > 23) | (min > 59) | (sec > 60); // 60: leap second
+    int_t i = 19;
+    int64_t fraction = 0;
+    if (i < bytes && s[i] == '.') {
+        i++;
+        int digits = 0;
+        while (i < bytes && '0' <= s[i] && s[i] <= '9') {
+            if (digits < 9) { fraction = fraction * 10 + (s[i] - '0'); }
+            digits++;
+            i++;
+        }
+        bad |= digits == 0;
+        for (int k = digits; k < 9; k++) { fraction *= 10; }
+    }
+    int offset = 0; // seconds east of UTC
+    if (i < bytes && (s[i] == 'Z' || s[i] == 'z')) {
+        i++;
+    } else if (i < bytes && (s[i] == '+' || s[i] == '-')) {
+        const int sign = s[i] == '-' ? -1 : 1;
+        // "+HH:MM" or "+HHMM"
+        const bool colon = bytes - i >= 6 && s[i + 3] == ':';
+        if (bytes - i < (colon ? 6 : 5)) { return EINVAL; }
+        const int oh = str_digits(s + i + 1, 2, &bad);
+        const int om = str_digits(s + i + (colon ? 4 : 3), 2, &bad);
+        bad |= (oh > 23) | (om > 59);
+        offset = sign * (oh * 3600 + om * 60);
+        i += colon ? 6 : 5;
+    } else {
+        bad = 1; // RFC 3339 requires time zone offset
+    }
+    bad |= i != bytes;
+    if (bad) { return EINVAL; }
+    const int64_t days = str_days_from_civil(year, month, day);
+    int64_t seconds = days * 86400 + hour * 3600 + min * 60 + sec - offset;
+    // int64_t nanoseconds span 1677-09-21T00:12:43.145224192Z to
+    // 2262-04-11T23:47:16.854775807Z; borrow a second for negative
+    // times so that INT64_MIN itself does not overflow the product:
+    if (seconds < 0 && fraction > 0) {
+        seconds++;
+        fraction -= 1000000000LL;
+    }
+    int64_t v = 0;
+    if (__builtin_mul_overflow(seconds, 1000000000LL, &v) ||
+        __builtin_add_overflow(v, fraction, &v)) {
+        return ERANGE;
+    }
+    *ns = v;
+    return 0;
+}
+
+static char* str_put_digits(char* s, int64_t v, int n) {
+    for (int i = n - 1; i >= 0; i--) { s[i] = (char)('0' + v % 10); v /= 10; }
+    return s + n;
+}
+
+static int_t str_format_iso8601(char* s, int_t count, int64_t ns,
+                                int digits) {
+    assertion(0 <= digits && digits <= 9, "digits=%d", digits);
+    // "YYYY-MM-DDTHH:MM:SSZ" and zero terminator plus '.' and digits
+    assertion(count >= 21 + (digits > 0) + digits, "count=%lld digits=%d",
+              (int64_t)count, digits);
+    // floor division so that negative (before 1970) times work too
+    int64_t seconds = ns / 1000000000LL;
+    int64_t fraction = ns % 1000000000LL;
+    if (fraction < 0) { fraction += 1000000000LL; seconds--; }
+    int64_t days = seconds / 86400;
+    int64_t sod = seconds % 86400;
+    if (sod < 0) { sod += 86400; days--; }
+    int64_t year = 0;
+    int month = 0;
+    int day = 0;
+    str_civil_from_days(days, &year, &month, &day);
+    assertion(0 <= year && year <= 9999, "year=%lld", year);
+    char* p = s;
+    p = str_put_digits(p, year, 4);   *p++ = '-';
+    p = str_put_digits(p, month, 2);  *p++ = '-';
+    p = str_put_digits(p, day, 2);    *p++ = 'T';
+    p = str_put_digits(p, sod / 3600, 2); *p++ = ':';
+    p = str_put_digits(p, sod / 60 % 60, 2); *p++ = ':';
+    p = str_put_digits(p, sod % 60, 2);
+    if (digits > 0) {
+        *p++ = '.';
+        for (int i = digits; i < 9; i++) { fraction /= 10; }
+        p = str_put_digits(p, fraction, digits);
+    }
+    *p++ = 'Z';
+    *p = 0;
+    return p - s;
+}
+
 str_if str = {
     .length = str_length,
     .equals = str_equals,
     .to_double = str_to_double,
     .to_int64 = str_to_int64,
     .starts_with = str_starts_with,
-    .contains = str_contains
+    .contains = str_contains,
+    .matcher_compile = str_matcher_compile,
+    .matcher_find = str_matcher_find,
+    .matcher_dispose = str_matcher_dispose,
+    .glob_compile = str_glob_compile,
+    .glob_match = str_glob_match,
+    .parse_iso8601 = str_parse_iso8601,
+    .format_iso8601 = str_format_iso8601
 };
 
 typedef struct random_48bit_seed_s {
@@ -200,339 +634,6738 @@ random_generator_if random_generator = {
     .next_seeded_double = random_next_seeded_double,
 };
 
-static double time_since_epoch(void) {
-    struct timespec ts;
-    clock_gettime(CLOCK_REALTIME, &ts);
-    uint64_t ns = ts.tv_sec * (uint64_t)process_clock.nsec_per_sec + ts.tv_nsec;
-    return ns / (double)process_clock.nsec_per_sec;
+static double sampling_next_double(random_generator_if* rg, uint64_t* seed) {
+    return seed == null ? rg->next_double() : rg->next_seeded_double(seed);
 }
 
-static double time_in_seconds(void) {
-    struct timespec ts = {};
-#ifdef __APPLE__
-    static clockid_t process_clock_id = CLOCK_PROCESS_CPUTIME_ID;
-#else
-    static clockid_t process_clock_id;
-    if (process_clock_id == 0) {
-        if_error_fatal(clock_getcpuclockid(0, &process_clock_id));
+static void sampling_alias_dispose(random_alias_t* a) {
+    heap.free(a->probability);
+    heap.free(a->alias);
+    mem.zero(a, sizeof(*a));
+}
+
+static errno_t sampling_alias_init(random_alias_t* a, const double weights[],
+                                   int_t n) {
+    mem.zero(a, sizeof(*a));
+    double sum = 0;
+    for (int_t i = 0; i < n; i++) {
+        if (!(weights[i] >= 0) || isinf(weights[i])) { return EINVAL; }
+        sum += weights[i];
     }
-#endif
-    if_error_fatal(clock_gettime(process_clock_id, &ts));
-    uint_fast64_t ns = ts.tv_sec * (uint_fast64_t)process_clock.nsec_per_sec + ts.tv_nsec;
-#ifdef PROCESS_CLOCK_TIME_ZERO_AT_FIRST_CALL
-    // convinience - number of seconds since first call
-    static atomic_uint_fast64_t first;
-    uint_fast64_t zero = 0;
-    atomic_compare_exchange_strong(&first, &zero, ns); // prevent negative
-    if (first == 0) {
-        traceln("atomic_compare_exchange_strong() failed?");
-        first = ns; // Plan B
+    if (n <= 0 || !(sum > 0)) { return EINVAL; }
+    a->n = n;
+    a->probability = (double*)heap.alloc(n * sizeof(double));
+    a->alias = (int_t*)heap.alloc(n * sizeof(int_t));
+    int_t* work = (int_t*)heap.alloc(n * sizeof(int_t));
+    if (a->probability == null || a->alias == null || work == null) {
+        heap.free(work);
+        sampling_alias_dispose(a);
+        return ENOMEM;
     }
-    ns = ns - first;
-#endif
-    return ns / (double)process_clock.nsec_per_sec; // nanoseconds to seconds
+    // Vose: "work" holds small columns growing from the start and large
+    // columns growing from the end
+    double* p = a->probability;
+    int_t small = 0;
+    int_t large = n;
+    for (int_t i = 0; i < n; i++) {
+        p[i] = weights[i] * n / sum;
+        a->alias[i] = i;
+        if (p[i] < 1) { work[small++] = i; } else { work[--large] = i; }
+    }
+    while (small > 0 && large < n) {
+        int_t s = work[--small];
+        int_t l = work[large++];
+        a->alias[s] = l; // p[s] stays as probability of keeping "s"
+        p[l] = (p[l] + p[s]) - 1;
+        if (p[l] < 1) { work[small++] = l; } else { work[--large] = l; }
+    }
+    // leftovers are 1 up to rounding errors
+    while (small > 0) { p[work[--small]] = 1; }
+    while (large < n) { p[work[large++]] = 1; }
+    heap.free(work);
+    return 0;
 }
 
-process_clock_if process_clock = {
-    .nsec_per_sec = 1000000000,
-    .usec_per_sec = 1000000,
-    .msec_per_sec = 1000,
-    .time_since_epoch = time_since_epoch,
-    .time = time_in_seconds
-};
+static int_t sampling_alias_draw(const random_alias_t* a,
+                                 random_generator_if* rg, uint64_t* seed) {
+    double u = sampling_next_double(rg, seed) * a->n;
+    int_t i = (int_t)u;
+    if (i >= a->n) { i = a->n - 1; } // paranoia about rounding
+    return u - i < a->probability[i] ? i : a->alias[i];
+}
 
-static void mutex_init(mutex_t* m) {
-    if_error_fatal(pthread_mutex_init(m, null));
+// (0..1] because log(0) is not useful
+
+static double sampling_uniform(random_reservoir_t* r) {
+    return 1.0 - sampling_next_double(r->rg, r->seed);
 }
 
-static void mutex_lock(mutex_t* m) {
-    if_error_fatal(pthread_mutex_lock(m));
+static void sampling_reservoir_advance(random_reservoir_t* r) {
+    r->w *= exp(log(sampling_uniform(r)) / r->k);
+    double skip = floor(log(sampling_uniform(r)) / log1p(-r->w));
+    // w close to 1.0 yields skip == -0.0, huge skips are capped
+    r->next += 1 + (skip > 0 ? (skip < (double)INTPTR_MAX / 2 ?
+                                (int_t)skip : INTPTR_MAX / 2) : 0);
 }
 
-static errno_t mutex_try_lock(mutex_t* m) {
-    int mutex_trylock = pthread_mutex_trylock(m);
-    if (mutex_trylock != EBUSY) {
-        if_error_fatal(mutex_trylock);
-    }
-    return mutex_trylock;
+static void sampling_reservoir_init(random_reservoir_t* r, int_t k,
+                                    random_generator_if* rg, uint64_t* seed) {
+    assertion(k > 0, "k=%lld", (int64_t)k);
+    r->k = k;
+    r->seen = 0;
+    r->rg = rg;
+    r->seed = seed;
+    r->w = 1.0;
+    r->next = k - 1;
+    sampling_reservoir_advance(r); // first replacement after reservoir fill
 }
 
-static void mutex_unlock(mutex_t* m) {
-    if_error_fatal(pthread_mutex_unlock(m));
+static int_t sampling_reservoir_offer(random_reservoir_t* r) {
+    int_t i = r->seen++;
+    int_t slot = -1;
+    if (i < r->k) {
+        slot = i;
+    } else if (i == r->next) {
+        slot = (int_t)(sampling_next_double(r->rg, r->seed) * r->k);
+        if (slot >= r->k) { slot = r->k - 1; }
+        sampling_reservoir_advance(r);
+    }
+    return slot;
 }
 
-static void mutex_dispose(mutex_t* m) {
-    if_error_fatal(pthread_mutex_destroy(m));
+static int_t sampling_reservoir_skip(random_reservoir_t* r) {
+    int_t skip = 0;
+    if (r->seen >= r->k && r->next > r->seen) {
+        skip = r->next - r->seen;
+        r->seen = r->next;
+    }
+    return skip;
 }
 
-mutex_if mutex = {
-    .init = mutex_init,
-    .lock = mutex_lock,
-    .try_lock = mutex_try_lock,
-    .unlock = mutex_unlock,
-    .dispose = mutex_dispose
+sampling_if sampling = {
+    .alias_init = sampling_alias_init,
+    .alias_draw = sampling_alias_draw,
+    .alias_dispose = sampling_alias_dispose,
+    .reservoir_init = sampling_reservoir_init,
+    .reservoir_offer = sampling_reservoir_offer,
+    .reservoir_skip = sampling_reservoir_skip
 };
 
-static void event_init(event_t* e) {
-    if_error_fatal(pthread_cond_init(e, null));
-}
+/* ChaCha20 (RFC 7539) four blocks at a time. Each state word is an array
+   of 4 lanes (one per block) so that quarter rounds are plain loops over
+   lanes which compilers turn into SSE/NEON vector instructions.
+*/
 
-static void event_signal(event_t* e) {
-    if_error_fatal(pthread_cond_signal(e));
+enum { secure_random_lanes = 4, secure_random_buffer = 64 * 4 };
+
+typedef uint32_t secure_random_lanes_t[secure_random_lanes];
+
+static inline uint32_t secure_random_rotl(uint32_t v, int n) {
+    return (v << n) | (v >> (32 - n));
 }
 
-static void event_wait(event_t* e, mutex_t* m) {
-    if_error_fatal(pthread_cond_wait(e, m));
+static inline void secure_random_quarter(secure_random_lanes_t* x,
+                                         int a, int b, int c, int d) {
+    for (int i = 0; i < secure_random_lanes; i++) {
+        x[a][i] += x[b][i]; x[d][i] = secure_random_rotl(x[d][i] ^ x[a][i], 16);
+        x[c][i] += x[d][i]; x[b][i] = secure_random_rotl(x[b][i] ^ x[c][i], 12);
+        x[a][i] += x[b][i]; x[d][i] = secure_random_rotl(x[d][i] ^ x[a][i], 8);
+        x[c][i] += x[d][i]; x[b][i] = secure_random_rotl(x[b][i] ^ x[c][i], 7);
+    }
 }
 
-static errno_t event_timed_wait(event_t* e, mutex_t* m, double seconds) {
-    // Nothing is ever easy with posix.
-    // pthread_cond_timedwait() uses *unspecified* abstime
-    // which is a guess work for each OS
-    // e.g. see:
-    // https://github.com/apple/darwin-libpthread/blob/master/tests/cond_timed.c
-    struct timespec now = {};
-    if_error_fatal(clock_gettime(CLOCK_REALTIME, &now)); // since epoch
-    uint64_t now_ns = now.tv_sec * process_clock.nsec_per_sec + now.tv_nsec;
-    uint64_t wait_ns = seconds * process_clock.nsec_per_sec;
-    uint64_t abs_ns = now_ns + wait_ns;
-    struct timespec ts = {};
-    ts.tv_sec = (time_t)(abs_ns / process_clock.nsec_per_sec);
-    ts.tv_nsec = (long)(abs_ns % process_clock.nsec_per_sec);
-    double time = process_clock.time();
-    int timedwait_result = pthread_cond_timedwait(e, m, &ts);
-    time = process_clock.time() - time;
-    if (timedwait_result != 0 && timedwait_result != ETIMEDOUT) {
-        if_error_fatal(timedwait_result);
+static void secure_random_chacha20(const uint32_t key[8], uint32_t counter,
+        const uint32_t nonce[3], uint8_t out[secure_random_buffer]) {
+    secure_random_lanes_t input[16];
+    secure_random_lanes_t x[16];
+    for (int i = 0; i < secure_random_lanes; i++) {
+        input[0][i] = 0x61707865; // "expand 32-byte k"
+        input[1][i] = 0x3320646E;
+        input[2][i] = 0x79622D32;
+        input[3][i] = 0x6B206574;
+        for (int k = 0; k < 8; k++) { input[4 + k][i] = key[k]; }
+        input[12][i] = counter + (uint32_t)i;
+        for (int k = 0; k < 3; k++) { input[13 + k][i] = nonce[k]; }
     }
-    // CLOCK_REALTIME may be adjusted on the fly by (e.g. NTP) which may
-    // result in spurious early wake on (e.g. at Day Time Savings adjustment)
-    if (timedwait_result == ETIMEDOUT && time < seconds) {
-        traceln("WARNING: spurious early wake %.3fs while waiting for %.3fs",
-                time, seconds);
+    mem.copy(x, input, sizeof(x));
+    for (int round = 0; round < 10; round++) { // 20 rounds: column+diagonal
+        secure_random_quarter(x, 0, 4,  8, 12);
+        secure_random_quarter(x, 1, 5,  9, 13);
+        secure_random_quarter(x, 2, 6, 10, 14);
+        secure_random_quarter(x, 3, 7, 11, 15);
+        secure_random_quarter(x, 0, 5, 10, 15);
+        secure_random_quarter(x, 1, 6, 11, 12);
+        secure_random_quarter(x, 2, 7,  8, 13);
+        secure_random_quarter(x, 3, 4,  9, 14);
+    }
+    for (int i = 0; i < secure_random_lanes; i++) {
+        for (int k = 0; k < 16; k++) {
+            uint32_t v = x[k][i] + input[k][i];
+            uint8_t* p = out + i * 64 + k * 4;
+            p[0] = (uint8_t)v;
+            p[1] = (uint8_t)(v >> 8);
+            p[2] = (uint8_t)(v >> 16);
+            p[3] = (uint8_t)(v >> 24);
+        }
     }
-    return timedwait_result;
 }
 
-static void event_dispose(event_t* e) {
-    if_error_fatal(pthread_cond_destroy(e));
+typedef struct {
+    uint32_t key[8];
+    uint32_t nonce[3];
+    uint32_t counter;
+    uint64_t generation; // 0 - not seeded yet
+    int position; // of next unused byte in buffer
+    uint8_t buffer[secure_random_buffer];
+} secure_random_state_t;
+
+static _Thread_local secure_random_state_t secure_random_state;
+
+// bumped in child process after fork() so that parent and child
+// never share keystream
+
+static atomic_uint_fast64_t secure_random_generation = 1;
+
+static void secure_random_after_fork(void) {
+    atomic_fetch_add(&secure_random_generation, 1);
 }
 
-event_if event = {
-    .init = event_init,
-    .signal = event_signal,
-    .wait = event_wait,
-    .timed_wait = event_timed_wait,
-    .dispose = event_dispose
-};
+static void secure_random_register_atfork(void) {
+    if_error_fatal(pthread_atfork(null, null, secure_random_after_fork));
+}
 
-static void thread_sleep(double secs) {
-    double deadline = process_clock.time() + secs;
-    for (;;) {
-        double s = deadline - process_clock.time();
-        if (s <= 0) { break; }
-        const double nsd = s * (double)process_clock.nsec_per_sec;
-        long ns = (long)(((int64_t)nsd) % process_clock.nsec_per_sec);
-        struct timespec req = { (time_t)s, ns };
-        nanosleep(&req, null); // can be interrupted
+static void secure_random_entropy(void* data, int_t bytes) {
+    uint8_t* p = (uint8_t*)data;
+    while (bytes > 0) {
+        int_t n = bytes < 256 ? bytes : 256; // getentropy() limit
+#if defined(__linux__)
+        ssize_t k = getrandom(p, n, 0);
+        if (k < 0 && errno == EINTR) { continue; }
+        if (k <= 0) { fatal("getrandom() failed %s", strerror(errno)); }
+        n = k;
+#else
+        if (getentropy(p, n) != 0) {
+            fatal("getentropy() failed %s", strerror(errno));
+        }
+#endif
+        p += n;
+        bytes -= n;
     }
 }
 
-static void thread_start(thread_t* t, void (*function)(void*), void* p,
-                          int_t stack_size, bool detached) {
-    void* (*f)(void*) = (void* (*)(void*))function;
-    pthread_attr_t a;
-    if_error_fatal(pthread_attr_init(&a));
-    if (stack_size > 0) {
-        if_error_fatal(pthread_attr_setstacksize(&a, stack_size));
+static void secure_random_reseed(void) {
+    static pthread_once_t atfork_once = PTHREAD_ONCE_INIT;
+    if_error_fatal(pthread_once(&atfork_once, secure_random_register_atfork));
+    secure_random_state_t* s = &secure_random_state;
+    uint32_t seed[11];
+    secure_random_entropy(seed, sizeof(seed));
+    mem.copy(s->key, seed, sizeof(s->key));
+    mem.copy(s->nonce, seed + 8, sizeof(s->nonce));
+    mem.zero(seed, sizeof(seed));
+    s->counter = 0;
+    s->position = secure_random_buffer; // empty
+    s->generation = atomic_load(&secure_random_generation);
+}
+
+static void secure_random_refill(secure_random_state_t* s) {
+    secure_random_chacha20(s->key, s->counter, s->nonce, s->buffer);
+    s->counter += secure_random_lanes;
+    // fast key erasure: previous outputs cannot be reconstructed
+    // from the state even if it is compromised later
+    mem.copy(s->key, s->buffer, sizeof(s->key));
+    mem.zero(s->buffer, sizeof(s->key));
+    s->position = sizeof(s->key);
+}
+
+static void secure_random_fill_bytes(void* data, int_t bytes) {
+    secure_random_state_t* s = &secure_random_state;
+    if (s->generation != atomic_load(&secure_random_generation)) {
+        secure_random_reseed();
     }
-    if (detached > 0) {
-        if_error_fatal(pthread_attr_setdetachstate(&a, 1));
+    uint8_t* p = (uint8_t*)data;
+    while (bytes > 0) {
+        if (s->position == secure_random_buffer) { secure_random_refill(s); }
+        int_t n = secure_random_buffer - s->position;
+        if (n > bytes) { n = bytes; }
+        mem.copy(p, s->buffer + s->position, n);
+        mem.zero(s->buffer + s->position, n); // served bytes are not kept
+        s->position += (int)n;
+        p += n;
+        bytes -= n;
     }
-    if_error_fatal(pthread_create(t, &a, f, p));
-    if_error_fatal(pthread_attr_destroy(&a));
 }
 
-void thread_join(thread_t t) { if_error_fatal(pthread_join(t, null)); }
+static uint64_t secure_random_next_uint64(void) {
+    uint64_t v = 0;
+    secure_random_fill_bytes(&v, sizeof(v));
+    return v;
+}
 
-threads_if threads = {
-    thread_start,
-    thread_join,
-    thread_sleep
-};
+static int32_t secure_random_next_int32(void) {
+    uint32_t v = 0;
+    secure_random_fill_bytes(&v, sizeof(v));
+    return (int32_t)v;
+}
 
-static void memmap_file(const char* fn, int_t offset, int_t size,
-                        void* *data, int_t *bytes, int* r, bool readonly) {
-    assertion(*data == null && *bytes == 0 && *r == 0,
-              "invalid (uninitialized or reused) parameters");
-    if_error_return(*data != null || *bytes != 0, { *r = EINVAL; }, {});
-    assertion(offset >= 0, "negative offset = %lld is invalid", (int64_t)offset);
-    if_error_return(offset < 0, { *r = EINVAL; }, {});
-    int f = open(fn, readonly ? O_RDONLY : O_RDWR);
-    if_error_return(f < 0, { *r = errno; }, {});
-    if (size <= 0) { // use file size instead of specified size:
-        struct stat s = {};
-        if_error_return(fstat(f, &s) < 0, { *r = errno; }, { close(f); });
-        size = (int)s.st_size;
-    }
-    const int protection = PROT_READ | (readonly ? 0 : PROT_WRITE);
-    const int flags = readonly ? MAP_PRIVATE : MAP_SHARED;
-    *bytes = size;
-    *data = mmap(null, size, protection, flags, f, 0);
-    if_error_return(*data == null, { *r = errno; }, { close(f); });
-    if_error_fatal(close(f));
+static int32_t secure_random_next_uint32(void) {
+    uint32_t v = 0;
+    secure_random_fill_bytes(&v, sizeof(v));
+    return (int32_t)(v >> 1);
 }
 
-static int memmap_file_readonly(const char* fn, void* *data, int_t *bytes) {
-    int r = 0;
-    memmap_file(fn, 0, 0, data, bytes, &r, true);
-    return r;
+static double secure_random_next_double(void) {
+    return (secure_random_next_uint64() >> 11) * (1.0 / (1ULL << 53));
 }
 
-static int memmap_file_readwrite(const char* fn, int_t offset, int_t size,
-                                 void* *data, int_t *bytes) {
-    int r = 0;
-    memmap_file(fn, offset, size, data, bytes, &r, false);
+secure_random_if secure_random = {
+    .next_int32 = secure_random_next_int32,
+    .next_uint32 = secure_random_next_uint32,
+    .next_uint64 = secure_random_next_uint64,
+    .next_double = secure_random_next_double,
+    .fill_bytes = secure_random_fill_bytes,
+    .reseed = secure_random_reseed
+};
+
+enum { sequence_kind_sobol = 1, sequence_kind_halton = 2 };
+
+// GF(2) polynomial product of "a" and "b" modulo "p" of degree "s"
+
+static uint32_t sequence_gf2_mul(uint32_t a, uint32_t b, uint32_t p, int s) {
+    uint32_t r = 0;
+    while (b != 0) {
+        if (b & 1) { r ^= a; }
+        b >>= 1;
+        a <<= 1;
+        if (a & (1U << s)) { a ^= p; }
+    }
     return r;
 }
 
-static int memmap_file_unmap(void *data, int_t bytes) {
-    int r = 0;
-    if (data != null && bytes != 0) {
-        if_error_fatal(munmap((void*)data, bytes));
-    } else {
-        r = EINVAL;
+static uint32_t sequence_gf2_pow_x(uint32_t e, uint32_t p, int s) {
+    uint32_t r = 1;
+    uint32_t x = s == 1 ? (2 ^ p) : 2; // x mod p
+    while (e != 0) {
+        if (e & 1) { r = sequence_gf2_mul(r, x, p, s); }
+        x = sequence_gf2_mul(x, x, p, s);
+        e >>= 1;
     }
     return r;
 }
 
-memmap_if memmap = {
-    .file_readonly = memmap_file_readonly,
-    .file_readwrite = memmap_file_readwrite, // TODO
-    .file_unmap = memmap_file_unmap,
-    // TODO: the rest of it
-};
+// primitive iff multiplicative order of x modulo p is exactly 2^s - 1
+
+static bool sequence_primitive(uint32_t p, int s) {
+    const uint32_t order = (1U << s) - 1;
+    if (sequence_gf2_pow_x(order, p, s) != 1) { return false; }
+    uint32_t n = order;
+    for (uint32_t q = 2; q * q <= n; q++) {
+        if (n % q == 0) {
+            if (sequence_gf2_pow_x(order / q, p, s) == 1) { return false; }
+            while (n % q == 0) { n /= q; }
+        }
+    }
+    return n == 1 || n == order || sequence_gf2_pow_x(order / n, p, s) != 1;
+}
+
+static void sequence_dispose(sequence_t* s) {
+    heap.free(s->direction);
+    heap.free(s->x);
+    heap.free(s->base);
+    mem.zero(s, sizeof(*s));
+}
+
+// S. Joe and F. Y. Kuo "Constructing Sobol sequences with better
+// two-dimensional projections" SIAM J. Sci. Comput. 30, 2635-2654 (2008)
+// initial direction numbers m[1..s] from "new-joe-kuo-6.21201" for
+// dimensions 2..1111 (all primitive polynomials of degree up to 13),
+// "s" (degree) numbers per dimension in sequence_sobol() enumeration order.
+
+static const uint16_t sequence_joe_kuo[13223] = {
+    1, 1, 3, 1, 3, 1, 1, 1, 1, 1, 1, 3, 3, 1, 3, 5, 13, 1, 1, 5, 5, 17, 1, 1, 5,
+    5, 5, 1, 1, 7, 11, 19, 1, 1, 5, 1, 1, 1, 1, 1, 3, 11, 1, 3, 5, 5, 31, 1, 3,
+    3, 9, 7, 49, 1, 1, 1, 15, 21, 21, 1, 3, 1, 13, 27, 49, 1, 1, 1, 15, 7, 5, 1,
+    3, 1, 15, 13, 25, 1, 1, 5, 5, 19, 61, 1, 3, 7, 11, 23, 15, 103, 1, 3, 7, 13,
+    13, 15, 69, 1, 1, 3, 13, 7, 35, 63, 1, 3, 5, 9, 1, 25, 53, 1, 3, 1, 13, 9,
+    35, 107, 1, 3, 1, 5, 27, 61, 31, 1, 1, 5, 11, 19, 41, 61, 1, 3, 5, 3, 3, 13,
+    69, 1, 1, 7, 13, 1, 19, 1, 1, 3, 7, 5, 13, 19, 59, 1, 1, 3, 9, 25, 29, 41,
+    1, 3, 5, 13, 23, 1, 55, 1, 3, 7, 3, 13, 59, 17, 1, 3, 1, 3, 5, 53, 69, 1, 1,
+    5, 5, 23, 33, 13, 1, 1, 7, 7, 1, 61, 123, 1, 1, 7, 9, 13, 61, 49, 1, 3, 3,
+    5, 3, 55, 33, 1, 3, 1, 15, 31, 13, 49, 245, 1, 3, 5, 15, 31, 59, 63, 97, 1,
+    3, 1, 11, 11, 11, 77, 249, 1, 3, 1, 11, 27, 43, 71, 9, 1, 1, 7, 15, 21, 11,
+    81, 45, 1, 3, 7, 3, 25, 31, 65, 79, 1, 3, 1, 1, 19, 11, 3, 205, 1, 1, 5, 9,
+    19, 21, 29, 157, 1, 3, 7, 11, 1, 33, 89, 185, 1, 3, 3, 3, 15, 9, 79, 71, 1,
+    3, 7, 11, 15, 39, 119, 27, 1, 1, 3, 1, 11, 31, 97, 225, 1, 1, 1, 3, 23, 43,
+    57, 177, 1, 3, 7, 7, 17, 17, 37, 71, 1, 3, 1, 5, 27, 63, 123, 213, 1, 1, 3,
+    5, 11, 43, 53, 133, 1, 3, 5, 5, 29, 17, 47, 173, 479, 1, 3, 3, 11, 3, 1,
+    109, 9, 69, 1, 1, 1, 5, 17, 39, 23, 5, 343, 1, 3, 1, 5, 25, 15, 31, 103,
+    499, 1, 1, 1, 11, 11, 17, 63, 105, 183, 1, 1, 5, 11, 9, 29, 97, 231, 363, 1,
+    1, 5, 15, 19, 45, 41, 7, 383, 1, 3, 7, 7, 31, 19, 83, 137, 221, 1, 1, 1, 3,
+    23, 15, 111, 223, 83, 1, 1, 5, 13, 31, 15, 55, 25, 161, 1, 1, 3, 13, 25, 47,
+    39, 87, 257, 1, 1, 1, 11, 21, 53, 125, 249, 293, 1, 1, 7, 11, 11, 7, 57, 79,
+    323, 1, 1, 5, 5, 17, 13, 81, 3, 131, 1, 1, 7, 13, 23, 7, 65, 251, 475, 1, 3,
+    5, 1, 9, 43, 3, 149, 11, 1, 1, 3, 13, 31, 13, 13, 255, 487, 1, 3, 3, 1, 5,
+    63, 89, 91, 127, 1, 1, 3, 3, 1, 19, 123, 127, 237, 1, 1, 5, 7, 23, 31, 37,
+    243, 289, 1, 1, 5, 11, 17, 53, 117, 183, 491, 1, 1, 1, 5, 1, 13, 13, 209,
+    345, 1, 1, 3, 15, 1, 57, 115, 7, 33, 1, 3, 1, 11, 7, 43, 81, 207, 175, 1, 3,
+    1, 1, 15, 27, 63, 255, 49, 1, 3, 5, 3, 27, 61, 105, 171, 305, 1, 1, 5, 3, 1,
+    3, 57, 249, 149, 1, 1, 3, 5, 5, 57, 15, 13, 159, 1, 1, 1, 11, 7, 11, 105,
+    141, 225, 1, 3, 3, 5, 27, 59, 121, 101, 271, 1, 3, 5, 9, 11, 49, 51, 59,
+    115, 1, 1, 7, 1, 23, 45, 125, 71, 419, 1, 1, 3, 5, 23, 5, 105, 109, 75, 1,
+    1, 7, 15, 7, 11, 67, 121, 453, 1, 3, 7, 3, 9, 13, 31, 27, 449, 1, 3, 1, 15,
+    19, 39, 39, 89, 15, 1, 1, 1, 1, 1, 33, 73, 145, 379, 1, 3, 1, 15, 15, 43,
+    29, 13, 483, 1, 1, 7, 3, 19, 27, 85, 131, 431, 1, 3, 3, 3, 5, 35, 23, 195,
+    349, 1, 3, 3, 7, 9, 27, 39, 59, 297, 1, 1, 3, 9, 11, 17, 13, 241, 157, 1, 3,
+    7, 15, 25, 57, 33, 189, 213, 1, 1, 7, 1, 9, 55, 73, 83, 217, 1, 3, 3, 13,
+    19, 27, 23, 113, 249, 1, 3, 5, 3, 23, 43, 3, 253, 479, 1, 1, 5, 5, 11, 5,
+    45, 117, 217, 1, 3, 3, 7, 29, 37, 33, 123, 147, 1, 3, 1, 15, 5, 5, 37, 227,
+    223, 459, 1, 1, 7, 5, 5, 39, 63, 255, 135, 487, 1, 3, 1, 7, 9, 7, 87, 249,
+    217, 599, 1, 1, 3, 13, 9, 47, 7, 225, 363, 247, 1, 3, 7, 13, 19, 13, 9, 67,
+    9, 737, 1, 3, 5, 5, 19, 59, 7, 41, 319, 677, 1, 1, 5, 3, 31, 63, 15, 43,
+    207, 789, 1, 1, 7, 9, 13, 39, 3, 47, 497, 169, 1, 3, 1, 7, 21, 17, 97, 19,
+    415, 905, 1, 3, 7, 1, 3, 31, 71, 111, 165, 127, 1, 1, 5, 11, 1, 61, 83, 119,
+    203, 847, 1, 3, 3, 13, 9, 61, 19, 97, 47, 35, 1, 1, 7, 7, 15, 29, 63, 95,
+    417, 469, 1, 3, 1, 9, 25, 9, 71, 57, 213, 385, 1, 3, 5, 13, 31, 47, 101, 57,
+    39, 341, 1, 1, 3, 3, 31, 57, 125, 173, 365, 551, 1, 3, 7, 1, 13, 57, 67,
+    157, 451, 707, 1, 1, 1, 7, 21, 13, 105, 89, 429, 965, 1, 1, 5, 9, 17, 51,
+    45, 119, 157, 141, 1, 3, 7, 7, 13, 45, 91, 9, 129, 741, 1, 3, 7, 1, 23, 57,
+    67, 141, 151, 571, 1, 1, 3, 11, 17, 47, 93, 107, 375, 157, 1, 3, 3, 5, 11,
+    21, 43, 51, 169, 915, 1, 1, 5, 3, 15, 55, 101, 67, 455, 625, 1, 3, 5, 9, 1,
+    23, 29, 47, 345, 595, 1, 3, 7, 7, 5, 49, 29, 155, 323, 589, 1, 3, 3, 7, 5,
+    41, 127, 61, 261, 717, 1, 3, 7, 7, 17, 23, 117, 67, 129, 1009, 1, 1, 3, 13,
+    11, 39, 21, 207, 123, 305, 1, 1, 3, 9, 29, 3, 95, 47, 231, 73, 1, 3, 1, 9,
+    1, 29, 117, 21, 441, 259, 1, 3, 1, 13, 21, 39, 125, 211, 439, 723, 1, 1, 7,
+    3, 17, 63, 115, 89, 49, 773, 1, 3, 7, 13, 11, 33, 101, 107, 63, 73, 1, 1, 5,
+    5, 13, 57, 63, 135, 437, 177, 1, 1, 3, 7, 27, 63, 93, 47, 417, 483, 1, 1, 3,
+    1, 23, 29, 1, 191, 49, 23, 1, 1, 3, 15, 25, 55, 9, 101, 219, 607, 1, 3, 1,
+    7, 7, 19, 51, 251, 393, 307, 1, 3, 3, 3, 25, 55, 17, 75, 337, 3, 1, 1, 1,
+    13, 25, 17, 65, 45, 479, 413, 1, 1, 7, 7, 27, 49, 99, 161, 213, 727, 1, 3,
+    5, 1, 23, 5, 43, 41, 251, 857, 1, 3, 3, 7, 11, 61, 39, 87, 383, 835, 1, 1,
+    3, 15, 13, 7, 29, 7, 505, 923, 1, 3, 7, 1, 5, 31, 47, 157, 445, 501, 1, 1,
+    3, 7, 1, 43, 9, 147, 115, 605, 1, 3, 3, 13, 5, 1, 119, 211, 455, 1001, 1, 1,
+    3, 5, 13, 19, 3, 243, 75, 843, 1, 3, 7, 7, 1, 19, 91, 249, 357, 589, 1, 1,
+    1, 9, 1, 25, 109, 197, 279, 411, 1, 3, 1, 15, 23, 57, 59, 135, 191, 75, 1,
+    1, 5, 15, 29, 21, 39, 253, 383, 349, 1, 3, 3, 5, 19, 45, 61, 151, 199, 981,
+    1, 3, 5, 13, 9, 61, 107, 141, 141, 1, 1, 3, 1, 11, 27, 25, 85, 105, 309,
+    979, 1, 3, 3, 11, 19, 7, 115, 223, 349, 43, 1, 1, 7, 9, 21, 39, 123, 21,
+    275, 927, 1, 1, 7, 13, 15, 41, 47, 243, 303, 437, 1, 1, 1, 7, 7, 3, 15, 99,
+    409, 719, 1, 3, 3, 15, 27, 49, 113, 123, 113, 67, 469, 1, 3, 7, 11, 3, 23,
+    87, 169, 119, 483, 199, 1, 1, 5, 15, 7, 17, 109, 229, 179, 213, 741, 1, 1,
+    5, 13, 11, 17, 25, 135, 403, 557, 1433, 1, 3, 1, 1, 1, 61, 67, 215, 189,
+    945, 1243, 1, 1, 7, 13, 17, 33, 9, 221, 429, 217, 1679, 1, 1, 3, 11, 27, 3,
+    15, 93, 93, 865, 1049, 1, 3, 7, 7, 25, 41, 121, 35, 373, 379, 1547, 1, 3, 3,
+    9, 11, 35, 45, 205, 241, 9, 59, 1, 3, 1, 7, 3, 51, 7, 177, 53, 975, 89, 1,
+    1, 3, 5, 27, 1, 113, 231, 299, 759, 861, 1, 3, 3, 15, 25, 29, 5, 255, 139,
+    891, 2031, 1, 3, 1, 1, 13, 9, 109, 193, 419, 95, 17, 1, 1, 7, 9, 3, 7, 29,
+    41, 135, 839, 867, 1, 1, 7, 9, 25, 49, 123, 217, 113, 909, 215, 1, 1, 7, 3,
+    23, 15, 43, 133, 217, 327, 901, 1, 1, 3, 3, 13, 53, 63, 123, 477, 711, 1387,
+    1, 1, 3, 15, 7, 29, 75, 119, 181, 957, 247, 1, 1, 1, 11, 27, 25, 109, 151,
+    267, 99, 1461, 1, 3, 7, 15, 5, 5, 53, 145, 11, 725, 1501, 1, 3, 7, 1, 9, 43,
+    71, 229, 157, 607, 1835, 1, 3, 3, 13, 25, 1, 5, 27, 471, 349, 127, 1, 1, 1,
+    1, 23, 37, 9, 221, 269, 897, 1685, 1, 1, 3, 3, 31, 29, 51, 19, 311, 553,
+    1969, 1, 3, 7, 5, 5, 55, 17, 39, 475, 671, 1529, 1, 1, 7, 1, 1, 35, 47, 27,
+    437, 395, 1635, 1, 1, 7, 3, 13, 23, 43, 135, 327, 139, 389, 1, 3, 7, 3, 9,
+    25, 91, 25, 429, 219, 513, 1, 1, 3, 5, 13, 29, 119, 201, 277, 157, 2043, 1,
+    3, 5, 3, 29, 57, 13, 17, 167, 739, 1031, 1, 3, 3, 5, 29, 21, 95, 27, 255,
+    679, 1531, 1, 3, 7, 15, 9, 5, 21, 71, 61, 961, 1201, 1, 3, 5, 13, 15, 57,
+    33, 93, 459, 867, 223, 1, 1, 1, 15, 17, 43, 127, 191, 67, 177, 1073, 1, 1,
+    1, 15, 23, 7, 21, 199, 75, 293, 1611, 1, 3, 7, 13, 15, 39, 21, 149, 65, 741,
+    319, 1, 3, 7, 11, 23, 13, 101, 89, 277, 519, 711, 1, 3, 7, 15, 19, 27, 85,
+    203, 441, 97, 1895, 1, 3, 1, 3, 29, 25, 21, 155, 11, 191, 197, 1, 1, 7, 5,
+    27, 11, 81, 101, 457, 675, 1687, 1, 3, 1, 5, 25, 5, 65, 193, 41, 567, 781,
+    1, 3, 1, 5, 11, 15, 113, 77, 411, 695, 1111, 1, 1, 3, 9, 11, 53, 119, 171,
+    55, 297, 509, 1, 1, 1, 1, 11, 39, 113, 139, 165, 347, 595, 1, 3, 7, 11, 9,
+    17, 101, 13, 81, 325, 1733, 1, 3, 1, 1, 21, 43, 115, 9, 113, 907, 645, 1, 1,
+    7, 3, 9, 25, 117, 197, 159, 471, 475, 1, 3, 1, 9, 11, 21, 57, 207, 485, 613,
+    1661, 1, 1, 7, 7, 27, 55, 49, 223, 89, 85, 1523, 1, 1, 5, 3, 19, 41, 45, 51,
+    447, 299, 1355, 1, 3, 1, 13, 1, 33, 117, 143, 313, 187, 1073, 1, 1, 7, 7, 5,
+    11, 65, 97, 377, 377, 1501, 1, 3, 1, 1, 21, 35, 95, 65, 99, 23, 1239, 1, 1,
+    5, 9, 3, 37, 95, 167, 115, 425, 867, 1, 3, 3, 13, 1, 37, 27, 189, 81, 679,
+    773, 1, 1, 3, 11, 1, 61, 99, 233, 429, 969, 49, 1, 1, 1, 7, 25, 63, 99, 165,
+    245, 793, 1143, 1, 1, 5, 11, 11, 43, 55, 65, 71, 283, 273, 1, 1, 5, 5, 9, 3,
+    101, 251, 355, 379, 1611, 1, 1, 1, 15, 21, 63, 85, 99, 49, 749, 1335, 1, 1,
+    5, 13, 27, 9, 121, 43, 255, 715, 289, 1, 3, 1, 5, 27, 19, 17, 223, 77, 571,
+    1415, 1, 1, 5, 3, 13, 59, 125, 251, 195, 551, 1737, 1, 3, 3, 15, 13, 27, 49,
+    105, 389, 971, 755, 1, 3, 5, 15, 23, 43, 35, 107, 447, 763, 253, 1, 3, 5,
+    11, 21, 3, 17, 39, 497, 407, 611, 1, 1, 7, 13, 15, 31, 113, 17, 23, 507,
+    1995, 1, 1, 7, 15, 3, 15, 31, 153, 423, 79, 503, 1, 1, 7, 9, 19, 25, 23,
+    171, 505, 923, 1989, 1, 1, 5, 9, 21, 27, 121, 223, 133, 87, 697, 1, 1, 5, 5,
+    9, 19, 107, 99, 319, 765, 1461, 1, 1, 3, 3, 19, 25, 3, 101, 171, 729, 187,
+    1, 1, 3, 1, 13, 23, 85, 93, 291, 209, 37, 1, 1, 1, 15, 25, 25, 77, 253, 333,
+    947, 1073, 1, 1, 3, 9, 17, 29, 55, 47, 255, 305, 2037, 1, 3, 3, 9, 29, 63,
+    9, 103, 489, 939, 1523, 1, 3, 7, 15, 7, 31, 89, 175, 369, 339, 595, 1, 3, 7,
+    13, 25, 5, 71, 207, 251, 367, 665, 1, 3, 3, 3, 21, 25, 75, 35, 31, 321,
+    1603, 1, 1, 1, 9, 11, 1, 65, 5, 11, 329, 535, 1, 1, 5, 3, 19, 13, 17, 43,
+    379, 485, 383, 1, 3, 5, 13, 13, 9, 85, 147, 489, 787, 1133, 1, 3, 1, 1, 5,
+    51, 37, 129, 195, 297, 1783, 1, 1, 3, 15, 19, 57, 59, 181, 455, 697, 2033,
+    1, 3, 7, 1, 27, 9, 65, 145, 325, 189, 201, 1, 3, 1, 15, 31, 23, 19, 5, 485,
+    581, 539, 1, 1, 7, 13, 11, 15, 65, 83, 185, 847, 831, 1, 3, 5, 7, 7, 55, 73,
+    15, 303, 511, 1905, 1, 3, 5, 9, 7, 21, 45, 15, 397, 385, 597, 1, 3, 7, 3,
+    23, 13, 73, 221, 511, 883, 1265, 1, 1, 3, 11, 1, 51, 73, 185, 33, 975, 1441,
+    1, 3, 3, 9, 19, 59, 21, 39, 339, 37, 143, 1, 1, 7, 1, 31, 33, 19, 167, 117,
+    635, 639, 1, 1, 1, 3, 5, 13, 59, 83, 355, 349, 1967, 1, 1, 1, 5, 19, 3, 53,
+    133, 97, 863, 983, 1, 3, 1, 13, 9, 41, 91, 105, 173, 97, 625, 1, 1, 5, 3, 7,
+    49, 115, 133, 71, 231, 1063, 1, 1, 7, 5, 17, 43, 47, 45, 497, 547, 757, 1,
+    3, 5, 15, 21, 61, 123, 191, 249, 31, 631, 1, 3, 7, 9, 17, 7, 11, 185, 127,
+    169, 1951, 1, 1, 5, 13, 11, 11, 9, 49, 29, 125, 791, 1, 1, 1, 15, 31, 41,
+    13, 167, 273, 429, 57, 1, 3, 5, 3, 27, 7, 35, 209, 65, 265, 1393, 1, 3, 1,
+    13, 31, 19, 53, 143, 135, 9, 1021, 1, 1, 7, 13, 31, 5, 115, 153, 143, 957,
+    623, 1, 1, 5, 11, 25, 19, 29, 31, 297, 943, 443, 1, 3, 3, 5, 21, 11, 127,
+    81, 479, 25, 699, 1, 1, 3, 11, 25, 31, 97, 19, 195, 781, 705, 1, 1, 5, 5,
+    31, 11, 75, 207, 197, 885, 2037, 1, 1, 1, 11, 9, 23, 29, 231, 307, 17, 1497,
+    1, 1, 5, 11, 11, 43, 111, 233, 307, 523, 1259, 1, 1, 7, 5, 1, 21, 107, 229,
+    343, 933, 217, 1, 1, 1, 11, 3, 21, 125, 131, 405, 599, 1469, 1, 3, 5, 5, 9,
+    39, 33, 81, 389, 151, 811, 1, 1, 7, 7, 7, 1, 59, 223, 265, 529, 2021, 1, 3,
+    1, 3, 9, 23, 85, 181, 47, 265, 49, 1, 3, 5, 11, 19, 23, 9, 7, 157, 299,
+    1983, 1, 3, 1, 5, 15, 5, 21, 105, 29, 339, 1041, 1, 1, 1, 1, 5, 33, 65, 85,
+    111, 705, 479, 1, 1, 1, 7, 9, 35, 77, 87, 151, 321, 101, 1, 1, 5, 7, 17, 1,
+    51, 197, 175, 811, 1229, 1, 3, 3, 15, 23, 37, 85, 185, 239, 543, 731, 1, 3,
+    1, 7, 7, 55, 111, 109, 289, 439, 243, 1, 1, 7, 11, 17, 53, 35, 217, 259,
+    853, 1667, 1, 3, 1, 9, 1, 63, 87, 17, 73, 565, 1091, 1, 1, 3, 3, 11, 41, 1,
+    57, 295, 263, 1029, 1, 1, 5, 1, 27, 45, 109, 161, 411, 421, 1395, 1, 3, 5,
+    11, 25, 35, 47, 191, 339, 417, 1727, 1, 1, 5, 15, 21, 1, 93, 251, 351, 217,
+    1767, 1, 3, 3, 11, 3, 7, 75, 155, 313, 211, 491, 1, 3, 3, 5, 11, 9, 101,
+    161, 453, 913, 1067, 1, 1, 3, 1, 15, 45, 127, 141, 163, 727, 1597, 1, 3, 3,
+    7, 1, 33, 63, 73, 73, 341, 1691, 1, 3, 5, 13, 15, 39, 53, 235, 77, 99, 949,
+    1, 1, 5, 13, 31, 17, 97, 13, 215, 301, 1927, 1, 1, 7, 1, 1, 37, 91, 93, 441,
+    251, 1131, 1, 3, 7, 9, 25, 5, 105, 69, 81, 943, 1459, 1, 3, 7, 11, 31, 43,
+    13, 209, 27, 1017, 501, 1, 1, 7, 15, 1, 33, 31, 233, 161, 507, 387, 1, 3, 3,
+    5, 5, 53, 33, 177, 503, 627, 1927, 1, 1, 7, 11, 7, 61, 119, 31, 457, 229,
+    1875, 1, 1, 5, 15, 19, 5, 53, 201, 157, 885, 1057, 1, 3, 7, 9, 1, 35, 51,
+    113, 249, 425, 1009, 1, 3, 5, 7, 21, 53, 37, 155, 119, 345, 631, 1, 3, 5, 7,
+    15, 31, 109, 69, 503, 595, 1879, 1, 3, 3, 1, 25, 35, 65, 131, 403, 705, 503,
+    1, 3, 7, 7, 19, 33, 11, 153, 45, 633, 499, 1, 3, 3, 5, 11, 3, 29, 93, 487,
+    33, 703, 1, 1, 3, 15, 21, 53, 107, 179, 387, 927, 1757, 1, 1, 3, 7, 21, 45,
+    51, 147, 175, 317, 361, 1, 1, 1, 7, 7, 13, 15, 243, 269, 795, 1965, 1, 1, 3,
+    5, 19, 33, 57, 115, 443, 537, 627, 1, 3, 3, 9, 3, 39, 25, 61, 185, 717,
+    1049, 1, 3, 7, 3, 7, 37, 107, 153, 7, 269, 1581, 1, 1, 7, 3, 7, 41, 91, 41,
+    145, 489, 1245, 1, 1, 5, 9, 7, 7, 105, 81, 403, 407, 283, 1, 1, 7, 9, 27,
+    55, 29, 77, 193, 963, 949, 1, 1, 5, 3, 25, 51, 107, 63, 403, 917, 815, 1, 1,
+    7, 3, 7, 61, 19, 51, 457, 599, 535, 1, 3, 7, 1, 23, 51, 105, 153, 239, 215,
+    1847, 1, 1, 3, 5, 27, 23, 79, 49, 495, 45, 1935, 1, 1, 1, 11, 11, 47, 55,
+    133, 495, 999, 1461, 1, 1, 3, 15, 27, 51, 93, 17, 355, 763, 1675, 1, 3, 1,
+    3, 1, 3, 79, 119, 499, 17, 995, 1, 1, 1, 1, 15, 43, 45, 17, 167, 973, 799,
+    1, 1, 1, 3, 27, 49, 89, 29, 483, 913, 2023, 1, 1, 3, 3, 5, 11, 75, 7, 41,
+    851, 611, 1, 3, 1, 3, 7, 57, 39, 123, 257, 283, 507, 1, 3, 3, 11, 27, 23,
+    113, 229, 187, 299, 133, 1, 1, 3, 13, 9, 63, 101, 77, 451, 169, 337, 1, 3,
+    7, 3, 3, 59, 45, 195, 229, 415, 409, 1, 3, 5, 3, 11, 19, 71, 93, 43, 857,
+    369, 1, 3, 7, 9, 19, 33, 115, 19, 241, 703, 247, 1, 3, 5, 11, 5, 35, 21,
+    155, 463, 1005, 1073, 1, 3, 7, 3, 25, 15, 109, 83, 93, 69, 1189, 1, 3, 5, 7,
+    5, 21, 93, 133, 135, 167, 903, 1, 1, 7, 7, 3, 59, 121, 161, 285, 815, 1769,
+    3705, 1, 3, 1, 1, 3, 47, 103, 171, 381, 609, 185, 373, 1, 3, 3, 15, 23, 33,
+    107, 131, 441, 445, 689, 2059, 1, 3, 3, 11, 7, 53, 101, 167, 435, 803, 1255,
+    3781, 1, 1, 5, 11, 15, 59, 41, 19, 135, 835, 1263, 505, 1, 1, 7, 11, 21, 49,
+    23, 219, 127, 961, 1065, 385, 1, 3, 5, 15, 7, 47, 117, 217, 45, 731, 1639,
+    733, 1, 1, 7, 11, 27, 57, 91, 87, 81, 35, 1269, 1007, 1, 1, 3, 11, 15, 37,
+    53, 219, 193, 937, 1899, 3733, 1, 3, 5, 3, 13, 11, 27, 19, 199, 393, 965,
+    2195, 1, 3, 1, 3, 5, 1, 37, 173, 413, 1023, 553, 409, 1, 3, 1, 7, 15, 29,
+    123, 95, 255, 373, 1799, 3841, 1, 3, 5, 13, 21, 57, 51, 17, 511, 195, 1157,
+    1831, 1, 1, 1, 15, 29, 19, 7, 73, 295, 519, 587, 3523, 1, 1, 5, 13, 13, 35,
+    115, 191, 123, 535, 717, 1661, 1, 3, 3, 5, 23, 21, 47, 251, 379, 921, 1119,
+    297, 1, 3, 3, 9, 29, 53, 121, 201, 135, 193, 523, 2943, 1, 1, 1, 7, 29, 45,
+    125, 9, 99, 867, 425, 601, 1, 3, 1, 9, 13, 15, 67, 181, 109, 293, 1305,
+    3079, 1, 3, 3, 9, 5, 35, 15, 209, 305, 87, 767, 2795, 1, 3, 3, 11, 27, 57,
+    113, 123, 179, 643, 149, 523, 1, 1, 3, 15, 11, 17, 67, 223, 63, 657, 335,
+    3309, 1, 1, 1, 9, 25, 29, 109, 159, 39, 513, 571, 1761, 1, 1, 3, 1, 5, 63,
+    75, 19, 455, 601, 123, 691, 1, 1, 1, 3, 21, 5, 45, 169, 377, 513, 1951,
+    2565, 1, 1, 3, 11, 3, 33, 119, 69, 253, 907, 805, 1449, 1, 1, 5, 13, 31, 15,
+    17, 7, 499, 61, 687, 1867, 1, 3, 7, 11, 17, 33, 73, 77, 299, 243, 641, 2345,
+    1, 1, 7, 11, 9, 35, 31, 235, 359, 647, 379, 1161, 1, 3, 3, 15, 31, 25, 5,
+    67, 33, 45, 437, 4067, 1, 1, 3, 11, 7, 17, 37, 87, 333, 253, 1517, 2921, 1,
+    1, 7, 15, 7, 15, 107, 189, 153, 769, 1521, 3427, 1, 3, 5, 13, 5, 61, 113,
+    37, 293, 393, 113, 43, 1, 1, 1, 15, 29, 43, 107, 31, 167, 147, 301, 1021, 1,
+    1, 1, 13, 3, 1, 35, 93, 195, 181, 2027, 1491, 1, 3, 3, 3, 13, 33, 77, 199,
+    153, 221, 1699, 3671, 1, 3, 5, 13, 7, 49, 123, 155, 495, 681, 819, 809, 1,
+    3, 5, 15, 27, 61, 117, 189, 183, 887, 617, 4053, 1, 1, 1, 7, 31, 59, 125,
+    235, 389, 369, 447, 1039, 1, 3, 5, 1, 5, 39, 115, 89, 249, 377, 431, 3747,
+    1, 1, 1, 5, 7, 47, 59, 157, 77, 445, 699, 3439, 1, 1, 3, 5, 11, 21, 19, 75,
+    11, 599, 1575, 735, 1, 3, 5, 3, 19, 13, 41, 69, 199, 143, 1761, 3215, 1, 3,
+    5, 7, 19, 43, 25, 41, 41, 11, 1647, 2783, 1, 3, 1, 9, 19, 45, 111, 97, 405,
+    399, 457, 3219, 1, 1, 3, 1, 23, 15, 65, 121, 59, 985, 829, 2259, 1, 1, 3, 7,
+    17, 13, 107, 229, 75, 551, 1299, 2363, 1, 1, 5, 5, 21, 57, 23, 199, 509,
+    139, 2007, 3875, 1, 3, 1, 11, 19, 53, 15, 229, 215, 741, 695, 823, 1, 3, 7,
+    1, 29, 3, 17, 163, 417, 559, 549, 319, 1, 3, 1, 13, 17, 9, 47, 133, 365, 7,
+    1937, 1071, 1, 3, 5, 7, 19, 37, 55, 163, 301, 249, 689, 2327, 1, 3, 5, 13,
+    11, 23, 61, 205, 257, 377, 615, 1457, 1, 3, 5, 1, 23, 37, 13, 75, 331, 495,
+    579, 3367, 1, 1, 1, 9, 1, 23, 49, 129, 475, 543, 883, 2531, 1, 3, 1, 5, 23,
+    59, 51, 35, 343, 695, 219, 369, 1, 3, 3, 1, 27, 17, 63, 97, 71, 507, 1929,
+    613, 1, 1, 5, 1, 21, 31, 11, 109, 247, 409, 1817, 2173, 1, 1, 3, 15, 23, 9,
+    7, 209, 301, 23, 147, 1691, 1, 1, 7, 5, 5, 19, 37, 229, 249, 277, 1115,
+    2309, 1, 1, 1, 5, 5, 63, 5, 249, 285, 431, 343, 2467, 1, 1, 1, 11, 7, 45,
+    35, 75, 505, 537, 29, 2919, 1, 3, 5, 15, 11, 39, 15, 63, 263, 9, 199, 445,
+    1, 3, 3, 3, 27, 63, 53, 171, 227, 63, 1049, 827, 1, 1, 3, 13, 7, 11, 115,
+    183, 179, 937, 1785, 381, 1, 3, 1, 11, 13, 15, 107, 81, 53, 295, 1785, 3757,
+    1, 3, 3, 13, 11, 5, 109, 243, 3, 505, 323, 1373, 1, 3, 3, 11, 21, 51, 17,
+    177, 381, 937, 1263, 3889, 1, 3, 5, 9, 27, 25, 85, 193, 143, 573, 1189,
+    2995, 1, 3, 5, 11, 13, 9, 81, 21, 159, 953, 91, 1751, 1, 1, 3, 3, 27, 61,
+    11, 253, 391, 333, 1105, 635, 1, 3, 3, 15, 9, 57, 95, 81, 419, 735, 251,
+    1141, 1, 1, 5, 9, 31, 39, 59, 13, 319, 807, 1241, 2433, 1, 3, 3, 5, 27, 13,
+    107, 141, 423, 937, 2027, 3233, 1, 3, 3, 9, 9, 25, 125, 23, 443, 835, 1245,
+    847, 1, 1, 7, 15, 17, 17, 83, 107, 411, 285, 847, 1571, 1, 1, 3, 13, 29, 61,
+    37, 81, 349, 727, 1453, 1957, 1, 3, 7, 11, 31, 13, 59, 77, 273, 591, 1265,
+    1533, 1, 1, 7, 7, 13, 17, 25, 25, 187, 329, 347, 1473, 1, 3, 7, 7, 5, 51,
+    37, 99, 221, 153, 503, 2583, 1, 3, 1, 13, 19, 27, 11, 69, 181, 479, 1183,
+    3229, 1, 3, 3, 13, 23, 21, 103, 147, 323, 909, 947, 315, 1, 3, 1, 3, 23, 1,
+    31, 59, 93, 513, 45, 2271, 1, 3, 5, 1, 7, 43, 109, 59, 231, 41, 1515, 2385,
+    1, 3, 1, 5, 31, 57, 49, 223, 283, 1013, 11, 701, 1, 1, 5, 1, 19, 53, 55, 31,
+    31, 299, 495, 693, 1, 3, 3, 9, 5, 33, 77, 253, 427, 791, 731, 1019, 1, 3, 7,
+    11, 1, 9, 119, 203, 53, 877, 1707, 3499, 1, 1, 3, 7, 13, 39, 55, 159, 423,
+    113, 1653, 3455, 1, 1, 3, 5, 21, 47, 51, 59, 55, 411, 931, 251, 1, 3, 7, 3,
+    31, 25, 81, 115, 405, 239, 741, 455, 1, 1, 5, 1, 31, 3, 101, 83, 479, 491,
+    1779, 2225, 1, 3, 3, 3, 9, 37, 107, 161, 203, 503, 767, 3435, 1, 3, 7, 9, 1,
+    27, 61, 119, 233, 39, 1375, 4089, 1, 1, 5, 9, 1, 31, 45, 51, 369, 587, 383,
+    2813, 1, 3, 7, 5, 31, 7, 49, 119, 487, 591, 1627, 53, 1, 1, 7, 1, 9, 47, 1,
+    223, 369, 711, 1603, 1917, 1, 3, 5, 3, 21, 37, 111, 17, 483, 739, 1193,
+    2775, 1, 3, 3, 7, 17, 11, 51, 117, 455, 191, 1493, 3821, 1, 1, 5, 9, 23, 39,
+    99, 181, 343, 485, 99, 1931, 1, 3, 1, 7, 29, 49, 31, 71, 489, 527, 1763,
+    2909, 1, 1, 5, 11, 5, 5, 73, 189, 321, 57, 1191, 3685, 1, 1, 5, 15, 13, 45,
+    125, 207, 371, 415, 315, 983, 1, 3, 3, 5, 25, 59, 33, 31, 239, 919, 1859,
+    2709, 1, 3, 5, 13, 27, 61, 23, 115, 61, 413, 1275, 3559, 1, 3, 7, 15, 5, 59,
+    101, 81, 47, 967, 809, 3189, 1, 1, 5, 11, 31, 15, 39, 25, 173, 505, 809,
+    2677, 1, 1, 5, 9, 19, 13, 95, 89, 511, 127, 1395, 2935, 1, 1, 5, 5, 31, 45,
+    9, 57, 91, 303, 1295, 3215, 1, 3, 3, 3, 19, 15, 113, 187, 217, 489, 1285,
+    1803, 1, 1, 3, 1, 13, 29, 57, 139, 255, 197, 537, 2183, 1, 3, 1, 15, 11, 7,
+    53, 255, 467, 9, 757, 3167, 1, 3, 3, 15, 21, 13, 9, 189, 359, 323, 49, 333,
+    1, 3, 7, 11, 7, 37, 21, 119, 401, 157, 1659, 1069, 1, 1, 5, 7, 17, 33, 115,
+    229, 149, 151, 2027, 279, 1, 1, 5, 15, 5, 49, 77, 155, 383, 385, 1985, 945,
+    1, 3, 7, 3, 7, 55, 85, 41, 357, 527, 1715, 1619, 1, 1, 3, 1, 21, 45, 115,
+    21, 199, 967, 1581, 3807, 1, 1, 3, 7, 21, 39, 117, 191, 169, 73, 413, 3417,
+    1, 1, 1, 13, 1, 31, 57, 195, 231, 321, 367, 1027, 1, 3, 7, 3, 11, 29, 47,
+    161, 71, 419, 1721, 437, 1, 1, 7, 3, 11, 9, 43, 65, 157, 1, 1851, 823, 1, 1,
+    1, 5, 21, 15, 31, 101, 293, 299, 127, 1321, 1, 1, 7, 1, 27, 1, 11, 229, 241,
+    705, 43, 1475, 1, 3, 7, 1, 5, 15, 73, 183, 193, 55, 1345, 49, 1, 3, 3, 3,
+    19, 3, 55, 21, 169, 663, 1675, 137, 1, 1, 1, 13, 7, 21, 69, 67, 373, 965,
+    1273, 2279, 1, 1, 7, 7, 21, 23, 17, 43, 341, 845, 465, 3355, 1, 3, 5, 5, 25,
+    5, 81, 101, 233, 139, 359, 2057, 1, 1, 3, 11, 15, 39, 55, 3, 471, 765, 1143,
+    3941, 1, 1, 7, 15, 9, 57, 81, 79, 215, 433, 333, 3855, 1, 1, 5, 5, 19, 45,
+    83, 31, 209, 363, 701, 1303, 1, 3, 7, 5, 1, 13, 55, 163, 435, 807, 287,
+    2031, 1, 3, 3, 7, 3, 3, 17, 197, 39, 169, 489, 1769, 1, 1, 3, 5, 29, 43, 87,
+    161, 289, 339, 1233, 2353, 1, 3, 3, 9, 21, 9, 77, 1, 453, 167, 1643, 2227,
+    1, 1, 7, 1, 15, 7, 67, 33, 193, 241, 1031, 2339, 1, 3, 1, 11, 1, 63, 45, 65,
+    265, 661, 849, 1979, 1, 3, 1, 13, 19, 49, 3, 11, 159, 213, 659, 2839, 1, 3,
+    5, 11, 9, 29, 27, 227, 253, 449, 1403, 3427, 1, 1, 3, 1, 7, 3, 77, 143, 277,
+    779, 1499, 475, 1, 1, 1, 5, 11, 23, 87, 131, 393, 849, 193, 3189, 1, 3, 5,
+    11, 3, 3, 89, 9, 449, 243, 1501, 1739, 1, 3, 1, 9, 29, 29, 113, 15, 65, 611,
+    135, 3687, 1, 1, 1, 9, 21, 19, 39, 151, 395, 501, 1339, 959, 2725, 1, 3, 7,
+    1, 7, 35, 45, 33, 119, 225, 1631, 1695, 1459, 1, 1, 1, 3, 25, 55, 37, 79,
+    167, 907, 1075, 271, 4059, 1, 3, 5, 13, 5, 13, 53, 165, 437, 67, 1705, 3177,
+    8095, 1, 3, 3, 13, 27, 57, 95, 55, 443, 245, 1945, 1725, 1929, 1, 3, 1, 9,
+    5, 33, 109, 35, 99, 827, 341, 2401, 2411, 1, 1, 5, 9, 7, 33, 43, 39, 87,
+    799, 635, 3481, 7159, 1, 3, 1, 1, 31, 15, 45, 27, 337, 113, 987, 2065, 2529,
+    1, 1, 5, 9, 5, 15, 105, 123, 479, 289, 1609, 2177, 4629, 1, 3, 5, 11, 31,
+    47, 97, 87, 385, 195, 1041, 651, 3271, 1, 1, 3, 7, 17, 3, 101, 55, 87, 629,
+    1687, 1387, 2745, 1, 3, 5, 5, 7, 21, 9, 237, 313, 549, 1107, 117, 6183, 1,
+    1, 3, 9, 9, 5, 55, 201, 487, 851, 1103, 2993, 4055, 1, 1, 5, 9, 31, 19, 59,
+    7, 363, 381, 1167, 2057, 5715, 1, 3, 3, 15, 23, 63, 19, 227, 387, 827, 487,
+    1049, 7471, 1, 3, 1, 5, 23, 25, 61, 245, 363, 863, 963, 3583, 6475, 1, 1, 5,
+    1, 5, 27, 81, 85, 275, 49, 235, 3291, 1195, 1, 1, 5, 7, 23, 53, 85, 107,
+    511, 779, 1265, 1093, 7859, 1, 3, 3, 1, 9, 21, 75, 219, 59, 485, 1739, 3845,
+    1109, 1, 3, 5, 1, 13, 41, 19, 143, 293, 391, 2023, 1791, 4399, 1, 3, 7, 15,
+    21, 13, 21, 195, 215, 413, 523, 2099, 2341, 1, 1, 1, 3, 29, 51, 47, 57, 135,
+    575, 943, 1673, 541, 1, 3, 5, 1, 9, 13, 113, 175, 447, 115, 657, 4077, 5973,
+    1, 1, 1, 11, 17, 41, 37, 95, 297, 579, 911, 2207, 2387, 1, 3, 5, 3, 23, 11,
+    23, 231, 93, 667, 711, 1563, 7961, 1, 1, 7, 3, 17, 59, 13, 181, 141, 991,
+    1817, 457, 1711, 1, 3, 3, 5, 31, 59, 81, 205, 245, 537, 1049, 997, 1815, 1,
+    3, 7, 5, 17, 13, 9, 79, 17, 185, 5, 2211, 6263, 1, 3, 7, 13, 7, 53, 61, 145,
+    13, 285, 1203, 947, 2933, 1, 1, 7, 3, 31, 19, 69, 217, 47, 441, 1893, 673,
+    4451, 1, 1, 1, 1, 25, 9, 23, 225, 385, 629, 603, 3747, 4241, 1, 3, 1, 9, 5,
+    37, 31, 237, 431, 79, 1521, 459, 2523, 1, 3, 7, 3, 9, 43, 105, 179, 5, 225,
+    799, 1777, 4893, 1, 1, 3, 1, 29, 45, 29, 159, 267, 247, 455, 847, 3909, 1,
+    1, 3, 7, 25, 21, 121, 57, 467, 275, 719, 1521, 7319, 1, 3, 1, 3, 11, 35,
+    119, 123, 81, 979, 1187, 3623, 4293, 1, 1, 1, 7, 15, 25, 121, 235, 25, 487,
+    873, 1787, 1977, 1, 1, 1, 11, 3, 7, 17, 135, 345, 353, 383, 4011, 2573, 1,
+    3, 7, 15, 27, 13, 97, 123, 65, 675, 951, 1285, 6559, 1, 3, 7, 3, 7, 1, 71,
+    19, 325, 765, 337, 1197, 2697, 1, 3, 5, 1, 31, 37, 11, 71, 169, 283, 83,
+    3801, 7083, 1, 1, 3, 15, 17, 29, 83, 65, 275, 679, 1749, 4007, 7749, 1, 1,
+    3, 1, 21, 11, 41, 95, 237, 361, 1819, 2783, 2383, 1, 3, 7, 11, 29, 57, 111,
+    187, 465, 145, 605, 1987, 8109, 1, 1, 3, 3, 19, 15, 55, 83, 357, 1001, 643,
+    1517, 6529, 1, 3, 1, 5, 29, 35, 73, 23, 77, 619, 1523, 1725, 8145, 1, 1, 5,
+    5, 19, 23, 7, 197, 449, 337, 717, 2921, 315, 1, 3, 5, 9, 7, 63, 117, 97, 97,
+    813, 1925, 2817, 1579, 1, 1, 1, 11, 31, 7, 25, 235, 231, 133, 1007, 1371,
+    1553, 1, 1, 7, 5, 19, 7, 47, 171, 267, 243, 1331, 567, 6033, 1, 1, 5, 1, 7,
+    49, 55, 89, 109, 735, 1455, 3193, 6239, 1, 1, 1, 7, 1, 61, 9, 103, 3, 929,
+    1481, 2927, 2957, 1, 1, 5, 13, 17, 21, 75, 49, 255, 1019, 1161, 2133, 1177,
+    1, 3, 1, 3, 13, 15, 41, 247, 211, 409, 1163, 523, 2635, 1, 3, 7, 7, 21, 59,
+    91, 149, 479, 391, 681, 2311, 6249, 1, 1, 5, 11, 27, 53, 21, 211, 197, 815,
+    719, 1605, 255, 1, 1, 3, 3, 9, 33, 59, 3, 323, 1, 101, 1135, 8105, 1, 3, 3,
+    1, 29, 5, 17, 141, 51, 991, 841, 327, 3859, 1, 3, 1, 5, 11, 19, 23, 89, 175,
+    173, 165, 2881, 1881, 1, 1, 1, 15, 13, 51, 87, 39, 495, 611, 1341, 1531,
+    7029, 1, 1, 3, 11, 13, 55, 75, 185, 57, 61, 1917, 2051, 5965, 1, 1, 5, 5, 7,
+    53, 11, 217, 213, 933, 921, 3607, 5175, 1, 3, 3, 5, 17, 53, 103, 251, 369,
+    781, 1319, 3717, 4439, 1, 3, 5, 13, 1, 39, 25, 235, 321, 773, 251, 3111,
+    6397, 1, 1, 7, 3, 31, 5, 25, 29, 325, 385, 1313, 127, 4705, 1, 1, 5, 15, 15,
+    27, 15, 85, 239, 243, 1633, 3473, 2621, 1, 3, 3, 3, 9, 19, 113, 13, 137,
+    165, 25, 2957, 7549, 1, 3, 1, 3, 11, 21, 3, 97, 417, 183, 1205, 1437, 247,
+    1, 1, 7, 3, 17, 21, 125, 55, 67, 387, 385, 2323, 887, 1, 3, 5, 5, 29, 11,
+    103, 223, 233, 641, 133, 415, 1297, 1, 3, 3, 11, 1, 9, 5, 189, 235, 1007,
+    1363, 3985, 889, 1, 3, 7, 9, 23, 19, 19, 183, 269, 403, 1643, 3559, 5189, 1,
+    3, 7, 3, 29, 45, 17, 69, 475, 149, 1291, 2689, 7625, 1, 3, 7, 3, 27, 37, 41,
+    73, 253, 1001, 431, 1111, 7887, 1, 1, 7, 5, 3, 7, 87, 143, 289, 495, 631,
+    3011, 6151, 1, 1, 1, 13, 5, 45, 17, 167, 23, 975, 801, 1975, 6833, 1, 3, 1,
+    11, 7, 21, 39, 23, 213, 429, 1301, 2059, 197, 1, 3, 3, 15, 3, 57, 121, 133,
+    29, 711, 1961, 2497, 189, 1, 1, 3, 5, 11, 55, 115, 137, 233, 673, 985, 2849,
+    5911, 1, 1, 7, 15, 29, 45, 1, 241, 329, 323, 925, 2821, 3331, 1, 1, 5, 7,
+    13, 31, 81, 105, 199, 145, 195, 1365, 5119, 1, 3, 7, 11, 3, 55, 11, 31, 117,
+    343, 1265, 1837, 2451, 1, 1, 3, 7, 29, 57, 61, 179, 429, 591, 177, 1945,
+    2159, 1, 3, 5, 11, 23, 49, 101, 137, 339, 323, 1035, 1749, 7737, 1, 3, 1,
+    13, 21, 35, 55, 79, 19, 269, 1055, 2651, 7083, 1, 3, 3, 11, 9, 9, 95, 167,
+    437, 361, 1185, 4083, 603, 1, 1, 1, 7, 31, 61, 77, 65, 489, 657, 691, 2423,
+    4147, 1, 3, 5, 7, 21, 37, 87, 191, 311, 453, 2013, 829, 2619, 1, 1, 5, 9,
+    17, 47, 35, 101, 5, 813, 1157, 1279, 7365, 1, 1, 5, 3, 11, 35, 113, 199,
+    369, 721, 901, 1471, 7801, 1, 3, 1, 5, 9, 61, 83, 157, 391, 739, 1957, 2123,
+    4341, 1, 3, 5, 11, 19, 19, 111, 225, 383, 219, 997, 717, 7505, 1, 3, 1, 11,
+    13, 63, 35, 127, 209, 831, 501, 3017, 3507, 1, 3, 7, 9, 29, 7, 11, 163, 81,
+    563, 1445, 3215, 6377, 1, 3, 7, 11, 25, 3, 39, 195, 491, 45, 839, 4021,
+    4899, 1, 3, 7, 15, 13, 5, 67, 143, 117, 505, 1281, 3679, 5695, 1, 3, 7, 9,
+    9, 19, 21, 221, 147, 763, 683, 2211, 589, 1, 1, 3, 5, 21, 47, 53, 109, 299,
+    807, 1153, 1209, 7961, 1, 3, 7, 11, 9, 31, 45, 43, 505, 647, 1127, 2681,
+    4917, 1, 1, 5, 15, 31, 41, 63, 113, 399, 727, 673, 2587, 5259, 1, 1, 1, 13,
+    17, 53, 35, 99, 57, 243, 1447, 1919, 2831, 1, 3, 7, 11, 23, 51, 13, 9, 49,
+    449, 997, 3073, 4407, 1, 3, 5, 7, 23, 33, 89, 41, 415, 53, 697, 1113, 1489,
+    1, 1, 3, 7, 1, 13, 29, 13, 255, 749, 77, 3463, 1761, 1, 3, 3, 7, 13, 15, 93,
+    191, 309, 869, 739, 1041, 3053, 1, 3, 5, 13, 5, 19, 109, 211, 347, 839, 893,
+    2947, 7735, 1, 3, 1, 13, 27, 3, 119, 157, 485, 99, 1703, 3895, 573, 1, 3, 7,
+    11, 1, 23, 123, 105, 31, 359, 275, 1775, 3685, 1, 3, 3, 5, 27, 11, 125, 3,
+    413, 199, 2043, 2895, 2945, 1, 3, 3, 3, 15, 49, 121, 159, 233, 543, 193,
+    4007, 321, 1, 1, 3, 5, 9, 47, 87, 1, 51, 1011, 1595, 2239, 6467, 1, 3, 7, 9,
+    1, 33, 87, 137, 469, 749, 1413, 805, 6817, 1, 3, 1, 13, 19, 45, 95, 227, 29,
+    677, 1275, 3395, 4451, 1, 1, 7, 5, 7, 63, 33, 71, 443, 561, 1311, 3069,
+    6943, 1, 1, 1, 13, 9, 37, 23, 69, 13, 415, 1479, 1197, 861, 1, 3, 3, 13, 27,
+    21, 13, 233, 105, 777, 345, 2443, 1105, 1, 1, 7, 11, 23, 13, 21, 147, 221,
+    549, 73, 2729, 6279, 1, 1, 7, 7, 25, 27, 15, 45, 227, 39, 75, 1191, 3563, 1,
+    1, 5, 7, 13, 49, 99, 167, 227, 13, 353, 1047, 8075, 1, 1, 3, 13, 31, 9, 27,
+    7, 461, 737, 1559, 3243, 53, 1, 3, 1, 1, 21, 41, 97, 165, 171, 821, 587,
+    2137, 2293, 1, 3, 1, 11, 17, 41, 29, 187, 87, 599, 1467, 1395, 5931, 1, 1,
+    1, 9, 9, 49, 89, 205, 409, 453, 61, 1923, 1257, 1, 3, 7, 3, 9, 43, 89, 143,
+    431, 83, 1243, 1795, 3599, 1, 3, 5, 13, 3, 25, 59, 219, 43, 223, 797, 2651,
+    6015, 1, 1, 5, 15, 7, 55, 65, 207, 213, 311, 1287, 1269, 6467, 1, 3, 7, 11,
+    21, 57, 31, 183, 351, 857, 911, 1683, 7155, 1, 3, 5, 11, 27, 1, 21, 47, 387,
+    383, 1593, 115, 3805, 1, 3, 1, 1, 13, 23, 87, 173, 181, 619, 1653, 3931,
+    6073, 1, 1, 7, 5, 17, 43, 37, 61, 307, 621, 1785, 55, 115, 1, 3, 7, 15, 25,
+    61, 123, 15, 237, 671, 1473, 467, 1907, 1, 1, 7, 5, 29, 57, 75, 237, 85,
+    699, 159, 3577, 4771, 1, 1, 1, 11, 25, 19, 51, 1, 147, 31, 895, 2617, 625,
+    1, 3, 7, 5, 29, 15, 115, 175, 395, 391, 1141, 1827, 1181, 1, 3, 5, 7, 17, 7,
+    11, 193, 89, 243, 561, 3787, 4551, 1, 3, 1, 11, 7, 57, 7, 125, 403, 947,
+    1261, 409, 8083, 1, 1, 5, 13, 21, 63, 115, 233, 231, 921, 1747, 3635, 2519,
+    1, 1, 5, 11, 3, 27, 15, 91, 505, 591, 1451, 3881, 2997, 1, 1, 3, 11, 21, 9,
+    109, 153, 317, 533, 593, 3967, 2797, 1, 3, 3, 13, 9, 57, 121, 245, 219, 867,
+    967, 791, 7095, 1, 1, 1, 9, 29, 21, 99, 35, 375, 959, 329, 4087, 7171, 1, 1,
+    1, 9, 11, 17, 17, 97, 89, 135, 631, 3809, 3253, 1, 1, 1, 15, 21, 51, 91,
+    249, 459, 801, 757, 2353, 2033, 1, 3, 5, 9, 23, 29, 77, 53, 399, 767, 1817,
+    2171, 1629, 1, 1, 3, 5, 29, 5, 43, 121, 17, 859, 1479, 3785, 6641, 1, 1, 3,
+    7, 7, 61, 45, 109, 371, 833, 91, 153, 4553, 1, 1, 3, 11, 7, 55, 81, 123,
+    389, 139, 1933, 891, 1789, 1, 3, 7, 15, 25, 17, 93, 165, 503, 717, 1553,
+    1475, 1627, 1, 1, 1, 13, 13, 63, 13, 225, 357, 571, 33, 4073, 3795, 1, 1, 3,
+    11, 1, 31, 107, 145, 407, 961, 501, 2987, 103, 1, 1, 7, 1, 23, 63, 49, 193,
+    173, 281, 25, 2465, 5927, 1, 1, 7, 1, 1, 1, 85, 77, 273, 693, 349, 1239,
+    4503, 1, 1, 5, 11, 7, 61, 9, 121, 25, 357, 1443, 405, 7827, 1, 1, 7, 13, 11,
+    53, 11, 207, 145, 211, 1703, 1081, 2117, 1, 1, 3, 11, 27, 23, 19, 9, 297,
+    279, 1481, 2273, 6387, 1, 3, 3, 5, 15, 45, 3, 41, 305, 87, 1815, 3461, 5349,
+    1, 3, 3, 13, 9, 37, 79, 125, 259, 561, 1087, 4091, 793, 1, 3, 5, 7, 31, 55,
+    7, 145, 347, 929, 589, 2783, 5905, 1, 1, 7, 15, 3, 25, 1, 181, 13, 243, 653,
+    2235, 7445, 1, 3, 5, 5, 17, 53, 65, 7, 33, 583, 1363, 1313, 2319, 1, 3, 3,
+    7, 27, 47, 97, 201, 187, 321, 63, 1515, 7917, 1, 1, 3, 5, 23, 9, 3, 165, 61,
+    19, 1789, 3783, 3037, 1, 3, 1, 13, 15, 43, 125, 191, 67, 273, 1551, 2227,
+    5253, 1, 1, 1, 13, 25, 53, 107, 33, 299, 249, 1475, 2233, 907, 1, 3, 5, 1,
+    23, 37, 85, 17, 207, 643, 665, 2933, 5199, 1, 1, 7, 7, 25, 57, 59, 41, 15,
+    751, 751, 1749, 7053, 1, 3, 3, 1, 13, 25, 127, 93, 281, 613, 875, 2223,
+    6345, 1, 1, 5, 3, 29, 55, 79, 249, 43, 317, 533, 995, 1991, 1, 3, 3, 15, 17,
+    49, 79, 31, 193, 233, 1437, 2615, 819, 1, 1, 5, 15, 25, 3, 123, 145, 377, 9,
+    455, 1191, 3953, 1, 3, 5, 3, 15, 19, 41, 231, 81, 393, 3, 19, 2409, 1, 1, 3,
+    1, 27, 43, 113, 179, 7, 853, 947, 2731, 297, 1, 1, 1, 11, 29, 39, 53, 191,
+    443, 689, 529, 3329, 7431, 1, 3, 7, 5, 3, 29, 19, 67, 441, 113, 949, 2769,
+    4169, 1, 3, 5, 11, 11, 55, 85, 169, 215, 815, 803, 2345, 3967, 1, 1, 7, 9,
+    5, 45, 111, 5, 419, 375, 303, 1725, 4489, 1, 3, 5, 15, 29, 43, 79, 19, 23,
+    417, 381, 541, 4923, 1, 1, 3, 15, 3, 31, 117, 39, 117, 305, 1227, 1223, 143,
+    1, 1, 5, 9, 5, 47, 87, 239, 181, 353, 1561, 3313, 1921, 1, 3, 3, 1, 3, 15,
+    53, 221, 441, 987, 1997, 2529, 8059, 1, 1, 7, 11, 15, 57, 111, 139, 137,
+    883, 1881, 2823, 5661, 1, 3, 5, 5, 21, 11, 5, 13, 27, 973, 587, 1331, 1373,
+    1, 1, 7, 11, 29, 51, 93, 29, 217, 221, 55, 2477, 1979, 1, 3, 3, 13, 3, 11,
+    49, 75, 379, 371, 1441, 793, 7633, 1, 1, 1, 13, 19, 45, 89, 249, 91, 649,
+    1695, 915, 5619, 1, 3, 1, 7, 7, 29, 1, 77, 313, 895, 519, 771, 295, 1, 3, 1,
+    15, 5, 3, 1, 57, 331, 109, 485, 2853, 6831, 1, 1, 1, 15, 17, 3, 35, 99, 245,
+    971, 839, 2509, 2803, 1, 3, 3, 3, 9, 37, 57, 251, 325, 317, 529, 1313, 6379,
+    1, 1, 1, 15, 25, 59, 1, 119, 95, 15, 795, 2375, 6463, 1, 3, 1, 5, 1, 49,
+    117, 21, 47, 179, 863, 85, 1669, 1, 3, 7, 3, 9, 37, 19, 221, 455, 973, 571,
+    1427, 817, 1, 1, 1, 15, 17, 9, 67, 213, 127, 887, 1299, 2913, 7451, 1, 3, 1,
+    13, 27, 27, 41, 43, 171, 623, 691, 391, 4885, 1, 3, 1, 13, 17, 17, 123, 239,
+    143, 227, 1151, 519, 6543, 1, 3, 7, 5, 7, 63, 97, 39, 101, 555, 1057, 381,
+    7891, 1, 3, 5, 1, 3, 27, 85, 129, 161, 875, 1945, 3541, 695, 1, 3, 3, 5, 21,
+    59, 25, 183, 35, 25, 987, 1459, 181, 1, 3, 5, 13, 1, 15, 127, 237, 349, 337,
+    1491, 2383, 7811, 1, 3, 5, 5, 31, 5, 109, 51, 409, 733, 1395, 3207, 6049, 1,
+    1, 5, 7, 13, 35, 113, 25, 263, 389, 299, 2521, 1783, 1, 3, 7, 11, 15, 47,
+    97, 73, 55, 75, 113, 2695, 1023, 1, 3, 1, 1, 3, 13, 69, 211, 289, 483, 1335,
+    787, 677, 1, 1, 3, 3, 17, 7, 37, 77, 505, 137, 1113, 345, 2975, 1, 1, 1, 13,
+    3, 11, 95, 199, 453, 109, 479, 3725, 239, 1, 1, 7, 15, 19, 53, 3, 145, 359,
+    863, 347, 3833, 3043, 1, 1, 7, 15, 25, 63, 127, 129, 125, 195, 155, 2211,
+    8153, 1, 1, 7, 13, 9, 49, 121, 115, 73, 119, 1851, 727, 47, 1, 3, 3, 13, 13,
+    11, 71, 7, 45, 591, 133, 2407, 5563, 1, 1, 1, 13, 23, 29, 87, 89, 501, 71,
+    1759, 1119, 687, 1, 1, 7, 7, 13, 7, 13, 183, 53, 951, 1877, 3991, 6771, 1,
+    3, 7, 11, 7, 1, 27, 47, 61, 21, 919, 961, 1091, 1, 3, 5, 5, 1, 27, 1, 5, 63,
+    157, 1297, 1049, 5893, 1, 3, 7, 9, 19, 33, 17, 133, 425, 797, 1721, 153,
+    119, 1, 3, 3, 7, 13, 37, 1, 215, 509, 1003, 61, 2353, 7511, 1, 1, 7, 1, 29,
+    19, 31, 79, 199, 555, 1209, 1603, 6089, 1, 3, 1, 1, 5, 31, 111, 127, 333,
+    429, 1863, 3925, 5411, 1, 1, 7, 5, 5, 5, 123, 191, 47, 993, 269, 4051, 2111,
+    1, 1, 5, 15, 1, 9, 87, 5, 47, 463, 865, 1813, 7357, 1, 3, 1, 3, 23, 63, 123,
+    83, 511, 777, 63, 1285, 4537, 1, 3, 3, 7, 27, 25, 31, 65, 441, 529, 1815,
+    1893, 323, 1, 3, 7, 5, 11, 19, 7, 5, 397, 811, 755, 2883, 4217, 1, 3, 1, 13,
+    9, 21, 13, 7, 271, 539, 1769, 3243, 5325, 1, 1, 7, 1, 31, 13, 47, 131, 181,
+    457, 1559, 2663, 6653, 1, 3, 3, 7, 29, 55, 25, 203, 419, 91, 437, 1159,
+    5691, 1, 1, 3, 13, 29, 19, 71, 217, 337, 329, 501, 939, 2205, 1, 1, 3, 1, 1,
+    27, 17, 201, 97, 285, 1269, 4043, 2207, 1, 1, 1, 1, 3, 41, 13, 199, 141,
+    129, 1515, 3129, 5969, 1, 3, 3, 9, 3, 17, 119, 41, 271, 933, 877, 701, 2197,
+    1, 1, 1, 7, 15, 47, 3, 195, 115, 821, 725, 843, 6071, 1, 3, 5, 15, 17, 33,
+    85, 65, 297, 571, 1123, 2743, 5727, 1, 1, 5, 11, 27, 15, 37, 235, 415, 293,
+    1439, 2739, 4171, 1, 3, 7, 7, 1, 55, 71, 35, 307, 11, 401, 1881, 933, 1, 3,
+    1, 11, 21, 37, 3, 177, 119, 339, 559, 3991, 3437, 1, 3, 3, 9, 17, 17, 97,
+    119, 301, 169, 157, 3267, 2261, 1, 3, 3, 9, 29, 3, 111, 101, 355, 869, 375,
+    2609, 7377, 1, 3, 5, 9, 7, 21, 123, 99, 343, 693, 1927, 1605, 4923, 1, 1, 3,
+    5, 13, 31, 99, 17, 75, 385, 1539, 1553, 7077, 1, 3, 3, 5, 31, 35, 107, 11,
+    407, 1019, 1317, 3593, 7203, 1, 3, 3, 13, 17, 33, 99, 245, 401, 957, 157,
+    1949, 1571, 1, 3, 1, 11, 27, 15, 11, 109, 429, 307, 1911, 2701, 861, 1, 1,
+    5, 13, 13, 35, 55, 255, 311, 957, 1803, 2673, 5195, 1, 1, 1, 11, 19, 3, 89,
+    37, 211, 783, 1355, 3567, 7135, 1, 1, 5, 5, 21, 49, 79, 17, 509, 331, 183,
+    3831, 855, 1, 3, 7, 5, 29, 19, 85, 109, 105, 523, 845, 3385, 7477, 1, 1, 1,
+    7, 25, 17, 125, 131, 53, 757, 253, 2989, 2939, 1, 3, 3, 9, 19, 23, 105, 39,
+    351, 677, 211, 401, 8103, 1, 3, 5, 1, 5, 11, 17, 3, 405, 469, 1569, 2865,
+    3133, 1, 1, 3, 13, 15, 5, 117, 179, 139, 145, 477, 1137, 2537, 1, 1, 7, 9,
+    5, 21, 9, 93, 211, 963, 1207, 3343, 4911, 1, 1, 1, 9, 13, 43, 17, 53, 81,
+    793, 1571, 2523, 3683, 1, 3, 3, 13, 25, 21, 5, 59, 489, 987, 1941, 171,
+    6009, 1, 3, 3, 7, 1, 39, 89, 171, 403, 467, 1767, 3423, 2791, 1, 1, 3, 9,
+    19, 49, 91, 125, 163, 1013, 89, 2849, 6785, 1, 1, 5, 9, 9, 11, 15, 241, 43,
+    297, 1719, 1541, 1821, 1, 3, 7, 15, 29, 23, 103, 239, 191, 33, 1043, 3649,
+    6579, 1, 3, 3, 9, 21, 51, 123, 55, 223, 645, 1463, 4021, 5891, 1, 1, 5, 7,
+    3, 41, 27, 235, 391, 303, 2021, 3187, 7607, 1, 1, 1, 9, 5, 49, 49, 29, 377,
+    251, 1887, 1017, 1301, 1, 1, 3, 3, 13, 41, 27, 47, 223, 23, 517, 3227, 6731,
+    1, 1, 7, 1, 31, 25, 47, 9, 511, 623, 2047, 1263, 1511, 1, 1, 3, 15, 15, 23,
+    53, 1, 261, 595, 85, 241, 7047, 1, 3, 3, 11, 17, 5, 81, 73, 149, 781, 2035,
+    3163, 4247, 1, 3, 7, 7, 29, 59, 49, 79, 397, 901, 1105, 2191, 6277, 1, 3, 3,
+    11, 13, 27, 25, 173, 107, 73, 1265, 585, 5251, 1, 1, 7, 15, 29, 23, 73, 229,
+    235, 887, 1469, 4073, 2591, 1, 1, 3, 9, 17, 15, 83, 173, 207, 879, 1701,
+    1509, 11, 1, 1, 3, 5, 5, 37, 65, 161, 39, 421, 1153, 2007, 5355, 1, 1, 7,
+    11, 23, 37, 5, 11, 9, 499, 17, 157, 5747, 1, 3, 7, 13, 25, 9, 49, 7, 39,
+    945, 1349, 1759, 1441, 1, 1, 5, 3, 21, 15, 113, 81, 265, 837, 333, 3625,
+    6133, 1, 3, 1, 11, 13, 27, 73, 109, 297, 327, 299, 3253, 6957, 1, 1, 3, 13,
+    19, 39, 123, 73, 65, 5, 1061, 2187, 5055, 1, 1, 3, 1, 11, 31, 21, 115, 453,
+    857, 711, 495, 549, 1, 3, 7, 7, 15, 29, 79, 103, 47, 713, 1735, 3121, 6321,
+    1, 1, 5, 5, 29, 9, 97, 33, 471, 705, 329, 1501, 1349, 1, 3, 3, 1, 21, 9,
+    111, 209, 71, 47, 491, 2143, 1797, 1, 3, 3, 3, 11, 39, 21, 135, 445, 259,
+    607, 3811, 5449, 1, 1, 7, 9, 11, 25, 113, 251, 395, 317, 317, 91, 1979, 1,
+    3, 1, 9, 3, 21, 103, 133, 389, 943, 1235, 1749, 7063, 1, 1, 3, 7, 1, 11, 5,
+    15, 497, 477, 479, 3079, 6969, 1, 1, 3, 3, 15, 39, 105, 131, 475, 465, 181,
+    865, 3813, 1, 1, 7, 9, 19, 63, 123, 131, 415, 525, 457, 2471, 3135, 1, 3, 7,
+    15, 25, 35, 123, 45, 341, 805, 485, 4049, 7065, 1, 1, 1, 5, 29, 9, 47, 227,
+    51, 867, 1873, 1593, 2271, 1, 1, 7, 15, 31, 9, 71, 117, 285, 711, 837, 1435,
+    6275, 1, 3, 1, 1, 5, 19, 79, 25, 301, 415, 1871, 645, 3251, 1, 3, 1, 3, 17,
+    51, 99, 185, 447, 43, 523, 219, 429, 1, 3, 1, 13, 29, 13, 51, 93, 7, 995,
+    757, 3017, 6865, 1, 1, 3, 15, 7, 25, 75, 17, 155, 981, 1231, 1229, 1995, 1,
+    3, 5, 3, 27, 45, 71, 73, 225, 763, 377, 1139, 2863, 1, 1, 3, 1, 1, 39, 69,
+    113, 29, 371, 1051, 793, 3749, 1, 1, 3, 13, 23, 61, 27, 183, 307, 431, 1345,
+    2757, 4031, 1, 3, 7, 5, 5, 59, 117, 197, 303, 721, 877, 723, 1601, 1, 3, 5,
+    1, 27, 33, 99, 237, 485, 711, 665, 3077, 5105, 1, 1, 3, 1, 13, 9, 103, 201,
+    23, 951, 2029, 165, 2093, 1, 3, 5, 13, 5, 29, 55, 85, 221, 677, 611, 3613,
+    4567, 1, 1, 1, 1, 7, 61, 9, 233, 261, 561, 953, 4023, 2443, 1, 3, 3, 13, 1,
+    17, 103, 71, 223, 213, 833, 1747, 6999, 1, 3, 5, 15, 25, 53, 57, 187, 25,
+    695, 1207, 4089, 2877, 1, 1, 7, 1, 7, 31, 87, 129, 493, 519, 1555, 1155,
+    4637, 1, 1, 1, 15, 21, 17, 23, 29, 19, 255, 927, 1791, 3093, 1, 1, 3, 9, 17,
+    33, 95, 129, 175, 461, 287, 2633, 2325, 1, 3, 5, 7, 23, 19, 63, 209, 249,
+    583, 1373, 2039, 2225, 1, 3, 3, 5, 5, 19, 79, 241, 459, 355, 1455, 3313,
+    3639, 1, 1, 7, 9, 21, 41, 97, 119, 129, 769, 1541, 3495, 7741, 1, 1, 7, 11,
+    9, 29, 35, 255, 141, 937, 1763, 41, 1393, 1, 3, 7, 1, 13, 51, 61, 157, 177,
+    847, 1829, 3539, 285, 1, 1, 1, 15, 21, 13, 9, 55, 397, 19, 1495, 1255, 7235,
+    1, 1, 7, 7, 25, 37, 53, 237, 319, 197, 269, 1205, 1485, 1, 1, 5, 15, 23, 17,
+    35, 247, 323, 807, 233, 3681, 4407, 1, 1, 3, 7, 9, 59, 85, 105, 493, 763,
+    1639, 391, 1451, 1, 3, 3, 9, 15, 33, 5, 253, 129, 625, 1527, 2793, 6057, 1,
+    3, 1, 1, 7, 47, 21, 161, 235, 83, 397, 3563, 5953, 1, 3, 7, 11, 3, 41, 25,
+    117, 375, 779, 1297, 3715, 8117, 1, 1, 3, 7, 31, 19, 103, 173, 475, 189,
+    2035, 2921, 1107, 1, 1, 7, 3, 25, 7, 93, 255, 307, 113, 1893, 2233, 6919, 1,
+    3, 5, 15, 9, 57, 79, 143, 165, 5, 1389, 193, 693, 1, 3, 5, 1, 29, 45, 91,
+    49, 189, 461, 439, 1283, 7835, 1, 1, 3, 13, 11, 61, 41, 231, 373, 695, 395,
+    915, 5393, 1, 3, 7, 11, 5, 51, 67, 53, 483, 95, 1943, 247, 5653, 1, 3, 7, 5,
+    5, 57, 45, 235, 137, 793, 1069, 1661, 1557, 1, 3, 5, 3, 25, 55, 103, 177,
+    81, 861, 1151, 143, 7655, 1, 1, 3, 1, 21, 41, 67, 131, 253, 431, 1269, 3181,
+    3429, 1, 3, 1, 1, 21, 7, 77, 221, 257, 663, 71, 2949, 2481, 1, 3, 5, 3, 3,
+    23, 45, 107, 299, 739, 1013, 3, 3165, 1, 1, 5, 1, 3, 37, 109, 37, 243, 983,
+    1221, 1691, 3869, 1, 1, 5, 5, 31, 7, 5, 193, 397, 867, 1495, 3435, 7441, 1,
+    1, 1, 1, 17, 59, 97, 233, 389, 597, 1013, 1631, 483, 1, 1, 1, 11, 7, 41,
+    107, 53, 111, 125, 1513, 1921, 7647, 1, 3, 3, 3, 31, 29, 117, 3, 365, 971,
+    1139, 2123, 5913, 1, 1, 1, 13, 23, 3, 1, 167, 475, 639, 1811, 3841, 3081, 1,
+    1, 5, 3, 5, 47, 65, 123, 275, 783, 95, 119, 7591, 1, 3, 1, 15, 13, 33, 93,
+    237, 467, 431, 705, 4013, 4035, 1, 3, 5, 1, 19, 7, 101, 231, 155, 737, 1381,
+    3343, 2051, 1, 1, 5, 9, 15, 49, 45, 163, 433, 765, 2031, 201, 2589, 1, 3, 7,
+    9, 19, 41, 31, 89, 93, 623, 105, 745, 4409, 1, 1, 5, 1, 11, 45, 127, 85,
+    389, 439, 829, 477, 7965, 1, 3, 3, 15, 13, 41, 1, 207, 435, 585, 311, 1725,
+    2737, 1, 3, 3, 3, 13, 49, 21, 31, 197, 799, 1411, 2959, 7133, 1, 3, 1, 3, 7,
+    43, 9, 141, 133, 579, 1059, 93, 957, 1, 3, 7, 1, 15, 51, 23, 213, 381, 851,
+    699, 2261, 3419, 1, 3, 5, 9, 25, 35, 67, 141, 35, 409, 1423, 365, 1645, 1,
+    3, 3, 11, 15, 33, 27, 181, 93, 87, 1761, 3511, 1353, 1, 3, 5, 3, 25, 63,
+    111, 137, 321, 819, 705, 1547, 7271, 1, 3, 1, 1, 5, 57, 99, 59, 411, 757,
+    1371, 3953, 3695, 1, 3, 5, 11, 11, 21, 25, 147, 239, 455, 709, 953, 7175, 1,
+    3, 3, 15, 5, 53, 91, 205, 341, 63, 723, 1565, 7135, 1, 1, 7, 15, 11, 21, 99,
+    79, 63, 593, 2007, 3629, 5271, 1, 3, 3, 1, 9, 21, 45, 175, 453, 435, 1855,
+    2649, 6959, 1, 1, 3, 15, 15, 33, 121, 121, 251, 431, 1127, 3305, 4199, 1, 1,
+    1, 9, 31, 15, 71, 29, 345, 391, 1159, 2809, 345, 1, 3, 7, 1, 23, 29, 95,
+    151, 327, 727, 647, 1623, 2971, 1, 1, 7, 7, 9, 29, 79, 91, 127, 909, 1293,
+    1315, 5315, 1, 1, 5, 11, 13, 37, 89, 73, 149, 477, 1909, 3343, 525, 1, 3, 5,
+    7, 5, 59, 55, 255, 223, 459, 2027, 237, 4205, 1, 1, 1, 7, 27, 11, 95, 65,
+    325, 835, 907, 3801, 3787, 1, 1, 1, 11, 27, 33, 99, 175, 51, 913, 331, 1851,
+    4133, 1, 3, 5, 5, 13, 37, 31, 99, 273, 409, 1827, 3845, 5491, 1, 1, 3, 7,
+    23, 19, 107, 85, 283, 523, 509, 451, 421, 1, 3, 5, 7, 13, 9, 51, 81, 87,
+    619, 61, 2803, 5271, 1, 1, 1, 15, 9, 45, 35, 219, 401, 271, 953, 649, 6847,
+    1, 1, 7, 11, 9, 45, 17, 219, 169, 837, 1483, 1605, 2901, 1, 1, 7, 7, 21, 43,
+    37, 33, 291, 359, 71, 2899, 7037, 1, 3, 3, 13, 31, 53, 37, 15, 149, 949,
+    551, 3445, 5455, 1, 3, 1, 5, 19, 45, 81, 223, 193, 439, 2047, 3879, 789, 1,
+    1, 7, 3, 11, 63, 35, 61, 255, 563, 459, 2991, 3359, 1, 1, 5, 9, 13, 49, 47,
+    185, 239, 221, 1533, 3635, 2045, 1, 3, 7, 3, 25, 37, 127, 223, 51, 357, 483,
+    3837, 6873, 1, 1, 7, 9, 31, 37, 113, 31, 387, 833, 1243, 1543, 5535, 1, 3,
+    1, 9, 23, 59, 119, 221, 73, 185, 2007, 2885, 2563, 1, 1, 1, 13, 7, 33, 53,
+    179, 67, 185, 1541, 1807, 4659, 1, 3, 1, 11, 31, 37, 23, 215, 269, 357, 207,
+    645, 4219, 1, 3, 3, 13, 19, 27, 107, 55, 91, 71, 1695, 1815, 89, 1, 1, 3,
+    15, 3, 19, 35, 247, 49, 529, 1523, 3317, 6151, 1, 1, 7, 7, 23, 25, 107, 139,
+    483, 503, 1277, 243, 7879, 1, 3, 3, 13, 3, 15, 11, 197, 135, 839, 985, 275,
+    5527, 1, 3, 5, 3, 25, 47, 95, 21, 113, 307, 1001, 3065, 295, 1, 1, 3, 9, 19,
+    19, 99, 213, 363, 449, 735, 2851, 2521, 1, 1, 3, 9, 5, 49, 63, 61, 157, 857,
+    497, 2801, 6987, 1, 1, 1, 9, 1, 41, 109, 119, 499, 939, 867, 3675, 8023, 1,
+    3, 1, 1, 13, 33, 109, 123, 289, 3, 1271, 2773, 4265, 1, 3, 1, 11, 9, 57, 83,
+    221, 95, 43, 1189, 457, 7133, 1, 1, 7, 3, 11, 49, 33, 219, 229, 289, 685,
+    3359, 4495, 1, 3, 1, 3, 19, 43, 67, 193, 41, 771, 407, 81, 3891, 1, 1, 7,
+    11, 5, 29, 51, 175, 297, 539, 1, 2245, 6439, 1, 3, 7, 15, 21, 33, 117, 183,
+    511, 489, 1283, 3281, 5979, 1, 3, 7, 5, 9, 3, 125, 147, 359, 549, 369, 3049,
+    2405, 1, 3, 5, 7, 19, 5, 65, 97, 483, 377, 1523, 1457, 2995, 1, 1, 5, 1, 11,
+    21, 41, 113, 277, 131, 1475, 1043, 2367, 1, 3, 3, 1, 15, 17, 101, 69, 443,
+    865, 817, 1421, 5231, 1, 1, 3, 3, 3, 55, 95, 99, 75, 195, 1929, 3931, 5855,
+    1, 3, 1, 3, 19, 23, 93, 213, 241, 551, 1307, 585, 7729, 1, 3, 1, 11, 23, 15,
+    53, 249, 467, 519, 95, 741, 409, 1, 1, 1, 15, 29, 37, 43, 203, 233, 877, 77,
+    1933, 2729, 1, 3, 7, 11, 27, 39, 43, 161, 255, 15, 1463, 833, 495, 1, 1, 7,
+    11, 3, 53, 81, 67, 375, 823, 1903, 3061, 395, 1, 1, 1, 1, 15, 37, 93, 233,
+    247, 501, 1321, 3275, 5409, 1, 3, 3, 7, 7, 11, 5, 105, 139, 983, 1239, 531,
+    3881, 1, 1, 5, 3, 19, 49, 107, 227, 361, 101, 355, 2649, 7383, 1, 1, 7, 5,
+    25, 41, 101, 121, 209, 293, 1937, 2259, 5557, 1, 1, 3, 7, 7, 1, 9, 13, 463,
+    1019, 995, 3159, 107, 1, 3, 5, 11, 5, 35, 127, 97, 261, 789, 807, 807, 6257,
+    1, 1, 7, 5, 11, 13, 45, 91, 417, 101, 1973, 3645, 2107, 1, 1, 3, 7, 5, 63,
+    57, 49, 203, 157, 115, 1393, 8117, 1, 3, 5, 5, 3, 43, 15, 155, 127, 489,
+    1165, 3701, 4867, 1, 1, 7, 7, 29, 29, 69, 215, 415, 367, 371, 1901, 6075, 1,
+    1, 1, 3, 11, 33, 89, 149, 433, 705, 1437, 1597, 505, 1, 3, 5, 1, 13, 37, 19,
+    119, 5, 581, 2037, 1633, 2099, 1, 3, 7, 13, 5, 49, 103, 245, 215, 515, 133,
+    2007, 1933, 1, 3, 1, 9, 1, 3, 25, 197, 253, 387, 1683, 2267, 221, 1, 3, 5,
+    15, 21, 9, 73, 201, 405, 999, 437, 3877, 6045, 1, 1, 3, 1, 31, 55, 25, 83,
+    421, 395, 1807, 2129, 7797, 1, 1, 3, 1, 23, 21, 121, 183, 125, 347, 143,
+    3685, 4317, 1, 3, 3, 3, 17, 45, 17, 223, 267, 795, 1815, 1309, 155, 1, 1, 1,
+    15, 17, 59, 5, 133, 15, 715, 1503, 153, 2887, 1, 1, 1, 1, 27, 13, 119, 77,
+    243, 995, 1851, 3719, 4695, 1, 3, 1, 5, 31, 49, 43, 165, 49, 609, 1265,
+    1141, 505, 1, 1, 7, 13, 11, 63, 21, 253, 229, 585, 1543, 3719, 4141, 1, 3,
+    7, 11, 23, 27, 17, 131, 295, 895, 1493, 1411, 3247, 1, 1, 5, 9, 29, 7, 97,
+    15, 113, 445, 859, 1483, 1121, 1, 3, 1, 9, 13, 49, 99, 107, 323, 201, 681,
+    3071, 5281, 1, 1, 1, 15, 9, 19, 61, 161, 7, 87, 587, 2199, 2811, 1, 3, 3,
+    15, 15, 19, 95, 45, 299, 829, 981, 3479, 487, 1, 1, 1, 9, 3, 37, 7, 19, 227,
+    13, 397, 513, 1257, 1, 1, 5, 15, 15, 13, 17, 111, 135, 929, 1145, 811, 1801,
+    1, 3, 1, 3, 27, 57, 31, 19, 279, 103, 693, 631, 3409, 1, 1, 1, 1, 15, 13,
+    67, 83, 23, 799, 1735, 2063, 3363, 1, 3, 3, 7, 3, 1, 61, 31, 41, 533, 2025,
+    4067, 6963, 1, 1, 5, 7, 17, 27, 81, 79, 107, 205, 29, 97, 4883, 1, 1, 1, 5,
+    19, 49, 91, 201, 283, 949, 651, 3819, 5073, 1, 1, 7, 9, 11, 13, 73, 197, 37,
+    219, 1931, 3369, 6017, 1, 1, 7, 15, 11, 7, 75, 205, 7, 819, 399, 661, 6487,
+    1, 3, 3, 3, 27, 37, 95, 41, 307, 165, 1077, 3485, 563, 1, 3, 5, 3, 21, 49,
+    57, 179, 109, 627, 1789, 431, 2941, 1, 1, 7, 5, 11, 19, 43, 137, 149, 679,
+    1543, 245, 1381, 1, 3, 5, 5, 15, 3, 69, 81, 135, 159, 1363, 3401, 6355, 1,
+    3, 5, 1, 9, 61, 49, 53, 319, 25, 1647, 1297, 615, 1, 3, 5, 11, 31, 43, 9,
+    101, 71, 919, 335, 3147, 5823, 1, 3, 1, 1, 15, 5, 29, 109, 511, 945, 867,
+    3677, 6915, 1, 3, 3, 15, 17, 49, 91, 111, 215, 29, 1879, 97, 2505, 1, 3, 1,
+    13, 19, 61, 11, 111, 163, 777, 533, 1113, 5339, 1, 1, 7, 9, 17, 55, 117, 91,
+    455, 289, 557, 913, 4455, 1, 3, 1, 7, 25, 19, 123, 37, 1, 277, 717, 2965,
+    4469, 1, 3, 7, 3, 19, 23, 87, 235, 209, 457, 2041, 2893, 1805, 1, 3, 3, 5,
+    5, 43, 23, 61, 351, 791, 59, 2009, 2909, 1, 1, 3, 7, 5, 1, 27, 231, 385,
+    257, 1261, 2701, 1807, 1, 3, 1, 1, 27, 19, 87, 253, 131, 685, 1743, 3983,
+    2651, 1, 3, 7, 11, 21, 17, 11, 81, 191, 641, 1821, 3005, 7251, 1, 3, 3, 5,
+    15, 31, 41, 213, 55, 931, 1953, 49, 6037, 1, 1, 7, 15, 7, 27, 65, 223, 113,
+    79, 1875, 911, 5445, 1, 3, 7, 7, 23, 55, 51, 167, 495, 25, 1585, 3447, 799,
+    1, 1, 3, 7, 27, 15, 95, 193, 337, 415, 975, 3085, 967, 1, 1, 7, 15, 19, 7,
+    93, 41, 433, 551, 401, 3169, 3971, 1, 1, 7, 11, 13, 15, 53, 69, 433, 59,
+    1117, 3359, 6231, 1, 1, 7, 3, 23, 5, 115, 201, 225, 109, 1903, 3897, 6265,
+    1, 1, 1, 11, 17, 1, 39, 143, 361, 659, 1105, 23, 4923, 1, 1, 1, 9, 27, 57,
+    85, 227, 261, 119, 1881, 3965, 6999, 1, 3, 7, 7, 15, 7, 107, 17, 315, 49,
+    1591, 905, 7789, 1, 3, 1, 7, 29, 3, 47, 237, 157, 769, 839, 3199, 3195, 1,
+    1, 3, 15, 25, 39, 63, 15, 111, 857, 881, 1505, 7671, 1, 1, 7, 1, 3, 35, 41,
+    215, 99, 895, 1025, 1483, 4707, 1, 3, 5, 1, 1, 31, 25, 247, 113, 841, 397,
+    1825, 6969, 1, 1, 3, 5, 19, 41, 49, 243, 225, 973, 241, 175, 1041, 1, 1, 1,
+    7, 15, 15, 105, 141, 83, 75, 1675, 3523, 5219, 1, 1, 7, 5, 13, 27, 47, 199,
+    445, 841, 959, 1157, 2209, 1, 3, 5, 15, 23, 31, 31, 81, 85, 33, 785, 2639,
+    7799, 1, 1, 5, 13, 21, 3, 47, 99, 235, 943, 1731, 2467, 7891, 1, 1, 1, 3,
+    17, 53, 85, 219, 73, 131, 1339, 875, 1191, 1, 1, 5, 7, 17, 63, 113, 7, 185,
+    557, 749, 3563, 4973, 1, 3, 3, 15, 15, 21, 43, 111, 155, 689, 345, 423,
+    3597, 1, 1, 5, 1, 15, 29, 93, 5, 361, 713, 695, 3937, 425, 1, 3, 7, 7, 13,
+    41, 115, 175, 315, 937, 123, 2841, 4457, 1, 1, 3, 11, 25, 5, 103, 53, 423,
+    811, 657, 399, 7257, 1, 1, 1, 1, 1, 13, 101, 211, 383, 325, 97, 1703, 4429,
+    1, 3, 7, 9, 31, 45, 83, 157, 509, 701, 841, 1105, 3643, 1, 1, 1, 7, 1, 9,
+    69, 17, 129, 281, 1161, 2945, 7693, 1, 3, 7, 1, 11, 29, 51, 143, 77, 433,
+    1723, 2317, 5641, 1, 1, 1, 1, 21, 43, 13, 67, 177, 505, 1629, 1267, 4885, 1,
+    1, 3, 11, 27, 63, 111, 47, 233, 781, 453, 1679, 3209, 1, 1, 3, 13, 29, 27,
+    119, 141, 493, 971, 461, 1159, 633, 1, 1, 3, 15, 23, 5, 79, 215, 163, 149,
+    1805, 2399, 61, 1, 3, 5, 13, 19, 5, 1, 39, 409, 561, 709, 829, 1357, 1, 3,
+    3, 13, 19, 43, 9, 177, 449, 447, 73, 2107, 5669, 1, 3, 5, 1, 23, 13, 63,
+    109, 203, 593, 829, 4017, 6881, 1, 1, 5, 7, 3, 9, 53, 175, 391, 169, 1283,
+    3793, 4451, 1, 1, 5, 7, 29, 43, 9, 5, 209, 77, 927, 2941, 8145, 1, 3, 5, 15,
+    17, 49, 5, 143, 131, 771, 1685, 925, 2175, 1, 1, 3, 11, 27, 27, 27, 159,
+    161, 1015, 1587, 4049, 1983, 1, 3, 1, 3, 23, 57, 119, 67, 481, 577, 389,
+    3319, 5325, 1, 3, 5, 1, 19, 39, 87, 61, 329, 657, 1773, 31, 1707, 1, 1, 3,
+    1, 5, 25, 15, 241, 131, 815, 1751, 3029, 8039, 1, 3, 3, 13, 27, 13, 77, 87,
+    437, 57, 621, 1031, 7891, 1, 3, 1, 13, 23, 51, 117, 37, 331, 745, 605, 3179,
+    4713, 1, 1, 5, 5, 19, 17, 99, 167, 87, 721, 737, 789, 2165, 1, 3, 5, 13, 1,
+    51, 119, 211, 165, 299, 1327, 3053, 3343, 1, 1, 5, 15, 29, 45, 17, 129, 67,
+    345, 1553, 2705, 7369, 1, 1, 1, 9, 23, 7, 13, 209, 7, 407, 317, 3077, 7287,
+    1, 1, 1, 5, 9, 59, 89, 3, 487, 451, 505, 2499, 7563, 1, 3, 1, 7, 21, 1, 21,
+    203, 101, 417, 1389, 2751, 1397, 1, 3, 7, 13, 7, 31, 3, 247, 349, 485, 1259,
+    549, 6321, 1, 1, 7, 7, 27, 33, 107, 197, 293, 729, 1753, 2571, 103, 1, 3, 5,
+    9, 25, 35, 5, 253, 137, 213, 2041, 3387, 1809, 1, 1, 7, 13, 15, 35, 67, 83,
+    295, 175, 839, 2831, 839, 1, 3, 3, 11, 3, 17, 55, 141, 247, 991, 117, 3799,
+    1221, 1, 1, 5, 1, 11, 37, 87, 233, 457, 653, 899, 2933, 3105, 1, 1, 3, 15,
+    3, 31, 67, 167, 437, 9, 651, 1109, 1139, 1, 1, 3, 1, 7, 63, 67, 17, 11, 883,
+    1855, 1941, 4751, 1, 3, 7, 9, 19, 33, 113, 117, 495, 39, 1795, 2561, 5519,
+    1, 1, 7, 5, 1, 3, 103, 37, 201, 223, 1101, 877, 6483, 1, 1, 5, 9, 29, 49,
+    51, 33, 439, 917, 861, 1321, 2135, 1, 1, 3, 3, 1, 5, 17, 93, 217, 619, 613,
+    1357, 6095, 1, 3, 1, 11, 3, 21, 5, 41, 15, 175, 843, 2937, 6849, 1, 3, 3, 7,
+    9, 57, 55, 127, 79, 287, 445, 2205, 7989, 1, 1, 7, 13, 23, 17, 93, 129, 157,
+    135, 1747, 1813, 4183, 1, 1, 1, 5, 31, 59, 99, 33, 425, 329, 887, 367, 1761,
+    1, 1, 7, 9, 17, 53, 77, 139, 435, 387, 49, 3649, 1773, 1, 3, 3, 15, 21, 57,
+    45, 161, 331, 719, 273, 3479, 4173, 1, 1, 3, 9, 3, 3, 105, 201, 373, 877,
+    919, 1263, 6649, 1, 3, 1, 15, 13, 43, 13, 99, 73, 163, 353, 3569, 5601, 1,
+    3, 7, 3, 5, 9, 69, 177, 449, 47, 781, 1125, 4245, 1, 1, 1, 5, 3, 45, 1, 123,
+    409, 903, 205, 2057, 7637, 1, 3, 5, 9, 19, 47, 87, 135, 481, 799, 101, 3409,
+    2241, 1, 3, 1, 13, 3, 25, 15, 27, 181, 967, 669, 2577, 7249, 1, 1, 7, 3, 31,
+    5, 103, 53, 1, 911, 1209, 3697, 6685, 1, 1, 3, 1, 5, 5, 49, 135, 281, 747,
+    761, 2973, 7963, 1, 3, 3, 5, 19, 61, 125, 199, 299, 515, 1365, 369, 7027, 1,
+    3, 1, 7, 5, 41, 63, 229, 283, 571, 147, 447, 657, 1, 3, 1, 11, 5, 15, 55, 7,
+    259, 61, 27, 1429, 5631, 1, 1, 5, 1, 3, 53, 51, 253, 155, 553, 1293, 3735,
+    6567, 1, 3, 5, 9, 5, 41, 21, 159, 101, 785, 1981, 3799, 7693, 1, 3, 7, 7, 9,
+    3, 95, 105, 129, 213, 1215, 1027, 5699, 1, 1, 3, 3, 29, 13, 9, 253, 449,
+    321, 341, 2879, 171, 1, 3, 7, 11, 21, 11, 75, 35, 43, 965, 675, 2217, 7175,
+    1, 1, 5, 15, 31, 5, 29, 137, 311, 751, 47, 1367, 5921, 1, 1, 3, 15, 17, 1,
+    45, 69, 55, 649, 835, 569, 7615, 1, 3, 1, 13, 31, 7, 23, 15, 391, 145, 1845,
+    1825, 1403, 1, 1, 3, 15, 5, 9, 79, 77, 105, 399, 1933, 2503, 4781, 1, 3, 1,
+    3, 17, 47, 19, 13, 107, 475, 759, 2933, 3761, 1, 1, 7, 11, 3, 7, 121, 209,
+    397, 877, 293, 847, 7039, 1, 1, 1, 15, 29, 45, 5, 109, 335, 461, 143, 931,
+    4045, 1, 3, 1, 7, 11, 57, 73, 89, 201, 173, 803, 3953, 5205, 1, 1, 5, 11,
+    11, 33, 37, 29, 263, 1019, 657, 1453, 7807, 1, 3, 3, 13, 31, 25, 37, 47,
+    261, 607, 1703, 2603, 417, 1, 1, 1, 1, 31, 61, 45, 115, 275, 239, 1989,
+    1897, 4329, 1, 3, 5, 3, 31, 3, 11, 173, 335, 579, 1193, 2219, 7875, 1, 1, 7,
+    9, 29, 45, 13, 67, 399, 177, 1293, 3865, 2225, 1, 1, 7, 11, 11, 51, 121,
+    227, 469, 905, 929, 2635, 4165, 1, 3, 7, 9, 13, 39, 55, 167, 23, 147, 1603,
+    2083, 4645, 1, 1, 3, 15, 27, 53, 11, 155, 157, 629, 259, 3009, 4605, 1, 3,
+    1, 7, 15, 47, 51, 1, 259, 603, 887, 2833, 6581, 1, 3, 5, 3, 1, 47, 91, 43,
+    361, 571, 29, 1453, 4269, 1, 1, 3, 9, 11, 51, 55, 23, 415, 277, 1423, 3475,
+    1527, 1, 1, 3, 11, 29, 49, 101, 75, 299, 709, 805, 4037, 4389, 1, 1, 7, 3,
+    23, 1, 37, 51, 379, 771, 1301, 3717, 6673, 1, 1, 5, 3, 23, 11, 125, 177,
+    375, 665, 951, 1577, 2603, 1, 1, 1, 1, 1, 5, 71, 255, 21, 459, 467, 2083,
+    5415, 1, 1, 5, 13, 23, 29, 109, 157, 363, 971, 549, 647, 1177, 1, 1, 3, 9,
+    7, 15, 101, 3, 365, 213, 745, 1155, 6099, 1, 3, 5, 15, 15, 19, 47, 179, 303,
+    521, 1279, 219, 2415, 1, 3, 3, 13, 27, 11, 83, 165, 369, 989, 261, 3933,
+    4809, 1, 1, 3, 11, 31, 59, 1, 185, 53, 703, 1471, 2935, 1107, 1, 3, 3, 7,
+    25, 3, 81, 27, 93, 521, 433, 2859, 5861, 1, 3, 3, 11, 29, 15, 49, 167, 315,
+    927, 543, 3473, 4307, 1, 3, 1, 3, 29, 33, 53, 15, 183, 691, 703, 1311, 3393,
+    1, 3, 5, 13, 23, 49, 3, 11, 1, 357, 1407, 415, 7211, 1, 3, 7, 15, 1, 25, 91,
+    113, 323, 371, 189, 925, 1181, 1, 3, 3, 3, 17, 59, 119, 199, 115, 223, 877,
+    2193, 193, 1, 1, 1, 5, 5, 35, 31, 59, 437, 411, 37, 2405, 3797, 1, 3, 1, 13,
+    9, 37, 1, 241, 59, 157, 1785, 1223, 563, 1, 3, 5, 13, 3, 21, 25, 95, 15,
+    745, 85, 701, 5361, 1, 3, 7, 1, 31, 33, 111, 195, 35, 913, 2013, 2951, 6611,
+    1, 3, 5, 1, 19, 3, 75, 119, 111, 409, 951, 1457, 4957, 1, 3, 1, 15, 19, 59,
+    3, 155, 237, 657, 1967, 3323, 6235, 1, 1, 5, 1, 3, 19, 45, 105, 377, 881,
+    167, 2255, 4483, 1, 1, 7, 7, 13, 13, 99, 89, 201, 279, 161, 2483, 6001, 1,
+    1, 7, 3, 13, 17, 97, 129, 137, 377, 1519, 183, 3725, 1, 1, 7, 9, 9, 5, 45,
+    135, 115, 181, 1685, 3505, 4387, 1, 1, 1, 1, 19, 35, 69, 113, 305, 419, 949,
+    2969, 247, 1, 1, 5, 13, 23, 61, 13, 139, 501, 811, 67, 1501, 6493, 1, 1, 3,
+    13, 15, 41, 27, 217, 293, 13, 145, 2631, 6991, 1, 3, 3, 13, 15, 37, 71, 123,
+    285, 49, 627, 1283, 5993, 1, 3, 3, 11, 9, 25, 11, 1, 203, 353, 1347, 1999,
+    2799, 1, 3, 5, 1, 7, 49, 101, 231, 499, 63, 1977, 2207, 7829, 1, 1, 7, 1,
+    17, 15, 115, 139, 381, 943, 623, 4037, 2971, 1, 1, 3, 5, 13, 55, 23, 87,
+    139, 795, 1669, 1375, 1185, 1, 3, 3, 5, 5, 45, 97, 253, 241, 333, 645, 555,
+    7867, 1, 3, 5, 1, 1, 1, 89, 27, 407, 509, 1433, 609, 2355, 1, 3, 7, 1, 27,
+    29, 5, 157, 495, 811, 1293, 1143, 827, 1, 1, 3, 3, 25, 49, 127, 111, 191, 3,
+    845, 1383, 2521, 1, 1, 5, 7, 5, 51, 101, 155, 237, 461, 831, 3091, 3851, 1,
+    3, 7, 1, 29, 35, 105, 91, 285, 705, 131, 395, 6011, 1, 3, 5, 3, 13, 21, 83,
+    173, 221, 827, 1775, 1931, 6727, 1, 1, 3, 5, 3, 25, 95, 115, 205, 569, 1447,
+    933, 6425, 1, 1, 7, 9, 31, 3, 17, 175, 145, 447, 1321, 1069, 6527, 1, 1, 3,
+    3, 23, 1, 79, 51, 421, 419, 873, 3939, 1801, 1, 1, 5, 1, 3, 39, 15, 85, 169,
+    669, 919, 397, 5579, 1, 3, 5, 1, 21, 61, 87, 217, 251, 619, 1091, 4009, 229,
+    1, 1, 1, 11, 23, 55, 85, 121, 363, 867, 315, 447, 3373, 1, 3, 3, 13, 29, 19,
+    89, 85, 137, 469, 1873, 2765, 3975, 1, 3, 7, 13, 19, 63, 61, 77, 67, 361,
+    11, 1787, 4703, 1, 1, 3, 11, 7, 15, 127, 105, 179, 857, 1671, 3647, 3389, 1,
+    1, 1, 7, 19, 21, 99, 161, 499, 519, 1287, 2973, 479, 1, 1, 3, 13, 29, 51,
+    95, 251, 55, 519, 1955, 2881, 5951, 1, 1, 3, 11, 23, 63, 121, 237, 175, 311,
+    701, 1539, 2383, 1, 1, 7, 5, 5, 45, 73, 97, 5, 153, 715, 2037, 3353, 1, 1,
+    1, 3, 13, 7, 67, 173, 425, 843, 1497, 2729, 5193, 1, 1, 7, 1, 23, 3, 119,
+    11, 77, 141, 1905, 2269, 4269, 1, 1, 7, 15, 1, 23, 79, 251, 439, 603, 405,
+    2449, 6383, 1, 3, 7, 11, 29, 27, 47, 255, 47, 661, 1967, 1007, 3689, 1, 3,
+    7, 5, 19, 39, 35, 115, 417, 373, 291, 329, 603, 1, 3, 1, 9, 11, 33, 27, 193,
+    207, 423, 1311, 1369, 7307, 1, 1, 3, 11, 9, 29, 83, 17, 497, 493, 329, 3141,
+    5935, 1, 3, 1, 5, 31, 51, 29, 171, 51, 493, 1621, 3501, 4091, 1, 1, 5, 9,
+    21, 43, 105, 207, 245, 363, 1191, 699, 1139, 1, 1, 3, 11, 19, 5, 81, 119,
+    247, 169, 1337, 45, 6565, 1, 3, 1, 11, 3, 51, 3, 101, 159, 11, 253, 299,
+    5043, 1, 3, 1, 5, 11, 53, 85, 39, 57, 645, 2007, 1039, 3627, 1, 3, 5, 3, 17,
+    61, 97, 165, 415, 357, 283, 601, 5505, 1, 3, 7, 3, 9, 51, 49, 85, 3, 227,
+    137, 309, 243, 1, 1, 5, 3, 11, 59, 11, 131, 409, 703, 455, 123, 6727, 1, 3,
+    7, 9, 25, 49, 21, 171, 287, 379, 667, 313, 713, 1, 1, 3, 9, 7, 35, 47, 3,
+    367, 581, 1627, 1665, 3905, 1, 3, 1, 1, 29, 57, 35, 55, 255, 653, 823, 2197,
+    6179, 1, 3, 7, 15, 17, 15, 117, 83, 359, 163, 115, 2999, 5373, 1, 1, 5, 3,
+    21, 61, 35, 97, 71, 687, 207, 2917, 1049, 1, 1, 1, 15, 13, 15, 125, 81, 263,
+    661, 417, 3243, 1669, 1, 1, 7, 3, 3, 19, 111, 193, 443, 339, 659, 1211,
+    1557, 1, 3, 1, 3, 27, 3, 3, 173, 391, 213, 803, 3281, 3207, 1, 1, 5, 15, 19,
+    1, 7, 211, 157, 603, 403, 1387, 1583,
+};
+
+static errno_t sequence_sobol(sequence_t* s, int dimensions) {
+    mem.zero(s, sizeof(*s));
+    if (dimensions < 1 || dimensions > sequence_sobol_max_dimensions) {
+        return EINVAL;
+    }
+    s->kind = sequence_kind_sobol;
+    s->dimensions = dimensions;
+    s->direction = (uint32_t*)heap.alloc(dimensions * 32 * sizeof(uint32_t));
+    s->x = (uint32_t*)heap.allocate(dimensions * sizeof(uint32_t));
+    if (s->direction == null || s->x == null) {
+        sequence_dispose(s);
+        return ENOMEM;
+    }
+    for (int k = 0; k < 32; k++) { s->direction[k] = 1U << (31 - k); }
+    const uint16_t* joe_kuo = sequence_joe_kuo; // of dimension d
+    int degree = 1;
+    uint32_t a = 0; // next candidate middle coefficients
+    for (int d = 1; d < dimensions; d++) {
+        uint32_t p = 0;
+        for (;;) { // next primitive polynomial in Joe & Kuo order
+            if (a >= (1U << (degree - 1))) { degree++; a = 0; }
+            p = (1U << degree) | (a << 1) | 1;
+            a++;
+            if (sequence_primitive(p, degree)) { break; }
+        }
+        uint32_t m[32];
+        for (int k = 0; k < degree; k++) { m[k] = *joe_kuo++; } // odd < 2^(k+1)
+        for (int k = degree; k < 32; k++) { // Bratley & Fox recurrence
+            uint32_t v = m[k - degree] ^ (m[k - degree] << degree);
+            for (int j = 1; j < degree; j++) {
+                if ((p >> (degree - j)) & 1) { v ^= m[k - j] << j; }
+            }
+            m[k] = v;
+        }
+        uint32_t* v = s->direction + d * 32;
+        for (int k = 0; k < 32; k++) { v[k] = m[k] << (31 - k); }
+    }
+    assertion(joe_kuo <= sequence_joe_kuo + countof(sequence_joe_kuo),
+              "%d dimensions", dimensions);
+    return 0;
+}
+
+static errno_t sequence_halton(sequence_t* s, int dimensions) {
+    mem.zero(s, sizeof(*s));
+    if (dimensions < 1 || dimensions > sequence_max_dimensions) {
+        return EINVAL;
+    }
+    s->kind = sequence_kind_halton;
+    s->dimensions = dimensions;
+    s->base = (uint32_t*)heap.alloc(dimensions * sizeof(uint32_t));
+    if (s->base == null) { return ENOMEM; }
+    int n = 0;
+    for (uint32_t c = 2; n < dimensions; c++) {
+        bool prime = true;
+        for (int i = 0; i < n && s->base[i] * s->base[i] <= c && prime; i++) {
+            prime = c % s->base[i] != 0;
+        }
+        if (prime) { s->base[n++] = c; }
+    }
+    return 0;
+}
+
+static void sequence_skip(sequence_t* s, int64_t n) {
+    s->index += n;
+    if (s->kind == sequence_kind_sobol) {
+        assertion(0 <= s->index && s->index <= UINT32_MAX, "index=%lld",
+                  (long long)s->index);
+        const uint32_t gray = (uint32_t)(s->index ^ (s->index >> 1));
+        for (int d = 0; d < s->dimensions; d++) {
+            const uint32_t* v = s->direction + d * 32;
+            uint32_t x = 0;
+            for (int k = 0; k < 32; k++) {
+                if ((gray >> k) & 1) { x ^= v[k]; }
+            }
+            s->x[d] = x;
+        }
+    }
+}
+
+static void sequence_next(sequence_t* s, double point[]) {
+    if (s->kind == sequence_kind_sobol) {
+        assertion(s->index < UINT32_MAX, "Sobol sequence exhausted");
+        // Gray code order: next point differs by one direction number
+        const int c = __builtin_ctz((uint32_t)(s->index + 1));
+        for (int d = 0; d < s->dimensions; d++) {
+            point[d] = s->x[d] * (1.0 / 4294967296.0);
+            s->x[d] ^= s->direction[d * 32 + c];
+        }
+    } else {
+        for (int d = 0; d < s->dimensions; d++) {
+            const uint32_t b = s->base[d];
+            const double inverse = 1.0 / b;
+            double f = inverse;
+            double r = 0;
+            for (int64_t i = s->index; i > 0; i /= b) {
+                r += (double)(i % b) * f;
+                f *= inverse;
+            }
+            point[d] = r;
+        }
+    }
+    s->index++;
+}
+
+static void sequence_fill(sequence_t* s, double points[], int_t count) {
+    for (int_t i = 0; i < count; i++) {
+        sequence_next(s, points + i * s->dimensions);
+    }
+}
+
+sequence_if sequence = {
+    .sobol = sequence_sobol,
+    .halton = sequence_halton,
+    .next = sequence_next,
+    .skip = sequence_skip,
+    .fill = sequence_fill,
+    .dispose = sequence_dispose
+};
+
+enum { heap_mmap_threshold = 1024 * 1024 }; // larger blocks are mmap()-ed
+
+typedef struct { // precedes every block of the global heap
+    int_t bytes;  // requested
+    int_t mapped; // bytes of mmap()-ed region or 0 for malloc()-ed block
+                  // or < 0 for NUMA node arena block (see numa_arena_t)
+} heap_block_t;
+
+static void numa_arena_free(heap_block_t* b);
+static int_t numa_arena_usable_size(const heap_block_t* b);
+
+static int_t heap_mapping_size(int_t bytes) {
+    const int_t page = (int_t)sysconf(_SC_PAGESIZE);
+    return (bytes + (int_t)sizeof(heap_block_t) + page - 1) / page * page;
+}
+
+static heap_block_t* heap_map(int_t bytes) {
+    const int_t size = heap_mapping_size(bytes);
+    void* a = mmap(null, size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (a == MAP_FAILED) { return null; }
+    heap_block_t* b = (heap_block_t*)a;
+    b->bytes = bytes;
+    b->mapped = size;
+    return b;
+}
+
+// Grows without copying (mremap() moves pages by editing page tables)
+// and gives tail pages back to the OS on shrink.
+
+static heap_block_t* heap_remap(heap_block_t* b, int_t bytes) {
+    const int_t size = heap_mapping_size(bytes);
+    if (size < b->mapped) {
+        if_error_fatal(munmap((uint8_t*)b + size, b->mapped - size));
+    } else if (size > b->mapped) {
+        #if defined(__linux__)
+            void* a = mremap(b, b->mapped, size, MREMAP_MAYMOVE);
+            if (a == MAP_FAILED) { return null; }
+            b = (heap_block_t*)a;
+        #else // try to extend in place, otherwise move
+            uint8_t* end = (uint8_t*)b + b->mapped;
+            void* a = mmap(end, size - b->mapped, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (a == MAP_FAILED) { return null; }
+            if (a != end) {
+                if_error_fatal(munmap(a, size - b->mapped));
+                heap_block_t* n = heap_map(bytes);
+                if (n == null) { return null; }
+                memcpy(n + 1, b + 1, b->bytes);
+                if_error_fatal(munmap(b, b->mapped));
+                b = n;
+            }
+        #endif
+    }
+    b->bytes = bytes;
+    b->mapped = size;
+    return b;
+}
+
+static void* heap_alloc(int_t bytes) {
+    heap_block_t* b = null;
+    if (bytes >= heap_mmap_threshold) {
+        b = heap_map(bytes);
+    } else {
+        b = (heap_block_t*)malloc(sizeof(heap_block_t) + bytes);
+        if (b != null) { b->bytes = bytes; b->mapped = 0; }
+    }
+    return b == null ? null : b + 1;
+}
+
+static void* heap_free(void* data) {
+    if (data != null) {
+        heap_block_t* b = (heap_block_t*)data - 1;
+        if (b->mapped < 0) {
+            numa_arena_free(b);
+        } else if (b->mapped != 0) {
+            if_error_fatal(munmap(b, b->mapped));
+        } else {
+            free(b);
+        }
+    }
+    return null;
+}
+
+static void* heap_realloc(void* data, int_t bytes) {
+    if (data == null) { return heap_alloc(bytes); }
+    heap_block_t* b = (heap_block_t*)data - 1;
+    heap_block_t* r = null;
+    if (b->mapped > 0 && bytes >= heap_mmap_threshold) {
+        r = heap_remap(b, bytes);
+    } else if (b->mapped == 0 && bytes < heap_mmap_threshold) {
+        r = (heap_block_t*)realloc(b, sizeof(heap_block_t) + bytes);
+        if (r != null) { r->bytes = bytes; }
+    } else { // crossing the threshold in either direction or node arena
+        void* p = heap_alloc(bytes);
+        if (p != null) {
+            memcpy(p, data, bytes < b->bytes ? bytes : b->bytes);
+            heap_free(data);
+        }
+        return p;
+    }
+    return r == null ? null : r + 1;
+}
+
+static void* heap_allocate(int_t bytes) {
+    if (bytes >= heap_mmap_threshold) { return heap_alloc(bytes); } // zeroed
+    heap_block_t* b = (heap_block_t*)calloc(1, sizeof(heap_block_t) + bytes);
+    if (b != null) { b->bytes = bytes; }
+    return b == null ? null : b + 1;
+}
+
+static int_t heap_usable_size(const void* data) {
+    if (data == null) { return 0; }
+    const heap_block_t* b = (const heap_block_t*)data - 1;
+    if (b->mapped < 0) { return numa_arena_usable_size(b); }
+    if (b->mapped != 0) { return b->mapped - (int_t)sizeof(heap_block_t); }
+    #if defined(__APPLE__)
+        return (int_t)malloc_size(b) - (int_t)sizeof(heap_block_t);
+    #else
+        return (int_t)malloc_usable_size((void*)b) - (int_t)sizeof(heap_block_t);
+    #endif
+}
+
+static void* heap_free_sized(void* data, int_t bytes) {
+    #if defined(_DEBUG) || defined(DEBUG)
+        assertion(data == null || ((heap_block_t*)data - 1)->bytes == bytes,
+            "%p was not allocated with %lld bytes", data, (long long)bytes);
+    #else
+        (void)bytes;
+    #endif
+    return heap_free(data); // the block header already has the size
+}
+
+static errno_t heap_alloc_batch(int_t bytes, int_t n, void* out[]) {
+    for (int_t i = 0; i < n; i++) {
+        out[i] = heap_alloc(bytes);
+        if (out[i] == null) {
+            while (i > 0) { heap_free(out[--i]); }
+            return ENOMEM;
+        }
+    }
+    return 0;
+}
+
+static void heap_free_batch(void* data[], int_t n) {
+    for (int_t i = 0; i < n; i++) { heap_free(data[i]); }
+}
+
+#if defined(__linux__)
+
+enum { numa_mpol_default = 0, numa_mpol_preferred = 1, numa_mpol_bind = 2,
+       numa_mpol_interleave = 3 }; // from <linux/mempolicy.h>
+
+static atomic_int numa_online; // 0 until first numa_nodes() call
+
+static int numa_nodes(void) {
+    int n = atomic_load_explicit(&numa_online, memory_order_relaxed);
+    if (n == 0) { // "0" or "0-1" or "0-3,5" ...
+        n = 1;
+        FILE* f = fopen("/sys/devices/system/node/online", "r");
+        if (f != null) {
+            int from = 0;
+            int to = 0;
+            char separator = 0;
+            while (fscanf(f, "%d", &from) == 1) {
+                to = from;
+                if (fscanf(f, "%c", &separator) == 1 && separator == '-') {
+                    if (fscanf(f, "%d", &to) != 1) { to = from; }
+                    if (fscanf(f, "%c", &separator) != 1) { separator = 0; }
+                }
+                if (to + 1 > n) { n = to + 1; }
+                if (separator != ',') { break; }
+            }
+            fclose(f);
+        }
+        if (n > numa_max_nodes) { n = numa_max_nodes; }
+        atomic_store_explicit(&numa_online, n, memory_order_relaxed);
+    }
+    return n;
+}
+
+static int numa_current_node(void) {
+    unsigned int cpu = 0;
+    unsigned int node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, null) != 0) { node = 0; }
+    return (int)node;
+}
+
+static errno_t numa_mbind(void* data, int_t bytes, int mode,
+                          unsigned long mask) {
+    // maxnode + 1 because kernel drops the last bit (historical quirk)
+    return syscall(SYS_mbind, data, bytes, mode, &mask, numa_max_nodes + 1,
+                   0) == 0 ? 0 : errno;
+}
+
+static errno_t numa_bind(void* data, int_t bytes, int node) {
+    if (node < 0 || node >= numa_max_nodes) { return EINVAL; }
+    return numa_mbind(data, bytes, numa_mpol_bind, 1UL << node);
+}
+
+static unsigned long numa_all_nodes(void) {
+    const int n = numa_nodes();
+    return n >= 64 ? ~0UL : (1UL << n) - 1;
+}
+
+static errno_t numa_interleave(void* data, int_t bytes) {
+    return numa_mbind(data, bytes, numa_mpol_interleave, numa_all_nodes());
+}
+
+static errno_t numa_prefer(int node) {
+    if (node >= numa_max_nodes) { return EINVAL; }
+    unsigned long mask = node < 0 ? 0 : 1UL << node;
+    const int mode = node < 0 ? numa_mpol_default : numa_mpol_preferred;
+    return syscall(SYS_set_mempolicy, mode, node < 0 ? null : &mask,
+                   node < 0 ? 0 : numa_max_nodes + 1) == 0 ? 0 : errno;
+}
 
-
-#if (defined(DEBUG) || defined(_DEBUG)) && !defined(NDEBUG)
-enum { is_debug_build = 1 };
 #else
-enum { is_debug_build = 0 };
+
+static int numa_nodes(void) { return 1; }
+
+static int numa_current_node(void) { return 0; }
+
+static errno_t numa_bind(void* data, int_t bytes, int node) {
+    (void)data; (void)bytes; (void)node;
+    return ENOSYS;
+}
+
+static errno_t numa_interleave(void* data, int_t bytes) {
+    (void)data; (void)bytes;
+    return ENOSYS;
+}
+
+static errno_t numa_prefer(int node) {
+    (void)node;
+    return ENOSYS;
+}
+
 #endif
 
-nposix_if np = {
-    (bool)is_debug_build
-};
+// Per node arenas: chunks are mmap()-ed and mbind()-ed once and small
+// blocks (header included up to 64KB) are carved out of them in size
+// classes 32, 48, 64, 96, 128 ... 64KB. Freed blocks go to the free list
+// of their node and class (any thread may free) and are reused; chunks
+// are never returned to the OS. Larger blocks are mmap()-ed and bound
+// individually. Arena blocks have heap_block_t.mapped = -(1 + node *
+// numa_arena_classes + class).
+
+enum {
+    numa_arena_classes = 23, // 32 << 11 = 64KB is the last one
+    numa_arena_max = 64 * 1024,
+    numa_arena_chunk = 2 * 1024 * 1024
+};
+
+typedef struct {
+    pthread_mutex_t lock;
+    uint8_t* chunk; // carving position in the current chunk
+    int_t left;     // bytes left in the current chunk
+    heap_block_t* free_list[numa_arena_classes]; // next is in block data
+} numa_arena_t;
+
+static numa_arena_t numa_arenas[numa_max_nodes];
+static pthread_once_t numa_arenas_once = PTHREAD_ONCE_INIT;
+
+static void numa_arenas_init(void) {
+    for (int i = 0; i < numa_max_nodes; i++) {
+        if_error_fatal(pthread_mutex_init(&numa_arenas[i].lock, null));
+    }
+}
+
+static int_t numa_arena_class_size(int c) {
+    return (int_t)((c % 2 == 0 ? 32 : 48) << (c / 2));
+}
+
+static int numa_arena_class(int_t size) { // size including header
+    if (size <= 32) { return 0; }
+    const int p = 63 - __builtin_clzll((uint64_t)size - 1); // 2^p < size
+    return size <= (int_t)3 << (p - 1) ? 2 * (p - 5) + 1 : 2 * (p - 4);
+}
+
+static heap_block_t* numa_arena_alloc(int_t bytes, int node) {
+    const int c = numa_arena_class(bytes + (int_t)sizeof(heap_block_t));
+    const int_t size = numa_arena_class_size(c);
+    pthread_once(&numa_arenas_once, numa_arenas_init);
+    numa_arena_t* a = &numa_arenas[node];
+    if_error_fatal(pthread_mutex_lock(&a->lock));
+    heap_block_t* b = a->free_list[c];
+    if (b != null) {
+        a->free_list[c] = *(heap_block_t**)(b + 1);
+    } else {
+        if (a->left < size) { // tail of previous chunk (< 64KB) is lost
+            void* m = mmap(null, numa_arena_chunk, PROT_READ | PROT_WRITE,
+                           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (m != MAP_FAILED) {
+                (void)numa_bind(m, numa_arena_chunk, node);
+                a->chunk = (uint8_t*)m;
+                a->left = numa_arena_chunk;
+            }
+        }
+        if (a->left >= size) {
+            b = (heap_block_t*)a->chunk;
+            a->chunk += size;
+            a->left -= size;
+        }
+    }
+    if_error_fatal(pthread_mutex_unlock(&a->lock));
+    if (b != null) {
+        b->bytes = bytes;
+        b->mapped = -(1 + node * numa_arena_classes + c);
+    }
+    return b;
+}
+
+static void numa_arena_free(heap_block_t* b) {
+    const int_t i = -b->mapped - 1;
+    numa_arena_t* a = &numa_arenas[i / numa_arena_classes];
+    const int c = (int)(i % numa_arena_classes);
+    if_error_fatal(pthread_mutex_lock(&a->lock));
+    *(heap_block_t**)(b + 1) = a->free_list[c];
+    a->free_list[c] = b;
+    if_error_fatal(pthread_mutex_unlock(&a->lock));
+}
+
+static int_t numa_arena_usable_size(const heap_block_t* b) {
+    const int c = (int)((-b->mapped - 1) % numa_arena_classes);
+    return numa_arena_class_size(c) - (int_t)sizeof(heap_block_t);
+}
+
+// Placement failures (e.g. mbind() denied by seccomp) are not fatal:
+// memory is still usable, it just lands wherever first touch puts it.
+
+static void* numa_node_alloc(int_t bytes, int node) {
+    heap_block_t* b = null;
+    if (bytes + (int_t)sizeof(heap_block_t) <= numa_arena_max) {
+        b = numa_arena_alloc(bytes, node);
+    } else {
+        b = heap_map(bytes);
+        if (b != null) { (void)numa_bind(b, b->mapped, node); }
+    }
+    return b == null ? null : b + 1;
+}
+
+static void* heap_alloc_on_node(int_t bytes, int node) {
+    assertion(0 <= node && node < numa_nodes(), "node=%d", node);
+    if (numa_nodes() == 1) { return heap_alloc(bytes); }
+    return numa_node_alloc(bytes, node);
+}
+
+static void* heap_alloc_interleaved(int_t bytes) {
+    if (numa_nodes() == 1) { return heap_alloc(bytes); }
+    heap_block_t* b = heap_map(bytes);
+    if (b != null) { (void)numa_interleave(b, b->mapped); }
+    return b == null ? null : b + 1;
+}
+
+heap_if heap = {
+    .alloc = heap_alloc,
+    .realloc = heap_realloc,
+    .free = heap_free,
+    .allocate = heap_allocate,
+    .free_sized = heap_free_sized,
+    .usable_size = heap_usable_size,
+    .alloc_batch = heap_alloc_batch,
+    .free_batch = heap_free_batch,
+    .alloc_on_node = heap_alloc_on_node,
+    .alloc_interleaved = heap_alloc_interleaved
+};
+
+static void* numa_local_alloc(int_t bytes) {
+    return heap_alloc_on_node(bytes, numa_current_node());
+}
+
+static void* numa_local_allocate(int_t bytes) {
+    // mmap()-ed blocks are zero already, arena blocks may be reused
+    void* p = numa_local_alloc(bytes);
+    const heap_block_t* b = p == null ? null : (const heap_block_t*)p - 1;
+    if (b != null && b->mapped <= 0) { mem.zero(p, bytes); }
+    return p;
+}
+
+// Single node blocks come from malloc() and heap_realloc() is fine.
+// Bound mappings stay mappings: mremap() keeps the mbind() policy of the
+// mapping for moved and added pages. Arena blocks stay in place while
+// the size class is the same, otherwise move to the calling thread node.
+
+static void* numa_local_realloc(void* data, int_t bytes) {
+    if (data == null) { return numa_local_alloc(bytes); }
+    heap_block_t* b = (heap_block_t*)data - 1;
+    if (b->mapped == 0) { return heap_realloc(data, bytes); }
+    if (b->mapped > 0) {
+        heap_block_t* r = heap_remap(b, bytes);
+        return r == null ? null : r + 1;
+    }
+    const int c = (int)((-b->mapped - 1) % numa_arena_classes);
+    if (numa_arena_class(bytes + (int_t)sizeof(heap_block_t)) == c) {
+        b->bytes = bytes;
+        return data;
+    }
+    void* p = numa_node_alloc(bytes, numa_current_node());
+    if (p != null) {
+        mem.copy(p, data, bytes < b->bytes ? bytes : b->bytes);
+        heap_free(data);
+    }
+    return p;
+}
+
+static errno_t numa_local_alloc_batch(int_t bytes, int_t n, void* out[]) {
+    for (int_t i = 0; i < n; i++) {
+        out[i] = numa_local_alloc(bytes);
+        if (out[i] == null) {
+            while (i > 0) { heap_free(out[--i]); }
+            return ENOMEM;
+        }
+    }
+    return 0;
+}
+
+numa_if numa = {
+    .nodes = numa_nodes,
+    .current_node = numa_current_node,
+    .bind = numa_bind,
+    .interleave = numa_interleave,
+    .prefer = numa_prefer,
+    .heap = {
+        .alloc = numa_local_alloc,
+        .realloc = numa_local_realloc,
+        .free = heap_free,
+        .allocate = numa_local_allocate,
+        .free_sized = heap_free_sized,
+        .usable_size = heap_usable_size,
+        .alloc_batch = numa_local_alloc_batch,
+        .free_batch = heap_free_batch,
+        .alloc_on_node = heap_alloc_on_node,
+        .alloc_interleaved = heap_alloc_interleaved
+    }
+};
+
+typedef struct {
+    uint8_t* base; // null until the first push() of the thread
+    int_t top;
+    int_t high; // high-water mark: pages below may be committed
+} scratch_stack_t;
+
+typedef struct { // precedes blocks allocated via scratch.heap
+    int_t bytes;
+    int_t start; // of the block header
+} scratch_block_t;
+
+static _Thread_local scratch_stack_t scratch_stack;
+static pthread_key_t scratch_key;
+static pthread_once_t scratch_key_once = PTHREAD_ONCE_INIT;
+
+static void scratch_unmap(void* base) {
+    if_error_fatal(munmap(base, scratch_reserve));
+}
+
+static void scratch_key_create(void) {
+    if_error_fatal(pthread_key_create(&scratch_key, scratch_unmap));
+}
+
+static scratch_stack_t* scratch_reserved(void) {
+    scratch_stack_t* s = &scratch_stack;
+    if (s->base == null) {
+        if_error_fatal(pthread_once(&scratch_key_once, scratch_key_create));
+        void* a = mmap(null, scratch_reserve, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (a == MAP_FAILED) { fatal("mmap() failed %s", strerror(errno)); }
+        if_error_fatal(pthread_setspecific(scratch_key, a));
+        s->base = (uint8_t*)a;
+    }
+    return s;
+}
+
+static void* scratch_push(int_t bytes) {
+    scratch_stack_t* s = scratch_reserved();
+    // s->top is 16 bytes aligned: rounding cannot cross scratch_reserve
+    if (bytes < 0 || bytes > scratch_reserve - s->top) {
+        fatal("scratch overflow: %lld + %lld bytes",
+              (long long)s->top, (long long)bytes);
+    }
+    void* p = s->base + s->top;
+    s->top += (bytes + 15) & ~15;
+    if (s->top > s->high) { s->high = s->top; }
+    return p;
+}
+
+static int_t scratch_mark(void) { return scratch_stack.top; }
+
+static void scratch_pop(int_t mark) {
+    scratch_stack_t* s = &scratch_stack;
+    swear(0 <= mark && mark <= s->top);
+    s->top = mark;
+    const int_t keep = mark > scratch_retain ? mark : scratch_retain;
+    if (s->high > keep) { // return pages above the threshold to the OS
+        const int_t page = (int_t)sysconf(_SC_PAGESIZE);
+        const int_t start = (keep + page - 1) & ~(page - 1);
+        if (s->high > start) {
+            if_error_fatal(madvise(s->base + start, s->high - start,
+                                   MADV_DONTNEED));
+        }
+        s->high = keep;
+    }
+}
+
+static void* scratch_alloc(int_t bytes) {
+    const int_t start = scratch_mark();
+    scratch_block_t* b = (scratch_block_t*)
+        scratch_push(sizeof(scratch_block_t) + bytes);
+    b->bytes = bytes;
+    b->start = start;
+    return b + 1;
+}
+
+static bool scratch_is_last(const scratch_block_t* b) {
+    const scratch_stack_t* s = &scratch_stack;
+    return (const uint8_t*)b == s->base + b->start &&
+        b->start + (int_t)sizeof(*b) + ((b->bytes + 15) & ~15) == s->top;
+}
+
+static void* scratch_realloc(void* data, int_t bytes) {
+    if (data == null) { return scratch_alloc(bytes); }
+    scratch_block_t* b = (scratch_block_t*)data - 1;
+    if (scratch_is_last(b)) {
+        scratch_pop(b->start);
+        scratch_push(sizeof(scratch_block_t) + bytes); // cannot move
+        b->bytes = bytes;
+        return data;
+    }
+    void* p = scratch_alloc(bytes);
+    mem.copy(p, data, bytes < b->bytes ? bytes : b->bytes);
+    return p;
+}
+
+static void* scratch_free(void* data) {
+    if (data != null) {
+        scratch_block_t* b = (scratch_block_t*)data - 1;
+        if (scratch_is_last(b)) { scratch_pop(b->start); }
+    }
+    return null;
+}
+
+static void* scratch_allocate(int_t bytes) {
+    return mem.zero(scratch_alloc(bytes), bytes);
+}
+
+static void* scratch_free_sized(void* data, int_t bytes) {
+    #if defined(_DEBUG) || defined(DEBUG)
+        assertion(data == null || ((scratch_block_t*)data - 1)->bytes == bytes,
+            "%p was not allocated with %lld bytes", data, (long long)bytes);
+    #else
+        (void)bytes;
+    #endif
+    return scratch_free(data);
+}
+
+static int_t scratch_usable_size(const void* data) {
+    return data == null ? 0 :
+        (((const scratch_block_t*)data - 1)->bytes + 15) & ~15;
+}
+
+static errno_t scratch_alloc_batch(int_t bytes, int_t n, void* out[]) {
+    for (int_t i = 0; i < n; i++) { out[i] = scratch_alloc(bytes); }
+    return 0; // overflow is fatal anyway
+}
+
+static void scratch_free_batch(void* data[], int_t n) {
+    // in reverse order so that blocks at the top are released in place
+    for (int_t i = n - 1; i >= 0; i--) { scratch_free(data[i]); }
+}
+
+scratch_if scratch = {
+    .push = scratch_push,
+    .mark = scratch_mark,
+    .pop = scratch_pop,
+    .heap = {
+        .alloc = scratch_alloc,
+        .realloc = scratch_realloc,
+        .free = scratch_free,
+        .allocate = scratch_allocate,
+        .free_sized = scratch_free_sized,
+        .usable_size = scratch_usable_size,
+        .alloc_batch = scratch_alloc_batch,
+        .free_batch = scratch_free_batch
+    }
+};
+
+static void strbuf_init(strbuf_t* sb, heap_if* h) {
+    sb->heap = h != null ? h : &heap;
+    sb->data = sb->inline_buffer;
+    sb->bytes = 0;
+    sb->capacity = countof(sb->inline_buffer) - 1;
+    sb->data[0] = 0;
+}
+
+static errno_t strbuf_reserve(strbuf_t* sb, int_t bytes) {
+    assertion(bytes >= 0, "bytes=%lld", (int64_t)bytes);
+    int_t need = sb->bytes + bytes;
+    if (need <= sb->capacity) { return 0; }
+    // geometric growth makes series of appends amortized O(1)
+    int_t capacity = sb->capacity * 2 > need ? sb->capacity * 2 : need;
+    bool on_heap = sb->data != sb->inline_buffer;
+    char* data = null;
+    if (on_heap && sb->heap->realloc != null) {
+        data = (char*)sb->heap->realloc(sb->data, capacity + 1);
+        if (data == null) { return ENOMEM; }
+    } else { // inline buffer or heap (e.g. arena) without realloc()
+        data = (char*)sb->heap->alloc(capacity + 1);
+        if (data == null) { return ENOMEM; }
+        mem.copy(data, sb->data, sb->bytes + 1);
+        if (on_heap) { sb->heap->free(sb->data); }
+    }
+    sb->data = data;
+    sb->capacity = capacity;
+    return 0;
+}
+
+static errno_t strbuf_append(strbuf_t* sb, const void* data, int_t bytes) {
+    errno_t r = strbuf_reserve(sb, bytes);
+    if (r == 0) {
+        mem.copy(sb->data + sb->bytes, data, bytes);
+        sb->bytes += bytes;
+        sb->data[sb->bytes] = 0;
+    }
+    return r;
+}
+
+static errno_t strbuf_append_span(strbuf_t* sb, span_t s) {
+    return strbuf_append(sb, s.data, s.bytes);
+}
+
+static errno_t strbuf_append_str(strbuf_t* sb, const char* s) {
+    return strbuf_append(sb, s, strlen(s));
+}
+
+static errno_t strbuf_append_char(strbuf_t* sb, char ch) {
+    return strbuf_append(sb, &ch, 1);
+}
+
+// two digits at a time from the right halves number of divisions
+
+static const char strbuf_digit_pairs[201] =
+    "00010203040506070809101112131415161718192021222324252627282930313233"
+    "34353637383940414243444546474849505152535455565758596061626364656667"
+    "6869707172737475767778798081828384858687888990919293949596979899";
+
+static errno_t strbuf_append_unsigned(strbuf_t* sb, uint64_t v, bool minus) {
+    char digits[24]; // 2^64 - 1 = 18446744073709551615 (20 digits) and '-'
+    char* p = digits + countof(digits);
+    while (v >= 100) {
+        const char* pair = &strbuf_digit_pairs[(v % 100) * 2];
+        v /= 100;
+        *--p = pair[1];
+        *--p = pair[0];
+    }
+    if (v >= 10) {
+        *--p = strbuf_digit_pairs[v * 2 + 1];
+        *--p = strbuf_digit_pairs[v * 2];
+    } else {
+        *--p = (char)('0' + v);
+    }
+    if (minus) { *--p = '-'; }
+    return strbuf_append(sb, p, digits + countof(digits) - p);
+}
+
+static errno_t strbuf_append_uint64(strbuf_t* sb, uint64_t v) {
+    return strbuf_append_unsigned(sb, v, false);
+}
+
+static errno_t strbuf_append_int64(strbuf_t* sb, int64_t v) {
+    // 0 - (uint64_t)v is well defined for INT64_MIN unlike -v
+    return v < 0 ? strbuf_append_unsigned(sb, 0 - (uint64_t)v, true) :
+                   strbuf_append_unsigned(sb, (uint64_t)v, false);
+}
+
+// Grisu3 (F. Loitsch "Printing Floating-Point Numbers Quickly and Accurately
+// with Integers", PLDI 2010) produces the shortest digits that round trip
+// for about 99.5% of doubles and detects the rest which are left to
+// strbuf_shortest_fallback().
+
+typedef struct { uint64_t f; int e; } strbuf_fp_t; // f * 2^e
+
+// normalized f * 2^e approximations of 10^k for k = -348, -340 ... 340
+
+static const struct { uint64_t f; int16_t e; } strbuf_powers_of_ten[87] = {
+    { 0xFA8FD5A0081C0288, -1220 }, { 0xBAAEE17FA23EBF76, -1193 },
+    { 0x8B16FB203055AC76, -1166 }, { 0xCF42894A5DCE35EA, -1140 },
+    { 0x9A6BB0AA55653B2D, -1113 }, { 0xE61ACF033D1A45DF, -1087 },
+    { 0xAB70FE17C79AC6CA, -1060 }, { 0xFF77B1FCBEBCDC4F, -1034 },
+    { 0xBE5691EF416BD60C, -1007 }, { 0x8DD01FAD907FFC3C,  -980 },
+    { 0xD3515C2831559A83,  -954 }, { 0x9D71AC8FADA6C9B5,  -927 },
+    { 0xEA9C227723EE8BCB,  -901 }, { 0xAECC49914078536D,  -874 },
+    { 0x823C12795DB6CE57,  -847 }, { 0xC21094364DFB5637,  -821 },
+    { 0x9096EA6F3848984F,  -794 }, { 0xD77485CB25823AC7,  -768 },
+    { 0xA086CFCD97BF97F4,  -741 }, { 0xEF340A98172AACE5,  -715 },
+    { 0xB23867FB2A35B28E,  -688 }, { 0x84C8D4DFD2C63F3B,  -661 },
+    { 0xC5DD44271AD3CDBA,  -635 }, { 0x936B9FCEBB25C996,  -608 },
+    { 0xDBAC6C247D62A584,  -582 }, { 0xA3AB66580D5FDAF6,  -555 },
+    { 0xF3E2F893DEC3F126,  -529 }, { 0xB5B5ADA8AAFF80B8,  -502 },
+    { 0x87625F056C7C4A8B,  -475 }, { 0xC9BCFF6034C13053,  -449 },
+    { 0x964E858C91BA2655,  -422 }, { 0xDFF9772470297EBD,  -396 },
+    { 0xA6DFBD9FB8E5B88F,  -369 }, { 0xF8A95FCF88747D94,  -343 },
+    { 0xB94470938FA89BCF,  -316 }, { 0x8A08F0F8BF0F156B,  -289 },
+    { 0xCDB02555653131B6,  -263 }, { 0x993FE2C6D07B7FAC,  -236 },
+    { 0xE45C10C42A2B3B06,  -210 }, { 0xAA242499697392D3,  -183 },
+    { 0xFD87B5F28300CA0E,  -157 }, { 0xBCE5086492111AEB,  -130 },
+    { 0x8CBCCC096F5088CC,  -103 }, { 0xD1B71758E219652C,   -77 },
+    { 0x9C40000000000000,   -50 }, { 0xE8D4A51000000000,   -24 },
+    { 0xAD78EBC5AC620000,     3 }, { 0x813F3978F8940984,    30 },
+    { 0xC097CE7BC90715B3,    56 }, { 0x8F7E32CE7BEA5C70,    83 },
+    { 0xD5D238A4ABE98068,   109 }, { 0x9F4F2726179A2245,   136 },
+    { 0xED63A231D4C4FB27,   162 }, { 0xB0DE65388CC8ADA8,   189 },
+    { 0x83C7088E1AAB65DB,   216 }, { 0xC45D1DF942711D9A,   242 },
+    { 0x924D692CA61BE758,   269 }, { 0xDA01EE641A708DEA,   295 },
+    { 0xA26DA3999AEF774A,   322 }, { 0xF209787BB47D6B85,   348 },
+    { 0xB454E4A179DD1877,   375 }, { 0x865B86925B9BC5C2,   402 },
+    { 0xC83553C5C8965D3D,   428 }, { 0x952AB45CFA97A0B3,   455 },
+    { 0xDE469FBD99A05FE3,   481 }, { 0xA59BC234DB398C25,   508 },
+    { 0xF6C69A72A3989F5C,   534 }, { 0xB7DCBF5354E9BECE,   561 },
+    { 0x88FCF317F22241E2,   588 }, { 0xCC20CE9BD35C78A5,   614 },
+    { 0x98165AF37B2153DF,   641 }, { 0xE2A0B5DC971F303A,   667 },
+    { 0xA8D9D1535CE3B396,   694 }, { 0xFB9B7CD9A4A7443C,   720 },
+    { 0xBB764C4CA7A44410,   747 }, { 0x8BAB8EEFB6409C1A,   774 },
+    { 0xD01FEF10A657842C,   800 }, { 0x9B10A4E5E9913129,   827 },
+    { 0xE7109BFBA19C0C9D,   853 }, { 0xAC2820D9623BF429,   880 },
+    { 0x80444B5E7AA7CF85,   907 }, { 0xBF21E44003ACDD2D,   933 },
+    { 0x8E679C2F5E44FF8F,   960 }, { 0xD433179D9C8CB841,   986 },
+    { 0x9E19DB92B4E31BA9,  1013 }, { 0xEB96BF6EBADF77D9,  1039 },
+    { 0xAF87023B9BF0EE6B,  1066 },
+};
+
+static strbuf_fp_t strbuf_fp_normalize(strbuf_fp_t x) { // x.f != 0
+    const int z = __builtin_clzll(x.f);
+    x.f <<= z;
+    x.e -= z;
+    return x;
+}
+
+static strbuf_fp_t strbuf_fp_multiply(strbuf_fp_t a, strbuf_fp_t b) {
+    // upper 64 bits of 128 bit product rounded to nearest
+    const uint64_t m = 0xFFFFFFFFu;
+    const uint64_t a1 = a.f >> 32, a0 = a.f & m, b1 = b.f >> 32, b0 = b.f & m;
+    const uint64_t hh = a1 * b1, hl = a1 * b0, lh = a0 * b1, ll = a0 * b0;
+    const uint64_t mid = (ll >> 32) + (hl & m) + (lh & m) + (1u << 31);
+    strbuf_fp_t r = { hh + (hl >> 32) + (lh >> 32) + (mid >> 32),
+                      a.e + b.e + 64 };
+    return r;
+}
+
+// moves last digit closer to v while it stays inside the unsafe interval;
+// false when the result is not provably the closest shortest one
+
+static bool strbuf_round_weed(char* digits, int n, uint64_t distance,
+        uint64_t unsafe, uint64_t rest, uint64_t ten_kappa, uint64_t unit) {
+    const uint64_t small = distance - unit;
+    const uint64_t big = distance + unit;
+    while (rest < small && unsafe - rest >= ten_kappa &&
+           (rest + ten_kappa < small ||
+            small - rest >= rest + ten_kappa - small)) {
+        digits[n - 1]--;
+        rest += ten_kappa;
+    }
+    if (rest < big && unsafe - rest >= ten_kappa &&
+        (rest + ten_kappa < big || big - rest > rest + ten_kappa - big)) {
+        return false;
+    }
+    return 2 * unit <= rest && rest <= unsafe - 4 * unit;
+}
+
+// v > 0 finite: v == digits * 10^exponent, returns number of digits or 0
+
+static int strbuf_grisu3(double v, char digits[24], int* exponent) {
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof(bits));
+    const uint64_t hidden = 1ULL << 52;
+    const int biased = (int)((bits >> 52) & 0x7FF);
+    uint64_t f = bits & (hidden - 1);
+    int e = 1 - 1075; // denormal
+    if (biased != 0) { f |= hidden; e = biased - 1075; }
+    // boundaries halfway to the neighbours, lower one is closer at 2^e:
+    strbuf_fp_t w = strbuf_fp_normalize((strbuf_fp_t){ f, e });
+    strbuf_fp_t hi = strbuf_fp_normalize((strbuf_fp_t){ (f << 1) + 1, e - 1 });
+    strbuf_fp_t lo = f == hidden && biased > 1 ?
+        (strbuf_fp_t){ (f << 2) - 1, e - 2 } :
+        (strbuf_fp_t){ (f << 1) - 1, e - 1 };
+    lo.f <<= lo.e - hi.e;
+    lo.e = hi.e;
+    // scale by 10^mk so that the binary exponent lands in [-60, -32]:
+    const int k = (int)ceil((-60 - (w.e + 64) + 63) * 0.30102999566398114);
+    const int i = (348 + k - 1) / 8 + 1;
+    const int mk = i * 8 - 348;
+    const strbuf_fp_t c = { strbuf_powers_of_ten[i].f,
+                            strbuf_powers_of_ten[i].e };
+    w = strbuf_fp_multiply(w, c);
+    lo = strbuf_fp_multiply(lo, c);
+    hi = strbuf_fp_multiply(hi, c);
+    assertion(-60 <= w.e && w.e <= -32, "w.e=%d", w.e);
+    // generate digits of the upper boundary widened by the rounding error:
+    uint64_t unit = 1;
+    const uint64_t too_high = hi.f + unit;
+    uint64_t unsafe = too_high - (lo.f - unit);
+    const int shift = -w.e;
+    const uint64_t one = 1ULL << shift;
+    uint32_t integrals = (uint32_t)(too_high >> shift);
+    uint64_t fractionals = too_high & (one - 1);
+    uint32_t divisor = 1;
+    int kappa = 1;
+    while ((uint64_t)divisor * 10 <= integrals) { divisor *= 10; kappa++; }
+    int n = 0;
+    while (kappa > 0) {
+        digits[n++] = (char)('0' + integrals / divisor);
+        integrals %= divisor;
+        kappa--;
+        const uint64_t rest = ((uint64_t)integrals << shift) + fractionals;
+        if (rest < unsafe) {
+            *exponent = kappa - mk;
+            return strbuf_round_weed(digits, n, too_high - w.f, unsafe, rest,
+                (uint64_t)divisor << shift, unit) ? n : 0;
+        }
+        divisor /= 10;
+    }
+    for (;;) {
+        fractionals *= 10;
+        unit *= 10;
+        unsafe *= 10;
+        digits[n++] = (char)('0' + (fractionals >> shift));
+        fractionals &= one - 1;
+        kappa--;
+        if (fractionals < unsafe) {
+            *exponent = kappa - mk;
+            return strbuf_round_weed(digits, n, (too_high - w.f) * unit,
+                unsafe, fractionals, one, unit) ? n : 0;
+        }
+    }
+}
+
+// round trip is monotonic in precision: binary search for the shortest
+// "%.*e" and keep only its digits so the locale decimal point never leaks
+
+static int strbuf_shortest_fallback(double v, char digits[24], int* exponent) {
+    char s[32];
+    int lo = 1, hi = 17;
+    while (lo < hi) {
+        const int mid = (lo + hi) / 2;
+        snprintf(s, sizeof(s), "%.*e", mid - 1, v);
+        if (strtod(s, null) == v) { hi = mid; } else { lo = mid + 1; }
+    }
+    snprintf(s, sizeof(s), "%.*e", lo - 1, v);
+    int n = 0;
+    const char* p = s;
+    while (*p != 'e' && *p != 'E' && *p != 0) {
+        if ('0' <= *p && *p <= '9') { digits[n++] = *p; }
+        p++;
+    }
+    assertion(n == lo && *p != 0, "\"%s\"", s);
+    while (n > 1 && digits[n - 1] == '0') { n--; }
+    *exponent = (int)strtol(p + 1, null, 10) - (n - 1);
+    return n;
+}
+
+static errno_t strbuf_append_double(strbuf_t* sb, double v) {
+    if (isnan(v)) { return strbuf_append(sb, "nan", 3); }
+    if (isinf(v)) {
+        return v < 0 ? strbuf_append(sb, "-inf", 4) :
+                       strbuf_append(sb, "inf", 3);
+    }
+    // integral values below 2^53 are exact and by far the most common:
+    if (-9007199254740992.0 <= v && v <= 9007199254740992.0 &&
+        v == (double)(int64_t)v) {
+        return strbuf_append_int64(sb, (int64_t)v);
+    }
+    char digits[24];
+    int exponent = 0;
+    int n = strbuf_grisu3(fabs(v), digits, &exponent);
+    if (n == 0) { n = strbuf_shortest_fallback(fabs(v), digits, &exponent); }
+    // same layout as "%.17g" but with the shortest digits and always '.'
+    char s[32]; // "-0.00012345678901234567" "-1.2345678901234567e-308"
+    char* p = s;
+    if (v < 0) { *p++ = '-'; }
+    const int x = n - 1 + exponent; // decimal exponent of the first digit
+    if (-4 <= x && x < 17) {
+        if (x < 0) {
+            *p++ = '0';
+            *p++ = '.';
+            for (int i = 0; i < -x - 1; i++) { *p++ = '0'; }
+            memcpy(p, digits, n);
+            p += n;
+        } else if (x >= n - 1) {
+            memcpy(p, digits, n);
+            p += n;
+            for (int i = 0; i < x - (n - 1); i++) { *p++ = '0'; }
+        } else {
+            memcpy(p, digits, x + 1);
+            p += x + 1;
+            *p++ = '.';
+            memcpy(p, digits + x + 1, n - x - 1);
+            p += n - x - 1;
+        }
+    } else {
+        *p++ = digits[0];
+        if (n > 1) {
+            *p++ = '.';
+            memcpy(p, digits + 1, n - 1);
+            p += n - 1;
+        }
+        *p++ = 'e';
+        *p++ = x < 0 ? '-' : '+';
+        const int a = x < 0 ? -x : x;
+        if (a >= 100) { *p++ = (char)('0' + a / 100); }
+        *p++ = (char)('0' + a / 10 % 10);
+        *p++ = (char)('0' + a % 10);
+    }
+    assertion(p - s < (int_t)sizeof(s), "%d", (int)(p - s));
+    return strbuf_append(sb, s, p - s);
+}
+
+static span_t strbuf_span(const strbuf_t* sb) {
+    span_t s = { sb->data, sb->bytes };
+    return s;
+}
+
+static void strbuf_clear(strbuf_t* sb) {
+    sb->bytes = 0;
+    sb->data[0] = 0;
+}
+
+static void strbuf_dispose(strbuf_t* sb) {
+    if (sb->data != sb->inline_buffer) { sb->heap->free(sb->data); }
+    strbuf_init(sb, sb->heap);
+}
+
+strbuf_if strbuf = {
+    .init = strbuf_init,
+    .reserve = strbuf_reserve,
+    .append = strbuf_append,
+    .append_span = strbuf_append_span,
+    .append_str = strbuf_append_str,
+    .append_char = strbuf_append_char,
+    .append_int64 = strbuf_append_int64,
+    .append_uint64 = strbuf_append_uint64,
+    .append_double = strbuf_append_double,
+    .span = strbuf_span,
+    .clear = strbuf_clear,
+    .dispose = strbuf_dispose
+};
+
+static double time_since_epoch(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint64_t ns = ts.tv_sec * (uint64_t)process_clock.nsec_per_sec + ts.tv_nsec;
+    return ns / (double)process_clock.nsec_per_sec;
+}
+
+static double time_in_seconds(void) {
+    struct timespec ts = {};
+#ifdef __APPLE__
+    static clockid_t process_clock_id = CLOCK_PROCESS_CPUTIME_ID;
+#else
+    static clockid_t process_clock_id;
+    if (process_clock_id == 0) {
+        if_error_fatal(clock_getcpuclockid(0, &process_clock_id));
+    }
+#endif
+    if_error_fatal(clock_gettime(process_clock_id, &ts));
+    uint_fast64_t ns = ts.tv_sec * (uint_fast64_t)process_clock.nsec_per_sec + ts.tv_nsec;
+#ifdef PROCESS_CLOCK_TIME_ZERO_AT_FIRST_CALL
+    // convinience - number of seconds since first call
+    static atomic_uint_fast64_t first;
+    uint_fast64_t zero = 0;
+    atomic_compare_exchange_strong(&first, &zero, ns); // prevent negative
+    if (first == 0) {
+        traceln("atomic_compare_exchange_strong() failed?");
+        first = ns; // Plan B
+    }
+    ns = ns - first;
+#endif
+    return ns / (double)process_clock.nsec_per_sec; // nanoseconds to seconds
+}
+
+process_clock_if process_clock = {
+    .nsec_per_sec = 1000000000,
+    .usec_per_sec = 1000000,
+    .msec_per_sec = 1000,
+    .time_since_epoch = time_since_epoch,
+    .time = time_in_seconds
+};
+
+static void mutex_init(mutex_t* m) {
+    if_error_fatal(pthread_mutex_init(m, null));
+}
+
+static void mutex_init_shared(mutex_t* m) {
+    pthread_mutexattr_t a;
+    if_error_fatal(pthread_mutexattr_init(&a));
+    if_error_fatal(pthread_mutexattr_setpshared(&a, PTHREAD_PROCESS_SHARED));
+#if !defined(__APPLE__) // no robust mutexes on macOS
+    if_error_fatal(pthread_mutexattr_setrobust(&a, PTHREAD_MUTEX_ROBUST));
+#endif
+    if_error_fatal(pthread_mutex_init(m, &a));
+    if_error_fatal(pthread_mutexattr_destroy(&a));
+}
+
+// EOWNERDEAD: mutex is now held by the caller but the state it protects
+// may have been left half updated by the owner that died.
+
+static int mutex_recover(mutex_t* m, int r) {
+#if !defined(__APPLE__)
+    if (r == EOWNERDEAD) {
+        if (mutex.owner_died == null || !mutex.owner_died(m)) {
+            fatal("mutex %p owner died", (void*)m);
+        }
+        if_error_fatal(pthread_mutex_consistent(m));
+        r = 0;
+    }
+#endif
+    return r;
+}
+
+static void mutex_lock(mutex_t* m) {
+    if_error_fatal(mutex_recover(m, pthread_mutex_lock(m)));
+}
+
+static errno_t mutex_try_lock(mutex_t* m) {
+    int mutex_trylock = mutex_recover(m, pthread_mutex_trylock(m));
+    if (mutex_trylock != EBUSY) {
+        if_error_fatal(mutex_trylock);
+    }
+    return mutex_trylock;
+}
+
+// seconds * 1e9 does not fit int64_t past ~292 years (and is UB to convert)
+// so whole seconds and the fraction are added separately with timeouts
+// clamped to a century which is forever for anybody waiting on a lock.
+
+static const double mutex_deadline_max_seconds = 100.0 * 365 * 24 * 60 * 60;
+
+static struct timespec mutex_deadline(double seconds) {
+    struct timespec now = {};
+    if_error_fatal(clock_gettime(CLOCK_MONOTONIC, &now));
+    if (!(seconds > 0)) { seconds = 0; } // negative or NaN
+    if (seconds > mutex_deadline_max_seconds) {
+        seconds = mutex_deadline_max_seconds;
+    }
+    const int64_t whole = (int64_t)seconds;
+    const int64_t ns = now.tv_nsec +
+        (int64_t)((seconds - (double)whole) * process_clock.nsec_per_sec);
+    struct timespec deadline = {
+        .tv_sec = now.tv_sec + (time_t)whole +
+                  (time_t)(ns / process_clock.nsec_per_sec),
+        .tv_nsec = (long)(ns % process_clock.nsec_per_sec)
+    };
+    return deadline;
+}
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 30)
+
+static errno_t mutex_lock_timeout(mutex_t* m, double seconds) {
+    const struct timespec deadline = mutex_deadline(seconds);
+    int r = mutex_recover(m,
+                pthread_mutex_clocklock(m, CLOCK_MONOTONIC, &deadline));
+    if (r != ETIMEDOUT) { if_error_fatal(r); }
+    return r;
+}
+
+#else // pthread_mutex_timedlock() uses CLOCK_REALTIME or does not exist
+
+static errno_t mutex_lock_timeout(mutex_t* m, double seconds) {
+    const struct timespec deadline = mutex_deadline(seconds);
+    long sleep_ns = 1000; // exponential back off up to 1ms
+    for (;;) {
+        if (mutex_try_lock(m) == 0) { return 0; }
+        struct timespec now = {};
+        if_error_fatal(clock_gettime(CLOCK_MONOTONIC, &now));
+        const int64_t left = (deadline.tv_sec - now.tv_sec) *
+            process_clock.nsec_per_sec + (deadline.tv_nsec - now.tv_nsec);
+        if (left <= 0) { return ETIMEDOUT; }
+        struct timespec req = { 0, left < sleep_ns ? (long)left : sleep_ns };
+        nanosleep(&req, null);
+        if (sleep_ns < 1000 * 1000) { sleep_ns *= 2; }
+    }
+}
+
+#endif
+
+static void mutex_unlock(mutex_t* m) {
+    if_error_fatal(pthread_mutex_unlock(m));
+}
+
+static void mutex_dispose(mutex_t* m) {
+    if_error_fatal(pthread_mutex_destroy(m));
+}
+
+mutex_if mutex = {
+    .init = mutex_init,
+    .init_shared = mutex_init_shared,
+    .lock = mutex_lock,
+    .try_lock = mutex_try_lock,
+    .lock_timeout = mutex_lock_timeout,
+    .unlock = mutex_unlock,
+    .dispose = mutex_dispose,
+    .owner_died = null
+};
+
+static void event_init(event_t* e) {
+    if_error_fatal(pthread_cond_init(e, null));
+}
+
+static void event_init_shared(event_t* e) {
+    pthread_condattr_t a;
+    if_error_fatal(pthread_condattr_init(&a));
+    if_error_fatal(pthread_condattr_setpshared(&a, PTHREAD_PROCESS_SHARED));
+    if_error_fatal(pthread_cond_init(e, &a));
+    if_error_fatal(pthread_condattr_destroy(&a));
+}
+
+static void event_signal(event_t* e) {
+    if_error_fatal(pthread_cond_signal(e));
+}
+
+static void event_wait(event_t* e, mutex_t* m) {
+    if_error_fatal(mutex_recover(m, pthread_cond_wait(e, m)));
+}
+
+static errno_t event_timed_wait(event_t* e, mutex_t* m, double seconds) {
+    // Nothing is ever easy with posix.
+    // pthread_cond_timedwait() uses *unspecified* abstime
+    // which is a guess work for each OS
+    // e.g. see:
+    // https://github.com/apple/darwin-libpthread/blob/master/tests/cond_timed.c
+    struct timespec now = {};
+    if_error_fatal(clock_gettime(CLOCK_REALTIME, &now)); // since epoch
+    uint64_t now_ns = now.tv_sec * process_clock.nsec_per_sec + now.tv_nsec;
+    uint64_t wait_ns = seconds * process_clock.nsec_per_sec;
+    uint64_t abs_ns = now_ns + wait_ns;
+    struct timespec ts = {};
+    ts.tv_sec = (time_t)(abs_ns / process_clock.nsec_per_sec);
+    ts.tv_nsec = (long)(abs_ns % process_clock.nsec_per_sec);
+    double time = process_clock.time();
+    int timedwait_result = mutex_recover(m,
+                                         pthread_cond_timedwait(e, m, &ts));
+    time = process_clock.time() - time;
+    if (timedwait_result != 0 && timedwait_result != ETIMEDOUT) {
+        if_error_fatal(timedwait_result);
+    }
+    // CLOCK_REALTIME may be adjusted on the fly by (e.g. NTP) which may
+    // result in spurious early wake on (e.g. at Day Time Savings adjustment)
+    if (timedwait_result == ETIMEDOUT && time < seconds) {
+        traceln("WARNING: spurious early wake %.3fs while waiting for %.3fs",
+                time, seconds);
+    }
+    return timedwait_result;
+}
+
+static void event_dispose(event_t* e) {
+    if_error_fatal(pthread_cond_destroy(e));
+}
+
+event_if event = {
+    .init = event_init,
+    .init_shared = event_init_shared,
+    .signal = event_signal,
+    .wait = event_wait,
+    .timed_wait = event_timed_wait,
+    .dispose = event_dispose
+};
+
+static void thread_sleep(double secs) {
+    double deadline = process_clock.time() + secs;
+    for (;;) {
+        double s = deadline - process_clock.time();
+        if (s <= 0) { break; }
+        const double nsd = s * (double)process_clock.nsec_per_sec;
+        long ns = (long)(((int64_t)nsd) % process_clock.nsec_per_sec);
+        struct timespec req = { (time_t)s, ns };
+        nanosleep(&req, null); // can be interrupted
+    }
+}
+
+static void thread_start(thread_t* t, void (*function)(void*), void* p,
+                          int_t stack_size, bool detached) {
+    void* (*f)(void*) = (void* (*)(void*))function;
+    pthread_attr_t a;
+    if_error_fatal(pthread_attr_init(&a));
+    if (stack_size > 0) {
+        if_error_fatal(pthread_attr_setstacksize(&a, stack_size));
+    }
+    if (detached > 0) {
+        if_error_fatal(pthread_attr_setdetachstate(&a, 1));
+    }
+    if_error_fatal(pthread_create(t, &a, f, p));
+    if_error_fatal(pthread_attr_destroy(&a));
+}
+
+void thread_join(thread_t t) { if_error_fatal(pthread_join(t, null)); }
+
+#if defined(__linux__)
+
+// The affinity mask of the process (main thread) reflects taskset and
+// cgroup cpusets, unlike _SC_NPROCESSORS_ONLN. Masks wider than
+// CPU_SETSIZE fail with EINVAL and fall back to the online processors.
+
+static int thread_affinity(int cpu[], int n) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    int count = 0;
+    if (sched_getaffinity(getpid(), sizeof(set), &set) == 0) {
+        for (int i = 0; i < CPU_SETSIZE && count < CPU_COUNT(&set); i++) {
+            if (CPU_ISSET(i, &set)) {
+                if (count < n) { cpu[count] = i; }
+                count++;
+            }
+        }
+    }
+    if (count == 0) {
+        const long online = sysconf(_SC_NPROCESSORS_ONLN);
+        count = online > 0 ? (int)online : 1;
+        for (int i = 0; i < n && i < count; i++) { cpu[i] = i; }
+    }
+    return count;
+}
+
+static errno_t thread_pin(int cpu) {
+    if (cpu < 0 || cpu >= CPU_SETSIZE) { return EINVAL; }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+#else
+
+static int thread_affinity(int cpu[], int n) {
+    const long online = sysconf(_SC_NPROCESSORS_ONLN);
+    const int count = online > 0 ? (int)online : 1;
+    for (int i = 0; i < n && i < count; i++) { cpu[i] = i; }
+    return count;
+}
+
+static errno_t thread_pin(int cpu) {
+    return cpu < 0 ? EINVAL : ENOTSUP;
+}
+
+#endif
+
+static int thread_cpus(void) { return thread_affinity(null, 0); }
+
+threads_if threads = {
+    thread_start,
+    thread_join,
+    thread_sleep,
+    thread_cpus,
+    thread_pin,
+    thread_affinity
+};
+
+#if defined(__linux__)
+
+static errno_t futex_wait_op(const uint32_t* address, uint32_t expected,
+                             double seconds, int op) {
+    struct timespec ts = {};
+    if (seconds >= 0) {
+        ts.tv_sec = (time_t)seconds;
+        ts.tv_nsec = (long)((seconds - (double)ts.tv_sec) *
+                            process_clock.nsec_per_sec);
+    }
+    long r = syscall(SYS_futex, address, op, expected,
+                     seconds >= 0 ? &ts : null, null, 0);
+    return r == 0 || errno != ETIMEDOUT ? 0 : ETIMEDOUT; // EAGAIN, EINTR
+}
+
+static errno_t futex_wait(const uint32_t* address, uint32_t expected,
+                          double seconds) {
+    return futex_wait_op(address, expected, seconds, FUTEX_WAIT_PRIVATE);
+}
+
+static void futex_wake(const uint32_t* address, int32_t count) {
+    syscall(SYS_futex, address, FUTEX_WAKE_PRIVATE, count, null, null, 0);
+}
+
+static errno_t futex_wait_shared(const uint32_t* address, uint32_t expected,
+                                 double seconds) {
+    return futex_wait_op(address, expected, seconds, FUTEX_WAIT);
+}
+
+static void futex_wake_shared(const uint32_t* address, int32_t count) {
+    syscall(SYS_futex, address, FUTEX_WAKE, count, null, null, 0);
+}
+
+#else
+
+enum { futex_buckets = 64 };
+
+typedef struct {
+    mutex_t lock;
+    event_t parked;
+} futex_bucket_t;
+
+static futex_bucket_t futex_bucket[futex_buckets];
+static pthread_once_t futex_buckets_once = PTHREAD_ONCE_INIT;
+
+static void futex_buckets_init(void) {
+    for (int i = 0; i < futex_buckets; i++) {
+        mutex.init(&futex_bucket[i].lock);
+        event.init(&futex_bucket[i].parked);
+    }
+}
+
+static futex_bucket_t* futex_bucket_of(const uint32_t* address) {
+    if_error_fatal(pthread_once(&futex_buckets_once, futex_buckets_init));
+    const uint64_t a = (uint64_t)(uintptr_t)address;
+    return &futex_bucket[((a >> 2) * 0x9E3779B97F4A7C15ULL) >> 58];
+}
+
+// Value is re-checked under bucket lock and wake() takes the same lock
+// after the value was changed: no lost wake ups. Different addresses
+// hashed into the same bucket only cause spurious wake ups.
+
+static errno_t futex_wait(const uint32_t* address, uint32_t expected,
+                          double seconds) {
+    futex_bucket_t* b = futex_bucket_of(address);
+    errno_t r = 0;
+    mutex.lock(&b->lock);
+    if (atomic_load((_Atomic(uint32_t)*)address) == expected) {
+        if (seconds < 0) {
+            event.wait(&b->parked, &b->lock);
+        } else {
+            r = event.timed_wait(&b->parked, &b->lock, seconds);
+        }
+    }
+    mutex.unlock(&b->lock);
+    return r;
+}
+
+static void futex_wake(const uint32_t* address, int32_t count) {
+    futex_bucket_t* b = futex_bucket_of(address);
+    mutex.lock(&b->lock);
+    if_error_fatal(pthread_cond_broadcast(&b->parked));
+    mutex.unlock(&b->lock);
+}
+
+// Parking lot buckets are private to the process: other processes
+// cannot wake the sleeper, which polls instead.
+
+static errno_t futex_wait_shared(const uint32_t* address, uint32_t expected,
+                                 double seconds) {
+    if (atomic_load((_Atomic(uint32_t)*)address) != expected) { return 0; }
+    if (seconds == 0) { return ETIMEDOUT; }
+    const bool timeout = 0 < seconds && seconds <= 1e-3;
+    const double s = seconds < 0 || seconds > 1e-3 ? 1e-3 : seconds;
+    struct timespec req = { 0, (long)(s * process_clock.nsec_per_sec) };
+    nanosleep(&req, null);
+    return timeout ? ETIMEDOUT : 0;
+}
+
+static void futex_wake_shared(const uint32_t* address, int32_t count) {
+    (void)address; (void)count;
+}
+
+#endif
+
+futex_if futex = {
+    .wait = futex_wait,
+    .wake = futex_wake,
+    .wait_shared = futex_wait_shared,
+    .wake_shared = futex_wake_shared
+};
+
+#define waitable_state(e) ((_Atomic(uint32_t)*)&(e)->state)
+
+enum { waitable_signaled = 1, waitable_waiter = 2 }; // state bit, count unit
+
+static void waitable_init(waitable_t* e, bool manual_reset,
+                          bool initially_set) {
+    atomic_init(waitable_state(e), initially_set ? waitable_signaled : 0);
+    e->manual = manual_reset;
+    e->shared = false;
+}
+
+static void waitable_init_shared(waitable_t* e, bool manual_reset,
+                                 bool initially_set) {
+    waitable_init(e, manual_reset, initially_set);
+    e->shared = true;
+}
+
+static errno_t waitable_futex_wait(waitable_t* e, uint32_t expected,
+                                   double seconds) {
+    return e->shared ?
+        futex.wait_shared((const uint32_t*)&e->state, expected, seconds) :
+        futex.wait((const uint32_t*)&e->state, expected, seconds);
+}
+
+static void waitable_futex_wake(waitable_t* e, int32_t count) {
+    if (e->shared) {
+        futex.wake_shared((const uint32_t*)&e->state, count);
+    } else {
+        futex.wake((const uint32_t*)&e->state, count);
+    }
+}
+
+// Waiters count lives in the futex word next to the signaled bit: set()
+// learns about sleepers from its only atomic operation and does not
+// touch the event after it. A waiter may return and dispose (or reuse)
+// the event right away; a futex wake on stale address is harmless.
+
+static void waitable_set(waitable_t* e) {
+    const int32_t count = e->manual ? INT32_MAX : 1;
+    const bool shared = e->shared;
+    const uint32_t s = atomic_fetch_or(waitable_state(e), waitable_signaled);
+    if ((s & waitable_signaled) == 0 && s >= waitable_waiter) {
+        if (shared) {
+            futex.wake_shared((const uint32_t*)&e->state, count);
+        } else {
+            futex.wake((const uint32_t*)&e->state, count);
+        }
+    }
+}
+
+static void waitable_reset(waitable_t* e) {
+    atomic_fetch_and(waitable_state(e), ~(uint32_t)waitable_signaled);
+}
+
+static bool waitable_is_set(waitable_t* e) {
+    return (atomic_load(waitable_state(e)) & waitable_signaled) != 0;
+}
+
+static bool waitable_try(waitable_t* e) { // consumes auto reset state
+    uint32_t s = atomic_load(waitable_state(e));
+    if (e->manual) { return (s & waitable_signaled) != 0; }
+    while ((s & waitable_signaled) != 0) {
+        if (atomic_compare_exchange_weak(waitable_state(e), &s,
+                                         s & ~(uint32_t)waitable_signaled)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static double waitable_left(const struct timespec* deadline) {
+    struct timespec now = {};
+    if_error_fatal(clock_gettime(CLOCK_MONOTONIC, &now));
+    return (double)(deadline->tv_sec - now.tv_sec) +
+           (deadline->tv_nsec - now.tv_nsec) /
+           (double)process_clock.nsec_per_sec;
+}
+
+static errno_t waitable_timed_wait(waitable_t* e, double seconds) {
+    if (waitable_try(e)) { return 0; }
+    const bool forever = seconds < 0; // NaN is 0 as in mutex_deadline()
+    const struct timespec deadline = mutex_deadline(seconds);
+    errno_t r = 0;
+    while (!waitable_try(e)) {
+        double left = -1;
+        if (!forever) {
+            left = waitable_left(&deadline);
+            if (left <= 0) { r = ETIMEDOUT; break; }
+        }
+        const uint32_t s = atomic_fetch_add(waitable_state(e),
+                                            waitable_waiter) + waitable_waiter;
+        if ((s & waitable_signaled) == 0) { waitable_futex_wait(e, s, left); }
+        atomic_fetch_sub(waitable_state(e), waitable_waiter);
+    }
+    return r;
+}
+
+#if defined(__linux__)
+
+#ifndef SYS_futex_waitv
+#define SYS_futex_waitv 449 // Linux 5.16
+#endif
+
+typedef struct { // struct futex_waitv of <linux/futex.h>
+    uint64_t val;
+    uint64_t uaddr;
+    uint32_t flags;
+    uint32_t reserved;
+} waitable_waitv_t;
+
+enum {
+    waitable_waitv_u32 = 0x02,     // FUTEX2_SIZE_U32
+    waitable_waitv_private = 128   // FUTEX2_PRIVATE
+};
+
+static atomic_bool waitable_waitv_missing; // ENOSYS seen once
+
+// Returns 0 after wake up, mismatch or signal, ETIMEDOUT or ENOSYS.
+
+static errno_t waitable_waitv(waitable_t* events[], const uint32_t state[],
+                              int n, const struct timespec* deadline) {
+    if (atomic_load_explicit(&waitable_waitv_missing,
+                             memory_order_relaxed)) {
+        return ENOSYS;
+    }
+    waitable_waitv_t w[waitable_max_any];
+    for (int i = 0; i < n; i++) {
+        w[i] = (waitable_waitv_t){
+            .val = state[i], .uaddr = (uint64_t)(uintptr_t)&events[i]->state,
+            .flags = waitable_waitv_u32 |
+                     (events[i]->shared ? 0 : waitable_waitv_private) };
+    }
+    long r = syscall(SYS_futex_waitv, w, n, 0, deadline, CLOCK_MONOTONIC);
+    if (r >= 0 || (errno != ETIMEDOUT && errno != ENOSYS)) { return 0; }
+    if (errno == ENOSYS) { atomic_store(&waitable_waitv_missing, true); }
+    return errno;
+}
+
+#else
+
+static errno_t waitable_waitv(waitable_t* events[], const uint32_t state[],
+                              int n, const struct timespec* deadline) {
+    (void)events; (void)state; (void)n; (void)deadline;
+    return ENOSYS;
+}
+
+#endif
+
+// Without futex_waitv() sleep on the first event futex (it wakes up
+// immediately) and poll the others with exponential backoff up to 1ms.
+
+static int waitable_wait_any(waitable_t* events[], int n, double seconds) {
+    assertion(0 < n && n <= waitable_max_any, "n: %d", n);
+    const bool forever = seconds < 0; // NaN is 0 as in mutex_deadline()
+    const struct timespec deadline = mutex_deadline(seconds);
+    double backoff = 1e-6;
+    int signaled = -1;
+    for (;;) {
+        for (int i = 0; i < n && signaled < 0; i++) {
+            if (waitable_try(events[i])) { signaled = i; }
+        }
+        if (signaled >= 0) { break; }
+        double left = forever ? -1 : waitable_left(&deadline);
+        if (!forever && left <= 0) { break; }
+        uint32_t state[waitable_max_any];
+        bool signaled_meanwhile = false;
+        for (int i = 0; i < n; i++) {
+            state[i] = atomic_fetch_add(waitable_state(events[i]),
+                                        waitable_waiter) + waitable_waiter;
+            signaled_meanwhile |= (state[i] & waitable_signaled) != 0;
+        }
+        if (!signaled_meanwhile &&
+            waitable_waitv(events, state, n,
+                           forever ? null : &deadline) == ENOSYS) {
+            if (left < 0 || left > backoff) { left = backoff; }
+            waitable_futex_wait(events[0], state[0], left);
+            if (backoff < 1e-3) { backoff *= 2; }
+        }
+        for (int i = 0; i < n; i++) {
+            atomic_fetch_sub(waitable_state(events[i]), waitable_waiter);
+        }
+    }
+    // Auto reset set() wakes a single waiter. If that was this thread
+    // and it consumed another event (or timed out) pass the wake on.
+    for (int i = 0; i < n; i++) {
+        waitable_t* e = events[i];
+        const uint32_t s = atomic_load(waitable_state(e));
+        if (i != signaled && !e->manual && (s & waitable_signaled) != 0 &&
+            s >= waitable_waiter) {
+            waitable_futex_wake(e, 1);
+        }
+    }
+    return signaled;
+}
+
+static void waitable_wait(waitable_t* e) {
+    swear(waitable_timed_wait(e, -1) == 0);
+}
+
+static void waitable_dispose(waitable_t* e) {
+    // a process killed in wait() leaves its count in a shared event
+    const uint32_t state = atomic_load(waitable_state(e));
+    assertion(e->shared || state < waitable_waiter, "waiters: %d",
+              state / waitable_waiter);
+    (void)state;
+}
+
+waitable_if waitable = {
+    .init = waitable_init,
+    .init_shared = waitable_init_shared,
+    .set = waitable_set,
+    .reset = waitable_reset,
+    .is_set = waitable_is_set,
+    .wait = waitable_wait,
+    .timed_wait = waitable_timed_wait,
+    .wait_any = waitable_wait_any,
+    .dispose = waitable_dispose
+};
+
+enum { // queue_lock_node_t.state
+    queue_lock_waiting = 0, // MCS: not granted yet, CLH: released
+    queue_lock_granted = 1, // MCS: granted,         CLH: locked
+    queue_lock_parked  = 2  // waiter sleeps in futex.wait() on the state
+};
+
+typedef struct queue_lock_node_s {
+    _Atomic(struct queue_lock_node_s*) next; // MCS successor or pool link
+    _Atomic(uint32_t) state;
+    uint8_t padding[64 - sizeof(void*) - sizeof(uint32_t)];
+} queue_lock_node_t;
+
+static _Thread_local queue_lock_node_t* queue_lock_pool;
+static pthread_key_t queue_lock_key;
+static pthread_once_t queue_lock_key_once = PTHREAD_ONCE_INIT;
+
+static void queue_lock_pool_free(void* unused) {
+    (void)unused;
+    while (queue_lock_pool != null) {
+        queue_lock_node_t* n = queue_lock_pool;
+        queue_lock_pool = atomic_load_explicit(&n->next, memory_order_relaxed);
+        free(n);
+    }
+}
+
+static void queue_lock_key_create(void) {
+    if_error_fatal(pthread_key_create(&queue_lock_key, queue_lock_pool_free));
+}
+
+static queue_lock_node_t* queue_lock_node_alloc(void) {
+    queue_lock_node_t* n = null;
+    if (posix_memalign((void**)&n, 64, sizeof(*n)) != 0) {
+        fatal("out of memory");
+    }
+    atomic_init(&n->next, null);
+    atomic_init(&n->state, queue_lock_waiting);
+    return n;
+}
+
+static queue_lock_node_t* queue_lock_node_get(void) {
+    queue_lock_node_t* n = queue_lock_pool;
+    if (n != null) {
+        queue_lock_pool = atomic_load_explicit(&n->next, memory_order_relaxed);
+        return n;
+    }
+    // first node of the thread: arrange for the pool to be freed on exit
+    if_error_fatal(pthread_once(&queue_lock_key_once, queue_lock_key_create));
+    if_error_fatal(pthread_setspecific(queue_lock_key, (void*)1));
+    return queue_lock_node_alloc();
+}
+
+static void queue_lock_node_put(queue_lock_node_t* n) {
+    atomic_store_explicit(&n->next, queue_lock_pool, memory_order_relaxed);
+    queue_lock_pool = n;
+}
+
+static void queue_lock_pause(void) {
+    #if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+    #elif defined(__aarch64__)
+        __asm__ __volatile__("yield");
+    #endif
+}
+
+// spins for a while on "state" until it is not "value" anymore,
+// then parks (marking state as parked so that the changer wakes it up)
+
+static int queue_lock_spin_limit(void) {
+    static atomic_int limit = -1; // not known yet
+    int n = atomic_load_explicit(&limit, memory_order_relaxed);
+    if (n < 0) {
+        n = threads.cpus() > 1 ? queue_lock_spins : 0;
+        atomic_store_explicit(&limit, n, memory_order_relaxed);
+    }
+    return n;
+}
+
+static void queue_lock_wait_while(_Atomic(uint32_t)* state, uint32_t value) {
+    const int spins = queue_lock_spin_limit();
+    for (int i = 0; i < spins + queue_lock_yields; i++) {
+        if (atomic_load_explicit(state, memory_order_acquire) != value) {
+            return;
+        }
+        // handing the processor over lets the holder (or the waiter
+        // the lock is passed to) run when threads outnumber processors
+        if (i < spins) { queue_lock_pause(); } else { sched_yield(); }
+    }
+    uint32_t v = value;
+    if (atomic_compare_exchange_strong_explicit(state, &v, queue_lock_parked,
+            memory_order_acq_rel, memory_order_acquire)) {
+        v = queue_lock_parked;
+    }
+    while (v == queue_lock_parked) {
+        futex.wait((const uint32_t*)state, queue_lock_parked, -1);
+        v = atomic_load_explicit(state, memory_order_acquire);
+    }
+}
+
+static void queue_lock_set(_Atomic(uint32_t)* state, uint32_t value) {
+    if (atomic_exchange_explicit(state, value, memory_order_acq_rel) ==
+            queue_lock_parked) {
+        futex.wake((const uint32_t*)state, 1);
+    }
+}
+
+#define mcs_tail(l) ((_Atomic(queue_lock_node_t*)*)&(l)->tail)
+
+static void mcs_lock_init(mcs_lock_t* l) {
+    atomic_init(mcs_tail(l), null);
+    l->holder = null;
+}
+
+static void mcs_lock_lock(mcs_lock_t* l) {
+    queue_lock_node_t* n = queue_lock_node_get();
+    atomic_store_explicit(&n->next, null, memory_order_relaxed);
+    atomic_store_explicit(&n->state, queue_lock_waiting, memory_order_relaxed);
+    queue_lock_node_t* p = atomic_exchange_explicit(mcs_tail(l), n,
+                                                    memory_order_acq_rel);
+    if (p != null) {
+        atomic_store_explicit(&p->next, n, memory_order_release);
+        queue_lock_wait_while(&n->state, queue_lock_waiting);
+    }
+    l->holder = n;
+}
+
+static errno_t mcs_lock_try_lock(mcs_lock_t* l) {
+    queue_lock_node_t* n = queue_lock_node_get();
+    atomic_store_explicit(&n->next, null, memory_order_relaxed);
+    queue_lock_node_t* expected = null;
+    if (atomic_compare_exchange_strong_explicit(mcs_tail(l), &expected, n,
+            memory_order_acq_rel, memory_order_relaxed)) {
+        l->holder = n;
+        return 0;
+    }
+    queue_lock_node_put(n);
+    return EBUSY;
+}
+
+static void mcs_lock_unlock(mcs_lock_t* l) {
+    queue_lock_node_t* n = (queue_lock_node_t*)l->holder;
+    assertion(n != null, "not locked");
+    l->holder = null;
+    queue_lock_node_t* s = atomic_load_explicit(&n->next, memory_order_acquire);
+    if (s == null) {
+        queue_lock_node_t* expected = n;
+        if (atomic_compare_exchange_strong_explicit(mcs_tail(l), &expected,
+                null, memory_order_acq_rel, memory_order_relaxed)) {
+            queue_lock_node_put(n);
+            return;
+        }
+        // successor swapped the tail but has not linked itself yet
+        while ((s = atomic_load_explicit(&n->next, memory_order_acquire)) ==
+               null) {
+            queue_lock_pause();
+        }
+    }
+    queue_lock_set(&s->state, queue_lock_granted);
+    queue_lock_node_put(n);
+}
+
+static void mcs_lock_dispose(mcs_lock_t* l) {
+    assertion(atomic_load(mcs_tail(l)) == null, "locked");
+}
+
+mcs_lock_if mcs_lock = {
+    .init = mcs_lock_init,
+    .lock = mcs_lock_lock,
+    .try_lock = mcs_lock_try_lock,
+    .unlock = mcs_lock_unlock,
+    .dispose = mcs_lock_dispose
+};
+
+#define clh_tail(l) ((_Atomic(queue_lock_node_t*)*)&(l)->tail)
+#define clh_locked(l) ((_Atomic(uint32_t)*)&(l)->locked)
+
+// try_lock() can't look at the tail node: it may already be recycled into
+// another thread's pool (and freed on that thread's exit) and the same
+// address may come back as the tail in locked state (ABA). Instead
+// "locked" counts threads from entering lock() to leaving unlock(): zero
+// means the tail node is released. try_lock() claims 0 -> 1 together
+// with clh_trying bit and lock() does not enqueue while the bit is set,
+// so the node try_lock() swaps out of the tail is the released one.
+
+enum { clh_trying = 1u << 31 };
+
+static void clh_lock_init(clh_lock_t* l) {
+    atomic_init(clh_tail(l), queue_lock_node_alloc()); // released
+    atomic_init(clh_locked(l), 0);
+    l->holder = null;
+    l->predecessor = null;
+}
+
+static void clh_lock_lock(clh_lock_t* l) {
+    queue_lock_node_t* n = queue_lock_node_get();
+    atomic_store_explicit(&n->state, queue_lock_granted, memory_order_relaxed);
+    uint32_t v = atomic_fetch_add_explicit(clh_locked(l), 1,
+                                           memory_order_acq_rel);
+    // a few instructions window of try_lock(), yield if it was preempted:
+    for (int i = 0; (v & clh_trying) != 0; i++) {
+        if (i < queue_lock_spin_limit()) { queue_lock_pause(); }
+        else { sched_yield(); }
+        v = atomic_load_explicit(clh_locked(l), memory_order_acquire);
+    }
+    queue_lock_node_t* p = atomic_exchange_explicit(clh_tail(l), n,
+                                                    memory_order_acq_rel);
+    queue_lock_wait_while(&p->state, queue_lock_granted);
+    l->holder = n;
+    l->predecessor = p;
+}
+
+static errno_t clh_lock_try_lock(clh_lock_t* l) {
+    uint32_t expected = 0;
+    if (!atomic_compare_exchange_strong_explicit(clh_locked(l), &expected,
+            clh_trying | 1, memory_order_acq_rel, memory_order_relaxed)) {
+        return EBUSY;
+    }
+    queue_lock_node_t* n = queue_lock_node_get();
+    atomic_store_explicit(&n->state, queue_lock_granted, memory_order_relaxed);
+    queue_lock_node_t* p = atomic_exchange_explicit(clh_tail(l), n,
+                                                    memory_order_acq_rel);
+    assertion(atomic_load_explicit(&p->state, memory_order_relaxed) ==
+              queue_lock_waiting, "tail node is not released");
+    l->holder = n;
+    l->predecessor = p;
+    atomic_fetch_and_explicit(clh_locked(l), ~(uint32_t)clh_trying,
+                              memory_order_release);
+    return 0;
+}
+
+static void clh_lock_unlock(clh_lock_t* l) {
+    queue_lock_node_t* n = (queue_lock_node_t*)l->holder;
+    queue_lock_node_t* p = (queue_lock_node_t*)l->predecessor;
+    assertion(n != null, "not locked");
+    l->holder = null;
+    l->predecessor = null;
+    // "n" now belongs to the successor (or stays as the tail), the
+    // predecessor's node is not referenced by anybody and is recycled:
+    queue_lock_set(&n->state, queue_lock_waiting);
+    queue_lock_node_put(p);
+    atomic_fetch_sub_explicit(clh_locked(l), 1, memory_order_release);
+}
+
+static void clh_lock_dispose(clh_lock_t* l) {
+    queue_lock_node_t* t = atomic_load(clh_tail(l));
+    assertion(l->holder == null && atomic_load(clh_locked(l)) == 0 &&
+              atomic_load(&t->state) == queue_lock_waiting, "locked");
+    free(t);
+}
+
+clh_lock_if clh_lock = {
+    .init = clh_lock_init,
+    .lock = clh_lock_lock,
+    .try_lock = clh_lock_try_lock,
+    .unlock = clh_lock_unlock,
+    .dispose = clh_lock_dispose
+};
+
+enum { // combiner_slot_t.state
+    combiner_free = 0,
+    combiner_claimed = 1,
+    combiner_pending = 2,
+    combiner_done = 3
+};
+
+enum { combiner_spins = 100 }; // before blocking on the lock
+
+typedef struct {
+    _Atomic(uint32_t) state;
+    void* operation;
+    uint8_t padding[64 - sizeof(uint32_t) - sizeof(void*)];
+} combiner_slot_t;
+
+static atomic_int combiner_next_hint;
+static _Thread_local int combiner_hint = -1;
+
+static void combiner_init(combiner_t* c, void* data,
+                          void (*apply)(void* data, void* operation)) {
+    mem.zero(c, sizeof(*c));
+    mutex.init(&c->lock);
+    c->data = data;
+    c->apply = apply;
+    const int_t bytes = combiner_slots * sizeof(combiner_slot_t);
+    if (posix_memalign(&c->slots, 64, bytes) != 0) { fatal("out of memory"); }
+    mem.zero(c->slots, bytes);
+}
+
+static combiner_slot_t* combiner_publish(combiner_t* c, void* operation) {
+    if (combiner_hint < 0) {
+        combiner_hint = atomic_fetch_add(&combiner_next_hint, 1) %
+                        combiner_slots;
+    }
+    combiner_slot_t* slots = (combiner_slot_t*)c->slots;
+    for (int i = 0; ; i++) { // more than combiner_slots threads: retry
+        const int k = (combiner_hint + i) % combiner_slots;
+        combiner_slot_t* s = &slots[k];
+        uint32_t expected = combiner_free;
+        if (atomic_compare_exchange_strong_explicit(&s->state, &expected,
+                combiner_claimed, memory_order_acquire,
+                memory_order_relaxed)) {
+            _Atomic(int32_t)* used = (_Atomic(int32_t)*)&c->used;
+            int32_t u = atomic_load_explicit(used, memory_order_relaxed);
+            while (u <= k && !atomic_compare_exchange_weak(used, &u, k + 1)) { }
+            s->operation = operation;
+            atomic_store_explicit(&s->state, combiner_pending,
+                                  memory_order_release);
+            return s;
+        }
+        if (i % combiner_slots == combiner_slots - 1) { sched_yield(); }
+    }
+}
+
+static void combiner_combine(combiner_t* c) { // under lock
+    combiner_slot_t* slots = (combiner_slot_t*)c->slots;
+    for (int pass = 0; pass < 2; pass++) { // 2nd pass picks up late comers
+        int64_t applied = 0;
+        const int32_t used = atomic_load((_Atomic(int32_t)*)&c->used);
+        for (int i = 0; i < used; i++) {
+            combiner_slot_t* s = &slots[i];
+            if (atomic_load_explicit(&s->state, memory_order_acquire) ==
+                    combiner_pending) {
+                c->apply(c->data, s->operation);
+                atomic_store_explicit(&s->state, combiner_done,
+                                      memory_order_release);
+                applied++;
+            }
+        }
+        if (applied == 0) { break; }
+        c->batches++;
+        c->operations += applied;
+    }
+}
+
+static bool combiner_done_with(combiner_slot_t* s) {
+    return atomic_load_explicit(&s->state, memory_order_acquire) ==
+           combiner_done;
+}
+
+static void combiner_execute(combiner_t* c, void* operation) {
+    combiner_slot_t* s = combiner_publish(c, operation);
+    bool locked = mutex.try_lock(&c->lock) == 0;
+    if (!locked) { // somebody is combining and may pick up our operation
+        for (int i = 0; i < combiner_spins && !combiner_done_with(s); i++) {
+            queue_lock_pause();
+        }
+        if (!combiner_done_with(s)) {
+            mutex.lock(&c->lock);
+            locked = true;
+        }
+    }
+    if (locked) {
+        // previous combiner might have done it while we were blocked:
+        if (!combiner_done_with(s)) { combiner_combine(c); }
+        mutex.unlock(&c->lock);
+    }
+    atomic_store_explicit(&s->state, combiner_free, memory_order_release);
+}
+
+static void combiner_dispose(combiner_t* c) {
+    mutex.dispose(&c->lock);
+    free(c->slots);
+    mem.zero(c, sizeof(*c));
+}
+
+combiner_if combiner = {
+    .init = combiner_init,
+    .execute = combiner_execute,
+    .dispose = combiner_dispose
+};
+
+enum {
+    channel_magic = 0x4C4E4843, // 'CHNL'
+    channel_control = 4096,     // bytes of control page in front of ring
+    channel_committed = 1,      // channel_record_t.state
+    channel_padding = 2         // skip to the start of the ring
+};
+
+typedef struct { // in shared memory, fields on separate cache lines
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t bytes;              // ring capacity
+    uint8_t  pad0[48];
+    uint64_t tail;               // producers reserve [tail..tail + n)
+    uint8_t  pad1[56];
+    uint64_t head;               // consumer released everything before
+    uint32_t consumer_sleeping;  // 1 while consumer may be in futex wait
+    uint32_t data;               // futex word bumped to wake the consumer
+    uint32_t producers_sleeping; // count of producers waiting for space
+    uint32_t space;              // futex word bumped to wake producers
+} channel_shared_t;
+
+typedef struct {
+    uint32_t bytes; // of payload (of whole padding for channel_padding)
+    uint32_t state; // 0, channel_committed or channel_padding
+} channel_record_t;
+
+// Consumer zeroes released ring bytes, so whatever is not committed yet
+// reads as state 0 even at an offset where a stale payload used to be.
+
+#define channel_of(c) ((channel_shared_t*)(c)->shared)
+#define channel_u64(field) ((_Atomic(uint64_t)*)&(field))
+#define channel_u32(field) ((_Atomic(uint32_t)*)&(field))
+
+static int_t channel_size(int_t bytes) { // record with header, 8 aligned
+    return (int_t)sizeof(channel_record_t) + ((bytes + 7) & ~(int_t)7);
+}
+
+static channel_record_t* channel_record_at(channel_t* c, uint64_t pos) {
+    return (channel_record_t*)(c->ring + (pos & (uint64_t)(c->bytes - 1)));
+}
+
+static channel_record_t* channel_record_of(void* record) {
+    return (channel_record_t*)record - 1;
+}
+
+static errno_t channel_map(channel_t* c, int fd, int_t mapped) {
+    void* a = mmap(null, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (a == MAP_FAILED) { return errno; }
+    c->shared = a;
+    c->mapped = mapped;
+    c->ring = (uint8_t*)a + channel_control;
+    c->bytes = mapped - channel_control;
+    c->read = 0;
+    c->fd = fd;
+    return 0;
+}
+
+static errno_t channel_create(channel_t* c, int_t bytes) {
+    mem.zero(c, sizeof(*c));
+    int_t n = 4096;
+    while (n < bytes) { n <<= 1; }
+#if defined(__linux__)
+    int fd = memfd_create("nposix.channel", MFD_CLOEXEC);
+#else // anonymous POSIX shared memory object
+    char name[64];
+    snprintf(name, countof(name), "/nposix.channel.%d.%016" PRIx64,
+             (int)getpid(), secure_random.next_uint64());
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd >= 0) { shm_unlink(name); }
+#endif
+    if (fd < 0) { return errno; }
+    errno_t r = ftruncate(fd, channel_control + n) == 0 ? 0 : errno;
+    if (r == 0) { r = channel_map(c, fd, channel_control + n); }
+    if (r != 0) { close(fd); return r; }
+    channel_shared_t* h = channel_of(c);
+    h->bytes = (uint64_t)n;
+    atomic_store(channel_u32(h->magic), channel_magic);
+    return 0;
+}
+
+static errno_t channel_attach(channel_t* c, int fd) {
+    mem.zero(c, sizeof(*c));
+    struct stat st = {};
+    if (fstat(fd, &st) != 0) { return errno; }
+    const int_t mapped = (int_t)st.st_size;
+    if (mapped <= channel_control) { return EINVAL; }
+    errno_t r = channel_map(c, fd, mapped);
+    if (r != 0) { return r; }
+    channel_shared_t* h = channel_of(c);
+    if (atomic_load(channel_u32(h->magic)) != channel_magic ||
+        h->bytes != (uint64_t)c->bytes) {
+        if_error_fatal(munmap(c->shared, c->mapped));
+        mem.zero(c, sizeof(*c));
+        return EINVAL;
+    }
+    c->read = atomic_load(channel_u64(h->head));
+    return 0;
+}
+
+static void* channel_reserve(channel_t* c, int_t bytes, double seconds) {
+    const int_t need = channel_size(bytes);
+    assertion(bytes >= 0 && need <= c->bytes / 2, "bytes: %lld",
+              (int64_t)bytes);
+    channel_shared_t* h = channel_of(c);
+    const uint64_t n = (uint64_t)c->bytes;
+    const struct timespec deadline = mutex_deadline(seconds);
+    uint64_t tail = 0;
+    uint64_t pad = 0;
+    for (;;) { // head is loaded first: head <= tail
+        const uint64_t head = atomic_load(channel_u64(h->head));
+        tail = atomic_load(channel_u64(h->tail));
+        const uint64_t offset = tail & (n - 1);
+        pad = offset + need > n ? n - offset : 0;
+        if (tail + pad + need - head <= n) {
+            if (atomic_compare_exchange_weak(channel_u64(h->tail), &tail,
+                                             tail + pad + need)) { break; }
+            continue;
+        }
+        double left = -1;
+        if (seconds >= 0) {
+            left = waitable_left(&deadline);
+            if (left <= 0) { return null; }
+        }
+        atomic_fetch_add(channel_u32(h->producers_sleeping), 1);
+        const uint32_t space = atomic_load(channel_u32(h->space));
+        if (atomic_load(channel_u64(h->head)) == head) {
+            futex.wait_shared(&h->space, space, left);
+        }
+        atomic_fetch_sub(channel_u32(h->producers_sleeping), 1);
+    }
+    if (pad != 0) {
+        channel_record_t* p = channel_record_at(c, tail);
+        p->bytes = (uint32_t)pad;
+        atomic_store_explicit(channel_u32(p->state), channel_padding,
+                              memory_order_release);
+    }
+    channel_record_t* r = channel_record_at(c, tail + pad);
+    r->bytes = (uint32_t)bytes;
+    return r + 1;
+}
+
+static void channel_wake_consumer(channel_t* c) {
+    channel_shared_t* h = channel_of(c);
+    // pairs with the consumer store of consumer_sleeping before it
+    // re-checks the record state
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load(channel_u32(h->consumer_sleeping)) != 0) {
+        atomic_fetch_add(channel_u32(h->data), 1);
+        futex.wake_shared(&h->data, 1);
+    }
+}
+
+static void channel_commit_batch(channel_t* c, void* records[], int n) {
+    for (int i = 0; i < n; i++) {
+        atomic_store_explicit(channel_u32(channel_record_of(records[i])->state),
+                              channel_committed, memory_order_release);
+    }
+    channel_wake_consumer(c);
+}
+
+static void channel_commit(channel_t* c, void* record) {
+    channel_commit_batch(c, &record, 1);
+}
+
+static errno_t channel_send(channel_t* c, const void* data, int_t bytes,
+                            double seconds) {
+    void* record = channel_reserve(c, bytes, seconds);
+    if (record == null) { return ETIMEDOUT; }
+    if (bytes > 0) { mem.copy(record, data, bytes); }
+    channel_commit(c, record);
+    return 0;
+}
+
+static void* channel_receive(channel_t* c, int_t *bytes, double seconds) {
+    channel_shared_t* h = channel_of(c);
+    const struct timespec deadline = mutex_deadline(seconds);
+    for (;;) {
+        channel_record_t* r = channel_record_at(c, c->read);
+        const uint32_t state = atomic_load_explicit(channel_u32(r->state),
+                                                    memory_order_acquire);
+        if (state == channel_padding) {
+            c->read += r->bytes;
+        } else if (state == channel_committed) {
+            *bytes = r->bytes;
+            c->read += channel_size(r->bytes);
+            return r + 1;
+        } else {
+            double left = -1;
+            if (seconds >= 0) {
+                left = waitable_left(&deadline);
+                if (left <= 0) { return null; }
+            }
+            atomic_store(channel_u32(h->consumer_sleeping), 1);
+            const uint32_t data = atomic_load(channel_u32(h->data));
+            if (atomic_load(channel_u32(r->state)) == 0) {
+                futex.wait_shared(&h->data, data, left);
+            }
+            atomic_store(channel_u32(h->consumer_sleeping), 0);
+        }
+    }
+}
+
+static void channel_release(channel_t* c, void* record) {
+    channel_shared_t* h = channel_of(c);
+    channel_record_t* r = channel_record_of(record);
+    const uint64_t offset = (uint64_t)((uint8_t*)r - c->ring);
+    uint64_t head = atomic_load_explicit(channel_u64(h->head),
+                                         memory_order_relaxed);
+    // "record" ends at or before c->read and the ring never holds more
+    // than capacity so its position is unambiguous:
+    const uint64_t n = (uint64_t)c->bytes;
+    const uint64_t pos = head + ((offset - head) & (n - 1));
+    const uint64_t end = pos + channel_size(r->bytes);
+    assertion(end <= c->read, "released record was not received");
+    while (head < end) { // zero padding and records in two chunks at most
+        const uint64_t at = head & (n - 1);
+        const uint64_t k = end - head < n - at ? end - head : n - at;
+        mem.zero(c->ring + at, (int_t)k);
+        head += k;
+    }
+    atomic_store(channel_u64(h->head), head);
+    if (atomic_load(channel_u32(h->producers_sleeping)) != 0) {
+        atomic_fetch_add(channel_u32(h->space), 1);
+        futex.wake_shared(&h->space, INT32_MAX);
+    }
+}
+
+static void channel_close(channel_t* c) {
+    if (c->shared != null) {
+        if_error_fatal(munmap(c->shared, c->mapped));
+        if_error_fatal(close(c->fd));
+    }
+    mem.zero(c, sizeof(*c));
+}
+
+channel_if channel = {
+    .create = channel_create,
+    .attach = channel_attach,
+    .reserve = channel_reserve,
+    .commit = channel_commit,
+    .commit_batch = channel_commit_batch,
+    .send = channel_send,
+    .receive = channel_receive,
+    .release = channel_release,
+    .close = channel_close
+};
+
+typedef struct {
+    void* (*fn)(void* data, void* arg);
+    void* arg;
+    shard_future_t* future;
+} shard_message_t;
+
+typedef struct { // single producer single consumer, see shard_queue_of()
+    uint64_t tail;    // published by producer
+    uint8_t  pad0[56];
+    uint64_t head;    // consumed by consumer
+    uint8_t  pad1[56];
+    uint64_t pending; // producer only: written and not yet published
+    uint8_t  pad2[56];
+    shard_message_t slot[shard_queue_slots];
+} shard_queue_t;
+
+typedef struct {
+    shard_runtime_t* rt;
+    int index;
+    void* data;
+    thread_t thread;
+    waitable_t doorbell; // auto reset, set when messages are published
+    atomic_bool stopping;
+    int cpu;             // to pin to
+    errno_t pinned;      // result of threads.pin(cpu)
+    waitable_t ready;    // manual reset, set after pinning
+    waitable_t go;       // manual reset, set by start() after all pinned
+    mutex_t lock;        // guards inbox from non shard threads
+    shard_message_t* inbox;
+    int_t inbox_count;
+    int_t inbox_capacity;
+    shard_message_t* spare; // inbox swapped out by the looper
+    int_t spare_capacity;
+    int64_t messages; // sent to shard queues
+    int64_t batches;  // published
+} shard_t;
+
+static _Thread_local shard_t* shard_self;
+
+#define shard_u64(field) ((_Atomic(uint64_t)*)&(field))
+
+static shard_t* shard_of(shard_runtime_t* rt, int i) {
+    return (shard_t*)rt->shard + i;
+}
+
+static shard_queue_t* shard_queue_of(shard_runtime_t* rt, int from, int to) {
+    return (shard_queue_t*)rt->queues + from * rt->shards + to;
+}
+
+static void shard_execute(shard_t* s, const shard_message_t* m) {
+    void* result = m->fn(s->data, m->arg);
+    if (m->future != null) {
+        m->future->result = result;
+        waitable.set(&m->future->done); // release
+    }
+}
+
+static void shard_publish(shard_t* s, int to) {
+    shard_queue_t* q = shard_queue_of(s->rt, s->index, to);
+    if (q->pending != atomic_load_explicit(shard_u64(q->tail),
+                                           memory_order_relaxed)) {
+        atomic_store_explicit(shard_u64(q->tail), q->pending,
+                              memory_order_release);
+        waitable.set(&shard_of(s->rt, to)->doorbell);
+        s->batches++;
+    }
+}
+
+static void shard_flush(shard_t* s) {
+    for (int to = 0; to < s->rt->shards; to++) { shard_publish(s, to); }
+}
+
+// One pass over incoming queues and the inbox, then publishes whatever
+// executed messages have sent. Returns number of executed messages.
+// Reentrant: an executed message may wait (see shard_runtime_wait())
+// and poll again, so queue heads are re-read after every message and
+// the inbox being executed is detached from the shard.
+
+static int_t shard_poll(shard_t* s) {
+    shard_runtime_t* rt = s->rt;
+    int_t executed = 0;
+    for (int from = 0; from < rt->shards; from++) {
+        shard_queue_t* q = shard_queue_of(rt, from, s->index);
+        for (;;) {
+            const uint64_t head = atomic_load_explicit(shard_u64(q->head),
+                                                       memory_order_relaxed);
+            if (head == atomic_load_explicit(shard_u64(q->tail),
+                                             memory_order_acquire)) {
+                break;
+            }
+            // copy: slot is reused by producer as soon as head moves
+            const shard_message_t m = q->slot[head % shard_queue_slots];
+            atomic_store_explicit(shard_u64(q->head), head + 1,
+                                  memory_order_release);
+            shard_execute(s, &m);
+            executed++;
+        }
+    }
+    if (atomic_load_explicit((_Atomic(int_t)*)&s->inbox_count,
+                             memory_order_relaxed) != 0) {
+        mutex.lock(&s->lock);
+        shard_message_t* messages = s->inbox;
+        const int_t count = s->inbox_count;
+        const int_t capacity = s->inbox_capacity;
+        s->inbox = s->spare; // null if a nested poll holds it
+        s->inbox_capacity = s->spare_capacity;
+        s->spare = null;
+        s->spare_capacity = 0;
+        atomic_store_explicit((_Atomic(int_t)*)&s->inbox_count, 0,
+                              memory_order_relaxed);
+        mutex.unlock(&s->lock);
+        for (int_t i = 0; i < count; i++) { shard_execute(s, &messages[i]); }
+        if (s->spare == null) { // only the shard thread touches spare
+            s->spare = messages;
+            s->spare_capacity = capacity;
+        } else {
+            heap.free(messages);
+        }
+        executed += count;
+    }
+    shard_flush(s);
+    return executed;
+}
+
+static void shard_looper(void* p) {
+    shard_t* s = (shard_t*)p;
+    shard_runtime_t* rt = s->rt;
+    shard_self = s;
+    s->pinned = threads.pin(s->cpu);
+    waitable.set(&s->ready);
+    waitable.wait(&s->go);
+    if (atomic_load(&s->stopping)) { // start() failed, no init() or fini()
+        shard_self = null;
+        return;
+    }
+    s->data = rt->init != null ? rt->init(s->index, rt->context) : null;
+    shard_flush(s); // whatever init() has sent
+    for (;;) {
+        if (shard_poll(s) == 0) {
+            if (atomic_load(&s->stopping)) { break; }
+            waitable.wait(&s->doorbell);
+        }
+    }
+    if (rt->fini != null) { rt->fini(s->index, s->data, rt->context); }
+    shard_flush(s);
+    shard_self = null;
+}
+
+static void shard_runtime_stop(shard_runtime_t* rt);
+
+static errno_t shard_runtime_start(shard_runtime_t* rt, int shards,
+        void* (*init)(int shard, void* context),
+        void (*fini)(int shard, void* data, void* context), void* context) {
+    int cpu[shard_max];
+    const int cpus = threads.affinity(cpu, shard_max);
+    const int n = cpus < shard_max ? cpus : shard_max; // ids in cpu[]
+    if (shards <= 0) { shards = n; }
+    if (shards > shard_max) { return EINVAL; }
+    mem.zero(rt, sizeof(*rt));
+    rt->shards = shards;
+    rt->init = init;
+    rt->fini = fini;
+    rt->context = context;
+    const size_t qb = sizeof(shard_queue_t) * (size_t)(shards * shards);
+    const size_t sb = (sizeof(shard_t) + 63) / 64 * 64 * (size_t)shards;
+    if (posix_memalign(&rt->queues, 64, qb) != 0 ||
+        posix_memalign(&rt->shard, 64, sb) != 0) {
+        fatal("out of memory");
+    }
+    mem.zero(rt->queues, (int_t)qb);
+    mem.zero(rt->shard, (int_t)sb);
+    for (int i = 0; i < shards; i++) {
+        shard_t* s = shard_of(rt, i);
+        s->rt = rt;
+        s->index = i;
+        waitable.init(&s->doorbell, false, false);
+        waitable.init(&s->ready, true, false);
+        waitable.init(&s->go, true, false);
+        atomic_init(&s->stopping, false);
+        mutex.init(&s->lock);
+        s->cpu = cpu[i % n];
+    }
+    for (int i = 0; i < shards; i++) {
+        shard_t* s = shard_of(rt, i);
+        threads.start(&s->thread, shard_looper, s, 0, false);
+    }
+    errno_t r = 0;
+    for (int i = 0; i < shards; i++) {
+        shard_t* s = shard_of(rt, i);
+        waitable.wait(&s->ready);
+        // ENOTSUP: no affinity API (macOS) is not a failure to report
+        if (r == 0 && s->pinned != ENOTSUP) { r = s->pinned; }
+    }
+    for (int i = 0; i < shards; i++) {
+        shard_t* s = shard_of(rt, i);
+        if (r != 0) { atomic_store(&s->stopping, true); }
+        waitable.set(&s->go);
+    }
+    if (r != 0) { shard_runtime_stop(rt); }
+    return r;
+}
+
+static int shard_runtime_current(shard_runtime_t* rt) {
+    return shard_self != null && shard_self->rt == rt ? shard_self->index : -1;
+}
+
+static void shard_runtime_submit_to(shard_runtime_t* rt, int shard,
+        void* (*fn)(void* data, void* arg), void* arg,
+        shard_future_t* future) {
+    assertion(0 <= shard && shard < rt->shards, "shard: %d", shard);
+    if (future != null) {
+        waitable.init(&future->done, true, false);
+        future->result = null;
+    }
+    const shard_message_t m = { fn, arg, future };
+    shard_t* s = shard_self != null && shard_self->rt == rt ?
+                 shard_self : null;
+    if (s != null) {
+        shard_queue_t* q = shard_queue_of(rt, s->index, shard);
+        while (q->pending - atomic_load_explicit(shard_u64(q->head),
+                   memory_order_acquire) == shard_queue_slots) {
+            shard_publish(s, shard);
+            if (shard_poll(s) == 0) { queue_lock_pause(); }
+        }
+        q->slot[q->pending % shard_queue_slots] = m;
+        q->pending++;
+        s->messages++;
+        if (q->pending - atomic_load_explicit(shard_u64(q->tail),
+                             memory_order_relaxed) >= shard_batch) {
+            shard_publish(s, shard);
+        }
+    } else {
+        shard_t* t = shard_of(rt, shard);
+        mutex.lock(&t->lock);
+        if (t->inbox_count == t->inbox_capacity) {
+            t->inbox_capacity = t->inbox_capacity * 2 + 16;
+            t->inbox = (shard_message_t*)heap.realloc(t->inbox,
+                       t->inbox_capacity * (int_t)sizeof(shard_message_t));
+            if (t->inbox == null) { fatal("out of memory"); }
+        }
+        t->inbox[t->inbox_count] = m;
+        atomic_store_explicit((_Atomic(int_t)*)&t->inbox_count,
+                              t->inbox_count + 1, memory_order_relaxed);
+        mutex.unlock(&t->lock);
+        waitable.set(&t->doorbell);
+    }
+}
+
+static void* shard_runtime_wait(shard_runtime_t* rt, shard_future_t* f) {
+    shard_t* s = shard_self != null && shard_self->rt == rt ?
+                 shard_self : null;
+    if (s == null) {
+        waitable.wait(&f->done);
+    } else {
+        shard_flush(s);
+        while (!waitable.is_set(&f->done)) {
+            if (shard_poll(s) == 0) { queue_lock_pause(); }
+        }
+    }
+    waitable.dispose(&f->done);
+    return f->result;
+}
+
+static void shard_runtime_stop(shard_runtime_t* rt) {
+    for (int i = 0; i < rt->shards; i++) {
+        shard_t* s = shard_of(rt, i);
+        atomic_store(&s->stopping, true);
+        waitable.set(&s->doorbell);
+    }
+    for (int i = 0; i < rt->shards; i++) {
+        shard_t* s = shard_of(rt, i);
+        threads.join(s->thread);
+        rt->messages += s->messages;
+        rt->batches += s->batches;
+    }
+    for (int i = 0; i < rt->shards; i++) {
+        shard_t* s = shard_of(rt, i);
+        waitable.dispose(&s->doorbell);
+        waitable.dispose(&s->ready);
+        waitable.dispose(&s->go);
+        mutex.dispose(&s->lock);
+        heap.free(s->inbox);
+        heap.free(s->spare);
+    }
+    free(rt->queues);
+    free(rt->shard);
+    rt->queues = null;
+    rt->shard = null;
+}
+
+shard_runtime_if shard_runtime = {
+    .start = shard_runtime_start,
+    .current = shard_runtime_current,
+    .submit_to = shard_runtime_submit_to,
+    .wait = shard_runtime_wait,
+    .stop = shard_runtime_stop
+};
+
+typedef struct object_cache_magazine_s {
+    struct object_cache_magazine_s* next; // in depot lists
+    int_t rounds;
+    void* round[object_cache_magazine_rounds];
+} object_cache_magazine_t;
+
+typedef struct object_cache_thread_s { // magazines of a thread for a cache
+    struct object_cache_thread_s* next; // in cache->threads list
+    struct object_cache_thread_s* prev;
+    object_cache_t* cache; // null after cache was disposed
+    uint64_t serial;
+    object_cache_magazine_t* loaded;
+    object_cache_magazine_t* previous;
+} object_cache_thread_t;
+
+struct object_cache_s {
+    mutex_t lock; // depot and threads list
+    int index; // in registry and per thread arrays
+    uint64_t serial;
+    int_t bytes;
+    errno_t (*constructor)(void* object, void* context);
+    void (*destructor)(void* object, void* context);
+    void* context;
+    object_cache_magazine_t* full;  // depot
+    object_cache_magazine_t* empty;
+    object_cache_thread_t* threads;
+};
+
+// Lock order: object_cache_lock (registry) -> cache->lock
+
+static mutex_t object_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static object_cache_t* object_cache_registry[object_cache_max];
+static uint64_t object_cache_serial;
+static _Thread_local
+    object_cache_thread_t* object_cache_threads[object_cache_max];
+static pthread_key_t object_cache_key;
+static pthread_once_t object_cache_key_once = PTHREAD_ONCE_INIT;
+
+static void object_cache_destroy(object_cache_t* c, void* objects[], int_t n) {
+    if (c->destructor != null) {
+        for (int_t i = 0; i < n; i++) { c->destructor(objects[i], c->context); }
+    }
+    heap.free_batch(objects, n);
+}
+
+static void object_cache_depot_put(object_cache_t* c,
+                                   object_cache_magazine_t* m) { // under lock
+    if (m->rounds == object_cache_magazine_rounds) {
+        m->next = c->full;
+        c->full = m;
+    } else {
+        object_cache_destroy(c, m->round, m->rounds); // partially filled
+        m->rounds = 0;
+        m->next = c->empty;
+        c->empty = m;
+    }
+}
+
+static void object_cache_detach(object_cache_thread_t* t) { // registry lock
+    object_cache_t* c = t->cache;
+    if (c != null) {
+        mutex.lock(&c->lock);
+        if (t->prev != null) { t->prev->next = t->next; }
+        if (t->next != null) { t->next->prev = t->prev; }
+        if (c->threads == t) { c->threads = t->next; }
+        object_cache_depot_put(c, t->loaded);
+        object_cache_depot_put(c, t->previous);
+        mutex.unlock(&c->lock);
+    }
+    heap.free(t);
+}
+
+static void object_cache_thread_exit(void* p) {
+    object_cache_thread_t** threads = (object_cache_thread_t**)p;
+    mutex.lock(&object_cache_lock);
+    for (int i = 0; i < object_cache_max; i++) {
+        if (threads[i] != null) {
+            object_cache_detach(threads[i]);
+            threads[i] = null;
+        }
+    }
+    mutex.unlock(&object_cache_lock);
+}
+
+static void object_cache_key_create(void) {
+    if_error_fatal(pthread_key_create(&object_cache_key,
+                                      object_cache_thread_exit));
+}
+
+static object_cache_thread_t* object_cache_attach(object_cache_t* c) {
+    if_error_fatal(pthread_once(&object_cache_key_once,
+                                object_cache_key_create));
+    object_cache_thread_t* t = (object_cache_thread_t*)
+        heap.allocate(sizeof(object_cache_thread_t));
+    object_cache_magazine_t* loaded = (object_cache_magazine_t*)
+        heap.allocate(sizeof(object_cache_magazine_t));
+    object_cache_magazine_t* previous = (object_cache_magazine_t*)
+        heap.allocate(sizeof(object_cache_magazine_t));
+    if (t == null || loaded == null || previous == null) {
+        heap.free(t);
+        heap.free(loaded);
+        heap.free(previous);
+        return null;
+    }
+    t->cache = c;
+    t->serial = c->serial;
+    t->loaded = loaded;
+    t->previous = previous;
+    mutex.lock(&object_cache_lock);
+    // entry of a disposed cache that had the same index:
+    object_cache_thread_t* stale = object_cache_threads[c->index];
+    if (stale != null) { object_cache_detach(stale); }
+    mutex.lock(&c->lock);
+    t->next = c->threads;
+    if (c->threads != null) { c->threads->prev = t; }
+    c->threads = t;
+    mutex.unlock(&c->lock);
+    object_cache_threads[c->index] = t;
+    if_error_fatal(pthread_setspecific(object_cache_key, object_cache_threads));
+    mutex.unlock(&object_cache_lock);
+    return t;
+}
+
+static object_cache_thread_t* object_cache_thread(object_cache_t* c) {
+    object_cache_thread_t* t = object_cache_threads[c->index];
+    return t != null && t->serial == c->serial ? t : object_cache_attach(c);
+}
+
+static object_cache_t* object_cache_create(int_t bytes,
+        errno_t (*constructor)(void* object, void* context),
+        void (*destructor)(void* object, void* context), void* context) {
+    assertion(bytes > 0, "bytes=%lld", (long long)bytes);
+    object_cache_t* c = (object_cache_t*)heap.allocate(sizeof(object_cache_t));
+    if (c == null) { return null; }
+    mutex.init(&c->lock);
+    c->bytes = bytes;
+    c->constructor = constructor;
+    c->destructor = destructor;
+    c->context = context;
+    c->index = -1;
+    mutex.lock(&object_cache_lock);
+    for (int i = 0; i < object_cache_max && c->index < 0; i++) {
+        if (object_cache_registry[i] == null) {
+            object_cache_registry[i] = c;
+            c->index = i;
+            c->serial = ++object_cache_serial;
+        }
+    }
+    mutex.unlock(&object_cache_lock);
+    if (c->index < 0) {
+        traceln("more than %d object caches", object_cache_max);
+        mutex.dispose(&c->lock);
+        c = heap.free(c);
+    }
+    return c;
+}
+
+static int_t object_cache_reclaim(object_cache_t* c) {
+    mutex.lock(&c->lock);
+    object_cache_magazine_t* full = c->full;
+    object_cache_magazine_t* empty = c->empty;
+    c->full = null;
+    c->empty = null;
+    mutex.unlock(&c->lock);
+    int_t n = 0;
+    while (full != null) {
+        object_cache_magazine_t* next = full->next;
+        object_cache_destroy(c, full->round, full->rounds);
+        n += full->rounds;
+        heap.free(full);
+        full = next;
+    }
+    while (empty != null) {
+        object_cache_magazine_t* next = empty->next;
+        heap.free(empty);
+        empty = next;
+    }
+    return n;
+}
+
+static int_t object_cache_reclaim_all(void) {
+    int_t n = 0;
+    mutex.lock(&object_cache_lock);
+    for (int i = 0; i < object_cache_max; i++) {
+        if (object_cache_registry[i] != null) {
+            n += object_cache_reclaim(object_cache_registry[i]);
+        }
+    }
+    mutex.unlock(&object_cache_lock);
+    return n;
+}
+
+// Fills empty magazine with freshly constructed objects, taken from the
+// heap in one batch. Returns number of objects in the magazine.
+
+static int_t object_cache_construct(object_cache_t* c,
+                                    object_cache_magazine_t* m) {
+    const int_t n = object_cache_magazine_rounds;
+    errno_t r = heap.alloc_batch(c->bytes, n, m->round);
+    if (r != 0 && object_cache_reclaim_all() > 0) {
+        r = heap.alloc_batch(c->bytes, n, m->round);
+    }
+    m->rounds = 0;
+    for (int_t i = 0; i < n && r == 0; i++) {
+        void* object = m->round[i];
+        if (c->constructor == null ||
+            c->constructor(object, c->context) == 0) {
+            m->round[m->rounds++] = object;
+        } else {
+            heap.free(object);
+        }
+    }
+    return m->rounds;
+}
+
+static void* object_cache_alloc(object_cache_t* c) {
+    object_cache_thread_t* t = object_cache_thread(c);
+    if (t == null) { return null; }
+    for (;;) {
+        object_cache_magazine_t* m = t->loaded;
+        if (m->rounds > 0) { return m->round[--m->rounds]; }
+        if (t->previous->rounds > 0) {
+            t->loaded = t->previous;
+            t->previous = m;
+            continue;
+        }
+        mutex.lock(&c->lock);
+        object_cache_magazine_t* full = c->full;
+        if (full != null) { // both magazines are empty
+            c->full = full->next;
+            t->previous->next = c->empty;
+            c->empty = t->previous;
+            t->previous = m;
+            t->loaded = full;
+        }
+        mutex.unlock(&c->lock);
+        if (full == null && object_cache_construct(c, m) == 0) { return null; }
+    }
+}
+
+static void object_cache_free(object_cache_t* c, void* object) {
+    if (object == null) { return; }
+    object_cache_thread_t* t = object_cache_thread(c);
+    if (t == null) {
+        object_cache_destroy(c, &object, 1);
+        return;
+    }
+    for (;;) {
+        object_cache_magazine_t* m = t->loaded;
+        if (m->rounds < object_cache_magazine_rounds) {
+            m->round[m->rounds++] = object;
+            return;
+        }
+        if (t->previous->rounds == 0) {
+            t->loaded = t->previous;
+            t->previous = m;
+            continue;
+        }
+        mutex.lock(&c->lock); // both magazines are full
+        object_cache_magazine_t* empty = c->empty;
+        if (empty != null) { c->empty = empty->next; }
+        mutex.unlock(&c->lock);
+        if (empty == null) {
+            empty = (object_cache_magazine_t*)
+                heap.allocate(sizeof(object_cache_magazine_t));
+            if (empty == null) {
+                object_cache_destroy(c, &object, 1);
+                return;
+            }
+        }
+        mutex.lock(&c->lock);
+        t->previous->next = c->full;
+        c->full = t->previous;
+        mutex.unlock(&c->lock);
+        t->previous = m;
+        empty->rounds = 0;
+        t->loaded = empty;
+    }
+}
+
+static void object_cache_dispose(object_cache_t* c) {
+    mutex.lock(&object_cache_lock);
+    object_cache_registry[c->index] = null;
+    mutex.lock(&c->lock);
+    for (object_cache_thread_t* t = c->threads; t != null; t = t->next) {
+        object_cache_magazine_t* m[2] = { t->loaded, t->previous };
+        for (int i = 0; i < 2; i++) {
+            object_cache_destroy(c, m[i]->round, m[i]->rounds);
+            heap.free(m[i]);
+        }
+        t->loaded = null;
+        t->previous = null;
+        t->cache = null; // freed on thread exit or attach of the same index
+    }
+    mutex.unlock(&c->lock);
+    mutex.unlock(&object_cache_lock);
+    object_cache_reclaim(c);
+    mutex.dispose(&c->lock);
+    heap.free(c);
+}
+
+object_cache_if object_cache = {
+    .create = object_cache_create,
+    .alloc = object_cache_alloc,
+    .free = object_cache_free,
+    .reclaim = object_cache_reclaim,
+    .reclaim_all = object_cache_reclaim_all,
+    .dispose = object_cache_dispose
+};
+
+/* 64 bytes at a time bitmask scanning shared by text parsers below.
+   bit "i" of bitmask_eq(p, c) is set when p[i] == c. Last partial block
+   is zero padded by bitmask_block() (zero is not a structural character
+   in any of the parsed formats).
+*/
+
+#if defined(__SSE2__)
+
+#include <emmintrin.h>
+
+static uint64_t bitmask_eq(const uint8_t* p, uint8_t c) {
+    const __m128i v = _mm_set1_epi8((char)c);
+    uint64_t m = 0;
+    for (int i = 0; i < 4; i++) {
+        __m128i b = _mm_loadu_si128((const __m128i*)(p + i * 16));
+        m |= (uint64_t)(uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(b, v))
+                << (i * 16);
+    }
+    return m;
+}
+
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+
+#include <arm_neon.h>
+
+static uint64_t bitmask_eq(const uint8_t* p, uint8_t c) {
+    const uint8x16_t v = vdupq_n_u8(c);
+    const uint8x16_t bits = { 1, 2, 4, 8, 16, 32, 64, 128,
+                              1, 2, 4, 8, 16, 32, 64, 128 };
+    uint8x16_t t0 = vandq_u8(vceqq_u8(vld1q_u8(p +  0), v), bits);
+    uint8x16_t t1 = vandq_u8(vceqq_u8(vld1q_u8(p + 16), v), bits);
+    uint8x16_t t2 = vandq_u8(vceqq_u8(vld1q_u8(p + 32), v), bits);
+    uint8x16_t t3 = vandq_u8(vceqq_u8(vld1q_u8(p + 48), v), bits);
+    uint8x16_t sum = vpaddq_u8(vpaddq_u8(t0, t1), vpaddq_u8(t2, t3));
+    sum = vpaddq_u8(sum, sum);
+    return vgetq_lane_u64(vreinterpretq_u64_u8(sum), 0);
+}
+
+#else
+
+static uint64_t bitmask_eq(const uint8_t* p, uint8_t c) {
+    uint64_t m = 0;
+    for (int i = 0; i < 64; i++) { m |= (uint64_t)(p[i] == c) << i; }
+    return m;
+}
+
+#endif
+
+static const uint8_t* bitmask_block(const uint8_t* data, int_t bytes,
+                                    int_t block, uint8_t padded[64]) {
+    if (bytes - block >= 64) { return data + block; }
+    mem.zero(padded, 64);
+    mem.copy(padded, data + block, bytes - block);
+    return padded;
+}
+
+// bit "i" of result is xor of bits [0..i] of "x": 1 inside quoted regions
+// (including opening quote, excluding closing one). Which is the same as
+// carry-less multiplication of "x" by all ones.
+
+#if defined(__PCLMUL__)
+
+#include <wmmintrin.h>
+
+static uint64_t bitmask_prefix_xor(uint64_t x) {
+    __m128i all_ones = _mm_set1_epi8((char)0xFF);
+    __m128i r = _mm_clmulepi64_si128(_mm_set_epi64x(0, (int64_t)x),
+                                     all_ones, 0);
+    return (uint64_t)_mm_cvtsi128_si64(r);
+}
+
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_AES)
+
+static uint64_t bitmask_prefix_xor(uint64_t x) {
+    return (uint64_t)vmull_p64((poly64_t)x, (poly64_t)~0ULL);
+}
+
+#else
+
+static uint64_t bitmask_prefix_xor(uint64_t x) {
+    x ^= x << 1;
+    x ^= x << 2;
+    x ^= x << 4;
+    x ^= x << 8;
+    x ^= x << 16;
+    x ^= x << 32;
+    return x;
+}
+
+#endif
+
+static void memmap_file(const char* fn, int_t offset, int_t size,
+                        void* *data, int_t *bytes, int* r, bool readonly) {
+    assertion(*data == null && *bytes == 0 && *r == 0,
+              "invalid (uninitialized or reused) parameters");
+    if_error_return(*data != null || *bytes != 0, { *r = EINVAL; }, {});
+    assertion(offset >= 0, "negative offset = %lld is invalid", (int64_t)offset);
+    if_error_return(offset < 0, { *r = EINVAL; }, {});
+    int f = open(fn, readonly ? O_RDONLY : O_RDWR);
+    if_error_return(f < 0, { *r = errno; }, {});
+    if (size <= 0) { // use file size instead of specified size:
+        struct stat s = {};
+        if_error_return(fstat(f, &s) < 0, { *r = errno; }, { close(f); });
+        size = (int)s.st_size;
+    }
+    const int protection = PROT_READ | (readonly ? 0 : PROT_WRITE);
+    const int flags = readonly ? MAP_PRIVATE : MAP_SHARED;
+    *bytes = size;
+    *data = mmap(null, size, protection, flags, f, 0);
+    if_error_return(*data == null, { *r = errno; }, { close(f); });
+    if_error_fatal(close(f));
+}
+
+static int memmap_file_readonly(const char* fn, void* *data, int_t *bytes) {
+    int r = 0;
+    memmap_file(fn, 0, 0, data, bytes, &r, true);
+    return r;
+}
+
+static int memmap_file_readwrite(const char* fn, int_t offset, int_t size,
+                                 void* *data, int_t *bytes) {
+    int r = 0;
+    memmap_file(fn, offset, size, data, bytes, &r, false);
+    return r;
+}
+
+static int memmap_file_unmap(void *data, int_t bytes) {
+    int r = 0;
+    if (data != null && bytes != 0) {
+        if_error_fatal(munmap((void*)data, bytes));
+    } else {
+        r = EINVAL;
+    }
+    return r;
+}
+
+typedef struct {
+    const uint8_t* data;
+    int_t from;
+    int_t to;
+    int_t newlines; // before "from" (after 1st pass) or in [from..to)
+    int_t* starts;  // recorded line starts (2nd pass)
+    int_t count;
+} memmap_line_chunk_t;
+
+static void memmap_count_newlines(void* p) {
+    memmap_line_chunk_t* c = (memmap_line_chunk_t*)p;
+    uint8_t padded[64];
+    for (int_t b = c->from; b < c->to; b += 64) {
+        const uint8_t* block = bitmask_block(c->data, c->to, b, padded);
+        c->newlines += __builtin_popcountll(bitmask_eq(block, '\n'));
+    }
+}
+
+static void memmap_record_line_starts(void* p) {
+    memmap_line_chunk_t* c = (memmap_line_chunk_t*)p;
+    const int_t k = memmap_line_index_every;
+    uint8_t padded[64];
+    int_t line = c->newlines; // line started by next '\n' is line + 1
+    int_t next = (line / k + 1) * k; // next line number to record
+    for (int_t b = c->from; b < c->to; b += 64) {
+        const uint8_t* block = bitmask_block(c->data, c->to, b, padded);
+        uint64_t bits = bitmask_eq(block, '\n');
+        int n = __builtin_popcountll(bits);
+        if (line + n < next) { line += n; continue; } // skip whole block
+        while (bits != 0) {
+            line++;
+            if (line == next) {
+                c->starts[c->count++] = b + __builtin_ctzll(bits) + 1;
+                next += k;
+            }
+            bits &= bits - 1;
+        }
+    }
+}
+
+static int_t memmap_varint_put(uint8_t* p, uint64_t v) {
+    int_t n = 0;
+    while (v >= 0x80) { p[n++] = (uint8_t)(v | 0x80); v >>= 7; }
+    p[n++] = (uint8_t)v;
+    return n;
+}
+
+static uint64_t memmap_varint_get(const uint8_t* *p) {
+    uint64_t v = 0;
+    for (int shift = 0; ; shift += 7) {
+        uint8_t b = *(*p)++;
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (b < 0x80) { break; }
+    }
+    return v;
+}
+
+static void memmap_line_index_dispose(memmap_line_index_t* ix) {
+    heap.free(ix->skip);
+    heap.free(ix->deltas);
+    mem.zero(ix, sizeof(*ix));
+}
+
+static errno_t memmap_line_index(memmap_line_index_t* ix, const void* data,
+                                 int_t bytes, int parts) {
+    assertion(parts > 0, "threads=%d", parts);
+    const int_t k = memmap_line_index_every;
+    mem.zero(ix, sizeof(*ix));
+    ix->bytes = bytes;
+    memmap_line_chunk_t* chunks = (memmap_line_chunk_t*)heap.allocate(
+                                    parts * sizeof(memmap_line_chunk_t));
+    thread_t* t = (thread_t*)heap.allocate(parts * sizeof(thread_t));
+    errno_t r = chunks == null || t == null ? ENOMEM : 0;
+    for (int i = 0; r == 0 && i < parts; i++) {
+        // chunks are 64 bytes aligned so each block is scanned once
+        chunks[i].data = (const uint8_t*)data;
+        chunks[i].from = (bytes / parts * i) & ~63;
+        chunks[i].to = i == parts - 1 ?
+                       bytes : (bytes / parts * (i + 1)) & ~63;
+    }
+    for (int pass = 0; r == 0 && pass < 2; pass++) {
+        void (*f)(void*) = pass == 0 ?
+            memmap_count_newlines : memmap_record_line_starts;
+        for (int i = 1; i < parts; i++) {
+            threads.start(&t[i], f, &chunks[i], 0, false);
+        }
+        f(&chunks[0]);
+        for (int i = 1; i < parts; i++) { threads.join(t[i]); }
+        if (pass == 0) { // newlines in chunk -> newlines before chunk
+            int_t newlines = 0;
+            for (int i = 0; i < parts; i++) {
+                int_t n = chunks[i].newlines;
+                chunks[i].newlines = newlines;
+                newlines += n;
+            }
+            const char* d = (const char*)data;
+            ix->lines = newlines + (bytes > 0 && d[bytes - 1] != '\n');
+            ix->checkpoints = (ix->lines + k - 1) / k;
+            // one extra start per chunk may land at "bytes" (after last '\n')
+            for (int i = 0; r == 0 && i < parts; i++) {
+                int_t end = i + 1 < parts ? chunks[i + 1].newlines : newlines;
+                int_t n = (end - chunks[i].newlines) / k + 2;
+                chunks[i].starts = (int_t*)heap.alloc(n * sizeof(int_t));
+                if (chunks[i].starts == null) { r = ENOMEM; }
+            }
+        }
+    }
+    if (r == 0) {
+        ix->skips = (ix->checkpoints + 63) / 64;
+        ix->skip = (int_t*)heap.alloc((ix->skips * 2 + 1) * sizeof(int_t));
+        ix->deltas = (uint8_t*)heap.alloc(ix->checkpoints * 10 + 1);
+        if (ix->skip == null || ix->deltas == null) { r = ENOMEM; }
+    }
+    if (r == 0) {
+        int_t checkpoint = 0;
+        int_t previous = 0;
+        for (int i = -1; i < parts; i++) { // -1 stands for line 0 at 0
+            int_t n = i < 0 ? 1 : chunks[i].count;
+            for (int_t j = 0; j < n && checkpoint < ix->checkpoints; j++) {
+                int_t start = i < 0 ? 0 : chunks[i].starts[j];
+                if (checkpoint % 64 == 0) {
+                    ix->skip[checkpoint / 64 * 2] = start;
+                    ix->skip[checkpoint / 64 * 2 + 1] = ix->deltas_bytes;
+                } else {
+                    ix->deltas_bytes += memmap_varint_put(
+                        ix->deltas + ix->deltas_bytes, start - previous);
+                }
+                previous = start;
+                checkpoint++;
+            }
+        }
+        assertion(checkpoint == ix->checkpoints, "checkpoint=%lld of %lld",
+                  (int64_t)checkpoint, (int64_t)ix->checkpoints);
+    }
+    for (int i = 0; chunks != null && i < parts; i++) {
+        heap.free(chunks[i].starts);
+    }
+    heap.free(t);
+    heap.free(chunks);
+    if (r != 0) { memmap_line_index_dispose(ix); }
+    return r;
+}
+
+static errno_t memmap_line_seek(const memmap_line_index_t* ix,
+        const void* data, int_t line, span_t* s) {
+    if (line < 0 || line >= ix->lines) { return EINVAL; }
+    const int_t k = memmap_line_index_every;
+    const int_t checkpoint = line / k;
+    int_t offset = ix->skip[checkpoint / 64 * 2];
+    const uint8_t* p = ix->deltas + ix->skip[checkpoint / 64 * 2 + 1];
+    for (int_t i = 0; i < checkpoint % 64; i++) {
+        offset += (int_t)memmap_varint_get(&p);
+    }
+    const char* d = (const char*)data;
+    for (int_t i = 0; i < line % k; i++) {
+        const char* nl = (const char*)memchr(d + offset, '\n',
+                                             ix->bytes - offset);
+        if (nl == null) { return EINVAL; } // index does not match data
+        offset = nl - d + 1;
+    }
+    const char* nl = (const char*)memchr(d + offset, '\n', ix->bytes - offset);
+    s->data = d + offset;
+    s->bytes = (nl != null ? nl - d : ix->bytes) - offset;
+    return 0;
+}
+
+// file layout: header, skip[] pairs as int64_t, deltas[]
+
+enum { memmap_line_index_magic = 0x78644E4C }; // "LNdx"
+
+typedef struct {
+    uint32_t magic;
+    uint32_t every;
+    int64_t bytes;
+    int64_t lines;
+    int64_t checkpoints;
+    int64_t skips;
+    int64_t deltas_bytes;
+} memmap_line_index_header_t;
+
+static errno_t memmap_line_index_save(const memmap_line_index_t* ix,
+                                      const char* filename) {
+    memmap_line_index_header_t h = {
+        .magic = memmap_line_index_magic, .every = memmap_line_index_every,
+        .bytes = ix->bytes, .lines = ix->lines,
+        .checkpoints = ix->checkpoints, .skips = ix->skips,
+        .deltas_bytes = ix->deltas_bytes
+    };
+    FILE* f = fopen(filename, "wb");
+    if (f == null) { return errno; }
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+    for (int_t i = 0; ok && i < ix->skips * 2; i++) {
+        const int64_t v = ix->skip[i]; // same file for 32 and 64 bit int_t
+        ok = fwrite(&v, sizeof(v), 1, f) == 1;
+    }
+    ok = ok && (ix->deltas_bytes == 0 ||
+                fwrite(ix->deltas, ix->deltas_bytes, 1, f) == 1);
+    errno_t r = ok ? 0 : (errno != 0 ? errno : EIO);
+    if (fclose(f) != 0 && r == 0) { r = errno; }
+    return r;
+}
+
+// Decodes every varint once: skip[] positions must agree with the decoding,
+// line starts must increase and stay within ix->bytes and deltas[] must be
+// consumed exactly. After that line_seek() cannot leave data or deltas[].
+
+static errno_t memmap_line_index_verify(const memmap_line_index_t* ix) {
+    const uint8_t* p = ix->deltas;
+    const uint8_t* end = ix->deltas + ix->deltas_bytes;
+    int_t offset = 0;
+    for (int_t c = 0; c < ix->checkpoints; c++) {
+        if (c % 64 == 0) {
+            const int_t start = ix->skip[c / 64 * 2];
+            if (p - ix->deltas != ix->skip[c / 64 * 2 + 1] ||
+                (c == 0 ? start != 0 : start <= offset) || start > ix->bytes) {
+                return EINVAL;
+            }
+            offset = start;
+        } else {
+            uint64_t v = 0;
+            for (int shift = 0; ; shift += 7) {
+                if (p == end || shift > 63) { return EINVAL; }
+                const uint8_t b = *p++;
+                v |= (uint64_t)(b & 0x7F) << shift;
+                if (b < 0x80) { break; }
+            }
+            if (v == 0 || v > (uint64_t)(ix->bytes - offset)) { return EINVAL; }
+            offset += (int_t)v;
+        }
+    }
+    return p == end ? 0 : EINVAL;
+}
+
+static errno_t memmap_line_index_load(memmap_line_index_t* ix,
+                                      const char* filename) {
+    mem.zero(ix, sizeof(*ix));
+    void* data = null;
+    int_t bytes = 0;
+    errno_t r = memmap_file_readonly(filename, &data, &bytes);
+    if (r != 0) { return r; }
+    memmap_line_index_header_t h;
+    const int64_t k = memmap_line_index_every;
+    const int64_t pairs = sizeof(int64_t) * 2;
+    if (bytes < (int_t)sizeof(h)) {
+        r = EINVAL;
+    } else {
+        mem.copy(&h, data, sizeof(h));
+        const int64_t payload = (int64_t)bytes - (int64_t)sizeof(h);
+        // every line has at least '\n' or the last character:
+        if (h.magic != memmap_line_index_magic ||
+            h.every != memmap_line_index_every ||
+            h.bytes < 0 || h.bytes > INTPTR_MAX ||
+            h.lines < 0 || h.lines > h.bytes ||
+            h.checkpoints != h.lines / k + (h.lines % k != 0) ||
+            h.skips != (h.checkpoints + 63) / 64 ||
+            h.skips > payload / pairs ||
+            h.deltas_bytes != payload - h.skips * pairs) {
+            r = EINVAL;
+        }
+    }
+    if (r == 0) {
+        ix->bytes = (int_t)h.bytes;
+        ix->lines = (int_t)h.lines;
+        ix->checkpoints = (int_t)h.checkpoints;
+        ix->skips = (int_t)h.skips;
+        ix->deltas_bytes = (int_t)h.deltas_bytes;
+        ix->skip = (int_t*)heap.alloc(ix->skips * 2 * sizeof(int_t) + 1);
+        ix->deltas = (uint8_t*)heap.alloc(ix->deltas_bytes + 1);
+        if (ix->skip == null || ix->deltas == null) {
+            r = ENOMEM;
+        } else {
+            const uint8_t* p = (const uint8_t*)data + sizeof(h);
+            for (int_t i = 0; r == 0 && i < ix->skips * 2; i++) {
+                int64_t v = 0;
+                mem.copy(&v, p + i * sizeof(v), sizeof(v));
+                // even: line start, odd: position in deltas[]
+                const int64_t limit = i % 2 == 0 ? h.bytes : h.deltas_bytes;
+                if (v < 0 || v > limit) { r = EINVAL; }
+                ix->skip[i] = (int_t)v;
+            }
+            mem.copy(ix->deltas, p + ix->skips * pairs, ix->deltas_bytes);
+        }
+    }
+    if (r == 0) { r = memmap_line_index_verify(ix); }
+    memmap_file_unmap(data, bytes);
+    if (r != 0) { memmap_line_index_dispose(ix); }
+    return r;
+}
+
+memmap_if memmap = {
+    .file_readonly = memmap_file_readonly,
+    .file_readwrite = memmap_file_readwrite, // TODO
+    .file_unmap = memmap_file_unmap,
+    .line_index = memmap_line_index,
+    .line_seek = memmap_line_seek,
+    .line_index_save = memmap_line_index_save,
+    .line_index_load = memmap_line_index_load,
+    .line_index_dispose = memmap_line_index_dispose
+    // TODO: the rest of it
+};
+
+enum {
+    persistent_heap_page = 4096, // both header slots live in the first page
+    persistent_heap_classes = 8 + 4 * 33, // largest class is 7 << 38 bytes
+    persistent_heap_initial = 1024 * 1024,
+    persistent_heap_block_magic = 0x4B4C4248 // "HBLK"
+};
+
+static const uint64_t persistent_heap_magic = 0x5041454850585053ULL;
+
+typedef struct {
+    uint64_t magic;
+    uint64_t sequence;
+    uint64_t top;      // bump allocation offset
+    uint64_t root;
+    uint64_t snapshot[2]; // blocks with free stacks of each slot
+    uint64_t checksum; // FNV-1a of the fields above
+} persistent_heap_header_t;
+
+typedef struct { // precedes every block, keeps user data 16 bytes aligned
+    uint32_t magic;
+    uint32_t size_class;
+    uint64_t bytes; // requested
+} persistent_heap_block_t;
+
+typedef struct { // free blocks offsets of a size class
+    uint64_t* offsets;
+    int_t count;
+    int_t capacity;
+} persistent_heap_stack_t;
+
+typedef struct {
+    mutex_t lock;
+    int fd;
+    uint8_t* base; // null when closed
+    int_t reserve;
+    int_t mapped; // file size
+    uint64_t top;
+    uint64_t root;
+    uint64_t sequence;
+    int slot; // of the last committed header
+    uint64_t snapshot[2];
+    persistent_heap_stack_t free[persistent_heap_classes];
+} persistent_heap_state_t;
+
+static persistent_heap_state_t persistent_heap_state = {
+    .lock = PTHREAD_MUTEX_INITIALIZER, .fd = -1
+};
+
+static int persistent_heap_class(uint64_t bytes) { // including block header
+    if (bytes <= 128) { return bytes <= 16 ? 0 : (int)((bytes + 15) / 16) - 1; }
+    const uint64_t b = bytes - 1;
+    const int h = 63 - __builtin_clzll(b);
+    return 8 + (h - 7) * 4 + (int)((b >> (h - 2)) & 3);
+}
+
+static uint64_t persistent_heap_class_bytes(int c) {
+    if (c < 8) { return (uint64_t)(c + 1) * 16; }
+    const int h = 7 + (c - 8) / 4;
+    return (uint64_t)(5 + (c - 8) % 4) << (h - 2);
+}
+
+static uint64_t persistent_heap_checksum(const persistent_heap_header_t* h) {
+    const uint8_t* p = (const uint8_t*)h;
+    uint64_t x = 0xCBF29CE484222325ULL;
+    const int bytes = (int)offsetof(persistent_heap_header_t, checksum);
+    for (int i = 0; i < bytes; i++) {
+        x = (x ^ p[i]) * 0x100000001B3ULL;
+    }
+    return x;
+}
+
+static persistent_heap_block_t* persistent_heap_block(uint64_t offset) {
+    return (persistent_heap_block_t*)(persistent_heap_state.base + offset);
+}
+
+static bool persistent_heap_grow(uint64_t top) { // called under lock
+    persistent_heap_state_t* ph = &persistent_heap_state;
+    if (top > (uint64_t)ph->reserve) { return false; }
+    int_t size = ph->mapped;
+    while ((uint64_t)size < top) { size *= 2; }
+    if (size > ph->reserve) { size = ph->reserve; }
+    if (ftruncate(ph->fd, size) != 0) { return false; }
+    void* a = mmap(ph->base + ph->mapped, size - ph->mapped,
+                   PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED,
+                   ph->fd, ph->mapped);
+    if (a == MAP_FAILED) { return false; }
+    ph->mapped = size;
+    return true;
+}
+
+static bool persistent_heap_push(int c, uint64_t offset) { // under lock
+    persistent_heap_stack_t* s = &persistent_heap_state.free[c];
+    if (s->count == s->capacity) {
+        int_t n = s->capacity == 0 ? 16 : s->capacity * 2;
+        uint64_t* a = (uint64_t*)heap.realloc(s->offsets, n * sizeof(uint64_t));
+        if (a == null) { return false; } // block leaks, heap stays consistent
+        s->offsets = a;
+        s->capacity = n;
+    }
+    s->offsets[s->count++] = offset;
+    return true;
+}
+
+static uint64_t persistent_heap_take(int_t bytes) { // under lock
+    persistent_heap_state_t* ph = &persistent_heap_state;
+    if (ph->base == null || bytes < 0) { return 0; }
+    const int c = persistent_heap_class(bytes + sizeof(persistent_heap_block_t));
+    if (c >= persistent_heap_classes) { return 0; }
+    uint64_t offset = 0;
+    persistent_heap_stack_t* s = &ph->free[c];
+    if (s->count > 0) {
+        offset = s->offsets[--s->count];
+    } else {
+        const uint64_t top = ph->top + persistent_heap_class_bytes(c);
+        if (top > (uint64_t)ph->mapped && !persistent_heap_grow(top)) {
+            return 0;
+        }
+        offset = ph->top;
+        ph->top = top;
+    }
+    persistent_heap_block_t* b = persistent_heap_block(offset);
+    b->magic = persistent_heap_block_magic;
+    b->size_class = c;
+    b->bytes = bytes;
+    return offset;
+}
+
+static void persistent_heap_release(uint64_t offset) { // under lock
+    persistent_heap_block_t* b = persistent_heap_block(offset);
+    assertion(b->magic == persistent_heap_block_magic &&
+              b->size_class < persistent_heap_classes,
+              "not a persistent heap block %p", b);
+    persistent_heap_push(b->size_class, offset);
+}
+
+static void* persistent_heap_alloc(int_t bytes) {
+    persistent_heap_state_t* ph = &persistent_heap_state;
+    mutex.lock(&ph->lock);
+    uint64_t offset = persistent_heap_take(bytes);
+    mutex.unlock(&ph->lock);
+    return offset == 0 ? null :
+        ph->base + offset + sizeof(persistent_heap_block_t);
+}
+
+static void* persistent_heap_free(void* data) {
+    if (data != null) {
+        persistent_heap_state_t* ph = &persistent_heap_state;
+        mutex.lock(&ph->lock);
+        persistent_heap_release((uint8_t*)data - ph->base -
+                                sizeof(persistent_heap_block_t));
+        mutex.unlock(&ph->lock);
+    }
+    return null;
+}
+
+static void* persistent_heap_realloc(void* data, int_t bytes) {
+    if (data == null) { return persistent_heap_alloc(bytes); }
+    persistent_heap_block_t* b = (persistent_heap_block_t*)data - 1;
+    const uint64_t usable = persistent_heap_class_bytes(b->size_class) -
+                            sizeof(persistent_heap_block_t);
+    if (bytes >= 0 && (uint64_t)bytes <= usable) {
+        b->bytes = bytes;
+        return data;
+    }
+    void* p = persistent_heap_alloc(bytes);
+    if (p != null) {
+        mem.copy(p, data, (int_t)b->bytes);
+        persistent_heap_free(data);
+    }
+    return p;
+}
+
+static void* persistent_heap_allocate(int_t bytes) {
+    void* p = persistent_heap_alloc(bytes);
+    if (p != null) { mem.zero(p, bytes); }
+    return p;
+}
+
+static int_t persistent_heap_usable_size(const void* data) {
+    if (data == null) { return 0; }
+    const persistent_heap_block_t* b = (const persistent_heap_block_t*)data - 1;
+    return (int_t)(persistent_heap_class_bytes(b->size_class) - sizeof(*b));
+}
+
+static void* persistent_heap_free_sized(void* data, int_t bytes) {
+    #if defined(_DEBUG) || defined(DEBUG)
+        assertion(data == null || (uint64_t)bytes ==
+                  ((persistent_heap_block_t*)data - 1)->bytes,
+            "%p was not allocated with %lld bytes", data, (long long)bytes);
+    #else
+        (void)bytes;
+    #endif
+    return persistent_heap_free(data);
+}
+
+static errno_t persistent_heap_alloc_batch(int_t bytes, int_t n, void* out[]) {
+    persistent_heap_state_t* ph = &persistent_heap_state;
+    errno_t r = 0;
+    mutex.lock(&ph->lock);
+    for (int_t i = 0; i < n && r == 0; i++) {
+        const uint64_t offset = persistent_heap_take(bytes);
+        if (offset == 0) {
+            while (i > 0) {
+                persistent_heap_release((uint64_t)((uint8_t*)out[--i] -
+                    ph->base - sizeof(persistent_heap_block_t)));
+            }
+            r = ENOMEM;
+        } else {
+            out[i] = ph->base + offset + sizeof(persistent_heap_block_t);
+        }
+    }
+    mutex.unlock(&ph->lock);
+    return r;
+}
+
+static void persistent_heap_free_batch(void* data[], int_t n) {
+    persistent_heap_state_t* ph = &persistent_heap_state;
+    mutex.lock(&ph->lock);
+    for (int_t i = 0; i < n; i++) {
+        if (data[i] != null) {
+            persistent_heap_release((uint64_t)((uint8_t*)data[i] - ph->base -
+                                    sizeof(persistent_heap_block_t)));
+        }
+    }
+    mutex.unlock(&ph->lock);
+}
+
+static errno_t persistent_heap_commit(void) { // under lock
+    persistent_heap_state_t* ph = &persistent_heap_state;
+    const int k = 1 - ph->slot;
+    // snapshot: counts[classes] followed by all free offsets. Freeing old
+    // snapshot block and allocating new one changes total by at most 1
+    int_t total = 0;
+    for (int c = 0; c < persistent_heap_classes; c++) {
+        total += ph->free[c].count;
+    }
+    int_t bytes = (persistent_heap_classes + total + 1) * sizeof(uint64_t);
+    if (ph->snapshot[k] == 0 ||
+        persistent_heap_block(ph->snapshot[k])->bytes < (uint64_t)bytes) {
+        if (ph->snapshot[k] != 0) { persistent_heap_release(ph->snapshot[k]); }
+        ph->snapshot[k] = persistent_heap_take(bytes + bytes / 4);
+        if (ph->snapshot[k] == 0) { return ENOMEM; }
+    }
+    uint64_t* counts = (uint64_t*)(persistent_heap_block(ph->snapshot[k]) + 1);
+    uint64_t* offsets = counts + persistent_heap_classes;
+    for (int c = 0; c < persistent_heap_classes; c++) {
+        counts[c] = ph->free[c].count;
+        if (counts[c] > 0) {
+            mem.copy(offsets, ph->free[c].offsets, ph->free[c].count * 8);
+            offsets += ph->free[c].count;
+        }
+    }
+    if (msync(ph->base, ph->top, MS_SYNC) != 0) { return errno; }
+    persistent_heap_header_t h = {
+        .magic = persistent_heap_magic, .sequence = ph->sequence + 1,
+        .top = ph->top, .root = ph->root,
+        .snapshot = { ph->snapshot[0], ph->snapshot[1] }
+    };
+    h.checksum = persistent_heap_checksum(&h);
+    mem.copy(ph->base + k * (persistent_heap_page / 2), &h, sizeof(h));
+    if (msync(ph->base, persistent_heap_page, MS_SYNC) != 0) { return errno; }
+    ph->slot = k;
+    ph->sequence++;
+    return 0;
+}
+
+static errno_t persistent_heap_persist(void) {
+    persistent_heap_state_t* ph = &persistent_heap_state;
+    mutex.lock(&ph->lock);
+    errno_t r = ph->base == null ? EINVAL : persistent_heap_commit();
+    mutex.unlock(&ph->lock);
+    return r;
+}
+
+static bool persistent_heap_valid(const persistent_heap_header_t* h) {
+    const persistent_heap_state_t* ph = &persistent_heap_state;
+    return h->magic == persistent_heap_magic &&
+        h->checksum == persistent_heap_checksum(h) &&
+        persistent_heap_page <= h->top && h->top <= (uint64_t)ph->mapped &&
+        h->snapshot[0] < h->top && h->snapshot[1] < h->top &&
+        h->root < h->top;
+}
+
+static errno_t persistent_heap_load(void) { // under lock
+    persistent_heap_state_t* ph = &persistent_heap_state;
+    persistent_heap_header_t h[2];
+    mem.copy(&h[0], ph->base, sizeof(h[0]));
+    mem.copy(&h[1], ph->base + persistent_heap_page / 2, sizeof(h[1]));
+    const bool v0 = persistent_heap_valid(&h[0]);
+    const bool v1 = persistent_heap_valid(&h[1]);
+    if (!v0 && !v1) { return EINVAL; }
+    const int k = v0 && (!v1 || h[0].sequence > h[1].sequence) ? 0 : 1;
+    ph->slot = k;
+    ph->sequence = h[k].sequence;
+    ph->top = h[k].top;
+    ph->root = h[k].root;
+    ph->snapshot[0] = h[k].snapshot[0];
+    ph->snapshot[1] = h[k].snapshot[1];
+    if (ph->snapshot[k] < persistent_heap_page) { return EINVAL; }
+    const persistent_heap_block_t* b = persistent_heap_block(ph->snapshot[k]);
+    if (b->magic != persistent_heap_block_magic) { return EINVAL; }
+    const uint64_t* counts = (const uint64_t*)(b + 1);
+    const uint64_t* offsets = counts + persistent_heap_classes;
+    uint64_t total = 0;
+    for (int c = 0; c < persistent_heap_classes; c++) { total += counts[c]; }
+    if ((persistent_heap_classes + total) * 8 > b->bytes) { return EINVAL; }
+    for (int c = 0; c < persistent_heap_classes; c++) {
+        for (uint64_t i = 0; i < counts[c]; i++) {
+            const uint64_t offset = *offsets++;
+            if (offset < persistent_heap_page || offset >= ph->top) {
+                return EINVAL;
+            }
+            if (!persistent_heap_push(c, offset)) { return ENOMEM; }
+        }
+    }
+    return 0;
+}
+
+static void persistent_heap_unmap(void) { // under lock
+    persistent_heap_state_t* ph = &persistent_heap_state;
+    if (ph->base != null) { if_error_fatal(munmap(ph->base, ph->reserve)); }
+    if (ph->fd >= 0) { if_error_fatal(close(ph->fd)); }
+    for (int c = 0; c < persistent_heap_classes; c++) {
+        heap.free(ph->free[c].offsets);
+    }
+    mem.zero(ph->free, sizeof(ph->free));
+    ph->base = null;
+    ph->fd = -1;
+    ph->mapped = 0;
+    ph->top = 0;
+    ph->root = 0;
+    ph->sequence = 0;
+    ph->snapshot[0] = 0;
+    ph->snapshot[1] = 0;
+}
+
+static errno_t persistent_heap_open(const char* filename, int_t reserve) {
+    persistent_heap_state_t* ph = &persistent_heap_state;
+    mutex.lock(&ph->lock);
+    if (ph->base != null) {
+        mutex.unlock(&ph->lock);
+        return EBUSY;
+    }
+    errno_t r = 0;
+    ph->fd = open(filename, O_RDWR | O_CREAT, 0644);
+    if (ph->fd < 0) { r = errno; }
+    struct stat s = {};
+    if (r == 0 && fstat(ph->fd, &s) != 0) { r = errno; }
+    const bool fresh = r == 0 && s.st_size == 0;
+    if (r == 0) {
+        const int_t page = persistent_heap_page;
+        reserve = (reserve + page - 1) / page * page;
+        ph->reserve = reserve < persistent_heap_initial ?
+                      persistent_heap_initial : reserve;
+        ph->mapped = fresh ? persistent_heap_initial : (int_t)s.st_size;
+        if (ph->mapped < page || ph->mapped % page != 0) { r = EINVAL; }
+        if (ph->mapped > ph->reserve) { r = ENOMEM; }
+    }
+    if (r == 0 && fresh && ftruncate(ph->fd, ph->mapped) != 0) { r = errno; }
+    if (r == 0) { // reserve address space, then map the file over it
+        void* a = mmap(null, ph->reserve, PROT_NONE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (a == MAP_FAILED) { r = errno; } else { ph->base = (uint8_t*)a; }
+    }
+    if (r == 0 && mmap(ph->base, ph->mapped, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_FIXED, ph->fd, 0) == MAP_FAILED) {
+        r = errno;
+    }
+    if (r == 0 && fresh) {
+        ph->top = persistent_heap_page;
+        ph->slot = 1; // first commit goes to slot 0
+        r = persistent_heap_commit();
+    } else if (r == 0) {
+        r = persistent_heap_load();
+    }
+    if (r != 0) { persistent_heap_unmap(); }
+    mutex.unlock(&ph->lock);
+    return r;
+}
+
+static void persistent_heap_close(void) {
+    mutex.lock(&persistent_heap_state.lock);
+    persistent_heap_unmap();
+    mutex.unlock(&persistent_heap_state.lock);
+}
+
+static persistent_ptr_t persistent_heap_offset(const void* p) {
+    const persistent_heap_state_t* ph = &persistent_heap_state;
+    if (p == null) { return (persistent_ptr_t){0}; }
+    const uint8_t* a = (const uint8_t*)p;
+    assertion(ph->base + persistent_heap_page <= a &&
+              a < ph->base + ph->mapped, "%p is outside of persistent heap", p);
+    return (persistent_ptr_t){ (uint64_t)(a - ph->base) };
+}
+
+static void* persistent_heap_pointer(persistent_ptr_t o) {
+    return o.offset == 0 ? null : persistent_heap_state.base + o.offset;
+}
+
+static persistent_ptr_t persistent_heap_root(void) {
+    mutex.lock(&persistent_heap_state.lock);
+    persistent_ptr_t o = { persistent_heap_state.root };
+    mutex.unlock(&persistent_heap_state.lock);
+    return o;
+}
+
+static void persistent_heap_set_root(persistent_ptr_t o) {
+    mutex.lock(&persistent_heap_state.lock);
+    persistent_heap_state.root = o.offset;
+    mutex.unlock(&persistent_heap_state.lock);
+}
+
+persistent_heap_if persistent_heap = {
+    .open = persistent_heap_open,
+    .persist = persistent_heap_persist,
+    .close = persistent_heap_close,
+    .offset = persistent_heap_offset,
+    .pointer = persistent_heap_pointer,
+    .root = persistent_heap_root,
+    .set_root = persistent_heap_set_root,
+    .heap = {
+        .alloc = persistent_heap_alloc,
+        .realloc = persistent_heap_realloc,
+        .free = persistent_heap_free,
+        .allocate = persistent_heap_allocate,
+        .free_sized = persistent_heap_free_sized,
+        .usable_size = persistent_heap_usable_size,
+        .alloc_batch = persistent_heap_alloc_batch,
+        .free_batch = persistent_heap_free_batch
+    }
+};
+
+static void csv_scan(csv_reader_t* r) {
+    uint8_t padded[64];
+    const uint8_t* p = bitmask_block((const uint8_t*)r->data, r->bytes,
+                                     r->block, padded);
+    uint64_t quoted = bitmask_prefix_xor(bitmask_eq(p, '"')) ^ r->quoted;
+    r->quoted = (uint64_t)((int64_t)quoted >> 63); // carry into next block
+    r->structural = (bitmask_eq(p, (uint8_t)r->delimiter) |
+                     bitmask_eq(p, '\n')) & ~quoted;
+}
+
+static void csv_init(csv_reader_t* r, const void* data, int_t bytes,
+                     char delimiter) {
+    assertion(delimiter != '"' && delimiter != '\n' && delimiter != 0,
+              "invalid delimiter 0x%02X", delimiter);
+    mem.zero(r, sizeof(*r));
+    r->data = (const char*)data;
+    r->bytes = bytes;
+    r->delimiter = delimiter;
+    if (bytes > 0) { csv_scan(r); }
+}
+
+static bool csv_next(csv_reader_t* r, csv_field_t* f) {
+    if (r->position >= r->bytes && !r->after_delimiter) { return false; }
+    int_t end = r->bytes; // end of data terminates last field
+    while (r->structural == 0 && r->block + 64 < r->bytes) {
+        r->block += 64;
+        csv_scan(r);
+    }
+    if (r->structural != 0) {
+        end = r->block + __builtin_ctzll(r->structural);
+        r->structural &= r->structural - 1;
+    }
+    const char* s = r->data + r->position;
+    int_t bytes = end - r->position;
+    f->last = end == r->bytes || r->data[end] == '\n';
+    r->after_delimiter = !f->last;
+    r->position = end + 1;
+    if (f->last && bytes > 0 && s[bytes - 1] == '\r') { bytes--; } // CRLF
+    f->quoted = bytes >= 2 && s[0] == '"' && s[bytes - 1] == '"';
+    if (f->quoted) { s++; bytes -= 2; }
+    f->span.data = s;
+    f->span.bytes = bytes;
+    return true;
+}
+
+static int_t csv_unquote(const csv_field_t* f, char* to) {
+    const char* s = f->span.data;
+    const char* e = s + f->span.bytes;
+    char* d = to;
+    while (s < e) {
+        *d++ = *s;
+        s += f->quoted && s[0] == '"' && s + 1 < e && s[1] == '"' ? 2 : 1;
+    }
+    return d - to;
+}
+
+typedef struct {
+    const uint8_t* data;
+    int_t from;
+    int_t to;
+    int_t quotes; // number of '"' in [from..to)
+    int part;
+    char delimiter;
+    void* that;
+    void (*parse)(void* that, int part, csv_reader_t* r);
+} csv_chunk_t;
+
+static void csv_count_quotes(void* p) {
+    csv_chunk_t* c = (csv_chunk_t*)p;
+    uint8_t padded[64];
+    for (int_t b = c->from; b < c->to; b += 64) {
+        // bitmask_block() pads with zeros only at the end of the range
+        const uint8_t* p = bitmask_block(c->data, c->to, b, padded);
+        c->quotes += __builtin_popcountll(bitmask_eq(p, '"'));
+    }
+}
+
+static void csv_split(const void* data, int_t bytes, int parts,
+                      int_t offsets[]) {
+    assertion(parts > 0, "parts=%d", parts);
+    csv_chunk_t* chunks = (csv_chunk_t*)heap.allocate(
+                                            parts * sizeof(csv_chunk_t));
+    thread_t* t = (thread_t*)heap.allocate(parts * sizeof(thread_t));
+    if (chunks == null || t == null) { fatal("out of memory"); }
+    for (int i = 0; i < parts; i++) {
+        chunks[i].data = (const uint8_t*)data;
+        chunks[i].from = bytes / parts * i;
+        chunks[i].to = i == parts - 1 ? bytes : bytes / parts * (i + 1);
+    }
+    for (int i = 1; i < parts; i++) {
+        threads.start(&t[i], csv_count_quotes, &chunks[i], 0, false);
+    }
+    csv_count_quotes(&chunks[0]);
+    for (int i = 1; i < parts; i++) { threads.join(t[i]); }
+    // odd number of quotes before chunk start means it starts quoted
+    const char* s = (const char*)data;
+    int_t quotes = 0;
+    offsets[0] = 0;
+    for (int i = 1; i < parts; i++) {
+        quotes += chunks[i - 1].quotes;
+        bool quoted = quotes % 2 != 0;
+        int_t k = chunks[i].from;
+        while (k < bytes && (quoted || s[k] != '\n')) {
+            if (s[k] == '"') { quoted = !quoted; }
+            k++;
+        }
+        offsets[i] = k < bytes ? k + 1 : bytes;
+        if (offsets[i] < offsets[i - 1]) { offsets[i] = offsets[i - 1]; }
+    }
+    offsets[parts] = bytes;
+    heap.free(t);
+    heap.free(chunks);
+}
+
+static void csv_parse_chunk(void* p) {
+    csv_chunk_t* c = (csv_chunk_t*)p;
+    csv_reader_t r;
+    csv_init(&r, c->data + c->from, c->to - c->from, c->delimiter);
+    c->parse(c->that, c->part, &r);
+}
+
+static void csv_parallel(const void* data, int_t bytes, char delimiter,
+                         int parts, void* that,
+                         void (*parse)(void* that, int part, csv_reader_t* r)) {
+    int_t* offsets = (int_t*)heap.alloc((parts + 1) * sizeof(int_t));
+    csv_chunk_t* chunks = (csv_chunk_t*)heap.allocate(
+                                            parts * sizeof(csv_chunk_t));
+    thread_t* t = (thread_t*)heap.allocate(parts * sizeof(thread_t));
+    if (offsets == null || chunks == null || t == null) {
+        fatal("out of memory");
+    }
+    csv_split(data, bytes, parts, offsets);
+    for (int i = 0; i < parts; i++) {
+        chunks[i] = (csv_chunk_t){ .data = (const uint8_t*)data,
+            .from = offsets[i], .to = offsets[i + 1], .part = i,
+            .delimiter = delimiter, .that = that, .parse = parse };
+    }
+    for (int i = 1; i < parts; i++) {
+        threads.start(&t[i], csv_parse_chunk, &chunks[i], 0, false);
+    }
+    csv_parse_chunk(&chunks[0]);
+    for (int i = 1; i < parts; i++) { threads.join(t[i]); }
+    heap.free(t);
+    heap.free(chunks);
+    heap.free(offsets);
+}
+
+csv_if csv = {
+    .init = csv_init,
+    .next = csv_next,
+    .unquote = csv_unquote,
+    .split = csv_split,
+    .parallel = csv_parallel
+};
+
+// bits of characters escaped by preceding odd run of backslashes
+// (branchless algorithm from simdjson), "carry" is in/out for runs
+// crossing 64 bytes block boundary
+
+static uint64_t json_escaped(uint64_t backslash, uint64_t *carry) {
+    const uint64_t even = 0x5555555555555555ULL;
+    backslash &= ~*carry; // first backslash escaped by previous block
+    uint64_t follows_escape = (backslash << 1) | *carry;
+    uint64_t odd_starts = backslash & ~even & ~follows_escape;
+    uint64_t even_starts = 0;
+    *carry = __builtin_add_overflow(odd_starts, backslash, &even_starts);
+    return (even ^ (even_starts << 1)) & follows_escape;
+}
+
+static errno_t json_append(json_index_t* ix, uint64_t bits, int_t block) {
+    int_t n = __builtin_popcountll(bits);
+    if (ix->count + n > ix->capacity) {
+        int_t capacity = ix->capacity * 2 + 64;
+        void* p = heap.realloc(ix->position, capacity * sizeof(int_t));
+        if (p == null) { return ENOMEM; }
+        ix->position = (int_t*)p;
+        ix->capacity = capacity;
+    }
+    int_t* position = ix->position + ix->count;
+    while (bits != 0) {
+        *position++ = block + __builtin_ctzll(bits);
+        bits &= bits - 1;
+    }
+    ix->count += n;
+    return 0;
+}
+
+static errno_t json_index(json_index_t* ix, const void* data, int_t bytes) {
+    mem.zero(ix, sizeof(*ix));
+    ix->data = (const char*)data;
+    ix->bytes = bytes;
+    const uint8_t* d = (const uint8_t*)data;
+    uint8_t padded[64];
+    uint64_t escape_carry = 0;
+    uint64_t string_carry = 0; // ~0 when previous block ended in string
+    uint64_t scalar_carry = 0; // 1 when previous block ended in scalar
+    errno_t r = 0;
+    for (int_t block = 0; block < bytes && r == 0; block += 64) {
+        const uint8_t* p = bitmask_block(d, bytes, block, padded);
+        const uint64_t valid = bytes - block >= 64 ?
+                               ~0ULL : (1ULL << (bytes - block)) - 1;
+        uint64_t escaped = json_escaped(bitmask_eq(p, '\\'), &escape_carry);
+        uint64_t quote = bitmask_eq(p, '"') & ~escaped;
+        uint64_t in_string = bitmask_prefix_xor(quote) ^ string_carry;
+        string_carry = (uint64_t)((int64_t)in_string >> 63);
+        uint64_t op = bitmask_eq(p, '{') | bitmask_eq(p, '}') |
+                      bitmask_eq(p, '[') | bitmask_eq(p, ']') |
+                      bitmask_eq(p, ':') | bitmask_eq(p, ',');
+        uint64_t space = bitmask_eq(p, ' ') | bitmask_eq(p, '\t') |
+                         bitmask_eq(p, '\n') | bitmask_eq(p, '\r');
+        uint64_t scalar = ~(op | space | quote) & ~in_string & valid;
+        uint64_t scalar_start = scalar & ~((scalar << 1) | scalar_carry);
+        scalar_carry = scalar >> 63;
+        uint64_t structural = (op & ~in_string) | (quote & in_string) |
+                              scalar_start;
+        r = json_append(ix, structural & valid, block);
+    }
+    if (r == 0 && string_carry != 0) { r = EINVAL; }
+    return r;
+}
+
+static void json_dispose(json_index_t* ix) {
+    heap.free(ix->position);
+    mem.zero(ix, sizeof(*ix));
+}
+
+static void json_cursor(json_cursor_t* c, const json_index_t* ix) {
+    c->ix = ix;
+    c->next = 0;
+}
+
+static bool json_is_space(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\n' || ch == '\r';
+}
+
+// end of scalar or string started at position[i]: everything up to next
+// structural position (or end of data) less trailing white space
+
+static int_t json_token_end(const json_index_t* ix, int_t i) {
+    int_t end = i + 1 < ix->count ? ix->position[i + 1] : ix->bytes;
+    while (end > ix->position[i] && json_is_space(ix->data[end - 1])) {
+        end--;
+    }
+    return end;
+}
+
+static json_token_t json_next(json_cursor_t* c) {
+    const json_index_t* ix = c->ix;
+    json_token_t t = { json_end, { null, 0 } };
+    while (c->next < ix->count &&
+          (ix->data[ix->position[c->next]] == ':' ||
+           ix->data[ix->position[c->next]] == ',')) {
+        c->next++;
+    }
+    if (c->next < ix->count) {
+        const int_t i = c->next++;
+        const char* s = ix->data + ix->position[i];
+        t.span.data = s;
+        t.span.bytes = 1;
+        switch (*s) {
+            case '{': t.type = json_object; break;
+            case '}': t.type = json_object_end; break;
+            case '[': t.type = json_array; break;
+            case ']': t.type = json_array_end; break;
+            case '"': {
+                int_t end = json_token_end(ix, i); // past closing quote
+                t.span.data = s + 1;
+                t.span.bytes = end - ix->position[i] - 2;
+                bool key = c->next < ix->count &&
+                           ix->data[ix->position[c->next]] == ':';
+                t.type = key ? json_key : json_string;
+                if (t.span.bytes < 0 || s[end - ix->position[i] - 1] != '"') {
+                    t.type = json_invalid;
+                    t.span.data = s;
+                    t.span.bytes = 1;
+                }
+                break;
+            }
+            default: {
+                t.span.bytes = json_token_end(ix, i) - ix->position[i];
+                if (*s == '-' || ('0' <= *s && *s <= '9')) {
+                    t.type = json_number;
+                } else if (str.equals(s, "true", 4) && t.span.bytes == 4) {
+                    t.type = json_true;
+                } else if (str.equals(s, "false", 5) && t.span.bytes == 5) {
+                    t.type = json_false;
+                } else if (str.equals(s, "null", 4) && t.span.bytes == 4) {
+                    t.type = json_null;
+                } else {
+                    t.type = json_invalid;
+                }
+                break;
+            }
+        }
+    }
+    return t;
+}
+
+static void json_skip(json_cursor_t* c) {
+    const json_index_t* ix = c->ix;
+    int depth = 1;
+    while (c->next < ix->count && depth > 0) {
+        char ch = ix->data[ix->position[c->next++]];
+        if (ch == '{' || ch == '[') {
+            depth++;
+        } else if (ch == '}' || ch == ']') {
+            depth--;
+        }
+    }
+}
+
+static double json_to_double(const json_token_t* t, errno_t *error) {
+    *error = 0;
+    if (t->type != json_number) { *error = EINVAL; return nan(""); }
+    if (t->span.bytes >= 64) { *error = E2BIG; return nan(""); }
+    return str.to_double(t->span.data, (int)t->span.bytes, error);
+}
+
+static void json_to_int64(int64_t* v, const json_token_t* t, errno_t *error) {
+    *error = 0;
+    if (t->type != json_number) {
+        *error = EINVAL;
+    } else if (t->span.bytes >= 64) {
+        *error = E2BIG;
+    } else {
+        str.to_int64(v, t->span.data, (int)t->span.bytes, error);
+    }
+}
+
+static int json_hex4(const char* s) {
+    int v = 0;
+    for (int i = 0; i < 4; i++) {
+        char ch = s[i];
+        int d = '0' <= ch && ch <= '9' ? ch - '0' :
+                'a' <= ch && ch <= 'f' ? ch - 'a' + 10 :
+                'A' <= ch && ch <= 'F' ? ch - 'A' + 10 : -1;
+        if (d < 0) { return -1; }
+        v = v * 16 + d;
+    }
+    return v;
+}
+
+static int_t json_unescape(const json_token_t* t, char* to) {
+    const char* s = t->span.data;
+    const char* e = s + t->span.bytes;
+    char* d = to;
+    while (s < e) {
+        if (*s != '\\') { *d++ = *s++; continue; }
+        if (s + 1 >= e) { return -1; }
+        char ch = s[1];
+        s += 2;
+        switch (ch) {
+            case '"': case '\\': case '/': *d++ = ch; break;
+            case 'b': *d++ = '\b'; break;
+            case 'f': *d++ = '\f'; break;
+            case 'n': *d++ = '\n'; break;
+            case 'r': *d++ = '\r'; break;
+            case 't': *d++ = '\t'; break;
+            case 'u': {
+                if (e - s < 4) { return -1; }
+                int32_t u = json_hex4(s);
+                s += 4;
+                if (0xD800 <= u && u <= 0xDBFF) { // high surrogate
+                    if (e - s < 6 || s[0] != '\\' || s[1] != 'u') { return -1; }
+                    int32_t low = json_hex4(s + 2);
+                    if (low < 0xDC00 || low > 0xDFFF) { return -1; }
+                    u = 0x10000 + ((u - 0xD800) << 10) + (low - 0xDC00);
+                    s += 6;
+                } else if (u < 0 || (0xDC00 <= u && u <= 0xDFFF)) {
+                    return -1;
+                }
+                // UTF-8 encoding is never longer than 6 bytes of "\uXXXX"
+                if (u < 0x80) {
+                    *d++ = (char)u;
+                } else if (u < 0x800) {
+                    *d++ = (char)(0xC0 | (u >> 6));
+                    *d++ = (char)(0x80 | (u & 0x3F));
+                } else if (u < 0x10000) {
+                    *d++ = (char)(0xE0 | (u >> 12));
+                    *d++ = (char)(0x80 | ((u >> 6) & 0x3F));
+                    *d++ = (char)(0x80 | (u & 0x3F));
+                } else {
+                    *d++ = (char)(0xF0 | (u >> 18));
+                    *d++ = (char)(0x80 | ((u >> 12) & 0x3F));
+                    *d++ = (char)(0x80 | ((u >> 6) & 0x3F));
+                    *d++ = (char)(0x80 | (u & 0x3F));
+                }
+                break;
+            }
+            default: return -1;
+        }
+    }
+    return d - to;
+}
+
+json_if json = {
+    .index = json_index,
+    .dispose = json_dispose,
+    .cursor = json_cursor,
+    .next = json_next,
+    .skip = json_skip,
+    .to_double = json_to_double,
+    .to_int64 = json_to_int64,
+    .unescape = json_unescape
+};
+
+
+#if (defined(DEBUG) || defined(_DEBUG)) && !defined(NDEBUG)
+enum { is_debug_build = 1 };
+#else
+enum { is_debug_build = 0 };
+#endif
+
+nposix_if np = {
+    (bool)is_debug_build
+};
+
+#ifndef NO_TESTS
+
+static void nposix_test_mem() {
+    enum { n = 16 };
+    uint8_t c[n] = { 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15 };
+    uint8_t a[n]; // uninitialized
+    mem.fill(a, 0xFF, n);
+    for (int i = 0; i < n; i++) { swear(a[i] == 0xFF); }
+    mem.zero(a, n);
+    for (int i = 0; i < n; i++) { swear(a[i] == 0); }
+    mem.copy(a, c, n);
+    swear(mem.equals(a, c, n));
+    swear(mem.compare(a, c, n) == 0);
+    for (int i = 0; i < n; i++) { swear(a[i] == c[i]); }
+    a[8] = 0xFF;
+    swear(mem.compare(a, c, n) > 0);
+    swear(mem.compare(c, a, n) < 0);
+    mem.copy(a, c, n);
+    mem.move(&a[0], &a[1], n - 1);
+    for (int i = 0; i < n - 1; i++) { swear(a[i] == c[i + 1]); }
+    mem.copy(a, c, n);
+    // https://pubs.opengroup.org/onlinepubs/9699919799/
+    // "If copying takes place between objects that overlap,
+    //  the behavior is undefined"
+    mem.copy(&a[0], &a[1], n - 1);
+    for (int i = 0; i < n - 1; i++) {
+        if (a[i] != c[i+1]) { // this can happen:
+            traceln("a[%d]=%d != c[%d]=%d", i, a[i], i + 1, c[i + 1]);
+        }
+    }
+}
+
+static void nposix_test_heap_if(heap_if* h) {
+    enum { n = 100 };
+    void* a[n];
+    swear(h->alloc_batch(24, n, a) == 0);
+    for (int i = 0; i < n; i++) {
+        swear(h->usable_size(a[i]) >= 24);
+        mem.fill(a[i], (uint8_t)i, 24);
+    }
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < 24; j++) { swear(((uint8_t*)a[i])[j] == i); }
+    }
+    a[n / 2] = h->free_sized(a[n / 2], 24);
+    h->free_batch(a, n);
+    void* p = h->alloc(1000);
+    const int_t usable = h->usable_size(p);
+    swear(usable >= 1000);
+    mem.fill(p, 0xA5, usable); // all of usable size is writable
+    h->free_sized(p, 1000);
+    swear(h->usable_size(null) == 0);
+}
+
+static void nposix_test_heap() {
+    nposix_test_heap_if(&heap);
+    // append-heavy growth across mmap() threshold and back:
+    enum { mb = 1024 * 1024, steps = 256 };
+    uint8_t* p = (uint8_t*)heap.alloc(mb / 2);
+    p[0] = 0xA5;
+    double time = process_clock.time();
+    for (int i = 1; i <= steps; i++) {
+        p = (uint8_t*)heap.realloc(p, (int_t)i * mb);
+        swear(p != null && heap.usable_size(p) >= (int_t)i * mb);
+        p[(int_t)i * mb - 1] = (uint8_t)i; // touch one page per step only
+    }
+    time = process_clock.time() - time;
+    traceln("realloc 1MB..%dMB in 1MB steps %.3fms", steps, time * 1000);
+    (void)time;
+    swear(p[0] == 0xA5);
+    for (int i = 1; i <= steps; i++) {
+        swear(p[(int_t)i * mb - 1] == (uint8_t)i);
+    }
+    p = (uint8_t*)heap.realloc(p, 2 * mb + 1); // shrink in place
+    swear(p[0] == 0xA5 && p[mb - 1] == 1 && p[2 * mb - 1] == 2);
+    p = (uint8_t*)heap.realloc(p, 100); // back to malloc()
+    swear(p[0] == 0xA5 && heap.usable_size(p) >= 100);
+    heap.free_sized(p, 100);
+    uint8_t* z = (uint8_t*)heap.allocate(2 * mb);
+    swear(z[0] == 0 && z[2 * mb - 1] == 0);
+    heap.free(z);
+}
+
+static void nposix_test_numa_arena(int node) {
+    // arena is only used on multi node machines, exercise it directly
+    for (int_t size = 1; size <= numa_arena_max; size++) {
+        const int c = numa_arena_class(size);
+        swear(size <= numa_arena_class_size(c) &&
+              (c == 0 || numa_arena_class_size(c - 1) < size));
+    }
+    enum { n = 1000 };
+    static uint8_t* p[n];
+    for (int i = 0; i < n; i++) {
+        const int_t bytes = 1 + i % 300;
+        p[i] = (uint8_t*)numa_node_alloc(bytes, node);
+        swear(p[i] != null && (uintptr_t)p[i] % 16 == 0);
+        swear(((heap_block_t*)p[i] - 1)->mapped < 0); // not page granular
+        swear(bytes <= heap.usable_size(p[i]) &&
+              heap.usable_size(p[i]) < bytes * 3 / 2 + 32);
+        mem.fill(p[i], (uint8_t)i, bytes);
+    }
+    for (int i = 0; i < n; i++) {
+        for (int_t j = 0; j < 1 + i % 300; j++) {
+            swear(p[i][j] == (uint8_t)i);
+        }
+    }
+    for (int i = n - 1; i >= 0; i--) { heap.free(p[i]); }
+    uint8_t* q = (uint8_t*)numa_node_alloc(1, node);
+    swear(q == p[0]); // last freed block of the class is reused first
+    // realloc within the class stays, beyond it moves with the data:
+    for (int i = 0; i < 16; i++) { q[i] = (uint8_t)i; }
+    uint8_t* r = (uint8_t*)numa_local_realloc(q, 16);
+    swear(r == q && ((heap_block_t*)r - 1)->bytes == 16);
+    r = (uint8_t*)numa_local_realloc(r, 1000);
+    swear(r != null && ((heap_block_t*)r - 1)->mapped < 0);
+    for (int i = 0; i < 16; i++) { swear(r[i] == i); }
+    // from arena to bound mapping and mapping growth via mremap():
+    r = (uint8_t*)numa_local_realloc(r, 1024 * 1024);
+    swear(r != null && ((heap_block_t*)r - 1)->mapped >= 1024 * 1024);
+    for (int i = 0; i < 16; i++) { swear(r[i] == i); }
+    r[1024 * 1024 - 1] = 0x5A;
+    r = (uint8_t*)numa_local_realloc(r, 8 * 1024 * 1024);
+    swear(r != null && ((heap_block_t*)r - 1)->mapped >= 8 * 1024 * 1024);
+    for (int i = 0; i < 16; i++) { swear(r[i] == i); }
+    swear(r[1024 * 1024 - 1] == 0x5A);
+    r[8 * 1024 * 1024 - 1] = (uint8_t)0xA5;
+    numa.heap.free(r);
+    #if defined(__linux__) // pretend to be on a two node machine
+        const int nodes = atomic_exchange(&numa_online, 2);
+        if (nodes == 1) {
+            nposix_test_heap_if(&numa.heap);
+            uint8_t* z = (uint8_t*)numa.heap.allocate(1000);
+            for (int i = 0; i < 1000; i++) { swear(z[i] == 0); }
+            mem.fill(z, 0xFF, 1000);
+            numa.heap.free(z);
+            z = (uint8_t*)numa.heap.allocate(1000); // reused block is zeroed
+            for (int i = 0; i < 1000; i++) { swear(z[i] == 0); }
+            heap.free(z);
+        }
+        atomic_store(&numa_online, nodes);
+    #endif
+}
+
+static void nposix_test_numa() {
+    const int nodes = numa.nodes();
+    const int node = numa.current_node();
+    swear(1 <= nodes && nodes <= numa_max_nodes && 0 <= node && node < nodes);
+    nposix_test_heap_if(&numa.heap);
+    enum { bytes = 1024 * 1024 };
+    for (int i = 0; i < nodes; i++) {
+        uint8_t* p = (uint8_t*)heap.alloc_on_node(bytes, i);
+        mem.fill(p, 0x5A, bytes); // first touch
+        heap.free(p);
+    }
+    uint8_t* g = (uint8_t*)numa.heap.alloc(100);
+    for (int i = 0; i < 100; i++) { g[i] = (uint8_t)i; }
+    g = (uint8_t*)numa.heap.realloc(g, 200); // stays node local
+    swear(g != null && (nodes == 1 || ((heap_block_t*)g - 1)->mapped != 0));
+    g = (uint8_t*)numa.heap.realloc(g, 50);
+    for (int i = 0; i < 50; i++) { swear(g[i] == i); }
+    numa.heap.free(g);
+    nposix_test_numa_arena(node);
+    uint8_t* t = (uint8_t*)heap.alloc_interleaved(bytes * 4);
+    mem.fill(t, 0xA5, bytes * 4);
+    // explicit placement of a page aligned range (works on single node too,
+    // but may be denied by container seccomp policy or absent on the OS):
+    const int_t page = (int_t)sysconf(_SC_PAGESIZE);
+    uint8_t* a = (uint8_t*)(((uintptr_t)t + page - 1) & ~(uintptr_t)(page - 1));
+    errno_t r = numa.bind(a, page, node);
+    swear(r == 0 || r == ENOSYS || r == EPERM);
+    r = numa.interleave(a, page);
+    swear(r == 0 || r == ENOSYS || r == EPERM);
+    swear(numa.bind(a, page, -1) == EINVAL || r == ENOSYS);
+    heap.free(t);
+    r = numa.prefer(node);
+    swear(r == 0 || r == ENOSYS || r == EPERM);
+    r = numa.prefer(-1);
+    swear(r == 0 || r == ENOSYS || r == EPERM);
+    traceln("nodes: %d current: %d", nodes, node);
+}
+
+static void nposix_test_str() {
+    char s[4];
+    assertion(countof(s) == 4, "is countof() broken?");
+    strcpy(s, "abc");
+    assertion(str.equals("abc", "abc", 0), "compare to itself");
+    assertion(str.equals(s,     "abc", 0), "zero terminated not equal");
+    assertion(str.equals("abc", s,     0), "zero terminated not equal");
+    s[3] = 'z'; // str[] is not zero terminated anymore
+    assertion(str.equals(s,     "abc",  3), "non-zero terminated not equal");
+    assertion(str.equals("abc", s,      3), "non-zero terminated not equal");
+    assertion(str.equals(s,     "abcd", 3), "non-zero terminated not equal");
+    assertion(str.equals("abcd", s,     3), "non-zero terminated not equal");
+    assertion(!str.equals("abc", "xyz", 0), "should not be equal");
+    assertion(!str.equals("abc", "xyz", 3), "compare only 3 bytes");
+    // str_to_double
+    char numeral[16]= {};
+    // 9 bytes:      012345678
+    strcpy(numeral, "123.456E0");
+    numeral[9] = '2';
+    int error = 0;
+    assertion(str.to_double(numeral, 9, &error) == 123.456 && error == 0,
+              "str.to_double(%*.*s,  9)=%g error %d %s",
+              10, 10, numeral, str.to_double(numeral, 9, &error),
+              error, strerror(error));
+    assertion(str.to_double(numeral, 10, &error) == 12345.6 && error == 0,
+              "str.to_double(%*.*s, 10)=%g error %d %s",
+              10, 10, numeral, str.to_double(numeral, 10, &error),
+              error, strerror(error));
+    // hex zero terminated
+    strcpy(numeral, "0x123");
+    error = 0;
+    int64_t i64 = 0;
+    str.to_int64(&i64, numeral, 0, &error);
+    assertion(i64 == 0x123 && error == 0,
+              "str.to_int64(%*.*s, 0)=%lld error %d %s",
+              6, 6, numeral, i64, error, strerror(error));
+    // hex fixed width not zero terminated:
+    numeral[5] = '4';
+    error = 0;
+    i64 = 0;
+    str.to_int64(&i64, numeral, 5, &error);
+    assertion(i64 == 0x123 && error == 0,
+              "str.to_int64(%*.*s, 5)=%lld error %d %s",
+              6, 6, numeral, i64, error, strerror(error));
+
+    // octal zero terminated and not-terminated:
+    strcpy(numeral, "0123");
+    error = 0;
+    i64 = 0;
+    str.to_int64(&i64, numeral, 0, &error);
+    assertion(i64 == 0123 && error == 0,
+              "str.to_int64(%*.*s, 0)=%lld error %d %s",
+              4, 4, numeral, i64, error, strerror(error));
+    // octal fixed width not zero terminated:
+    numeral[4] = '4';
+    error = 0;
+    i64 = 0;
+    str.to_int64(&i64, numeral, 4, &error);
+    assertion(i64 == 0123 && error == 0,
+              "str.to_int64(%*.*s, 4)=%lld error %d %s",
+              5, 5, numeral, i64, error, strerror(error));
+    // decimal zero terminated
+    strcpy(numeral, "123");
+    error = 0;
+    i64 = 0;
+    str.to_int64(&i64, numeral, 0, &error);
+    assertion(i64 == 123 && error == 0,
+              "str.to_int64(%*.*s, 0)=%lld error %d %s",
+              3, 3, numeral, i64, error, strerror(error));
+    // decimal fixed width not zero terminated:
+    numeral[3] = '4';
+    error = 0;
+    i64 = 0;
+    str.to_int64(&i64, numeral, 3, &error);
+    assertion(i64 == 123 && error == 0,
+              "str.to_int64(%*.*s, 3)=%lld error %d %s",
+              4, 4, numeral, i64, error, strerror(error));
+}
+
+// tiny bump allocator arena (see README) to test strbuf on heap w/o realloc
+
+static uint8_t nposix_test_arena_memory[4096];
+static int_t nposix_test_arena_top;
+
+static void* nposix_test_arena_alloc(int_t bytes) {
+    bytes = (bytes + 15) & ~15;
+    void* p = null;
+    if (nposix_test_arena_top + bytes <= countof(nposix_test_arena_memory)) {
+        p = nposix_test_arena_memory + nposix_test_arena_top;
+        nposix_test_arena_top += bytes;
+    }
+    return p;
+}
+
+static void* nposix_test_arena_free(void* data) { (void)data; return null; }
+
+static void nposix_test_strbuf() {
+    strbuf_t sb;
+    strbuf.init(&sb, null);
+    swear(sb.bytes == 0 && sb.data[0] == 0);
+    swear(strbuf.append_str(&sb, "abc") == 0);
+    swear(strbuf.append_char(&sb, ':') == 0);
+    swear(strbuf.append_int64(&sb, -1234567) == 0);
+    swear(strbuf.append_char(&sb, ':') == 0);
+    swear(strbuf.append_int64(&sb, INT64_MIN) == 0);
+    swear(strbuf.append_char(&sb, ':') == 0);
+    swear(strbuf.append_uint64(&sb, UINT64_MAX) == 0);
+    assertion(strcmp(sb.data,
+              "abc:-1234567:-9223372036854775808:18446744073709551615") == 0,
+              "\"%s\"", sb.data);
+    strbuf.clear(&sb);
+    const double d[] = { 0, 1, -42, 0.1, 1.0 / 3, 1e300, -2.5e-300 };
+    for (int i = 0; i < countof(d); i++) {
+        strbuf.clear(&sb);
+        swear(strbuf.append_double(&sb, d[i]) == 0);
+        assertion(strtod(sb.data, null) == d[i], "%.17g \"%s\"", d[i], sb.data);
+    }
+    strbuf.clear(&sb);
+    strbuf.append_double(&sb, 0.1);
+    assertion(strcmp(sb.data, "0.1") == 0, "\"%s\"", sb.data);
+    static const struct { double v; const char* s; } shortest[] = {
+        { 1.5, "1.5" }, { -0.001, "-0.001" }, { 1e-5, "1e-05" },
+        { 1e300, "1e+300" }, { 5e-324, "5e-324" },
+        { 1.0 / 3, "0.3333333333333333" }, { 1e16 + 2, "10000000000000002" },
+        { 1e17 + 16, "1.0000000000000002e+17" },
+        { 2.2250738585072014e-308, "2.2250738585072014e-308" },
+        { 1.7976931348623157e308, "1.7976931348623157e+308" },
+        { 123.456, "123.456" }, { 0.0001, "0.0001" }
+    };
+    for (int i = 0; i < countof(shortest); i++) {
+        strbuf.clear(&sb);
+        strbuf.append_double(&sb, shortest[i].v);
+        assertion(strcmp(sb.data, shortest[i].s) == 0, "\"%s\" expected \"%s\"",
+                  sb.data, shortest[i].s);
+    }
+    // random bit patterns: round trip, not longer than shortest "%.*g",
+    // and Grisu3 either agrees with the fallback or gives up:
+    uint64_t seed = 1;
+    int gave_up = 0;
+    for (int i = 0; i < 100 * 1000; i++) {
+        seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+        double v;
+        uint64_t bits = seed ^ (seed >> 29);
+        memcpy(&v, &bits, sizeof(v));
+        if (isnan(v) || isinf(v) || v == 0) { continue; }
+        strbuf.clear(&sb);
+        swear(strbuf.append_double(&sb, v) == 0);
+        assertion(strtod(sb.data, null) == v, "%.17g \"%s\"", v, sb.data);
+        char d0[24], d1[24];
+        int e0 = 0, e1 = 0;
+        const int n0 = strbuf_grisu3(fabs(v), d0, &e0);
+        const int n1 = strbuf_shortest_fallback(fabs(v), d1, &e1);
+        if (n0 == 0) {
+            gave_up++;
+        } else {
+            assertion(n0 == n1 && e0 == e1 && memcmp(d0, d1, n0) == 0,
+                      "%.17g %.*s %d %.*s %d", v, n0, d0, e0, n1, d1, e1);
+        }
+    }
+    swear(gave_up < 1000);
+    strbuf.clear(&sb);
+    strbuf.append_double(&sb, -nan(""));
+    strbuf.append_double(&sb, -1.0 / 0.0);
+    assertion(strcmp(sb.data, "nan-inf") == 0, "\"%s\"", sb.data);
+    // outgrow inline buffer and then some:
+    strbuf.clear(&sb);
+    for (int i = 0; i < 1000; i++) { swear(strbuf.append_int64(&sb, i % 10) == 0); }
+    swear(sb.bytes == 1000 && sb.capacity >= 1000);
+    swear(sb.data != sb.inline_buffer);
+    for (int i = 0; i < 1000; i++) { swear(sb.data[i] == '0' + i % 10); }
+    swear(sb.data[1000] == 0);
+    span_t s = strbuf.span(&sb);
+    swear(s.data == sb.data && s.bytes == 1000);
+    strbuf.dispose(&sb);
+    // arena backed builder:
+    heap_if arena = {
+        .alloc = nposix_test_arena_alloc,
+        .realloc = null, // intentionally not implemented
+        .free = nposix_test_arena_free,
+        .allocate = null
+    };
+    nposix_test_arena_top = 0;
+    strbuf.init(&sb, &arena);
+    span_t hello = { "hello world", 5 };
+    int n = 0;
+    while (strbuf.append_span(&sb, hello) == 0) { n++; }
+    swear(n > strbuf_inline_bytes / 5 && sb.bytes == n * 5);
+    swear(mem.equals(sb.data + sb.bytes - 5, "hello", 5) && sb.data[sb.bytes] == 0);
+    strbuf.dispose(&sb);
+}
+
+static int nposix_test_matcher_reference(const char* patterns[], int n,
+        const char* s, int_t bytes, int_t *at) {
+    for (int_t i = 0; i < bytes; i++) {
+        for (int p = 0; p < n; p++) {
+            int_t k = strlen(patterns[p]);
+            if (k <= bytes - i && memcmp(s + i, patterns[p], k) == 0) {
+                *at = i;
+                return p;
+            }
+        }
+    }
+    return -1;
+}
+
+static void nposix_test_matcher() {
+    static const char* patterns[] = {
+        "error", "warn", "timeout", "refused", "panic", "oom", "fatal",
+        "segfault", "abort", "denied", "overflow", "deadlock", "retry",
+        "corrupt", "unreachable", "reset", "broken pipe", "disk full",
+        "no space", "killed", "throttled", "unavailable", "rejected",
+        "expired", "invalid", "mismatch", "stale", "lost", "dropped",
+        "exceeded", "unknown", "e", "ab", "b"
+    };
+    const int np = countof(patterns);
+    const char* alphabet = "abcdefghijklmnoprstuw ";
+    const int na = (int)strlen(alphabet);
+    char text[256];
+    uint64_t seed = random_generator.initial_seed;
+    for (int n = 1; n <= np; n++) { // n <= 8 Teddy, n > 8 Aho-Corasick
+        str_matcher_t* m = str.matcher_compile(patterns + np - n, n);
+        swear(m != null);
+        for (int i = 0; i < 200; i++) {
+            int_t bytes = random_generator.next_seeded_uint32(&seed) %
+                          countof(text);
+            for (int_t j = 0; j < bytes; j++) {
+                int32_t r = random_generator.next_seeded_uint32(&seed);
+                text[j] = alphabet[r % na];
+            }
+            int_t at = -1;
+            int_t expected_at = -1;
+            int found = str.matcher_find(m, text, bytes, &at);
+            int expected = nposix_test_matcher_reference(patterns + np - n,
+                                n, text, bytes, &expected_at);
+            assertion(found == expected && at == expected_at,
+                      "n=%d found=%d at=%d expected=%d at=%d \"%.*s\"",
+                      n, found, (int)at, expected, (int)expected_at,
+                      (int)bytes, text);
+        }
+        str.matcher_dispose(m);
+    }
+    // crude benchmark: single pass versus str.contains() per pattern
+    enum { lines = 2000, line_bytes = 120 };
+    static char log[lines][line_bytes + 1];
+    for (int i = 0; i < lines; i++) {
+        for (int j = 0; j < line_bytes; j++) {
+            int32_t r = random_generator.next_seeded_uint32(&seed);
+            log[i][j] = alphabet[r % na];
+        }
+        log[i][line_bytes] = 0;
+    }
+    const int n = np - 3; // without "e", "ab", "b" which match everything
+    str_matcher_t* m = str.matcher_compile(patterns, n);
+    int matched = 0;
+    double time = process_clock.time();
+    for (int i = 0; i < lines; i++) {
+        matched += str.matcher_find(m, log[i], line_bytes, null) >= 0;
+    }
+    double matcher_time = process_clock.time() - time;
+    int contained = 0;
+    time = process_clock.time();
+    for (int i = 0; i < lines; i++) {
+        bool found = false;
+        for (int p = 0; p < n && !found; p++) {
+            found = str.contains(log[i], patterns[p]);
+        }
+        contained += found;
+    }
+    double contains_time = process_clock.time() - time;
+    swear(matched == contained);
+    (void)matcher_time; (void)contains_time; // only traced in debug builds
+    traceln("%d patterns x %d lines: matcher %.3fms str.contains %.3fms",
+            n, lines, matcher_time * 1000, contains_time * 1000);
+    str.matcher_dispose(m);
+}
+
+static void nposix_test_glob() {
+    static const struct {
+        const char* pattern;
+        const char* s;
+        bool match;
+    } tests[] = {
+        { "foo.*.bar",  "foo.x.bar",     true  },
+        { "foo.*.bar",  "foo..bar",      true  },
+        { "foo.*.bar",  "foo.bar",       false },
+        { "foo.*.bar",  "foo.a.b.bar",   true  },
+        { "[a-z]?",     "x1",            true  },
+        { "[a-z]?",     "X1",            false },
+        { "[a-z]?",     "x",             false },
+        { "[!a-z]*",    "Xyz",           true  },
+        { "[^a-z]*",    "xyz",           false },
+        { "[]x]",       "]",             true  },
+        { "a\\*b",      "a*b",           true  },
+        { "a\\*b",      "axb",           false },
+        { "*",          "",              true  },
+        { "",           "",              true  },
+        { "",           "a",             false },
+        { "**a**",      "bab",           true  },
+        { "*a*b*c*",    "xxaxxbxxcxx",   true  },
+        { "*a*b*c*",    "xxaxxcxxbxx",   false },
+        // classic backtracking blowup for recursive matchers:
+        { "a*a*a*a*a*a*a*a*b", "aaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaaa", false },
+    };
+    for (int i = 0; i < countof(tests); i++) {
+        str_glob_t g;
+        swear(str.glob_compile(&g, tests[i].pattern) == 0);
+        bool match = str.glob_match(&g, tests[i].s, strlen(tests[i].s));
+        assertion(match == tests[i].match, "\"%s\" \"%s\" %d",
+                  tests[i].pattern, tests[i].s, match);
+    }
+    str_glob_t g;
+    swear(str.glob_compile(&g, "[a-z") == EINVAL);
+    swear(str.glob_compile(&g, "abc\\") == EINVAL);
+    char long_pattern[80] = {};
+    mem.fill(long_pattern, '?', 64);
+    swear(str.glob_compile(&g, long_pattern) == E2BIG);
+    long_pattern[63] = 0;
+    swear(str.glob_compile(&g, long_pattern) == 0);
+    // not zero terminated span:
+    swear(str.glob_compile(&g, "ab*") == 0);
+    swear(str.glob_match(&g, "abXYZ", 2));
+    swear(!str.glob_match(&g, "aXbYZ", 3));
+}
+
+typedef struct {
+    int64_t fields[4];
+    int64_t records[4];
+    int64_t sum[4];
+} nposix_test_csv_counts_t;
+
+static void nposix_test_csv_parse(void* that, int part, csv_reader_t* r) {
+    nposix_test_csv_counts_t* counts = (nposix_test_csv_counts_t*)that;
+    csv_field_t f;
+    while (csv.next(r, &f)) {
+        counts->fields[part]++;
+        counts->records[part] += f.last;
+        if (!f.quoted && f.span.bytes > 0) {
+            errno_t e = 0;
+            int64_t v = 0;
+            str.to_int64(&v, f.span.data, (int)f.span.bytes, &e);
+            if (e == 0) { counts->sum[part] += v; }
+        }
+    }
+}
+
+typedef struct {
+    mutex_t lock;
+    event_t changed;
+    waitable_t request; // auto reset
+    waitable_t reply;   // auto reset
+    waitable_t orphan;  // auto reset, its waiter gets killed
+    int64_t balance[2]; // consistent when sum is zero
+} nposix_test_shared_t;
+
+static nposix_test_shared_t* nposix_test_shared;
+static int nposix_test_owner_died_calls;
+
+static bool nposix_test_owner_died(mutex_t* m) {
+    nposix_test_shared_t* s = nposix_test_shared;
+    swear(m == &s->lock);
+    nposix_test_owner_died_calls++;
+    s->balance[1] = -s->balance[0]; // repair
+    return true;
+}
+
+static void nposix_test_shared_child(nposix_test_shared_t* s, int rounds) {
+    for (int i = 0; i < rounds; i++) {
+        waitable.wait(&s->request);
+        mutex.lock(&s->lock);
+        s->balance[0]++;
+        s->balance[1]--;
+        mutex.unlock(&s->lock);
+        waitable.set(&s->reply);
+    }
+    waitable.wait(&s->request);
+    mutex.lock(&s->lock);
+    s->balance[0] += 5;
+    _exit(0); // dies holding the lock in the middle of an update
+}
+
+static void nposix_test_shared_locks() {
+    char filename[4096] = {};
+    strcpy(filename, "shmtXXXXXX");
+    int fd = mkstemp(filename);
+    swear(fd >= 0);
+    swear(ftruncate(fd, sizeof(nposix_test_shared_t)) == 0);
+    close(fd);
+    void* data = null;
+    int_t bytes = 0;
+    swear(memmap.file_readwrite(filename, 0, sizeof(nposix_test_shared_t),
+                                &data, &bytes) == 0);
+    nposix_test_shared_t* s = (nposix_test_shared_t*)data;
+    nposix_test_shared = s;
+    mutex.init_shared(&s->lock);
+    event.init_shared(&s->changed);
+    waitable.init_shared(&s->request, false, false);
+    waitable.init_shared(&s->reply, false, false);
+    mutex.lock(&s->lock);
+    swear(event.timed_wait(&s->changed, &s->lock, 0.001) == ETIMEDOUT);
+    mutex.unlock(&s->lock);
+    const int rounds = 1000;
+    pid_t pid = fork();
+    swear(pid >= 0);
+    if (pid == 0) { nposix_test_shared_child(s, rounds); }
+    double time = process_clock.time_since_epoch();
+    for (int i = 0; i < rounds; i++) {
+        waitable.set(&s->request);
+        waitable.wait(&s->reply);
+    }
+    time = process_clock.time_since_epoch() - time;
+    traceln("cross process round trip %.1fus", time * 1e6 / rounds);
+    (void)time;
+    waitable.set(&s->request);
+    int status = 0;
+    swear(waitpid(pid, &status, 0) == pid && status == 0);
+#if !defined(__APPLE__) // no robust mutexes
+    mutex.owner_died = nposix_test_owner_died;
+    mutex.lock(&s->lock);
+    swear(nposix_test_owner_died_calls == 1);
+    swear(s->balance[0] == rounds + 5 && s->balance[0] + s->balance[1] == 0);
+    mutex.unlock(&s->lock);
+    swear(mutex.try_lock(&s->lock) == 0); // consistent again
+    mutex.unlock(&s->lock);
+    swear(nposix_test_owner_died_calls == 1);
+    mutex.owner_died = null;
+#endif
+    // waiter killed inside wait() leaves a stale count behind:
+    waitable.init_shared(&s->orphan, false, false);
+    pid = fork();
+    swear(pid >= 0);
+    if (pid == 0) { waitable.wait(&s->orphan); _exit(0); }
+    while (atomic_load(waitable_state(&s->orphan)) < waitable_waiter) {
+        sched_yield();
+    }
+    swear(kill(pid, SIGKILL) == 0);
+    swear(waitpid(pid, &status, 0) == pid && WIFSIGNALED(status));
+    swear(atomic_load(waitable_state(&s->orphan)) == waitable_waiter);
+    for (int i = 0; i < 3; i++) { // still usable
+        waitable.set(&s->orphan);
+        swear(waitable.is_set(&s->orphan));
+        waitable.wait(&s->orphan);
+        swear(waitable.timed_wait(&s->orphan, 0.001) == ETIMEDOUT);
+    }
+    waitable.dispose(&s->orphan);
+    waitable.dispose(&s->request);
+    waitable.dispose(&s->reply);
+    event.dispose(&s->changed);
+    mutex.dispose(&s->lock);
+    nposix_test_shared = null;
+    memmap.file_unmap(data, bytes);
+    unlink(filename);
+}
+
+typedef struct {
+    channel_t* c;
+    int producer;
+    int count;
+} nposix_test_channel_producer_t;
+
+static void nposix_test_channel_producer(void* p) {
+    nposix_test_channel_producer_t* t = (nposix_test_channel_producer_t*)p;
+    for (int i = 0; i < t->count; i++) {
+        int32_t* r = (int32_t*)channel.reserve(t->c, 8 + (i % 5) * 4, -1);
+        r[0] = t->producer;
+        r[1] = i;
+        channel.commit(t->c, r);
+    }
+}
+
+enum { nposix_test_channel_message = 64 };
+
+static int nposix_test_channel_read(int fd, int count) { // pipe or socket
+    int64_t sum = 0;
+    uint8_t m[nposix_test_channel_message];
+    for (int i = 0; i < count; i++) {
+        int_t k = 0;
+        while (k < countof(m)) {
+            const ssize_t r = read(fd, m + k, countof(m) - k);
+            if (r <= 0) { return 1; }
+            k += r;
+        }
+        sum += m[i % countof(m)];
+    }
+    return sum == (int64_t)count * 'x' ? 0 : 1;
+}
+
+static double nposix_test_channel_stream(int fds[2], int count) {
+    pid_t pid = fork();
+    swear(pid >= 0);
+    if (pid == 0) { close(fds[1]); _exit(nposix_test_channel_read(fds[0], count)); }
+    close(fds[0]);
+    uint8_t m[nposix_test_channel_message];
+    memset(m, 'x', countof(m));
+    double time = process_clock.time_since_epoch();
+    for (int i = 0; i < count; i++) {
+        swear(write(fds[1], m, countof(m)) == countof(m));
+    }
+    int status = 0;
+    swear(waitpid(pid, &status, 0) == pid && status == 0);
+    time = process_clock.time_since_epoch() - time;
+    close(fds[1]);
+    return time * 1e9 / count;
+}
+
+static double nposix_test_channel_process(int count) {
+    channel_t c;
+    swear(channel.create(&c, 1024 * 1024) == 0);
+    pid_t pid = fork();
+    swear(pid >= 0);
+    if (pid == 0) {
+        int64_t sum = 0;
+        for (int i = 0; i < count; i++) {
+            int_t bytes = 0;
+            uint8_t* m = (uint8_t*)channel.receive(&c, &bytes, -1);
+            sum += m[i % nposix_test_channel_message];
+            if (i % 16 == 15 || i == count - 1) { channel.release(&c, m); }
+        }
+        _exit(sum == (int64_t)count * 'x' ? 0 : 1);
+    }
+    enum { batch = 16 };
+    double time = process_clock.time_since_epoch();
+    for (int i = 0; i < count; i += batch) {
+        void* records[batch];
+        const int n = count - i < batch ? count - i : batch;
+        for (int j = 0; j < n; j++) {
+            records[j] = channel.reserve(&c, nposix_test_channel_message, -1);
+            memset(records[j], 'x', nposix_test_channel_message);
+        }
+        channel.commit_batch(&c, records, n);
+    }
+    int status = 0;
+    swear(waitpid(pid, &status, 0) == pid && status == 0);
+    time = process_clock.time_since_epoch() - time;
+    channel.close(&c);
+    return time * 1e9 / count;
+}
+
+static void nposix_test_channel() {
+    channel_t c;
+    swear(channel.create(&c, 4096) == 0 && c.bytes == 4096);
+    int_t bytes = 0;
+    swear(channel.receive(&c, &bytes, 0.001) == null);
+    for (int i = 0; i < 4; i++) { // 4 * (8 + 1016) fill the ring exactly
+        channel.commit(&c, channel.reserve(&c, 1016, 0));
+    }
+    swear(channel.reserve(&c, 1, 0) == null);
+    char* m = null;
+    for (int i = 0; i < 4; i++) {
+        m = (char*)channel.receive(&c, &bytes, 0);
+        swear(m != null && bytes == 1016);
+    }
+    channel.release(&c, m); // all four at once
+    swear(channel.send(&c, "hello", 5, 0) == 0);
+    m = (char*)channel.receive(&c, &bytes, 0);
+    swear(m != null && bytes == 5 && memcmp(m, "hello", 5) == 0);
+    channel.release(&c, m);
+    for (int i = 0; i < 1000; i++) { // wraps around with padding
+        char s[256];
+        const int k = (i * 37) % countof(s);
+        for (int j = 0; j < k; j++) { s[j] = (char)(i + j); }
+        swear(channel.send(&c, s, k, 0) == 0);
+        m = (char*)channel.receive(&c, &bytes, 0);
+        swear(m != null && bytes == k && memcmp(m, s, k) == 0);
+        channel.release(&c, m);
+    }
+    int fd = dup(c.fd);
+    channel_t a;
+    swear(channel.attach(&a, fd) == 0 && a.bytes == c.bytes);
+    swear(channel.send(&a, "abc", 3, 0) == 0);
+    m = (char*)channel.receive(&c, &bytes, 0);
+    swear(m != null && bytes == 3 && memcmp(m, "abc", 3) == 0);
+    channel.release(&c, m);
+    channel.close(&a);
+    channel.close(&c);
+    // multiple producers, batched release
+    swear(channel.create(&c, 64 * 1024) == 0);
+    enum { producers = 4, count = 20000 };
+    nposix_test_channel_producer_t p[producers];
+    thread_t t[producers];
+    for (int i = 0; i < producers; i++) {
+        p[i] = (nposix_test_channel_producer_t){ &c, i, count };
+        threads.start(&t[i], nposix_test_channel_producer, &p[i], 0, false);
+    }
+    int next[producers] = {};
+    for (int i = 0; i < producers * count; i++) {
+        int32_t* r = (int32_t*)channel.receive(&c, &bytes, -1);
+        swear(0 <= r[0] && r[0] < producers && r[1] == next[r[0]]);
+        swear(bytes == 8 + (r[1] % 5) * 4);
+        next[r[0]]++;
+        if (i % 8 == 7) { channel.release(&c, r); }
+    }
+    for (int i = 0; i < producers; i++) { threads.join(t[i]); }
+    channel.close(&c);
+    // other process: channel vs pipe vs Unix socket
+    const int messages = 100 * 1000;
+    double ns_channel = nposix_test_channel_process(messages);
+    int fds[2];
+    swear(pipe(fds) == 0);
+    double ns_pipe = nposix_test_channel_stream(fds, messages);
+    swear(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    double ns_socket = nposix_test_channel_stream(fds, messages);
+    traceln("%d bytes messages to other process channel %.1fns "
+            "pipe %.1fns socket %.1fns", nposix_test_channel_message,
+            ns_channel, ns_pipe, ns_socket);
+    (void)ns_channel; (void)ns_pipe; (void)ns_socket;
+}
+
+enum { nposix_test_shard_keys = 1024 };
+
+typedef struct {
+    shard_runtime_t* rt;
+    int64_t value[nposix_test_shard_keys]; // owned by the shard thread
+} nposix_test_shard_data_t;
+
+static bool nposix_test_pinned_to(int cpu);
+
+static void* nposix_test_shard_init(int shard, void* context) {
+    int cpu[shard_max]; // shard runs pinned to its processor
+    const int n = threads.affinity(cpu, shard_max);
+    swear(nposix_test_pinned_to(cpu[shard % (n < shard_max ? n : shard_max)]));
+    nposix_test_shard_data_t* d = (nposix_test_shard_data_t*)
+        heap.alloc(sizeof(nposix_test_shard_data_t));
+    swear(d != null);
+    mem.zero(d, sizeof(*d));
+    d->rt = (shard_runtime_t*)context;
+    return d;
+}
+
+static void nposix_test_shard_fini(int shard, void* data, void* context) {
+    nposix_test_shard_data_t* d = (nposix_test_shard_data_t*)data;
+    swear(shard_runtime.current(d->rt) == shard && d->rt == context);
+    heap.free(d);
+}
+
+static void* nposix_test_shard_increment(void* data, void* arg) {
+    nposix_test_shard_data_t* d = (nposix_test_shard_data_t*)data;
+    return (void*)(intptr_t)++d->value[(uintptr_t)arg % nposix_test_shard_keys];
+}
+
+static void* nposix_test_shard_get(void* data, void* arg) {
+    nposix_test_shard_data_t* d = (nposix_test_shard_data_t*)data;
+    return (void*)(intptr_t)d->value[(uintptr_t)arg % nposix_test_shard_keys];
+}
+
+static void* nposix_test_shard_fan_out(void* data, void* arg) {
+    nposix_test_shard_data_t* d = (nposix_test_shard_data_t*)data;
+    const int self = shard_runtime.current(d->rt);
+    const int count = (int)(intptr_t)arg;
+    for (int i = 0; i < count; i++) {
+        for (int s = 0; s < d->rt->shards; s++) {
+            if (s != self) {
+                shard_runtime.submit_to(d->rt, s, nposix_test_shard_increment,
+                                        (void*)(uintptr_t)7, null);
+            }
+        }
+    }
+    int64_t sum = 0; // queues are FIFO: get() follows the increments
+    for (int s = 0; s < d->rt->shards; s++) {
+        if (s != self) {
+            shard_future_t f;
+            shard_runtime.submit_to(d->rt, s, nposix_test_shard_get,
+                                    (void*)(uintptr_t)7, &f);
+            sum += (intptr_t)shard_runtime.wait(d->rt, &f);
+        }
+    }
+    return (void*)(intptr_t)sum;
+}
+
+static void* nposix_test_shard_ask(void* data, void* arg) {
+    nposix_test_shard_data_t* d = (nposix_test_shard_data_t*)data;
+    const int next = (shard_runtime.current(d->rt) + 1) % d->rt->shards;
+    shard_future_t f;
+    shard_runtime.submit_to(d->rt, next, nposix_test_shard_get, arg, &f);
+    return shard_runtime.wait(d->rt, &f);
+}
+
+static void* nposix_test_shard_slow(void* data, void* arg) {
+    const double until = process_clock.time_since_epoch() + 0.002;
+    while (process_clock.time_since_epoch() < until) { sched_yield(); }
+    return nposix_test_shard_get(data, arg);
+}
+
+static void* nposix_test_shard_busy(void* data, void* arg) {
+    // waits for another shard while own queues and inbox keep filling:
+    // the wait executes them in a nested poll
+    nposix_test_shard_data_t* d = (nposix_test_shard_data_t*)data;
+    shard_future_t f;
+    shard_runtime.submit_to(d->rt, 1, nposix_test_shard_slow, arg, &f);
+    return shard_runtime.wait(d->rt, &f);
+}
+
+static void* nposix_test_shard_burst(void* data, void* arg) {
+    nposix_test_shard_data_t* d = (nposix_test_shard_data_t*)data;
+    const int count = (int)(intptr_t)arg;
+    shard_runtime.submit_to(d->rt, 0, nposix_test_shard_busy,
+                            (void*)(uintptr_t)9, null);
+    for (int i = 0; i < count; i++) { // same batch as busy and after
+        shard_runtime.submit_to(d->rt, 0, nposix_test_shard_increment,
+                                (void*)(uintptr_t)9, null);
+    }
+    shard_future_t f; // queue 2 -> 0 is FIFO: after all increments
+    shard_runtime.submit_to(d->rt, 0, nposix_test_shard_get,
+                            (void*)(uintptr_t)9, &f);
+    return shard_runtime.wait(d->rt, &f);
+}
+
+static int64_t nposix_test_shard_filled(int keys, int shards, int index) {
+    // increments of value[index] when keys 0..keys - 1 were spread
+    const int per_shard = keys / shards;
+    return (per_shard - index + nposix_test_shard_keys - 1) /
+           nposix_test_shard_keys;
+}
+
+static void nposix_test_shard_runtime() {
+    static shard_runtime_t rt;
+    enum { shards = 4, keys = 10000 };
+    swear(shard_runtime.start(&rt, shards, nposix_test_shard_init,
+                              nposix_test_shard_fini, &rt) == 0);
+    swear(shard_runtime.current(&rt) == -1);
+    for (int k = 0; k < keys; k++) { // key k lives on shard k % shards
+        shard_runtime.submit_to(&rt, k % shards, nposix_test_shard_increment,
+                                (void*)(uintptr_t)(k / shards), null);
+    }
+    for (int s = 0; s < shards; s++) {
+        shard_future_t f;
+        shard_runtime.submit_to(&rt, s, nposix_test_shard_get,
+                                (void*)(uintptr_t)1, &f);
+        const int64_t v = (intptr_t)shard_runtime.wait(&rt, &f);
+        swear(v == nposix_test_shard_filled(keys, shards, 1));
+    }
+    const int rounds = 10000;
+    double time = process_clock.time_since_epoch();
+    for (int i = 0; i < rounds; i++) {
+        shard_future_t f;
+        shard_runtime.submit_to(&rt, 1, nposix_test_shard_increment,
+                                (void*)(uintptr_t)3, &f);
+        swear((intptr_t)shard_runtime.wait(&rt, &f) ==
+              i + 1 + nposix_test_shard_filled(keys, shards, 3));
+    }
+    double round_trip = (process_clock.time_since_epoch() - time) / rounds;
+    const int count = 20000;
+    time = process_clock.time_since_epoch();
+    shard_future_t f;
+    shard_runtime.submit_to(&rt, 0, nposix_test_shard_fan_out,
+                            (void*)(intptr_t)count, &f);
+    const int64_t sum = (intptr_t)shard_runtime.wait(&rt, &f);
+    double cross = (process_clock.time_since_epoch() - time) /
+                   (count * (shards - 1));
+    const int64_t seven = count + nposix_test_shard_filled(keys, shards, 7);
+    swear(sum == (shards - 1) * seven);
+    shard_runtime.submit_to(&rt, 2, nposix_test_shard_ask,
+                            (void*)(uintptr_t)7, &f);
+    swear((intptr_t)shard_runtime.wait(&rt, &f) == seven);
+    // shard 0 re-enters its poll while busy: from a shard queue...
+    const int burst = 1000;
+    shard_runtime.submit_to(&rt, 2, nposix_test_shard_burst,
+                            (void*)(intptr_t)burst, &f);
+    swear((intptr_t)shard_runtime.wait(&rt, &f) ==
+          burst + nposix_test_shard_filled(keys, shards, 9));
+    // ...and from the inbox, which grows while the outer pass runs it
+    for (int i = 0; i < burst; i++) {
+        if (i % 100 == 0) {
+            shard_runtime.submit_to(&rt, 0, nposix_test_shard_busy,
+                                    (void*)(uintptr_t)10, null);
+        }
+        shard_runtime.submit_to(&rt, 0, nposix_test_shard_increment,
+                                (void*)(uintptr_t)10, null);
+    }
+    shard_runtime.submit_to(&rt, 0, nposix_test_shard_get,
+                            (void*)(uintptr_t)10, &f);
+    swear((intptr_t)shard_runtime.wait(&rt, &f) ==
+          burst + nposix_test_shard_filled(keys, shards, 10));
+    shard_runtime.stop(&rt);
+    traceln("%d shards round trip %.1fus cross shard message %.1fns "
+            "%.1f messages per batch", shards, round_trip * 1e6,
+            cross * 1e9, (double)rt.messages / rt.batches);
+    (void)round_trip; (void)cross;
+}
+
+static errno_t nposix_test_line_index_load(const char* filename,
+        const uint8_t* data, int_t bytes) {
+    FILE* f = fopen(filename, "wb");
+    swear(f != null);
+    swear(bytes == 0 || fwrite(data, bytes, 1, f) == 1);
+    swear(fclose(f) == 0);
+    memmap_line_index_t ix;
+    errno_t r = memmap.line_index_load(&ix, filename);
+    if (r == 0) { memmap.line_index_dispose(&ix); }
+    return r;
+}
+
+static void nposix_test_line_index_corrupt(const char* filename) {
+    // truncated or corrupt index files must be rejected with EINVAL
+    void* data = null;
+    int_t bytes = 0;
+    swear(memmap.file_readonly(filename, &data, &bytes) == 0);
+    uint8_t* good = (uint8_t*)heap.alloc(bytes);
+    uint8_t* bad = (uint8_t*)heap.alloc(bytes);
+    swear(good != null && bad != null);
+    mem.copy(good, data, bytes);
+    memmap.file_unmap(data, bytes);
+    memmap_line_index_header_t h;
+    mem.copy(&h, good, sizeof(h));
+    swear(h.skips > 1 && h.deltas_bytes > 0);
+    const int_t truncated[] = { 0, sizeof(h) - 1, sizeof(h), sizeof(h) + 8,
+                                bytes - h.deltas_bytes, bytes - 1 };
+    for (int i = 0; i < countof(truncated); i++) {
+        swear(nposix_test_line_index_load(filename, good, truncated[i]) ==
+              EINVAL);
+    }
+    const int64_t fields[][2] = {
+        { offsetof(memmap_line_index_header_t, bytes), -1 },
+        { offsetof(memmap_line_index_header_t, bytes), 100 },
+        { offsetof(memmap_line_index_header_t, lines), INT64_MAX },
+        { offsetof(memmap_line_index_header_t, lines), -64 },
+        { offsetof(memmap_line_index_header_t, checkpoints),
+          h.checkpoints + 1 },
+        { offsetof(memmap_line_index_header_t, skips), INT64_MAX / 8 },
+        { offsetof(memmap_line_index_header_t, deltas_bytes), INT64_MAX },
+        { sizeof(h), 1 }, // skip[0] start of line 0 is 0
+        { sizeof(h) + 16, h.bytes + 1 }, // skip[2] past the data
+        { sizeof(h) + 16, 1 }, // skip[2] before preceding line start
+        { sizeof(h) + 24, 0 }  // skip[3] position in deltas[]
+    };
+    for (int i = 0; i < countof(fields); i++) {
+        mem.copy(bad, good, bytes);
+        mem.copy(bad + fields[i][0], &fields[i][1], sizeof(int64_t));
+        swear(nposix_test_line_index_load(filename, bad, bytes) == EINVAL);
+    }
+    const int_t deltas = bytes - h.deltas_bytes;
+    swear(good[deltas] & 0x80); // first delta takes 2 bytes
+    const uint8_t varints[][2] = { // position and byte
+        { 0, 0x00 }, // zero delta
+        { 0, 0x7F }, // ends 2 byte varint early: skip[] positions disagree
+    };
+    for (int i = 0; i < countof(varints); i++) {
+        mem.copy(bad, good, bytes);
+        bad[deltas + varints[i][0]] = varints[i][1];
+        swear(nposix_test_line_index_load(filename, bad, bytes) == EINVAL);
+    }
+    mem.copy(bad, good, bytes);
+    bad[bytes - 1] |= 0x80; // unterminated last varint
+    swear(nposix_test_line_index_load(filename, bad, bytes) == EINVAL);
+    mem.fill(bad + deltas, 0x81, h.deltas_bytes); // never terminated
+    swear(nposix_test_line_index_load(filename, bad, bytes) == EINVAL);
+    swear(nposix_test_line_index_load(filename, good, bytes) == 0);
+    heap.free(bad);
+    heap.free(good);
+}
+
+static void nposix_test_line_index() {
+    strbuf_t sb;
+    strbuf.init(&sb, null);
+    uint64_t seed = random_generator.initial_seed;
+    enum { lines = 5000 };
+    int_t* start = (int_t*)heap.alloc(lines * sizeof(int_t));
+    for (int i = 0; i < lines; i++) {
+        start[i] = sb.bytes;
+        int n = random_generator.next_seeded_uint32(&seed) % 150;
+        if (i % 7 == 0) { n = 0; } // empty lines
+        for (int j = 0; j < n; j++) { strbuf.append_char(&sb, 'a' + j % 26); }
+        if (i < lines - 1) { strbuf.append_char(&sb, '\n'); }
+    }
+    char filename[4096] = {};
+    strcpy(filename, "lndxXXXXXX");
+    int fd = mkstemp(filename);
+    swear(fd >= 0);
+    close(fd);
+    for (int threads_count = 1; threads_count <= 5; threads_count++) {
+        memmap_line_index_t ix;
+        swear(memmap.line_index(&ix, sb.data, sb.bytes, threads_count) == 0);
+        swear(ix.lines == lines);
+        if (threads_count == 3) {
+            swear(memmap.line_index_save(&ix, filename) == 0);
+            memmap.line_index_dispose(&ix);
+            swear(memmap.line_index_load(&ix, filename) == 0);
+            swear(ix.lines == lines && ix.bytes == sb.bytes);
+        }
+        for (int i = 0; i < lines; i++) {
+            span_t s = {};
+            swear(memmap.line_seek(&ix, sb.data, i, &s) == 0);
+            int_t end = i < lines - 1 ? start[i + 1] - 1 : sb.bytes;
+            assertion(s.data == sb.data + start[i] && s.bytes == end - start[i],
+                      "line %d at %lld:%lld expected %lld:%lld", i,
+                      (int64_t)(s.data - sb.data), (int64_t)s.bytes,
+                      (int64_t)start[i], (int64_t)(end - start[i]));
+        }
+        span_t s = {};
+        swear(memmap.line_seek(&ix, sb.data, lines, &s) == EINVAL);
+        memmap.line_index_dispose(&ix);
+    }
+    nposix_test_line_index_corrupt(filename);
+    unlink(filename);
+    memmap_line_index_t ix;
+    swear(memmap.line_index(&ix, "", 0, 2) == 0 && ix.lines == 0);
+    memmap.line_index_dispose(&ix);
+    swear(memmap.line_index(&ix, "a\n", 2, 1) == 0 && ix.lines == 1);
+    memmap.line_index_dispose(&ix);
+    heap.free(start);
+    strbuf.dispose(&sb);
+}
+
+typedef struct nposix_test_node_s {
+    persistent_ptr_t next;
+    uint64_t value;
+} nposix_test_node_t;
+
+static persistent_ptr_t nposix_test_persistent_list(int n) {
+    persistent_ptr_t head = {0};
+    for (int i = 0; i < n; i++) {
+        nposix_test_node_t* node = (nposix_test_node_t*)
+            persistent_heap.heap.alloc(sizeof(nposix_test_node_t));
+        swear(node != null);
+        node->next = head;
+        node->value = i;
+        head = persistent_heap.offset(node);
+        if (i % 3 == 0) { // exercise size classes and free stacks
+            void* p = persistent_heap.heap.allocate(i % 1000);
+            char* q = (char*)persistent_heap.heap.realloc(p, i % 1000 + 100);
+            swear(q != null && (i % 1000 == 0 || q[i % 1000 - 1] == 0));
+            persistent_heap.heap.free(q);
+        }
+    }
+    return head;
+}
 
-#ifndef NO_TESTS
+static void nposix_test_persistent_list_verify(int n) {
+    persistent_ptr_t o = persistent_heap.root();
+    int count = 0;
+    while (o.offset != 0) {
+        const nposix_test_node_t* node =
+            (const nposix_test_node_t*)persistent_heap.pointer(o);
+        swear(node->value == (uint64_t)(n - 1 - count));
+        o = node->next;
+        count++;
+    }
+    swear(count == n);
+}
 
-static void nposix_test_mem() {
-    enum { n = 16 };
-    uint8_t c[n] = { 0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15 };
-    uint8_t a[n]; // uninitialized
-    mem.fill(a, 0xFF, n);
-    for (int i = 0; i < n; i++) { swear(a[i] == 0xFF); }
-    mem.zero(a, n);
-    for (int i = 0; i < n; i++) { swear(a[i] == 0); }
-    mem.copy(a, c, n);
-    swear(mem.equals(a, c, n));
-    swear(mem.compare(a, c, n) == 0);
-    for (int i = 0; i < n; i++) { swear(a[i] == c[i]); }
-    a[8] = 0xFF;
-    swear(mem.compare(a, c, n) > 0);
-    swear(mem.compare(c, a, n) < 0);
-    mem.copy(a, c, n);
-    mem.move(&a[0], &a[1], n - 1);
-    for (int i = 0; i < n - 1; i++) { swear(a[i] == c[i + 1]); }
-    mem.copy(a, c, n);
-    // https://pubs.opengroup.org/onlinepubs/9699919799/
-    // "If copying takes place between objects that overlap,
-    //  the behavior is undefined"
-    mem.copy(&a[0], &a[1], n - 1);
-    for (int i = 0; i < n - 1; i++) {
-        if (a[i] != c[i+1]) { // this can happen:
-            traceln("a[%d]=%d != c[%d]=%d", i, a[i], i + 1, c[i + 1]);
+static void nposix_test_persistent_heap() {
+    char filename[4096] = {};
+    strcpy(filename, "phepXXXXXX");
+    int fd = mkstemp(filename);
+    swear(fd >= 0);
+    close(fd);
+    enum { n = 100 * 1000 };
+    const int_t reserve = 1LL << 30;
+    swear(persistent_heap.open(filename, reserve) == 0);
+    swear(persistent_heap.open(filename, reserve) == EBUSY);
+    swear(persistent_heap.root().offset == 0);
+    double rebuild = process_clock.time();
+    persistent_ptr_t head = nposix_test_persistent_list(n);
+    persistent_heap.set_root(head);
+    rebuild = process_clock.time() - rebuild;
+    swear(persistent_heap.persist() == 0);
+    // growth beyond initial mapping keeps existing pointers in place:
+    const nposix_test_node_t* first =
+        (const nposix_test_node_t*)persistent_heap.pointer(head);
+    void* large = persistent_heap.heap.alloc(16 * 1024 * 1024);
+    swear(large != null);
+    mem.fill(large, 0xA5, 16 * 1024 * 1024);
+    swear(first == persistent_heap.pointer(head) && first->value == n - 1);
+    persistent_heap.heap.free(large);
+    swear(persistent_heap.heap.alloc(reserve) == null);
+    nposix_test_heap_if(&persistent_heap.heap);
+    void* a[3];
+    swear(persistent_heap.heap.alloc_batch(reserve / 2, 3, a) == ENOMEM);
+    persistent_heap.close();
+    double restart = process_clock.time();
+    swear(persistent_heap.open(filename, reserve) == 0);
+    nposix_test_persistent_list_verify(n);
+    restart = process_clock.time() - restart;
+    traceln("rebuild %d nodes %.3fms warm restart %.3fms",
+            n, rebuild * 1000, restart * 1000);
+    (void)rebuild; (void)restart;
+    // "crash": changes after the last persist() do not survive close()
+    persistent_heap.set_root(nposix_test_persistent_list(10));
+    persistent_heap.close();
+    swear(persistent_heap.open(filename, reserve) == 0);
+    nposix_test_persistent_list_verify(n);
+    // torn header: newer slot is corrupted, older one is used
+    persistent_heap.set_root(nposix_test_persistent_list(5));
+    swear(persistent_heap.persist() == 0);
+    persistent_heap.set_root(nposix_test_persistent_list(7));
+    swear(persistent_heap.persist() == 0);
+    persistent_heap.close();
+    swear(persistent_heap.open(filename, reserve) == 0);
+    nposix_test_persistent_list_verify(7);
+    persistent_heap.close();
+    fd = open(filename, O_RDWR);
+    persistent_heap_header_t h[2];
+    swear(pread(fd, h, sizeof(h[0]), 0) == sizeof(h[0]));
+    swear(pread(fd, &h[1], sizeof(h[1]), persistent_heap_page / 2) ==
+          sizeof(h[1]));
+    const int newer = h[0].sequence > h[1].sequence ? 0 : 1;
+    const uint8_t garbage[8] = { 0xFF };
+    swear(pwrite(fd, garbage, sizeof(garbage),
+                 newer * (persistent_heap_page / 2) + 16) == 8);
+    close(fd);
+    swear(persistent_heap.open(filename, reserve) == 0);
+    nposix_test_persistent_list_verify(5);
+    persistent_heap.close();
+    fd = open(filename, O_RDWR | O_TRUNC);
+    swear(write(fd, "abc", 3) == 3);
+    close(fd);
+    swear(persistent_heap.open(filename, reserve) == EINVAL);
+    unlink(filename);
+}
+
+static void nposix_test_csv() {
+    const char* text =
+        "id,name,comment\r\n"
+        "1,\"Smith, John\",\"said \"\"hi\"\"\"\r\n"
+        "2,,\"multi\nline, with comma and a long enough tail to cross "
+        "64 bytes block boundary\"\n"
+        "3,x,\n"
+        "\n"
+        "4,\"\",last";
+    static const struct {
+        const char* s;
+        bool quoted;
+        bool last;
+    } expected[] = {
+        { "id", false, false }, { "name", false, false },
+        { "comment", false, true },
+        { "1", false, false }, { "Smith, John", true, false },
+        { "said \"hi\"", true, true },
+        { "2", false, false }, { "", false, false },
+        { "multi\nline, with comma and a long enough tail to cross "
+          "64 bytes block boundary", true, true },
+        { "3", false, false }, { "x", false, false }, { "", false, true },
+        { "", false, true },
+        { "4", false, false }, { "", true, false }, { "last", false, true },
+    };
+    csv_reader_t r;
+    csv.init(&r, text, strlen(text), ',');
+    csv_field_t f;
+    char unquoted[128];
+    int i = 0;
+    while (csv.next(&r, &f)) {
+        swear(i < countof(expected));
+        int_t n = csv.unquote(&f, unquoted);
+        assertion(n == (int_t)strlen(expected[i].s) &&
+                  mem.equals(unquoted, expected[i].s, n) &&
+                  f.quoted == expected[i].quoted && f.last == expected[i].last,
+                  "[%d] \"%.*s\" expected \"%s\"", i, (int)n, unquoted,
+                  expected[i].s);
+        i++;
+    }
+    swear(i == countof(expected));
+    csv.init(&r, "", 0, ',');
+    swear(!csv.next(&r, &f));
+    csv.init(&r, "a;b;", 4, ';'); // trailing empty field
+    swear(csv.next(&r, &f) && f.span.bytes == 1 && !f.last);
+    swear(csv.next(&r, &f) && f.span.bytes == 1 && !f.last);
+    swear(csv.next(&r, &f) && f.span.bytes == 0 && f.last);
+    swear(!csv.next(&r, &f));
+    // parallel: records with quoted newlines must not be split
+    strbuf_t sb;
+    strbuf.init(&sb, null);
+    enum { records = 20000 };
+    int64_t sum = 0;
+    for (int k = 0; k < records; k++) {
+        strbuf.append_int64(&sb, k);
+        strbuf.append_str(&sb, k % 3 == 0 ? ",\"a\n\"\"b\"\"\n,c\"\n" : ",z\n");
+        sum += k;
+    }
+    for (int parts = 1; parts <= 4; parts++) {
+        nposix_test_csv_counts_t counts = {};
+        csv.parallel(sb.data, sb.bytes, ',', parts, &counts,
+                     nposix_test_csv_parse);
+        int64_t fields = 0;
+        int64_t recs = 0;
+        int64_t total = 0;
+        for (int k = 0; k < parts; k++) {
+            fields += counts.fields[k];
+            recs += counts.records[k];
+            total += counts.sum[k];
         }
+        assertion(fields == records * 2 && recs == records && total == sum,
+                  "parts=%d fields=%lld records=%lld sum=%lld", parts,
+                  fields, recs, total);
     }
+    strbuf.dispose(&sb);
 }
 
-static void nposix_test_str() {
-    char s[4];
-    assertion(countof(s) == 4, "is countof() broken?");
-    strcpy(s, "abc");
-    assertion(str.equals("abc", "abc", 0), "compare to itself");
-    assertion(str.equals(s,     "abc", 0), "zero terminated not equal");
-    assertion(str.equals("abc", s,     0), "zero terminated not equal");
-    s[3] = 'z'; // str[] is not zero terminated anymore
-    assertion(str.equals(s,     "abc",  3), "non-zero terminated not equal");
-    assertion(str.equals("abc", s,      3), "non-zero terminated not equal");
-    assertion(str.equals(s,     "abcd", 3), "non-zero terminated not equal");
-    assertion(str.equals("abcd", s,     3), "non-zero terminated not equal");
-    assertion(!str.equals("abc", "xyz", 0), "should not be equal");
-    assertion(!str.equals("abc", "xyz", 3), "compare only 3 bytes");
-    // str_to_double
-    char numeral[16]= {};
-    // 9 bytes:      012345678
-    strcpy(numeral, "123.456E0");
-    numeral[9] = '2';
-    int error = 0;
-    assertion(str.to_double(numeral, 9, &error) == 123.456 && error == 0,
-              "str.to_double(%*.*s,  9)=%g error %d %s",
-              10, 10, numeral, str.to_double(numeral, 9, &error),
-              error, strerror(error));
-    assertion(str.to_double(numeral, 10, &error) == 12345.6 && error == 0,
-              "str.to_double(%*.*s, 10)=%g error %d %s",
-              10, 10, numeral, str.to_double(numeral, 10, &error),
-              error, strerror(error));
-    // hex zero terminated
-    strcpy(numeral, "0x123");
-    error = 0;
+static void nposix_test_json() {
+    // backslashes run crosses 64 bytes block boundary at "\\\\\"":
+    const char* text =
+        "{\"id\": 1, \"name\": \"a \\\"quoted\\\" {name}\", \"x\": -2.5e3,"
+        "  \"s\":\"0123456789\\\\\\\"\\\\\",\"v\":[true,false,null,[]],"
+        " \"u\":\"\\u00e9\\ud83d\\ude00\", \"o\": {\"deep\": [1, {\"a\":2}]}}\n"
+        "{\"id\":2}\n"
+        "[]\n";
+    const int_t bytes = (int_t)strlen(text);
+    json_index_t ix;
+    swear(json.index(&ix, text, bytes) == 0);
+    json_cursor_t c;
+    json.cursor(&c, &ix);
+    char buffer[64];
+    json_token_t t = json.next(&c);
+    swear(t.type == json_object);
+    t = json.next(&c);
+    swear(t.type == json_key && t.span.bytes == 2 &&
+          mem.equals(t.span.data, "id", 2));
+    t = json.next(&c);
     int64_t i64 = 0;
-    str.to_int64(&i64, numeral, 0, &error);
-    assertion(i64 == 0x123 && error == 0,
-              "str.to_int64(%*.*s, 0)=%lld error %d %s",
-              6, 6, numeral, i64, error, strerror(error));
-    // hex fixed width not zero terminated:
-    numeral[5] = '4';
-    error = 0;
-    i64 = 0;
-    str.to_int64(&i64, numeral, 5, &error);
-    assertion(i64 == 0x123 && error == 0,
-              "str.to_int64(%*.*s, 5)=%lld error %d %s",
-              6, 6, numeral, i64, error, strerror(error));
+    errno_t e = 0;
+    json.to_int64(&i64, &t, &e);
+    swear(t.type == json_number && i64 == 1 && e == 0);
+    t = json.next(&c);
+    swear(t.type == json_key);
+    t = json.next(&c);
+    int_t n = json.unescape(&t, buffer);
+    swear(t.type == json_string && n == 17 &&
+          mem.equals(buffer, "a \"quoted\" {name}", n));
+    t = json.next(&c);
+    t = json.next(&c);
+    swear(t.type == json_number && json.to_double(&t, &e) == -2500 && e == 0);
+    t = json.next(&c);
+    swear(t.type == json_key && t.span.data[0] == 's');
+    t = json.next(&c);
+    n = json.unescape(&t, buffer);
+    swear(t.type == json_string && n == 13 &&
+          mem.equals(buffer, "0123456789\\\"\\", n));
+    t = json.next(&c);
+    swear(t.type == json_key && t.span.data[0] == 'v');
+    static const json_type_t array[] = { json_array, json_true, json_false,
+        json_null, json_array, json_array_end, json_array_end };
+    for (int i = 0; i < countof(array); i++) {
+        t = json.next(&c);
+        assertion(t.type == array[i], "[%d] %d", i, t.type);
+    }
+    t = json.next(&c);
+    t = json.next(&c);
+    n = json.unescape(&t, buffer);
+    swear(t.type == json_string && n == 6 &&
+          mem.equals(buffer, "\xC3\xA9\xF0\x9F\x98\x80", n));
+    t = json.next(&c);
+    swear(t.type == json_key && t.span.data[0] == 'o');
+    t = json.next(&c);
+    swear(t.type == json_object);
+    json.skip(&c);
+    t = json.next(&c);
+    swear(t.type == json_object_end);
+    // newline delimited next documents:
+    swear(json.next(&c).type == json_object);
+    swear(json.next(&c).type == json_key);
+    t = json.next(&c);
+    swear(t.type == json_number && t.span.bytes == 1 && t.span.data[0] == '2');
+    swear(json.next(&c).type == json_object_end);
+    swear(json.next(&c).type == json_array);
+    swear(json.next(&c).type == json_array_end);
+    swear(json.next(&c).type == json_end);
+    json.dispose(&ix);
+    swear(json.index(&ix, "{\"a\":\"unterminated}", 18) == EINVAL);
+    json.dispose(&ix);
+    // big document: every structural must be found across blocks
+    strbuf_t sb;
+    strbuf.init(&sb, null);
+    strbuf.append_char(&sb, '[');
+    for (int i = 0; i < 1000; i++) {
+        if (i > 0) { strbuf.append_char(&sb, ','); }
+        strbuf.append_str(&sb, "{\"k\\\\\":\"v,\\\"]\",\"n\":");
+        strbuf.append_int64(&sb, i);
+        strbuf.append_char(&sb, '}');
+    }
+    strbuf.append_char(&sb, ']');
+    swear(json.index(&ix, sb.data, sb.bytes) == 0);
+    json.cursor(&c, &ix);
+    int64_t sum = 0;
+    int strings = 0;
+    for (t = json.next(&c); t.type != json_end; t = json.next(&c)) {
+        if (t.type == json_number) {
+            json.to_int64(&i64, &t, &e);
+            sum += i64;
+        }
+        strings += t.type == json_string;
+        swear(t.type != json_invalid);
+    }
+    swear(sum == 999 * 1000 / 2 && strings == 1000);
+    json.dispose(&ix);
+    strbuf.dispose(&sb);
+}
 
-    // octal zero terminated and not-terminated:
-    strcpy(numeral, "0123");
-    error = 0;
-    i64 = 0;
-    str.to_int64(&i64, numeral, 0, &error);
-    assertion(i64 == 0123 && error == 0,
-              "str.to_int64(%*.*s, 0)=%lld error %d %s",
-              4, 4, numeral, i64, error, strerror(error));
-    // octal fixed width not zero terminated:
-    numeral[4] = '4';
-    error = 0;
-    i64 = 0;
-    str.to_int64(&i64, numeral, 4, &error);
-    assertion(i64 == 0123 && error == 0,
-              "str.to_int64(%*.*s, 4)=%lld error %d %s",
-              5, 5, numeral, i64, error, strerror(error));
-    // decimal zero terminated
-    strcpy(numeral, "123");
-    error = 0;
-    i64 = 0;
-    str.to_int64(&i64, numeral, 0, &error);
-    assertion(i64 == 123 && error == 0,
-              "str.to_int64(%*.*s, 0)=%lld error %d %s",
-              3, 3, numeral, i64, error, strerror(error));
-    // decimal fixed width not zero terminated:
-    numeral[3] = '4';
-    error = 0;
-    i64 = 0;
-    str.to_int64(&i64, numeral, 3, &error);
-    assertion(i64 == 123 && error == 0,
-              "str.to_int64(%*.*s, 3)=%lld error %d %s",
-              4, 4, numeral, i64, error, strerror(error));
+static void nposix_test_iso8601() {
+    static const struct {
+        const char* s;
+        int64_t ns;
+    } tests[] = {
+        { "1970-01-01T00:00:00Z",                0 },
+        { "1970-01-01T00:00:01.5Z",              1500000000LL },
+        { "2021-01-12T13:14:15.123456789Z",      1610457255123456789LL },
+        { "2021-01-12t13:14:15.1234567891234z",  1610457255123456789LL },
+        { "2021-01-12 15:14:15+02:00",           1610457255000000000LL },
+        { "2021-01-12T08:44:15.000-0430",        1610457255000000000LL },
+        { "2000-02-29T23:59:59Z",                951868799000000000LL },
+        { "1969-12-31T23:59:59.999999999Z",      -1 },
+        { "1900-01-01T00:00:00Z",                -2208988800000000000LL },
+    };
+    for (int i = 0; i < countof(tests); i++) {
+        int64_t ns = 0;
+        errno_t r = str.parse_iso8601(tests[i].s, strlen(tests[i].s), &ns);
+        assertion(r == 0 && ns == tests[i].ns, "\"%s\" %lld expected %lld",
+                  tests[i].s, (long long)ns, (long long)tests[i].ns);
+    }
+    static const char* invalid[] = {
+        "2021-01-12T13:14:15", "2021-13-12T13:14:15Z",
+        "2021-02-29T00:00:00Z", "2021-01-12T24:00:00Z",
+        "2021-01-12X13:14:15Z", "2021-01-12T13:14:15.Z",
+        "2021-01-12T13:14:15+0", "2021-01-12T13:14:15Zjunk",
+        "2021-1-12T13:14:15Z"
+    };
+    for (int i = 0; i < countof(invalid); i++) {
+        int64_t ns = 0;
+        errno_t r = str.parse_iso8601(invalid[i], strlen(invalid[i]), &ns);
+        assertion(r == EINVAL, "\"%s\" r=%d", invalid[i], r);
+    }
+    // limits of int64_t nanoseconds and just past them:
+    static const struct { const char* s; errno_t r; int64_t ns; } limits[] = {
+        { "2262-04-11T23:47:16.854775807Z", 0, INT64_MAX },
+        { "1677-09-21T00:12:43.145224192Z", 0, INT64_MIN },
+        { "2262-04-11T23:47:16.854775808Z", ERANGE, 0 },
+        { "1677-09-21T00:12:43.145224191Z", ERANGE, 0 },
+        { "2262-04-11T23:47:17Z", ERANGE, 0 },
+        { "1677-09-21T00:12:43Z", ERANGE, 0 },
+        { "9999-12-31T23:59:59Z", ERANGE, 0 },
+        { "1000-01-01T00:00:00Z", ERANGE, 0 },
+        { "0000-01-01T00:00:00Z", ERANGE, 0 }
+    };
+    for (int i = 0; i < countof(limits); i++) {
+        int64_t ns = 0;
+        errno_t r = str.parse_iso8601(limits[i].s, strlen(limits[i].s), &ns);
+        assertion(r == limits[i].r && (r != 0 || ns == limits[i].ns),
+                  "%s r=%d ns=%lld", limits[i].s, r, ns);
+    }
+    char s[32];
+    int_t n = str.format_iso8601(s, countof(s), 1610457255123456789LL, 3);
+    swear(n == 24 && strcmp(s, "2021-01-12T13:14:15.123Z") == 0);
+    n = str.format_iso8601(s, countof(s), -1, 9);
+    swear(strcmp(s, "1969-12-31T23:59:59.999999999Z") == 0);
+    n = str.format_iso8601(s, countof(s), 951868799000000000LL, 0);
+    swear(n == 20 && strcmp(s, "2000-02-29T23:59:59Z") == 0);
+    // exact fit buffers:
+    char s21[21];
+    n = str.format_iso8601(s21, countof(s21), 951868799000000000LL, 0);
+    swear(n == 20 && strcmp(s21, "2000-02-29T23:59:59Z") == 0);
+    char s23[23];
+    n = str.format_iso8601(s23, countof(s23), 951868799100000000LL, 1);
+    swear(n == 22 && strcmp(s23, "2000-02-29T23:59:59.1Z") == 0);
+    // round trip every few days over a few centuries
+    uint64_t seed = random_generator.initial_seed;
+    for (int i = 0; i < 10000; i++) {
+        int64_t ns = random_generator.next_seeded_int32(&seed) * (1LL << 30) +
+                     random_generator.next_seeded_uint32(&seed) % 1000000000;
+        int64_t back = 0;
+        n = str.format_iso8601(s, countof(s), ns, 9);
+        swear(str.parse_iso8601(s, n, &back) == 0 && back == ns);
+    }
+    int64_t now = (int64_t)(process_clock.time_since_epoch() * 1e9);
+    n = str.format_iso8601(s, countof(s), now, 6);
+    swear(n == 27);
 }
 
 static void nposix_test_random_generator() {
@@ -552,6 +7385,811 @@ static void nposix_test_random_generator() {
     }
 }
 
+static void nposix_test_sampling() {
+    const double weights[] = { 1, 2, 3, 4, 0, 10 };
+    const double total = 20;
+    random_alias_t a;
+    swear(sampling.alias_init(&a, weights, countof(weights)) == 0);
+    enum { n = 200 * 1000 };
+    int64_t histogram[countof(weights)] = {};
+    uint64_t seed = random_generator.initial_seed;
+    for (int i = 0; i < n; i++) {
+        int_t k = i % 2 == 0 ?
+            sampling.alias_draw(&a, &random_generator, null) :
+            sampling.alias_draw(&a, &random_generator, &seed);
+        swear(0 <= k && k < countof(weights));
+        histogram[k]++;
+    }
+    swear(histogram[4] == 0);
+    for (int i = 0; i < countof(weights); i++) {
+        double expected = n * weights[i] / total;
+        assertion(fabs(histogram[i] - expected) <= expected * 0.05,
+                  "[%d] %lld expected %.1f", i, (long long)histogram[i],
+                  expected);
+    }
+    sampling.alias_dispose(&a);
+    const double zero[] = { 0, 0 };
+    swear(sampling.alias_init(&a, zero, 2) == EINVAL);
+    const double negative[] = { 1, -1 };
+    swear(sampling.alias_init(&a, negative, 2) == EINVAL);
+    // reservoir: every item of the stream should be equally likely
+    enum { k = 10, items = 1000, runs = 2000, deciles = 10 };
+    int64_t picked[deciles] = {};
+    for (int run = 0; run < runs; run++) {
+        int reservoir[k];
+        random_reservoir_t r;
+        sampling.reservoir_init(&r, k, &random_generator, &seed);
+        for (int i = 0; i < items; i++) {
+            if (run % 2 == 0) {
+                int_t slot = sampling.reservoir_offer(&r);
+                if (slot >= 0) { reservoir[slot] = i; }
+            } else { // skipping variant must sample the same way
+                i += (int)sampling.reservoir_skip(&r);
+                if (i < items) {
+                    int_t slot = sampling.reservoir_offer(&r);
+                    swear(slot >= 0);
+                    reservoir[slot] = i;
+                }
+            }
+        }
+        for (int i = 0; i < k; i++) { picked[reservoir[i] * deciles / items]++; }
+    }
+    for (int i = 0; i < deciles; i++) {
+        const double expected = (double)runs * k / deciles;
+        assertion(fabs(picked[i] - expected) <= expected * 0.1,
+                  "decile[%d] %lld expected %.1f", i, (long long)picked[i],
+                  expected);
+    }
+}
+
+static void nposix_test_secure_random() {
+    // RFC 7539 2.3.2 test vector (block counter 1 and 2)
+    uint32_t key[8];
+    for (int i = 0; i < 8; i++) {
+        key[i] = (uint32_t)(i * 4) | (uint32_t)(i * 4 + 1) << 8 |
+                 (uint32_t)(i * 4 + 2) << 16 | (uint32_t)(i * 4 + 3) << 24;
+    }
+    const uint32_t nonce[3] = { 0x09000000, 0x4A000000, 0x00000000 };
+    uint8_t out[secure_random_buffer];
+    secure_random_chacha20(key, 1, nonce, out);
+    static const uint8_t block1[16] = { 0x10, 0xF1, 0xE7, 0xE4, 0xD1, 0x3B,
+        0x59, 0x15, 0x50, 0x0F, 0xDD, 0x1F, 0xA3, 0x20, 0x71, 0xC4 };
+    static const uint8_t block2[16] = { 0x0A, 0x88, 0x83, 0x77, 0x39, 0xD7,
+        0xBF, 0x4E, 0xF8, 0xCC, 0xAC, 0xB0, 0xEA, 0x2B, 0xB9, 0xD6 };
+    swear(mem.equals(out, block1, 16) && mem.equals(out + 64, block2, 16));
+    uint8_t a[1000];
+    uint8_t b[1000];
+    secure_random.fill_bytes(a, countof(a));
+    secure_random.fill_bytes(b, countof(b));
+    swear(!mem.equals(a, b, countof(a)));
+    int64_t bits = 0;
+    for (int i = 0; i < countof(a); i++) { bits += __builtin_popcount(a[i]); }
+    swear(3700 < bits && bits < 4300); // 4000 expected
+    double sum = 0;
+    for (int i = 0; i < 10000; i++) {
+        double d = secure_random.next_double();
+        swear(0 <= d && d < 1);
+        sum += d;
+        swear(secure_random.next_uint32() >= 0);
+    }
+    swear(4800 < sum && sum < 5200);
+    // fork child must not repeat parent keystream
+    int fds[2];
+    swear(pipe(fds) == 0);
+    pid_t pid = fork();
+    swear(pid >= 0);
+    if (pid == 0) {
+        uint64_t v = secure_random.next_uint64();
+        _exit(write(fds[1], &v, sizeof(v)) == sizeof(v) ? 0 : 1);
+    }
+    uint64_t parent = secure_random.next_uint64();
+    uint64_t child = 0;
+    swear(read(fds[0], &child, sizeof(child)) == sizeof(child));
+    swear(parent != child);
+    int status = 0;
+    swear(waitpid(pid, &status, 0) == pid && status == 0);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void nposix_test_sequence() {
+    sequence_t s;
+    double p[3];
+    // van der Corput and Joe & Kuo dimension 2 (m = 1):
+    static const double sobol[][2] = {
+        { 0, 0 }, { 0.5, 0.5 }, { 0.75, 0.25 }, { 0.25, 0.75 },
+        { 0.375, 0.375 }, { 0.875, 0.875 }
+    };
+    swear(sequence.sobol(&s, 2) == 0);
+    for (int i = 0; i < countof(sobol); i++) {
+        sequence.next(&s, p);
+        assertion(p[0] == sobol[i][0] && p[1] == sobol[i][1],
+                  "[%d] %g %g", i, p[0], p[1]);
+    }
+    sequence.dispose(&s);
+    static const double halton[][2] = {
+        { 0, 0 }, { 0.5, 1.0 / 3 }, { 0.25, 2.0 / 3 }, { 0.75, 1.0 / 9 }
+    };
+    swear(sequence.halton(&s, 2) == 0);
+    for (int i = 0; i < countof(halton); i++) {
+        sequence.next(&s, p);
+        assertion(fabs(p[0] - halton[i][0]) < 1e-15 &&
+                  fabs(p[1] - halton[i][1]) < 1e-15,
+                  "[%d] %g %g", i, p[0], p[1]);
+    }
+    sequence.dispose(&s);
+    swear(sequence.sobol(&s, 0) == EINVAL);
+    swear(sequence.sobol(&s, sequence_sobol_max_dimensions + 1) == EINVAL);
+    // Joe & Kuo initial direction numbers of the last (degree 13) dimension:
+    swear(sequence.sobol(&s, sequence_sobol_max_dimensions) == 0);
+    const uint32_t* v = s.direction + (sequence_sobol_max_dimensions - 1) * 32;
+    static const uint32_t last[] = { 1, 1, 5, 15, 19, 1, 7, 211, 157, 603 };
+    for (int k = 0; k < countof(last); k++) {
+        swear(v[k] == last[k] << (31 - k));
+    }
+    sequence.dispose(&s);
+    // every dimension of Sobol sequence: first 2^m points put exactly one
+    // point into each of 2^m equal intervals
+    enum { m = 10, n = 1 << m, dimensions = sequence_sobol_max_dimensions };
+    swear(sequence.sobol(&s, dimensions) == 0);
+    double* points = (double*)heap.alloc(n * dimensions * sizeof(double));
+    sequence.fill(&s, points, n);
+    uint8_t* hit = (uint8_t*)heap.alloc(n);
+    for (int d = 0; d < dimensions; d += 7) {
+        mem.zero(hit, n);
+        for (int i = 0; i < n; i++) {
+            double x = points[i * dimensions + d];
+            swear(0 <= x && x < 1);
+            hit[(int)(x * n)]++;
+        }
+        for (int i = 0; i < n; i++) { assertion(hit[i] == 1, "d=%d", d); }
+    }
+    // skip ahead is the same as sequential generation:
+    double* q = (double*)heap.alloc(dimensions * sizeof(double));
+    for (int i = 0; i < n; i += 97) {
+        sequence_t t;
+        swear(sequence.sobol(&t, dimensions) == 0);
+        sequence.skip(&t, i);
+        sequence.next(&t, q);
+        swear(mem.equals(q, points + i * dimensions, dimensions * sizeof(double)));
+        sequence.dispose(&t);
+    }
+    sequence.dispose(&s);
+    swear(sequence.halton(&s, 3) == 0);
+    sequence.skip(&s, 12345);
+    sequence.next(&s, p);
+    swear(fabs(p[0] - 0.60955810546875) < 1e-15); // 12345 = 0x3039
+    sequence.dispose(&s);
+    heap.free(q);
+    heap.free(hit);
+    heap.free(points);
+}
+
+typedef struct {
+    mutex_t lock;
+    event_t ready;
+    uint8_t* buffer;
+    uint32_t magic; // set by constructor, checked on every alloc
+    int uses;       // survives free()/alloc() round trips
+} nposix_test_object_t;
+
+typedef struct {
+    atomic_int constructed;
+    atomic_int destructed;
+    bool fail; // constructor fails when set
+    object_cache_t* cache;
+} nposix_test_object_stats_t;
+
+static errno_t nposix_test_object_constructor(void* o, void* context) {
+    nposix_test_object_stats_t* stats = (nposix_test_object_stats_t*)context;
+    if (stats->fail) { return ENOMEM; }
+    nposix_test_object_t* object = (nposix_test_object_t*)o;
+    object->buffer = (uint8_t*)heap.alloc(4096);
+    if (object->buffer == null) { return ENOMEM; }
+    mutex.init(&object->lock);
+    event.init(&object->ready);
+    object->magic = 0xC0FFEE;
+    object->uses = 0;
+    atomic_fetch_add(&stats->constructed, 1);
+    return 0;
+}
+
+static void nposix_test_object_destructor(void* o, void* context) {
+    nposix_test_object_stats_t* stats = (nposix_test_object_stats_t*)context;
+    nposix_test_object_t* object = (nposix_test_object_t*)o;
+    swear(object->magic == 0xC0FFEE);
+    object->magic = 0;
+    event.dispose(&object->ready);
+    mutex.dispose(&object->lock);
+    heap.free(object->buffer);
+    atomic_fetch_add(&stats->destructed, 1);
+}
+
+typedef struct {
+    mutex_t mutex;
+    _Atomic(uint32_t) locked;
+    _Atomic(uint32_t) release;
+} nposix_test_lock_timeout_t;
+
+static void nposix_test_lock_timeout_thread(void* p) {
+    nposix_test_lock_timeout_t* t = (nposix_test_lock_timeout_t*)p;
+    mutex.lock(&t->mutex);
+    atomic_store(&t->locked, 1);
+    futex.wake((const uint32_t*)&t->locked, 1);
+    while (atomic_load(&t->release) == 0) { // holder is "stuck"
+        futex.wait((const uint32_t*)&t->release, 0, -1);
+    }
+    mutex.unlock(&t->mutex);
+}
+
+static void nposix_test_lock_timeout() {
+    nposix_test_lock_timeout_t t = {};
+    mutex.init(&t.mutex);
+    swear(mutex.lock_timeout(&t.mutex, 0) == 0); // uncontended
+    mutex.unlock(&t.mutex);
+    thread_t thread;
+    threads.start(&thread, nposix_test_lock_timeout_thread, &t, 0, false);
+    while (atomic_load(&t.locked) == 0) {
+        futex.wait((const uint32_t*)&t.locked, 0, -1);
+    }
+    double time = process_clock.time_since_epoch(); // wall clock
+    swear(mutex.lock_timeout(&t.mutex, 0.005) == ETIMEDOUT);
+    time = process_clock.time_since_epoch() - time;
+    swear(time >= 0.004);
+    swear(mutex.lock_timeout(&t.mutex, nan("")) == ETIMEDOUT);
+    atomic_store(&t.release, 1);
+    futex.wake((const uint32_t*)&t.release, 1);
+    swear(mutex.lock_timeout(&t.mutex, 10.0) == 0); // after holder is done
+    mutex.unlock(&t.mutex);
+    // huge timeouts must neither overflow nor turn into the past:
+    swear(mutex.lock_timeout(&t.mutex, 1e300) == 0);
+    mutex.unlock(&t.mutex);
+    struct timespec now = {};
+    swear(clock_gettime(CLOCK_MONOTONIC, &now) == 0);
+    const double huge[] = { 1e10, 1e19, 1e300, 1.0 / 0.0 };
+    for (int i = 0; i < countof(huge); i++) {
+        struct timespec d = mutex_deadline(huge[i]);
+        swear(d.tv_sec >= now.tv_sec + (time_t)mutex_deadline_max_seconds &&
+              0 <= d.tv_nsec && d.tv_nsec < 1000000000L);
+    }
+    struct timespec d = mutex_deadline(2.5);
+    swear(now.tv_sec + 2 <= d.tv_sec && d.tv_sec <= now.tv_sec + 4);
+    threads.join(thread);
+    mutex.dispose(&t.mutex);
+}
+
+static void nposix_test_futex_thread(void* p) {
+    _Atomic(uint32_t)* v = (_Atomic(uint32_t)*)p;
+    while (atomic_load(v) == 0) { futex.wait((const uint32_t*)v, 0, -1); }
+    atomic_store(v, 2);
+    futex.wake((const uint32_t*)v, 1);
+}
+
+static void nposix_test_futex() {
+    _Atomic(uint32_t) v = 0;
+    double time = process_clock.time_since_epoch(); // wall clock
+    swear(futex.wait((const uint32_t*)&v, 0, 0.001) == ETIMEDOUT);
+    swear(process_clock.time_since_epoch() - time >= 0.0005);
+    swear(futex.wait((const uint32_t*)&v, 1, -1) == 0); // value differs
+    thread_t t;
+    threads.start(&t, nposix_test_futex_thread, &v, 0, false);
+    atomic_store(&v, 1);
+    futex.wake((const uint32_t*)&v, 1);
+    while (atomic_load(&v) != 2) { futex.wait((const uint32_t*)&v, 1, -1); }
+    threads.join(t);
+}
+
+typedef struct {
+    waitable_t ping;
+    waitable_t pong;
+    waitable_t go; // manual reset
+    atomic_int released;
+    int rounds;
+} nposix_test_waitable_t;
+
+static void nposix_test_waitable_ponger(void* p) {
+    nposix_test_waitable_t* t = (nposix_test_waitable_t*)p;
+    for (int i = 0; i < t->rounds; i++) {
+        waitable.wait(&t->ping);
+        waitable.set(&t->pong);
+    }
+}
+
+static void nposix_test_waitable_any_ponger(void* p) {
+    nposix_test_waitable_t* t = (nposix_test_waitable_t*)p;
+    waitable_t* events[] = { &t->go, &t->ping }; // go: quit
+    while (waitable.wait_any(events, countof(events), -1) == 1) {
+        waitable.set(&t->pong);
+    }
+}
+
+static double nposix_test_waitable_round_trip(nposix_test_waitable_t* t,
+                                              void (*ponger)(void*)) {
+    thread_t thread;
+    threads.start(&thread, ponger, t, 0, false);
+    double time = process_clock.time_since_epoch();
+    for (int i = 0; i < t->rounds; i++) {
+        waitable.set(&t->ping);
+        waitable.wait(&t->pong);
+    }
+    time = process_clock.time_since_epoch() - time;
+    waitable.set(&t->go);
+    threads.join(thread);
+    waitable.reset(&t->go);
+    return time * 1e6 / t->rounds;
+}
+
+static void nposix_test_waitable_any() {
+    waitable_t e[3];
+    waitable_t* events[countof(e)];
+    for (int i = 0; i < countof(e); i++) {
+        waitable.init(&e[i], i == 0, false);
+        events[i] = &e[i];
+    }
+    swear(waitable.wait_any(events, countof(e), 0.001) == -1);
+    swear(waitable.wait_any(events, countof(e), NAN) == -1); // not forever
+    waitable.set(&e[2]);
+    swear(waitable.wait_any(events, countof(e), 0) == 2);
+    swear(!waitable.is_set(&e[2])); // auto reset consumed
+    waitable.set(&e[1]);
+    waitable.set(&e[2]);
+    swear(waitable.wait_any(events, countof(e), 0) == 1);
+    swear(waitable.wait_any(events, countof(e), 0) == 2);
+    waitable.set(&e[0]); // manual reset stays set
+    swear(waitable.wait_any(events, countof(e), -1) == 0);
+    swear(waitable.wait_any(events, countof(e), -1) == 0);
+    for (int i = 0; i < countof(e); i++) { waitable.dispose(&e[i]); }
+}
+
+typedef struct {
+    waitable_t ready; // auto reset: "event" was published
+    _Atomic(waitable_t*) event;
+    int rounds;
+} nposix_test_waitable_dispose_t;
+
+static void nposix_test_waitable_setter(void* p) {
+    nposix_test_waitable_dispose_t* t = (nposix_test_waitable_dispose_t*)p;
+    for (int i = 0; i < t->rounds; i++) {
+        waitable.wait(&t->ready);
+        waitable.set(atomic_exchange(&t->event, null));
+    }
+}
+
+static void nposix_test_waitable_dispose() {
+    // waiter frees the event as soon as wait() returns while set() may
+    // still be running: set() must not touch the event after the wake
+    static nposix_test_waitable_dispose_t t;
+    t.rounds = 10000;
+    waitable.init(&t.ready, false, false);
+    thread_t setter;
+    threads.start(&setter, nposix_test_waitable_setter, &t, 0, false);
+    for (int i = 0; i < t.rounds; i++) {
+        waitable_t* e = (waitable_t*)heap.alloc(sizeof(waitable_t));
+        swear(e != null);
+        waitable.init(e, i % 2 == 0, false);
+        atomic_store(&t.event, e);
+        waitable.set(&t.ready);
+        waitable.wait(e);
+        waitable.dispose(e);
+        heap.free(e);
+    }
+    threads.join(setter);
+    waitable.dispose(&t.ready);
+}
+
+static void nposix_test_waitable_waiter(void* p) {
+    nposix_test_waitable_t* t = (nposix_test_waitable_t*)p;
+    waitable.wait(&t->go);
+    atomic_fetch_add(&t->released, 1);
+}
+
+static void nposix_test_waitable() {
+    waitable_t e;
+    waitable.init(&e, false, true);
+    waitable.wait(&e); // already set: no syscall, consumed
+    swear(!waitable.is_set(&e));
+    swear(waitable.timed_wait(&e, 0.001) == ETIMEDOUT);
+    swear(waitable.timed_wait(&e, NAN) == ETIMEDOUT); // not forever
+    waitable.set(&e); // nobody waits: not lost
+    waitable.set(&e); // auto reset event does not count
+    swear(waitable.timed_wait(&e, 0) == 0);
+    swear(waitable.timed_wait(&e, 0) == ETIMEDOUT);
+    waitable.dispose(&e);
+    waitable.init(&e, true, false);
+    waitable.set(&e);
+    for (int i = 0; i < 3; i++) { swear(waitable.timed_wait(&e, 0) == 0); }
+    waitable.reset(&e);
+    swear(waitable.timed_wait(&e, 0.001) == ETIMEDOUT);
+    waitable.dispose(&e);
+    static nposix_test_waitable_t t;
+    t.rounds = 10000;
+    waitable.init(&t.ping, false, false);
+    waitable.init(&t.pong, false, false);
+    waitable.init(&t.go, true, false);
+    void (*ponger)(void*) = nposix_test_waitable_ponger;
+    double wait = nposix_test_waitable_round_trip(&t, ponger);
+    ponger = nposix_test_waitable_any_ponger;
+    double any = nposix_test_waitable_round_trip(&t, ponger);
+    traceln("ping-pong round trip wait %.1fus wait_any %.1fus", wait, any);
+    (void)wait; (void)any;
+    nposix_test_waitable_any();
+    nposix_test_waitable_dispose();
+    enum { count = 8 };
+    thread_t waiters[count];
+    for (int i = 0; i < count; i++) {
+        threads.start(&waiters[i], nposix_test_waitable_waiter, &t, 0, false);
+    }
+    waitable.set(&t.go); // manual reset event releases everybody
+    for (int i = 0; i < count; i++) { threads.join(waiters[i]); }
+    swear(atomic_load(&t.released) == count);
+    waitable.dispose(&t.ping);
+    waitable.dispose(&t.pong);
+    waitable.dispose(&t.go);
+}
+
+typedef struct {
+    mcs_lock_t mcs;
+    clh_lock_t clh;
+    mutex_t mutex;
+    int kind; // 0: mcs 1: clh 2: mutex 3: clh mixed with try_lock()
+    int iterations;
+    volatile int64_t counter; // protected by the lock
+} nposix_test_queue_lock_t;
+
+static void nposix_test_queue_lock_thread(void* p) {
+    nposix_test_queue_lock_t* q = (nposix_test_queue_lock_t*)p;
+    for (int i = 0; i < q->iterations; i++) {
+        switch (q->kind) {
+            case 0: mcs_lock.lock(&q->mcs); break;
+            case 1: clh_lock.lock(&q->clh); break;
+            case 3:
+                if (i % 2 == 0) {
+                    clh_lock.lock(&q->clh);
+                } else {
+                    while (clh_lock.try_lock(&q->clh) != 0) { sched_yield(); }
+                }
+                break;
+            default: mutex.lock(&q->mutex); break;
+        }
+        const int64_t c = q->counter;
+        if ((i & 15) == 0) { sched_yield(); } // let others pile up
+        q->counter = c + 1;
+        switch (q->kind) {
+            case 0: mcs_lock.unlock(&q->mcs); break;
+            case 1: case 3: clh_lock.unlock(&q->clh); break;
+            default: mutex.unlock(&q->mutex); break;
+        }
+    }
+}
+
+static void nposix_test_clh_waiter(void* p) {
+    nposix_test_queue_lock_t* q = (nposix_test_queue_lock_t*)p;
+    clh_lock.lock(&q->clh);
+    q->counter++;
+    clh_lock.unlock(&q->clh);
+}
+
+static void nposix_test_queue_locks() {
+    nposix_test_futex();
+    nposix_test_lock_timeout();
+    nposix_test_waitable();
+    nposix_test_queue_lock_t q = { .iterations = 200 };
+    mcs_lock.init(&q.mcs);
+    clh_lock.init(&q.clh);
+    mutex.init(&q.mutex);
+    // nested locking and try_lock():
+    mcs_lock.lock(&q.mcs);
+    clh_lock.lock(&q.clh);
+    swear(mcs_lock.try_lock(&q.mcs) == EBUSY);
+    swear(clh_lock.try_lock(&q.clh) == EBUSY);
+    clh_lock.unlock(&q.clh);
+    mcs_lock.unlock(&q.mcs);
+    swear(mcs_lock.try_lock(&q.mcs) == 0);
+    swear(clh_lock.try_lock(&q.clh) == 0);
+    mcs_lock.unlock(&q.mcs);
+    clh_lock.unlock(&q.clh);
+    // try_lock() returns at once while a waiter is queued behind holder:
+    clh_lock.lock(&q.clh);
+    thread_t w;
+    threads.start(&w, nposix_test_clh_waiter, &q, 0, false);
+    while (atomic_load(clh_locked(&q.clh)) < 2) { sched_yield(); }
+    for (int i = 0; i < 1000; i++) { swear(clh_lock.try_lock(&q.clh) == EBUSY); }
+    clh_lock.unlock(&q.clh);
+    threads.join(w); // its node pool is freed on exit
+    swear(q.counter == 1 && clh_lock.try_lock(&q.clh) == 0);
+    clh_lock.unlock(&q.clh);
+    enum { count = 64 };
+    thread_t t[count];
+    static const char* names[] = { "mcs", "clh", "pthread_mutex",
+                                   "clh lock/try_lock" };
+    for (int kind = 0; kind < 4; kind++) {
+        q.kind = kind;
+        q.counter = 0;
+        double time = process_clock.time_since_epoch();
+        for (int i = 0; i < count; i++) {
+            threads.start(&t[i], nposix_test_queue_lock_thread, &q, 0, false);
+        }
+        for (int i = 0; i < count; i++) { threads.join(t[i]); }
+        time = process_clock.time_since_epoch() - time;
+        swear(q.counter == (int64_t)count * q.iterations);
+        traceln("%d threads x %d %s: %.1fns per lock/unlock", count,
+                q.iterations, names[kind],
+                time * 1e9 / (count * q.iterations));
+        (void)names; (void)time;
+    }
+    mcs_lock.dispose(&q.mcs);
+    clh_lock.dispose(&q.clh);
+    mutex.dispose(&q.mutex);
+}
+
+typedef struct { // binary min heap of int64_t
+    int64_t* a;
+    int_t n;
+    int_t capacity;
+} nposix_test_pq_t;
+
+typedef struct {
+    bool push;
+    int64_t value; // in for push, out for pop (-1 when empty)
+} nposix_test_pq_op_t;
+
+static void nposix_test_pq_apply(void* data, void* operation) {
+    nposix_test_pq_t* q = (nposix_test_pq_t*)data;
+    nposix_test_pq_op_t* op = (nposix_test_pq_op_t*)operation;
+    if (op->push) {
+        swear(q->n < q->capacity);
+        int_t i = q->n++;
+        while (i > 0 && q->a[(i - 1) / 2] > op->value) {
+            q->a[i] = q->a[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        q->a[i] = op->value;
+    } else if (q->n == 0) {
+        op->value = -1;
+    } else {
+        op->value = q->a[0];
+        const int64_t last = q->a[--q->n];
+        int_t i = 0;
+        for (;;) {
+            int_t k = i * 2 + 1;
+            if (k >= q->n) { break; }
+            if (k + 1 < q->n && q->a[k + 1] < q->a[k]) { k++; }
+            if (last <= q->a[k]) { break; }
+            q->a[i] = q->a[k];
+            i = k;
+        }
+        if (q->n > 0) { q->a[i] = last; }
+    }
+}
+
+typedef struct {
+    combiner_t combiner;
+    mutex_t lock;
+    nposix_test_pq_t pq;
+    bool combining; // false: plain locking
+    int iterations;
+    atomic_llong pushed;
+    atomic_llong popped;
+} nposix_test_combiner_t;
+
+static void nposix_test_combiner_thread(void* p) {
+    nposix_test_combiner_t* t = (nposix_test_combiner_t*)p;
+    uint64_t seed = (uint64_t)(uintptr_t)&seed;
+    int64_t pushed = 0;
+    int64_t popped = 0;
+    for (int i = 0; i < t->iterations; i++) {
+        nposix_test_pq_op_t op = { .push = (i & 1) == 0,
+            .value = random_generator.next_seeded_uint32(&seed) % 1000000 };
+        if (op.push) { pushed += op.value; }
+        if (t->combining) {
+            combiner.execute(&t->combiner, &op);
+        } else {
+            mutex.lock(&t->lock);
+            nposix_test_pq_apply(&t->pq, &op);
+            mutex.unlock(&t->lock);
+        }
+        if (!op.push && op.value >= 0) { popped += op.value; }
+    }
+    atomic_fetch_add(&t->pushed, pushed);
+    atomic_fetch_add(&t->popped, popped);
+}
+
+static void nposix_test_combiner() {
+    enum { count = 8, iterations = 20000 };
+    static nposix_test_combiner_t t;
+    t.iterations = iterations;
+    t.pq.capacity = count * iterations;
+    t.pq.a = (int64_t*)heap.alloc(t.pq.capacity * sizeof(int64_t));
+    combiner.init(&t.combiner, &t.pq, nposix_test_pq_apply);
+    mutex.init(&t.lock);
+    for (int k = 0; k < 2; k++) {
+        t.combining = k == 0;
+        t.pq.n = 0;
+        atomic_store(&t.pushed, 0);
+        atomic_store(&t.popped, 0);
+        thread_t threads_[count];
+        double time = process_clock.time_since_epoch();
+        for (int i = 0; i < count; i++) {
+            threads.start(&threads_[i], nposix_test_combiner_thread, &t,
+                          0, false);
+        }
+        for (int i = 0; i < count; i++) { threads.join(threads_[i]); }
+        time = process_clock.time_since_epoch() - time;
+        int64_t left = 0;
+        int64_t previous = -1;
+        while (t.pq.n > 0) { // drained in order
+            nposix_test_pq_op_t op = { .push = false };
+            nposix_test_pq_apply(&t.pq, &op);
+            swear(op.value >= previous);
+            previous = op.value;
+            left += op.value;
+        }
+        swear(atomic_load(&t.pushed) == atomic_load(&t.popped) + left);
+        traceln("%d threads priority queue %s: %.1fns per operation", count,
+                t.combining ? "flat combining" : "mutex",
+                time * 1e9 / (count * iterations));
+        (void)time;
+    }
+    swear(t.combiner.operations == count * iterations &&
+          t.combiner.batches <= t.combiner.operations);
+    traceln("%.2f operations per combining pass",
+            (double)t.combiner.operations / (double)t.combiner.batches);
+    combiner.dispose(&t.combiner);
+    mutex.dispose(&t.lock);
+    heap.free(t.pq.a);
+}
+
+static void nposix_test_object_cache_thread(void* p) {
+    nposix_test_object_stats_t* stats = (nposix_test_object_stats_t*)p;
+    nposix_test_object_t* objects[40];
+    uint64_t seed = (uint64_t)(uintptr_t)&objects;
+    for (int i = 0; i < 10000; i++) {
+        const int n = 1 + random_generator.next_seeded_uint32(&seed) % 40;
+        for (int j = 0; j < n; j++) {
+            void* o = object_cache.alloc(stats->cache);
+            objects[j] = (nposix_test_object_t*)o;
+            swear(objects[j] != null && objects[j]->magic == 0xC0FFEE);
+            mutex.lock(&objects[j]->lock);
+            objects[j]->buffer[j] = (uint8_t)j;
+            mutex.unlock(&objects[j]->lock);
+        }
+        for (int j = 0; j < n; j++) {
+            object_cache.free(stats->cache, objects[j]);
+        }
+    }
+}
+
+static void nposix_test_object_cache() {
+    nposix_test_object_stats_t stats = {};
+    object_cache_t* c = object_cache.create(sizeof(nposix_test_object_t),
+        nposix_test_object_constructor, nposix_test_object_destructor, &stats);
+    stats.cache = c;
+    enum { n = 100 };
+    nposix_test_object_t* objects[n];
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < n; i++) {
+            objects[i] = (nposix_test_object_t*)object_cache.alloc(c);
+            swear(objects[i] != null && objects[i]->magic == 0xC0FFEE);
+            objects[i]->uses++;
+        }
+        for (int i = 0; i < n; i++) { object_cache.free(c, objects[i]); }
+    }
+    // constructors ran once per object (in batches of magazine size):
+    const int constructed = atomic_load(&stats.constructed);
+    swear(n <= constructed && constructed < n + object_cache_magazine_rounds);
+    int uses = 0;
+    for (int i = 0; i < n; i++) {
+        objects[i] = (nposix_test_object_t*)object_cache.alloc(c);
+        uses += objects[i]->uses;
+    }
+    swear(uses >= 3 * n - 2 * object_cache_magazine_rounds);
+    for (int i = 0; i < n; i++) { object_cache.free(c, objects[i]); }
+    swear(object_cache.reclaim(c) > 0);
+    swear(atomic_load(&stats.destructed) > 0);
+    // threads: magazines of exited threads go back to the depot
+    enum { count = 4 };
+    thread_t t[count];
+    for (int i = 0; i < count; i++) {
+        threads.start(&t[i], nposix_test_object_cache_thread, &stats, 0, false);
+    }
+    for (int i = 0; i < count; i++) { threads.join(t[i]); }
+    object_cache.reclaim_all();
+    // only objects in magazines of this thread are left constructed:
+    const int alive = atomic_load(&stats.constructed) -
+                      atomic_load(&stats.destructed);
+    swear(0 <= alive && alive <= 2 * object_cache_magazine_rounds);
+    traceln("constructed: %d destructed: %d",
+            atomic_load(&stats.constructed), atomic_load(&stats.destructed));
+    object_cache.dispose(c);
+    swear(atomic_load(&stats.constructed) == atomic_load(&stats.destructed));
+    // disposed cache index is reused, constructor failures are reported:
+    nposix_test_object_stats_t failing = { .fail = true };
+    c = object_cache.create(sizeof(nposix_test_object_t),
+        nposix_test_object_constructor, nposix_test_object_destructor,
+        &failing);
+    swear(object_cache.alloc(c) == null);
+    object_cache.dispose(c);
+}
+
+static void nposix_test_scratch_thread(void* p) {
+    int_t* result = (int_t*)p;
+    swear(scratch.mark() == 0); // every thread has its own stack
+    uint8_t* a = (uint8_t*)scratch.push(100);
+    mem.fill(a, 0x5A, 100);
+    *result = scratch.mark();
+    scratch.pop(0);
+}
+
+static void nposix_test_scratch() {
+    const int_t m0 = scratch.mark();
+    uint8_t* a = (uint8_t*)scratch.push(3);
+    const int_t m1 = scratch.mark();
+    uint8_t* b = (uint8_t*)scratch.push(17);
+    swear(((uintptr_t)a & 15) == 0 && ((uintptr_t)b & 15) == 0 && b == a + 16);
+    mem.fill(b, 0xFF, 17);
+    scratch.pop(m1);
+    swear(scratch.push(1) == b); // LIFO reuse
+    scratch.pop(m0);
+    swear(scratch.mark() == m0);
+    // large pushes only commit touched pages:
+    uint8_t* big = (uint8_t*)scratch.push(scratch_reserve / 2);
+    big[0] = 1;
+    big[scratch_reserve / 2 - 1] = 2;
+    scratch.pop(m0);
+    // pop() returns pages above scratch_retain bytes to the OS:
+    big = (uint8_t*)scratch.push(scratch_retain * 4);
+    mem.fill(big, 0xA5, scratch_retain * 4);
+    scratch.pop(m0 + scratch_retain * 2);
+    swear(big[scratch_retain * 2 - 1] == 0xA5); // below mark: intact
+    scratch.pop(m0);
+    #if defined(__linux__) // MADV_DONTNEED zero fills private anonymous pages
+    swear(big[scratch_retain * 4 - 1] == 0);
+    #endif
+    swear(m0 >= scratch_retain || big[0] == 0xA5); // retained
+    // heap_if view: strbuf grows in place at the top of the stack
+    strbuf_t sb;
+    strbuf.init(&sb, &scratch.heap);
+    for (int i = 0; i < 1000; i++) { swear(strbuf.append_int64(&sb, i) == 0); }
+    swear(sb.bytes == 2890 && memcmp(sb.data, "0123456789101112", 16) == 0);
+    const int_t m2 = scratch.mark();
+    swear(m2 - m0 < 4096); // realloc()s did not leave garbage behind
+    strbuf.dispose(&sb);
+    swear(scratch.mark() == m0);
+    void* p = scratch.heap.alloc(10);
+    void* q = scratch.heap.allocate(10);
+    scratch.heap.free(p); // not the last: no-op
+    swear(scratch.mark() > m0);
+    q = scratch.heap.realloc(q, 1000); // the last: in place
+    scratch.heap.free(q);
+    scratch.pop(m0);
+    nposix_test_heap_if(&scratch.heap);
+    scratch.pop(m0);
+    thread_t t;
+    int_t result = 0;
+    threads.start(&t, nposix_test_scratch_thread, &result, 0, false);
+    threads.join(t);
+    swear(result == 112);
+    // time scratch against global heap for short lived temporaries:
+    enum { n = 1000 * 1000 };
+    double time = process_clock.time();
+    for (int i = 0; i < n; i++) {
+        const int_t m = scratch.mark();
+        volatile uint8_t* v = (volatile uint8_t*)scratch.push(64 + (i & 255));
+        v[0] = (uint8_t)i;
+        scratch.pop(m);
+    }
+    const double s = process_clock.time() - time;
+    time = process_clock.time();
+    for (int i = 0; i < n; i++) {
+        volatile uint8_t* v = (volatile uint8_t*)heap.alloc(64 + (i & 255));
+        v[0] = (uint8_t)i;
+        heap.free((void*)v);
+    }
+    const double h = process_clock.time() - time;
+    traceln("push/pop %.1fns heap.alloc/free %.1fns", s * 1e9 / n, h * 1e9 / n);
+    (void)s; (void)h;
+}
+
 static void nposix_test_process_clock() {
     for (int i = 0; i < 1000; i++) {
         double now = process_clock.time();
@@ -561,12 +8199,48 @@ static void nposix_test_process_clock() {
     }
 }
 
+static bool nposix_test_pinned_to(int cpu) { // calling thread
+    #if defined(__linux__)
+        cpu_set_t set;
+        swear(pthread_getaffinity_np(pthread_self(), sizeof(set), &set) == 0);
+        return CPU_COUNT(&set) == 1 && CPU_ISSET(cpu, &set) &&
+               sched_getcpu() == cpu;
+    #else
+        (void)cpu;
+        return true;
+    #endif
+}
+
+static void nposix_test_pin(void* p) {
+    (void)p; // pinning changes the mask of this thread only
+    enum { most = 1024 };
+    int cpu[most];
+    const int n = threads.affinity(cpu, most);
+    swear(n == threads.cpus() && 1 <= n && n <= most);
+    int outside = -1; // first processor id not available to the process
+    for (int i = 0; i < n; i++) {
+        swear(i == 0 || cpu[i - 1] < cpu[i]);
+        if (outside < 0 && cpu[i] != i) { outside = i; }
+        errno_t r = threads.pin(cpu[i]);
+        swear(r == 0 || r == ENOTSUP);
+        swear(r != 0 || nposix_test_pinned_to(cpu[i]));
+    }
+    if (outside < 0) { outside = cpu[n - 1] + 1; }
+    const errno_t r = threads.pin(outside);
+    swear(r == EINVAL || r == ENOTSUP);
+    swear(threads.pin(-1) == EINVAL);
+    swear(threads.cpus() == n); // process mask is not affected
+}
+
 static void nposix_test_threads() {
     const double time_to_wait = 0.000123 * (random_generator.next_double() + 0.1);
     double deadline = process_clock.time() + time_to_wait;
     threads.sleep(time_to_wait);
     double time = process_clock.time();
     assertion(time >= deadline, "time=%.9f deadline=%.9f", time, deadline);
+    thread_t t;
+    threads.start(&t, nposix_test_pin, null, 0, false);
+    threads.join(t);
 }
 
 static void nposix_test_memmap() {
@@ -608,11 +8282,31 @@ static void nposix_test_memmap() {
 
 void nposix_test(void) {
     nposix_test_mem();
+    nposix_test_heap();
+    nposix_test_numa();
     nposix_test_str();
+    nposix_test_strbuf();
+    nposix_test_matcher();
+    nposix_test_glob();
+    nposix_test_iso8601();
     nposix_test_random_generator();
+    nposix_test_sampling();
+    nposix_test_secure_random();
+    nposix_test_sequence();
     nposix_test_process_clock();
     nposix_test_threads();
+    nposix_test_scratch();
+    nposix_test_object_cache();
+    nposix_test_queue_locks();
+    nposix_test_combiner();
+    nposix_test_channel();
+    nposix_test_shard_runtime();
     nposix_test_memmap();
+    nposix_test_shared_locks();
+    nposix_test_line_index();
+    nposix_test_persistent_heap();
+    nposix_test_csv();
+    nposix_test_json();
 }
 
 #endif
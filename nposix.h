@@ -2,6 +2,7 @@
 /* Copyright (c) Dmitry "Leo" Kuznetsov 2021 see LICENSE for details */
 
 #include <errno.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -162,6 +163,14 @@ typedef struct {
 
 extern mem_if mem;
 
+typedef struct str_matcher_s str_matcher_t;
+
+typedef struct { // compiled glob pattern, see str.glob_compile()
+    int elements; // after "**" collapsing, at most 63
+    uint64_t star; // bit "i" is set when element "i" is '*'
+    uint64_t accept[256]; // bit "i": element "i" (not '*') accepts byte
+} str_glob_t;
+
 typedef struct {
     int_t (*length)(const char* s);
     bool (*equals)(const char* s1, const char* s2, int_t bytes);
@@ -170,6 +179,37 @@ typedef struct {
     void (*to_int64)(int64_t* d, const char* s, int bytes, errno_t *error);
     bool (*starts_with)(const char* s, const char* prefix);
     bool (*contains)(const char* s, const char* substring);
+    // Compiled multi-pattern search scans input once for all patterns.
+    // Patterns are zero terminated, non-empty and copied (caller may
+    // free them after compile). Returns null if out of memory.
+    str_matcher_t* (*matcher_compile)(const char* patterns[], int n);
+    // Returns index of the leftmost matching pattern (lowest index wins
+    // ties) and its start in *at (may be null), or -1 if none matches.
+    // "s" does not need to be zero terminated.
+    int (*matcher_find)(const str_matcher_t* m, const char* s, int_t bytes,
+                        int_t *at);
+    void (*matcher_dispose)(str_matcher_t* m);
+    // Shell-style glob: '*' any (possibly empty) run of bytes, '?' any
+    // byte, [abc] [a-z] [!a-z] [^a-z] classes and '\' escape.
+    // Returns 0, EINVAL for unterminated class or trailing '\',
+    // E2BIG for patterns with more than 63 elements.
+    errno_t (*glob_compile)(str_glob_t* g, const char* pattern);
+    // Bit-parallel NFA: linear time, no backtracking. "s" does not need
+    // to be zero terminated.
+    bool (*glob_match)(const str_glob_t* g, const char* s, int_t bytes);
+    // RFC 3339 "YYYY-MM-DDTHH:MM:SS[.fraction](Z|+HH:MM|-HH:MM)" ('t', 'z'
+    // and ' ' instead of 'T' accepted, fraction up to nanoseconds, extra
+    // digits truncated) to nanoseconds since 1970-01-01T00:00:00Z.
+    // Returns 0, EINVAL or ERANGE for times outside of int64_t nanoseconds
+    // (1677-09-21T00:12:43.145224192Z..2262-04-11T23:47:16.854775807Z).
+    // No libc time functions, locale or time zone.
+    errno_t (*parse_iso8601)(const char* s, int_t bytes, int64_t *ns);
+    // Formats "YYYY-MM-DDTHH:MM:SS[.fraction]Z" with "digits" (0..9)
+    // of fraction, e.g. for process_clock.time_since_epoch() * 1e9.
+    // Output is zero terminated and needs count >= 21 bytes for digits = 0
+    // or count >= 22 + digits bytes otherwise ('.' and fraction).
+    // Returns number of characters written (not counting zero).
+    int_t (*format_iso8601)(char* s, int_t count, int64_t ns, int digits);
 } str_if;
 
 extern str_if str;
@@ -193,16 +233,201 @@ typedef struct {
 
 extern random_generator_if random_generator;
 
+typedef struct { // see sampling.alias_init()
+    int_t n;
+    double* probability; // [n] probability to keep drawn column "i"
+    int_t* alias;        // [n] column taken otherwise
+} random_alias_t;
+
+typedef struct { // see sampling.reservoir_init()
+    int_t k;    // reservoir capacity
+    int_t seen; // number of items offered or skipped so far
+    int_t next; // index of the next item to be taken
+    double w;   // Algorithm L running weight
+    random_generator_if* rg;
+    uint64_t* seed;
+} random_reservoir_t;
+
+typedef struct {
+    // All functions draw from rg->next_double() if seed == null or from
+    // rg->next_seeded_double(seed) otherwise.
+    // Walker/Vose alias table: O(n) init, O(1) weighted draw.
+    // Weights must be non-negative with positive sum.
+    // Returns 0, EINVAL or ENOMEM.
+    errno_t (*alias_init)(random_alias_t* a, const double weights[], int_t n);
+    int_t (*alias_draw)(const random_alias_t* a, random_generator_if* rg,
+                        uint64_t* seed);
+    void (*alias_dispose)(random_alias_t* a);
+    // Single pass uniform sample of "k" items out of stream of unknown
+    // length (Li's Algorithm L with geometric skips).
+    void (*reservoir_init)(random_reservoir_t* r, int_t k,
+                           random_generator_if* rg, uint64_t* seed);
+    // returns reservoir slot [0..k) to store the offered item into
+    // or -1 if the item is not sampled
+    int_t (*reservoir_offer)(random_reservoir_t* r);
+    // skips (and returns number of) items that will not be sampled for
+    // streams that can seek cheaply; next item offered will be sampled
+    int_t (*reservoir_skip)(random_reservoir_t* r);
+} sampling_if;
+
+extern sampling_if sampling;
+
+typedef struct {
+    // Unpredictable numbers from per-thread ChaCha20 keystream (4 blocks
+    // computed at once in SIMD friendly lanes, fast key erasure: first
+    // 32 bytes of every batch become the next key). Seeded from
+    // getrandom()/getentropy() and reseeded in child after fork().
+    // Failure to obtain OS entropy is fatal.
+    int32_t  (*next_int32)(void);  // [-2^31..2^31 - 1]
+    int32_t  (*next_uint32)(void); // [0..2^31 - 1]
+    uint64_t (*next_uint64)(void);
+    double   (*next_double)(void); // [0.0 .. 1.0) 53 bits
+    void (*fill_bytes)(void* data, int_t bytes);
+    void (*reseed)(void); // of the calling thread keystream
+} secure_random_if;
+
+extern secure_random_if secure_random;
+
+enum {
+    sequence_max_dimensions = 4096, // Halton
+    sequence_sobol_max_dimensions = 1111 // Joe & Kuo table size
+};
+
+typedef struct { // low discrepancy sequence, see sequence.sobol()
+    int kind;
+    int dimensions;
+    int64_t index;        // of the next point
+    uint32_t* direction;  // Sobol: [dimensions][32] direction numbers
+    uint32_t* x;          // Sobol: [dimensions] Gray code state
+    uint32_t* base;       // Halton: [dimensions] first primes
+} sequence_t;
+
+typedef struct {
+    // Sobol points in [0..1)^dimensions up to 2^32 points. Primitive
+    // polynomials are enumerated in the order of Joe & Kuo tables and
+    // all dimensions use their "new-joe-kuo-6" initial direction numbers
+    // (optimized two-dimensional projections).
+    // Returns 0, EINVAL (dimensions out of 1..sequence_sobol_max_dimensions)
+    // or ENOMEM.
+    errno_t (*sobol)(sequence_t* s, int dimensions);
+    // Halton points: radical inverses in bases of first primes
+    errno_t (*halton)(sequence_t* s, int dimensions);
+    // both sequences start with point 0 = (0, 0, ... 0)
+    void (*next)(sequence_t* s, double point[]); // [dimensions]
+    // jumps to s->index + n in O(dimensions * 32) so that parallel workers
+    // can partition the sequence into disjoint ranges
+    void (*skip)(sequence_t* s, int64_t n);
+    void (*fill)(sequence_t* s, double points[], int_t count); // [count][d]
+    void (*dispose)(sequence_t* s);
+} sequence_if;
+
+extern sequence_if sequence;
+
 typedef struct {
     void* (*alloc)(int_t bytes); // traditional naming
     void* (*realloc)(void* data, int_t bytes);
     void* (*free)(void* data);
     // allocate() is convenience for alloc() + memset(p, 0, bytes)
     void* (*allocate)(int_t bytes);
+    // "bytes" must be what the block was allocated (or realloc-ed) with,
+    // it spares the allocator the size lookup where it can use that
+    // (mismatch is only detected in DEBUG builds)
+    void* (*free_sized)(void* data, int_t bytes);
+    int_t (*usable_size)(const void* data); // >= requested bytes
+    // one allocator round trip for "n" blocks of the same size;
+    // all or nothing: 0 or ENOMEM with none of the blocks allocated
+    errno_t (*alloc_batch)(int_t bytes, int_t n, void* out[]);
+    void (*free_batch)(void* data[], int_t n); // null elements are skipped
+    // NUMA placement, optional (null for heaps without placement control).
+    // Blocks up to 64KB are carved out of per node chunks bound once by
+    // mbind(), larger ones are page granular and bound individually.
+    // Interleaved blocks are page granular. All are freed with free().
+    // On single node machines both are the same as alloc().
+    void* (*alloc_on_node)(int_t bytes, int node);
+    void* (*alloc_interleaved)(int_t bytes); // pages round robin over nodes
 } heap_if;
 
 extern heap_if heap;
 
+enum { numa_max_nodes = 64 };
+
+typedef struct {
+    int (*nodes)(void); // online NUMA nodes, 1 on non-NUMA hardware/OSes
+    int (*current_node)(void); // of the CPU calling thread is running on
+    // mbind() of existing page aligned range: placement of shared tables
+    // allocated elsewhere. Returns 0, EINVAL, ENOSYS (not Linux) or errno
+    errno_t (*bind)(void* data, int_t bytes, int node);
+    errno_t (*interleave)(void* data, int_t bytes);
+    // set_mempolicy() for the calling thread: pages it touches first
+    // are placed on "node", node < 0 restores the default local policy
+    errno_t (*prefer)(int node);
+    // node local heap: alloc() places blocks on the node of the current
+    // CPU, the rest is global heap (free() etc. are interchangeable)
+    heap_if heap;
+} numa_if;
+
+extern numa_if numa;
+
+enum {
+    scratch_reserve = 1 << 30, // bytes of address space per thread
+    scratch_retain  = 1 << 20  // bytes kept committed by pop()
+};
+
+typedef struct {
+    // Per-thread LIFO stack for temporaries. Address space is reserved on
+    // the first push() of a thread; pages are committed by the OS on first
+    // touch, pop() returns pages above scratch_retain bytes back to the OS
+    // and the reservation is unmapped when the thread exits.
+    // push() returns 16 bytes aligned memory and is fatal on overflow.
+    void* (*push)(int_t bytes);
+    int_t (*mark)(void); // use: int_t m = scratch.mark(); ... scratch.pop(m);
+    void (*pop)(int_t mark); // releases everything pushed after mark
+    // heap_if view for code that takes heap_if* (e.g. strbuf): realloc()
+    // and free() of the most recent block are in place, other free()s are
+    // no-op and the memory comes back with the enclosing pop().
+    heap_if heap;
+} scratch_if;
+
+extern scratch_if scratch;
+
+typedef struct {
+    const char* data; // not necessarily zero terminated
+    int_t bytes;
+} span_t;
+
+enum { strbuf_inline_bytes = 64 };
+
+typedef struct {
+    heap_if* heap;  // where data lives after it outgrows inline buffer
+    char* data;     // always zero terminated
+    int_t bytes;    // not counting terminating zero
+    int_t capacity; // not counting terminating zero
+    char inline_buffer[strbuf_inline_bytes];
+} strbuf_t;
+
+typedef struct {
+    // heap == null stands for global heap. Caller supplied heap may be
+    // an arena (e.g. bump allocator with .free doing nothing and
+    // .realloc == null) to let per-request builders die all at once.
+    void (*init)(strbuf_t* sb, heap_if* heap);
+    // append*() and reserve() return 0 or ENOMEM leaving content intact
+    errno_t (*reserve)(strbuf_t* sb, int_t bytes); // for at least bytes more
+    errno_t (*append)(strbuf_t* sb, const void* data, int_t bytes);
+    errno_t (*append_span)(strbuf_t* sb, span_t s);
+    errno_t (*append_str)(strbuf_t* sb, const char* s); // zero terminated
+    errno_t (*append_char)(strbuf_t* sb, char ch);
+    errno_t (*append_int64)(strbuf_t* sb, int64_t v);
+    errno_t (*append_uint64)(strbuf_t* sb, uint64_t v);
+    // shortest digits that round trip laid out like "%.17g" with '.'
+    // regardless of locale, "nan", "inf", "-inf"
+    errno_t (*append_double)(strbuf_t* sb, double v);
+    span_t (*span)(const strbuf_t* sb);
+    void (*clear)(strbuf_t* sb); // keeps capacity
+    void (*dispose)(strbuf_t* sb); // returns memory to sb->heap
+} strbuf_if;
+
+extern strbuf_if strbuf;
+
 typedef struct {
     const int64_t nsec_per_sec; // nanoseconds  1,000,000,000
     const int64_t usec_per_sec; // microseconds 1,000,000
@@ -218,16 +443,29 @@ typedef pthread_mutex_t mutex_t;
 
 typedef struct {
     void (*init)(mutex_t* m);
+    // Process shared mutex that can live in MAP_SHARED memory e.g.
+    // memmap.file_readwrite(). Robust (except on macOS): when the owner
+    // dies holding it the next lock(), try_lock() or lock_timeout() gets
+    // it locked and calls owner_died(m) to repair the protected state.
+    void (*init_shared)(mutex_t* m);
     void (*lock)(mutex_t* m);
     errno_t (*try_lock)(mutex_t* m); // 0 or EBUSY only
+    // 0 or ETIMEDOUT. Deadline is measured on CLOCK_MONOTONIC and is not
+    // affected by wall clock (NTP, daylight saving) adjustments
+    errno_t (*lock_timeout)(mutex_t* m, double seconds);
     void (*unlock)(mutex_t* m);
     void (*dispose)(mutex_t* m);
+    // Recovery hook, null by default: fatal() on dead owner (fail fast).
+    // Returning true marks the mutex consistent and the lock succeeds,
+    // false is fatal. Also called by event.wait() and event.timed_wait().
+    bool (*owner_died)(mutex_t* m);
 } mutex_if;
 
 extern mutex_if mutex;
 
 typedef struct {
     void (*init)(event_t* e);
+    void (*init_shared)(event_t* e); // use with mutex.init_shared()
     void (*signal)(event_t* e);
     void (*wait)(event_t* e, mutex_t* m);
     errno_t (*timed_wait)(event_t* e, mutex_t* m, double seconds); // ETIMEDOUT
@@ -236,6 +474,45 @@ typedef struct {
 
 extern event_if event;
 
+enum { waitable_max_any = 128 }; // futex_waitv() limit
+
+typedef struct { // see waitable_if
+    uint32_t state;   // futex word: bit 0 set, bits 1..31 waiters count
+    uint32_t manual;  // manual reset
+    uint32_t shared;  // process shared
+} waitable_t;
+
+typedef struct {
+    // Self-contained event: state is remembered, set() with nobody
+    // waiting is not lost and no mutex or predicate is needed.
+    // set() without waiters is one atomic operation and wait() on an
+    // event that is already set returns without a syscall.
+    // Auto reset event releases a single waiter per set() and resets.
+    // Manual reset event releases every waiter until reset().
+    void (*init)(waitable_t* e, bool manual_reset, bool initially_set);
+    // Process shared event for MAP_SHARED memory. Nothing is owned so
+    // a process dying in wait() or set() leaves the event usable, but a
+    // process killed in wait() stays counted as a waiter: from then on
+    // every set() of the unsignaled event costs a futex wake syscall and
+    // dispose() tolerates the stale count.
+    void (*init_shared)(waitable_t* e, bool manual_reset,
+                        bool initially_set);
+    void (*set)(waitable_t* e);
+    void (*reset)(waitable_t* e);
+    bool (*is_set)(waitable_t* e);
+    void (*wait)(waitable_t* e);
+    // seconds < 0 waits forever, NaN is 0 (as in mutex.lock_timeout)
+    errno_t (*timed_wait)(waitable_t* e, double seconds); // 0 or ETIMEDOUT
+    // Waits until any of the events is set (seconds < 0 forever, NaN 0) and
+    // returns its index (consuming it if auto reset) or -1 on timeout.
+    // Lowest index wins when several are set. Uses futex_waitv() on
+    // Linux 5.16+, elsewhere the events after the first are polled.
+    int (*wait_any)(waitable_t* events[], int n, double seconds);
+    void (*dispose)(waitable_t* e);
+} waitable_if;
+
+extern waitable_if waitable;
+
 typedef pthread_t thread_t;
 
 typedef struct {
@@ -243,19 +520,389 @@ typedef struct {
                           int_t stack_size, bool detached);
     void (*join)(thread_t t);
     void (*sleep)(double seconds); // sleeps for at least specified time
+    int (*cpus)(void); // processors the process may run on
+    // Pins calling thread to "cpu". 0, EINVAL or ENOTSUP (not on macOS
+    // where affinity is only a hint).
+    errno_t (*pin)(int cpu);
+    // Ids of processors in the affinity mask of the process (taskset,
+    // cgroup cpuset) e.g. 4, 5, 6, 7 in a container limited to CPUs 4-7.
+    // Fills up to n of cpu[] and returns their total count (== cpus()).
+    // Without affinity API: 0, 1 ... online processors - 1.
+    int (*affinity)(int cpu[], int n);
 } threads_if;
 
 extern threads_if threads;
 
+typedef struct {
+    // Blocks while *address == expected; spurious wake ups are possible
+    // so callers re-check the value. seconds < 0 waits forever.
+    // Returns 0 or ETIMEDOUT. Linux futex(2), elsewhere a "parking lot"
+    // of mutex/event buckets hashed by address.
+    errno_t (*wait)(const uint32_t* address, uint32_t expected,
+                    double seconds);
+    void (*wake)(const uint32_t* address, int32_t count); // INT32_MAX all
+    // Same for words in MAP_SHARED memory waited on by other processes.
+    // Without futex(2) wait_shared() sleeps up to 1ms and wake_shared()
+    // does nothing.
+    errno_t (*wait_shared)(const uint32_t* address, uint32_t expected,
+                           double seconds);
+    void (*wake_shared)(const uint32_t* address, int32_t count);
+} futex_if;
+
+extern futex_if futex;
+
+// Queue locks: each waiter spins on its own cache line (node) and is
+// granted the lock in FIFO order. A waiter spins up to queue_lock_spins
+// iterations (none on a single processor where the holder cannot run
+// meanwhile), then yields the processor queue_lock_yields times and
+// only then parks on futex. Nodes come from a per-thread pool, so
+// the interfaces have the same shape as mutex_if.
+
+enum { queue_lock_spins = 1000, queue_lock_yields = 16 };
+
+typedef struct { // Mellor-Crummey & Scott lock
+    void* tail;   // node of the last waiter or null
+    void* holder; // node of the owner
+} mcs_lock_t;
+
+typedef struct {
+    void (*init)(mcs_lock_t* l);
+    void (*lock)(mcs_lock_t* l);
+    errno_t (*try_lock)(mcs_lock_t* l); // 0 or EBUSY only
+    void (*unlock)(mcs_lock_t* l);
+    void (*dispose)(mcs_lock_t* l);
+} mcs_lock_if;
+
+extern mcs_lock_if mcs_lock;
+
+typedef struct { // Craig, Landin & Hagersten lock
+    void* tail;        // node of the last thread in the queue
+    void* holder;      // node of the owner
+    void* predecessor; // node owner spun on, recycled by unlock()
+    uint32_t locked;   // threads in lock()..unlock() and try_lock() bit
+} clh_lock_t;
+
+typedef struct {
+    void (*init)(clh_lock_t* l); // allocates initial node
+    void (*lock)(clh_lock_t* l);
+    errno_t (*try_lock)(clh_lock_t* l); // 0 or EBUSY only, never waits
+    void (*unlock)(clh_lock_t* l);
+    void (*dispose)(clh_lock_t* l);
+} clh_lock_if;
+
+extern clh_lock_if clh_lock;
+
+enum { combiner_slots = 64 }; // publication records per combiner
+
+typedef struct { // flat combining, see combiner.execute()
+    mutex_t lock;
+    void* data; // shared data structure
+    void (*apply)(void* data, void* operation);
+    void* slots; // [combiner_slots] cache line aligned publication records
+    int32_t used; // slots[0..used - 1] were ever claimed, combiner scans them
+    int64_t batches;    // statistics: combining passes with work
+    int64_t operations; // statistics: applied operations
+} combiner_t;
+
+typedef struct {
+    void (*init)(combiner_t* c, void* data,
+                 void (*apply)(void* data, void* operation));
+    // Publishes "operation" in a slot (sticky per thread) and returns
+    // when it was applied. Whoever holds the lock applies operations of
+    // all published slots in one pass while the data is hot in its cache
+    // and others only spin on their own slot.
+    void (*execute)(combiner_t* c, void* operation);
+    void (*dispose)(combiner_t* c);
+} combiner_if;
+
+extern combiner_if combiner;
+
+typedef struct { // see channel_if
+    void* shared;  // mapping: control page followed by the ring
+    int_t mapped;  // bytes
+    uint8_t* ring;
+    int_t bytes;   // ring capacity, power of 2
+    uint64_t read; // consumer only: position of the next record
+    int fd;        // memfd, inherited by fork() or passed via SCM_RIGHTS
+} channel_t;
+
+typedef struct {
+    // Shared memory ring of variable size records for any number of
+    // producers and a single consumer in the same or other processes.
+    // "bytes" is rounded up to a power of 2. Returns 0 or errno.
+    errno_t (*create)(channel_t* c, int_t bytes);
+    // Maps the channel created by another process. The channel owns "fd"
+    // and closes it in close(). Returns 0, EINVAL or errno.
+    errno_t (*attach)(channel_t* c, int fd);
+    // Zero copy: returns space for a record of "bytes" (8 bytes aligned,
+    // at most capacity / 2 - 8) right in the ring or null on timeout.
+    // Waits while the ring is full (seconds < 0 forever).
+    void* (*reserve)(channel_t* c, int_t bytes, double seconds);
+    // Publishes reserved record(s). Records are received in reservation
+    // order. Costs a futex wake only if the consumer is asleep.
+    void (*commit)(channel_t* c, void* record);
+    void (*commit_batch)(channel_t* c, void* records[], int n);
+    // reserve(), copy and commit(). 0 or ETIMEDOUT
+    errno_t (*send)(channel_t* c, const void* data, int_t bytes,
+                    double seconds);
+    // Consumer: returns next record in place and its size or null on
+    // timeout. Several records may be received before they are released.
+    void* (*receive)(channel_t* c, int_t *bytes, double seconds);
+    // Returns records up to and including "record" to producers.
+    void (*release)(channel_t* c, void* record);
+    void (*close)(channel_t* c);
+} channel_if;
+
+extern channel_if channel;
+
+enum {
+    shard_max = 64,            // shards in a runtime
+    shard_queue_slots = 256,   // messages in each shard to shard queue
+    shard_batch = 32           // messages published at once at most
+};
+
+typedef struct { // see shard_runtime.submit_to()
+    waitable_t done; // manual reset
+    void* result;
+} shard_future_t;
+
+typedef struct { // see shard_runtime_if
+    int shards;
+    void* shard;  // [shards] cache line aligned per shard state
+    void* queues; // [shards * shards] SPSC queues [from * shards + to]
+    void* (*init)(int shard, void* context); // returns data of the shard
+    void (*fini)(int shard, void* data, void* context);
+    void* context;
+    int64_t messages; // statistics (after stop): shard to shard messages
+    int64_t batches;  // statistics (after stop): their published batches
+} shard_runtime_t;
+
+typedef struct {
+    // Shared nothing runtime: one thread per shard pinned to processor
+    // threads.affinity()[shard % threads.cpus()] owns its data; init()
+    // and fini() run on that thread. shards <= 0 means one per processor
+    // available to the process (at most shard_max).
+    // Returns 0, EINVAL or the error of pinning a shard thread (nothing
+    // is left running then). No affinity on macOS is not an error.
+    errno_t (*start)(shard_runtime_t* rt, int shards,
+                     void* (*init)(int shard, void* context),
+                     void (*fini)(int shard, void* data, void* context),
+                     void* context);
+    // Shard of the calling thread or -1 when it is not a shard thread.
+    int (*current)(shard_runtime_t* rt);
+    // Runs fn(data, arg) on "shard" and stores its return value into
+    // the future (may be null). From a shard thread the message goes to
+    // the SPSC queue of the pair and queued messages are published in
+    // batches when the shard looper finishes a pass (or shard_batch are
+    // pending); from any other thread via a mutex protected inbox.
+    // While the queue is full the calling shard keeps executing its own
+    // incoming messages, fn must tolerate that reentrancy.
+    void (*submit_to)(shard_runtime_t* rt, int shard,
+                      void* (*fn)(void* data, void* arg), void* arg,
+                      shard_future_t* future);
+    // Returns result. On a shard thread keeps serving its queues while
+    // waiting so that shards waiting for each other do not deadlock.
+    void* (*wait)(shard_runtime_t* rt, shard_future_t* future);
+    // After all submitted work has completed: runs fini(), joins threads.
+    void (*stop)(shard_runtime_t* rt);
+} shard_runtime_if;
+
+extern shard_runtime_if shard_runtime;
+
+enum {
+    object_cache_max = 64, // caches alive at the same time
+    object_cache_magazine_rounds = 15 // objects per magazine
+};
+
+typedef struct object_cache_s object_cache_t;
+
+typedef struct {
+    // Freed objects stay in constructed state: constructor() runs when
+    // an object enters the cache and destructor() when it leaves it
+    // (reclaim() or dispose()), not on every alloc()/free().
+    // Each thread keeps two magazines of objects, so alloc() and free()
+    // take no locks unless both magazines are empty (full) and a magazine
+    // has to be exchanged with the cache wide depot.
+    // constructor() returns 0 or errno (alloc() returns null then).
+    object_cache_t* (*create)(int_t bytes,
+        errno_t (*constructor)(void* object, void* context),
+        void (*destructor)(void* object, void* context), void* context);
+    void* (*alloc)(object_cache_t* c); // null on ENOMEM
+    void (*free)(object_cache_t* c, void* object);
+    // destroys objects of full magazines in the depot and returns memory
+    // to the heap. Returns number of destroyed objects. Magazines of
+    // threads are not touched: they are bounded and returned on exit.
+    int_t (*reclaim)(object_cache_t* c);
+    // low memory hook: reclaim() of every cache, also called by alloc()
+    // before it gives up on ENOMEM
+    int_t (*reclaim_all)(void);
+    // all objects must be freed and no other thread may use the cache
+    void (*dispose)(object_cache_t* c);
+} object_cache_if;
+
+extern object_cache_if object_cache;
+
+enum { memmap_line_index_every = 64 }; // every K-th line start is kept
+
+typedef struct { // see memmap.line_index()
+    int_t bytes; // of indexed data
+    int_t lines; // last line may not be terminated by '\n'
+    int_t checkpoints; // (lines + K - 1) / K recorded line starts
+    // Absolute offset of every 64th checkpoint and position of following
+    // varint in "deltas" (pairs) bound the decoding to 63 varints:
+    int_t* skip;
+    int_t  skips; // number of pairs
+    uint8_t* deltas; // LEB128 varint deltas of line starts in between
+    int_t deltas_bytes;
+} memmap_line_index_t;
+
 typedef struct {
     errno_t (*file_readonly)(const char* filename, void* *data, int_t *bytes);
     errno_t (*file_readwrite)(const char* filename, int_t offset, int_t size,
                           void* *data, int_t *bytes);
     errno_t (*file_unmap)(void* data, int_t bytes);
+    // Newlines are located 64 bytes at a time on "threads" threads in
+    // two passes (count per chunk, then record every K-th line start).
+    // Returns 0 or ENOMEM.
+    errno_t (*line_index)(memmap_line_index_t* ix, const void* data,
+                          int_t bytes, int threads);
+    // span of line (without '\n') or EINVAL if line >= ix->lines
+    errno_t (*line_seek)(const memmap_line_index_t* ix, const void* data,
+                         int_t line, span_t* s);
+    // index file is only valid for the same data: caller must compare
+    // ix->bytes with the size of the mapping (or use own checksum).
+    // Offsets are stored as int64_t in host byte order. Load returns
+    // EINVAL for truncated or inconsistent files.
+    errno_t (*line_index_save)(const memmap_line_index_t* ix,
+                               const char* filename);
+    errno_t (*line_index_load)(memmap_line_index_t* ix, const char* filename);
+    void (*line_index_dispose)(memmap_line_index_t* ix);
 } memmap_if;
 
 extern memmap_if memmap;
 
+typedef struct { uint64_t offset; } persistent_ptr_t; // {0} is null
+
+typedef struct {
+    // Maps (creates if necessary) "filename" at a fixed place inside
+    // "reserve" bytes of address space. File grows within reservation
+    // so pointers are stable while open; offsets are stable across runs.
+    // Single persistent heap per process. Returns 0, EBUSY (already open),
+    // EINVAL (not a persistent heap file) or errno of open/mmap.
+    errno_t (*open)(const char* filename, int_t reserve);
+    // msync()s everything and atomically commits allocator state and root
+    // into one of two checksummed header slots. After crash open() restores
+    // state of the last persist(). Block contents are written in place:
+    // for transactional updates write new blocks and publish them by
+    // set_root() + persist() (shadow paging).
+    errno_t (*persist)(void);
+    void (*close)(void); // does NOT persist()
+    persistent_ptr_t (*offset)(const void* p);
+    void* (*pointer)(persistent_ptr_t o);
+    persistent_ptr_t (*root)(void);
+    void (*set_root)(persistent_ptr_t o);
+    // size classes 16, 32, ... 128, 160, 192, 224, 256, 320, ... (<= 25%
+    // waste). alloc() returns null when reservation is exhausted.
+    heap_if heap;
+} persistent_heap_if;
+
+extern persistent_heap_if persistent_heap;
+
+typedef struct { // RFC 4180 reader state, see csv.init()
+    const char* data;
+    int_t bytes;
+    int_t position; // start of next field
+    int_t block;    // offset of 64 bytes block scanned into "structural"
+    uint64_t structural; // not yet consumed unquoted delimiters and '\n'
+    uint64_t quoted;     // ~0 if block ended inside quotes, 0 otherwise
+    bool after_delimiter; // trailing empty field is still pending
+    char delimiter;
+} csv_reader_t;
+
+typedef struct {
+    span_t span;  // zero copy: enclosing quotes removed, "" kept as is
+    bool quoted;  // span may contain "" escaped quotes (see csv.unquote)
+    bool last;    // last field of the record
+} csv_field_t;
+
+typedef struct {
+    // "data" is usually memmap.file_readonly() mapping and must outlive
+    // the reader. Structural characters are located 64 bytes at a time
+    // as bitmasks (SIMD where available), quoted regions masked off with
+    // prefix xor of quotes mask.
+    void (*init)(csv_reader_t* r, const void* data, int_t bytes,
+                 char delimiter);
+    bool (*next)(csv_reader_t* r, csv_field_t* f); // false at end of data
+    // copies span collapsing "" to " into "to" (at least f->span.bytes)
+    // and returns number of bytes written
+    int_t (*unquote)(const csv_field_t* f, char* to);
+    // splits data into "parts" ranges [offsets[i]..offsets[i + 1]) each
+    // starting at record boundary (offsets[] must have parts + 1 entries).
+    // Quotes are counted in parallel on "parts" threads to know exact
+    // quoted state at each chunk start.
+    void (*split)(const void* data, int_t bytes, int parts, int_t offsets[]);
+    // splits data and runs "parse" on "parts" threads for each range
+    void (*parallel)(const void* data, int_t bytes, char delimiter,
+                     int parts, void* that,
+                     void (*parse)(void* that, int part, csv_reader_t* r));
+} csv_if;
+
+extern csv_if csv;
+
+typedef struct { // structural index (simdjson "stage 1")
+    const char* data; // usually memmap.file_readonly() mapping
+    int_t bytes;
+    int_t* position; // offsets of {}[]:, opening quotes and scalar starts
+    int_t count;
+    int_t capacity;
+} json_index_t;
+
+typedef enum {
+    json_end = 0, // no more tokens
+    json_object,  json_object_end,
+    json_array,   json_array_end,
+    json_key,     // span is raw (still escaped) key without quotes
+    json_string,  // span is raw (still escaped) string without quotes
+    json_number,  // see json.to_double() json.to_int64()
+    json_true, json_false, json_null,
+    json_invalid  // unexpected character at span.data
+} json_type_t;
+
+typedef struct {
+    json_type_t type;
+    span_t span;
+} json_token_t;
+
+typedef struct { // on-demand cursor over structural index
+    const json_index_t* ix;
+    int_t next; // index into ix->position[]
+} json_cursor_t;
+
+typedef struct {
+    // Builds structural index 64 bytes at a time: quotes escaped by odd
+    // runs of backslashes are discarded, string interiors masked off by
+    // prefix xor (carry-less multiply where available) of quotes mask.
+    // Returns 0, ENOMEM or EINVAL for unterminated string. Does not
+    // validate grammar. Newline-delimited documents are simply
+    // consecutive top level values.
+    errno_t (*index)(json_index_t* ix, const void* data, int_t bytes);
+    void (*dispose)(json_index_t* ix);
+    void (*cursor)(json_cursor_t* c, const json_index_t* ix);
+    // next token in document order, ':' and ',' are consumed silently
+    json_token_t (*next)(json_cursor_t* c);
+    // skips remainder of object or array just returned by next()
+    void (*skip)(json_cursor_t* c);
+    // numbers via str.to_double() and str.to_int64() (less than 64 bytes)
+    double (*to_double)(const json_token_t* t, errno_t *error);
+    void (*to_int64)(int64_t* v, const json_token_t* t, errno_t *error);
+    // resolves escapes (including \uXXXX surrogate pairs to UTF-8) of
+    // string or key into "to" (at least t->span.bytes), returns bytes
+    // written or -1 for invalid escape
+    int_t (*unescape)(const json_token_t* t, char* to);
+} json_if;
+
+extern json_if json;
+
 typedef struct {
     bool is_debug_build;
 } nposix_if;
@@ -269,3 +916,302 @@ void nposix_test(void);
 #endif
 
 end_c
+
+#if defined(__cplusplus) && __cplusplus >= 201703L && \
+    __has_include(<memory_resource>)
+
+#include <memory_resource>
+#include <new>
+
+namespace nposix {
+
+// heap_if blocks are 16 bytes aligned. Over-aligned requests are padded
+// and the pointer returned by alloc() is kept right before aligned block.
+
+enum { natural_alignment = 16 };
+
+inline void* aligned_alloc(void* (*alloc)(int_t), std::size_t bytes,
+                           std::size_t align) {
+    if (align <= natural_alignment) {
+        void* p = alloc((int_t)bytes);
+        if (p == nullptr) { throw std::bad_alloc(); }
+        return p;
+    }
+    void* p = alloc((int_t)(bytes + align + sizeof(void*)));
+    if (p == nullptr) { throw std::bad_alloc(); }
+    uintptr_t a = ((uintptr_t)p + sizeof(void*) + align - 1) & ~(align - 1);
+    ((void**)a)[-1] = p;
+    return (void*)a;
+}
+
+inline void* unaligned(void* p, std::size_t align) {
+    return align <= natural_alignment ? p : ((void**)p)[-1];
+}
+
+// std::pmr adapter for any heap_if: global heap, numa.heap, scratch.heap,
+// persistent_heap.heap or caller's own arena
+
+class heap_resource : public std::pmr::memory_resource {
+public:
+    explicit heap_resource(heap_if* h = &::heap) noexcept : h_(h) {}
+    heap_if* heap() const noexcept { return h_; }
+private:
+    void* do_allocate(std::size_t bytes, std::size_t align) override {
+        return aligned_alloc(h_->alloc, bytes, align);
+    }
+    void do_deallocate(void* p, std::size_t bytes,
+                       std::size_t align) override {
+        if (align <= natural_alignment && h_->free_sized != nullptr) {
+            h_->free_sized(p, (int_t)bytes);
+        } else {
+            h_->free(unaligned(p, align));
+        }
+    }
+    bool do_is_equal(const std::pmr::memory_resource& o) const
+            noexcept override {
+        const heap_resource* r = dynamic_cast<const heap_resource*>(&o);
+        return r != nullptr && r->h_ == h_;
+    }
+    heap_if* h_;
+};
+
+// Monotonic resource on the per-thread scratch stack: everything is
+// released at once by the destructor (scratch.pop()). Must be created,
+// used and destroyed by the same thread in LIFO order with other
+// scratch users.
+
+class scratch_resource : public std::pmr::memory_resource {
+public:
+    scratch_resource() noexcept : mark_(scratch.mark()) {}
+    ~scratch_resource() override { scratch.pop(mark_); }
+    scratch_resource(const scratch_resource&) = delete;
+    scratch_resource& operator=(const scratch_resource&) = delete;
+private:
+    void* do_allocate(std::size_t bytes, std::size_t align) override {
+        return aligned_alloc(scratch.push, bytes, align);
+    }
+    void do_deallocate(void*, std::size_t, std::size_t) override {}
+    bool do_is_equal(const std::pmr::memory_resource& o) const
+            noexcept override {
+        return this == &o;
+    }
+    int_t mark_;
+};
+
+// Thread safe pool resource: one object_cache per power of 2 size class
+// from 16 to max_block bytes (per-thread magazines, no locks on fast
+// path), larger blocks come from "upstream". Caches are created lazily
+// and disposed by destructor: all blocks must be deallocated by then.
+// object_cache draws from the global heap, so with any other upstream
+// every block goes upstream. A class whose cache could not be created
+// (object_cache_max reached) stays upstream for the life of the pool:
+// deallocation must take the same path as allocation did.
+
+class pool_resource : public std::pmr::memory_resource {
+public:
+    enum { min_shift = 4, max_shift = 10 };
+    enum { classes = max_shift - min_shift + 1 };
+    explicit pool_resource(heap_if* upstream = &::heap) noexcept
+        : upstream_(upstream), pooled_(upstream == &::heap) {
+        for (int i = 0; i < classes; i++) {
+            cache_[i] = nullptr;
+            no_cache_[i] = false;
+        }
+        mutex.init(&lock_);
+    }
+    ~pool_resource() override {
+        for (int i = 0; i < classes; i++) {
+            if (cache_[i] != nullptr) { object_cache.dispose(cache_[i]); }
+        }
+        mutex.dispose(&lock_);
+    }
+    pool_resource(const pool_resource&) = delete;
+    pool_resource& operator=(const pool_resource&) = delete;
+    void reclaim() noexcept { // returns cached blocks to the heap
+        for (int i = 0; i < classes; i++) {
+            object_cache_t* c = cache(i, false);
+            if (c != nullptr) { object_cache.reclaim(c); }
+        }
+    }
+private:
+    static int class_of(std::size_t bytes, std::size_t align) {
+        std::size_t n = bytes < align ? align : bytes;
+        int i = 0;
+        while (((std::size_t)1 << (min_shift + i)) < n) { i++; }
+        return i; // == classes for blocks larger than 1 << max_shift
+    }
+    // null: blocks of class "i" go upstream. Decided once by the first
+    // allocation of the class and never changes after that.
+    object_cache_t* cache(int i, bool create) {
+        object_cache_t* c = __atomic_load_n(&cache_[i], __ATOMIC_ACQUIRE);
+        if (c == nullptr && create &&
+            !__atomic_load_n(&no_cache_[i], __ATOMIC_ACQUIRE)) {
+            mutex.lock(&lock_);
+            c = cache_[i];
+            if (c == nullptr && !no_cache_[i]) {
+                c = object_cache.create((int_t)1 << (min_shift + i),
+                                        nullptr, nullptr, nullptr);
+                if (c != nullptr) {
+                    __atomic_store_n(&cache_[i], c, __ATOMIC_RELEASE);
+                } else {
+                    __atomic_store_n(&no_cache_[i], true, __ATOMIC_RELEASE);
+                }
+            }
+            mutex.unlock(&lock_);
+        }
+        return c;
+    }
+    void* do_allocate(std::size_t bytes, std::size_t align) override {
+        const int i = class_of(bytes, align);
+        // object_cache blocks are heap blocks: 16 bytes aligned
+        object_cache_t* c = pooled_ && i < classes &&
+                            align <= natural_alignment ?
+                            cache(i, true) : nullptr;
+        if (c == nullptr) {
+            return aligned_alloc(upstream_->alloc, bytes, align);
+        }
+        void* p = object_cache.alloc(c);
+        if (p == nullptr) { throw std::bad_alloc(); }
+        return p;
+    }
+    void do_deallocate(void* p, std::size_t bytes,
+                       std::size_t align) override {
+        const int i = class_of(bytes, align);
+        object_cache_t* c = pooled_ && i < classes &&
+                            align <= natural_alignment ?
+                            cache(i, false) : nullptr;
+        if (c != nullptr) {
+            object_cache.free(c, p);
+        } else {
+            upstream_->free(unaligned(p, align));
+        }
+    }
+    bool do_is_equal(const std::pmr::memory_resource& o) const
+            noexcept override {
+        return this == &o;
+    }
+    heap_if* upstream_;
+    const bool pooled_; // upstream is the global heap
+    mutex_t lock_;
+    object_cache_t* cache_[classes];
+    bool no_cache_[classes]; // object_cache.create() failed
+};
+
+// Stateless STL allocator bound to the global heap, e.g.
+// std::vector<int, nposix::heap_allocator<int>>
+
+template <typename T>
+struct heap_allocator {
+    using value_type = T;
+    heap_allocator() noexcept = default;
+    template <typename U>
+    heap_allocator(const heap_allocator<U>&) noexcept {}
+    T* allocate(std::size_t n) {
+        if (n > (std::size_t)INTPTR_MAX / sizeof(T)) {
+            throw std::bad_array_new_length();
+        }
+        return (T*)aligned_alloc(::heap.alloc, n * sizeof(T), alignof(T));
+    }
+    void deallocate(T* p, std::size_t n) noexcept {
+        if (alignof(T) <= natural_alignment) {
+            ::heap.free_sized(p, (int_t)(n * sizeof(T)));
+        } else {
+            ::heap.free(unaligned(p, alignof(T)));
+        }
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const heap_allocator<T>&, const heap_allocator<U>&) noexcept {
+    return true;
+}
+
+template <typename T, typename U>
+bool operator!=(const heap_allocator<T>&, const heap_allocator<U>&) noexcept {
+    return false;
+}
+
+} // namespace nposix
+
+#ifndef NO_TESTS
+
+#include <string>
+#include <vector>
+
+namespace nposix {
+
+inline void test_pmr() {
+    { // size classes of the global heap pool in pmr containers
+        pool_resource pool;
+        std::pmr::vector<std::pmr::string> v(&pool);
+        for (int i = 0; i < 1000; i++) {
+            v.emplace_back(std::string(i % 1500, 'a' + i % 26).c_str());
+        }
+        for (int i = 0; i < 1000; i++) {
+            swear(v[i].size() == (std::size_t)(i % 1500));
+        }
+        void* p = pool.allocate(100, 64); // over-aligned goes upstream
+        swear(((uintptr_t)p & 63) == 0);
+        pool.deallocate(p, 100, 64);
+    }
+    { // no object_cache left: class is served upstream for good
+        object_cache_t* filler[object_cache_max];
+        int n = 0;
+        while (n < object_cache_max) {
+            filler[n] = object_cache.create(8, nullptr, nullptr, nullptr);
+            if (filler[n] == nullptr) { break; }
+            n++;
+        }
+        swear(n > 0);
+        pool_resource pool;
+        void* p = pool.allocate(40);
+        object_cache.dispose(filler[--n]); // a cache can be created again
+        void* q = pool.allocate(40);
+        pool.deallocate(p, 40);
+        void* r[32]; // none of them may be the 40 bytes block "p"
+        for (int i = 0; i < 32; i++) {
+            r[i] = pool.allocate(64);
+            for (int j = 0; j < 64; j++) { ((uint8_t*)r[i])[j] = 0x5A; }
+        }
+        for (int i = 0; i < 32; i++) { pool.deallocate(r[i], 64); }
+        pool.deallocate(q, 40);
+        while (n > 0) { object_cache.dispose(filler[--n]); }
+    }
+    { // every block of a pool over another heap comes from that heap
+        static int allocs;
+        static int frees;
+        heap_if counting = ::heap;
+        counting.alloc = [](int_t bytes) -> void* {
+            allocs++;
+            return ::heap.alloc(bytes);
+        };
+        counting.free = [](void* p) -> void* {
+            frees++;
+            return ::heap.free(p);
+        };
+        pool_resource pool(&counting);
+        void* p = pool.allocate(32);
+        void* q = pool.allocate(4096);
+        swear(allocs == 2);
+        pool.deallocate(p, 32);
+        pool.deallocate(q, 4096);
+        swear(frees == 2);
+    }
+    {
+        std::vector<int, heap_allocator<int>> v;
+        for (int i = 0; i < 10000; i++) { v.push_back(i); }
+        swear(v[9999] == 9999);
+        heap_resource h;
+        scratch_resource sr;
+        std::pmr::vector<int> a(&h);
+        std::pmr::vector<int> b(&sr);
+        for (int i = 0; i < 1000; i++) { a.push_back(i); b.push_back(i); }
+        swear(a == b);
+    }
+}
+
+} // namespace nposix
+
+#endif // NO_TESTS
+
+#endif // __cplusplus >= 201703L
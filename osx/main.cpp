@@ -0,0 +1,10 @@
+// C++17 build of the tests including std::pmr adapters:
+// cc -std=gnu11 -c nposix.c && c++ -std=c++17 -I. osx/main.cpp nposix.o
+#include "nposix.h"
+
+int main() {
+    nposix_test();
+    nposix::test_pmr();
+    traceln("Hello %s", "C++");
+    return 0;
+}